@@ -10,8 +10,16 @@
  * maintainability, testing, and code organization:
  * 
  * - logger: Centralized logging system
+ * - runtime_config: Configuration file overriding config.h, SIGHUP reload
  * - device_manager: BLE device tracking and heartbeat monitoring
  * - bluetooth_server: L2CAP Bluetooth server implementation
+ * - control_server: Control socket and display_system_status()
+ * - health: Health model, systemd watchdog and get_system_health()
+ * - startup: Startup steps run concurrently along dependency edges
+ * - state_file: State kept across restarts (last device token)
+ * - realtime: SCHED_FIFO, CPU pinning, memory locking, latency probe
+ * - simulation: Scenario runner for --simulate (loopback Bluetooth, scripted door)
+ * - timesource: Real or virtual clock behind timers and timestamps
  * - main: System initialization and coordination
  * - config: Centralized configuration management
  * 
@@ -34,6 +42,7 @@
 // ============================================================================
 
 #include "logger.h"
+#include "runtime_config.h"
 #include "device_manager.h"
 #include "bluetooth_server.h"
 
@@ -134,8 +143,9 @@ void display_system_status(DeviceManager *device_manager, BluetoothServer *bluet
  * @param bluetooth_server Pointer to Bluetooth server instance
  * @return 1 if system healthy, 0 if issues detected
  * 
- * Performs health checks on all system components and returns
- * overall system health status.
+ * Checks the door sensor, the Bluetooth server socket and the heartbeat
+ * sweep on demand. The health monitor adds event loop lag and notifier
+ * queue age; see health.h.
  */
 int get_system_health(DeviceManager *device_manager, BluetoothServer *bluetooth_server);
 
@@ -175,8 +185,9 @@ typedef Device BLEDevice;
  * 
  * @note Module Dependencies
  * - logger: No dependencies (can be used standalone)
- * - device_manager: Depends on logger and config
- * - bluetooth_server: Depends on logger, device_manager, and config
+ * - runtime_config: Depends on logger and config
+ * - device_manager: Depends on logger, runtime_config and config
+ * - bluetooth_server: Depends on logger, device_manager, runtime_config and config
  * - main: Coordinates all modules and external dependencies
  * 
  * @note Thread Safety
@@ -190,6 +201,8 @@ typedef Device BLEDevice;
  * - No scattered #define statements
  * - Single point of configuration changes
  * - Consistent parameter usage across modules
+ * Tunable values are defaults; runtime_config_get() returns the values
+ * in effect after the configuration file is applied.
  * 
  * @note Error Handling
  * Comprehensive error handling throughout:
@@ -0,0 +1,600 @@
+/**
+ * @file alloc_stats.c
+ * @brief Implementation of per-subsystem heap accounting
+ *
+ * The wrappers forward to glibc's __libc_* entry points, so allocations
+ * made inside json-c, OpenSSL and curl are charged too. Every block gets
+ * a BLOCK_HEADER_SIZE header in front of the caller's pointer holding the
+ * owning subsystem, the requested size and the distance to the start of
+ * the underlying glibc block. The header keeps malloc's alignment, and
+ * the aligned variants place the caller's pointer further in, so all of
+ * them can be released through the same free().
+ *
+ * The wrappers only touch atomics: nothing on the allocation path may
+ * allocate, log or take a lock. Metrics are updated from a reactor timer.
+ */
+
+#define _GNU_SOURCE
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+#include <malloc.h>
+#include <unistd.h>
+
+#include "alloc_stats.h"
+#include "logger.h"
+#include "metrics.h"
+
+// ============================================================================
+// STATIC VARIABLES
+// ============================================================================
+
+/// Subsystem the calling thread is in
+static __thread AllocSubsystem current_subsystem = ALLOC_SUBSYSTEM_OTHER;
+
+static const char *const subsystem_names[ALLOC_SUBSYSTEM_COUNT] = {
+    "other", "bluetooth", "device_manager", "logger", "reminder", "notifier", "oauth", "control"
+};
+
+#ifdef DOOR_MONITOR_HEAP_STATS
+
+/// Totals per subsystem since start (atomic)
+static AllocSubsystemStats subsystem_stats[ALLOC_SUBSYSTEM_COUNT];
+
+#endif // DOOR_MONITOR_HEAP_STATS
+
+#ifdef DOOR_MONITOR_ALLOC_STATS
+
+/// Allocations per subsystem made by the calling thread
+static __thread uint64_t thread_allocations[ALLOC_SUBSYSTEM_COUNT];
+
+/// Device messages seen, and those checked after warm-up (atomic)
+static uint64_t messages_seen = 0;
+static uint64_t messages_checked = 0;
+
+#endif // DOOR_MONITOR_ALLOC_STATS
+
+#ifdef DOOR_MONITOR_HEAP_STATS
+
+// ============================================================================
+// ALLOCATOR INTERPOSITION
+// ============================================================================
+
+/// Bytes in front of every block; a multiple of malloc's alignment
+#define BLOCK_HEADER_SIZE 16
+
+/// Marks a header written by these wrappers
+#define BLOCK_MAGIC 0xA10Cu
+
+/**
+ * @brief Header in front of every block
+ */
+typedef union {
+    struct {
+        uint16_t magic;                 /// BLOCK_MAGIC while the block is allocated
+        uint16_t subsystem;             /// AllocSubsystem the block is charged to
+        uint32_t offset;                /// Distance from the glibc block to the caller's pointer
+        size_t size;                    /// Bytes requested
+    } info;
+    unsigned char bytes[BLOCK_HEADER_SIZE];
+} BlockHeader;
+
+/// Alignment glibc's malloc already guarantees
+#define MALLOC_MIN_ALIGNMENT (2 * sizeof(size_t))
+
+extern void *__libc_malloc(size_t size);
+extern void *__libc_calloc(size_t count, size_t size);
+extern void *__libc_realloc(void *ptr, size_t size);
+extern void __libc_free(void *ptr);
+
+/**
+ * @brief Charge one block to a subsystem
+ */
+static void charge(AllocSubsystem subsystem, size_t size) {
+    AllocSubsystemStats *stats = &subsystem_stats[subsystem];
+    __atomic_add_fetch(&stats->allocations, 1, __ATOMIC_RELAXED);
+    __atomic_add_fetch(&stats->bytes_allocated, size, __ATOMIC_RELAXED);
+
+    int64_t live = __atomic_add_fetch(&stats->live_bytes, (int64_t)size, __ATOMIC_RELAXED);
+    int64_t peak = __atomic_load_n(&stats->peak_bytes, __ATOMIC_RELAXED);
+    while (live > peak &&
+           !__atomic_compare_exchange_n(&stats->peak_bytes, &peak, live, 1,
+                                        __ATOMIC_RELAXED, __ATOMIC_RELAXED)) {
+    }
+
+#ifdef DOOR_MONITOR_ALLOC_STATS
+    thread_allocations[subsystem]++;
+#endif
+}
+
+/**
+ * @brief Credit a released block to the subsystem it was charged to
+ */
+static void credit(const BlockHeader *header) {
+    AllocSubsystemStats *stats = &subsystem_stats[header->info.subsystem];
+    __atomic_add_fetch(&stats->frees, 1, __ATOMIC_RELAXED);
+    __atomic_sub_fetch(&stats->live_bytes, (int64_t)header->info.size, __ATOMIC_RELAXED);
+}
+
+/**
+ * @brief Write the header of a new block and charge it
+ * @param raw Block returned by glibc
+ * @param offset Distance from raw to the caller's pointer
+ * @param size Bytes requested
+ * @return The caller's pointer
+ */
+static void* finish_block(void *raw, size_t offset, size_t size) {
+    unsigned char *ptr = (unsigned char*)raw + offset;
+    BlockHeader *header = (BlockHeader*)(ptr - BLOCK_HEADER_SIZE);
+    AllocSubsystem subsystem = current_subsystem;
+
+    header->info.magic = BLOCK_MAGIC;
+    header->info.subsystem = (uint16_t)subsystem;
+    header->info.offset = (uint32_t)offset;
+    header->info.size = size;
+    charge(subsystem, size);
+    return ptr;
+}
+
+/**
+ * @brief Find the header of a caller's pointer
+ *
+ * A pointer without a valid header was not allocated here, or was freed
+ * already; releasing it would corrupt the heap, so the process aborts as
+ * glibc would.
+ */
+static BlockHeader* block_header(void *ptr) {
+    BlockHeader *header = (BlockHeader*)((unsigned char*)ptr - BLOCK_HEADER_SIZE);
+    if (header->info.magic != BLOCK_MAGIC) {
+        abort();
+    }
+    return header;
+}
+
+/**
+ * @brief Allocate a block whose caller's pointer is aligned to alignment
+ * @param alignment Power of two
+ */
+static void* aligned_block(size_t alignment, size_t size) {
+    if (alignment <= MALLOC_MIN_ALIGNMENT) {
+        return malloc(size);
+    }
+    if (alignment > UINT32_MAX / 2 || size > SIZE_MAX - BLOCK_HEADER_SIZE - alignment) {
+        errno = ENOMEM;
+        return NULL;
+    }
+
+    unsigned char *raw = __libc_malloc(size + BLOCK_HEADER_SIZE + alignment);
+    if (!raw) {
+        return NULL;
+    }
+    uintptr_t ptr = ((uintptr_t)raw + BLOCK_HEADER_SIZE + alignment - 1) & ~(uintptr_t)(alignment - 1);
+    return finish_block(raw, ptr - (uintptr_t)raw, size);
+}
+
+void *malloc(size_t size) {
+    if (size > SIZE_MAX - BLOCK_HEADER_SIZE) {
+        errno = ENOMEM;
+        return NULL;
+    }
+    void *raw = __libc_malloc(size + BLOCK_HEADER_SIZE);
+    return raw ? finish_block(raw, BLOCK_HEADER_SIZE, size) : NULL;
+}
+
+void *calloc(size_t count, size_t size) {
+    if (size != 0 && count > (SIZE_MAX - BLOCK_HEADER_SIZE) / size) {
+        errno = ENOMEM;
+        return NULL;
+    }
+    void *raw = __libc_calloc(1, count * size + BLOCK_HEADER_SIZE);
+    return raw ? finish_block(raw, BLOCK_HEADER_SIZE, count * size) : NULL;
+}
+
+void *realloc(void *ptr, size_t size) {
+    if (!ptr) {
+        return malloc(size);
+    }
+    if (size == 0) {
+        free(ptr);
+        return NULL;
+    }
+    if (size > SIZE_MAX - BLOCK_HEADER_SIZE) {
+        errno = ENOMEM;
+        return NULL;
+    }
+
+    BlockHeader *header = block_header(ptr);
+    BlockHeader previous = *header;
+
+    // glibc cannot resize an aligned block, whose start is not its own
+    if (previous.info.offset != BLOCK_HEADER_SIZE) {
+        void *moved = malloc(size);
+        if (moved) {
+            memcpy(moved, ptr, size < previous.info.size ? size : previous.info.size);
+            free(ptr);
+        }
+        return moved;
+    }
+
+    void *raw = __libc_realloc(header, size + BLOCK_HEADER_SIZE);
+    if (!raw) {
+        return NULL;
+    }
+    credit(&previous);
+    return finish_block(raw, BLOCK_HEADER_SIZE, size);
+}
+
+void free(void *ptr) {
+    if (!ptr) {
+        return;
+    }
+    BlockHeader *header = block_header(ptr);
+    credit(header);
+    header->info.magic = 0;
+    __libc_free((unsigned char*)ptr - header->info.offset);
+}
+
+int posix_memalign(void **memptr, size_t alignment, size_t size) {
+    if (alignment == 0 || (alignment & (alignment - 1)) != 0 || alignment % sizeof(void*) != 0) {
+        return EINVAL;
+    }
+    void *ptr = aligned_block(alignment, size);
+    if (!ptr) {
+        return ENOMEM;
+    }
+    *memptr = ptr;
+    return 0;
+}
+
+void *aligned_alloc(size_t alignment, size_t size) {
+    if (alignment == 0 || (alignment & (alignment - 1)) != 0) {
+        errno = EINVAL;
+        return NULL;
+    }
+    return aligned_block(alignment, size);
+}
+
+void *memalign(size_t alignment, size_t size) {
+    // Like glibc, round an alignment that is not a power of two up
+    size_t power = 1;
+    while (power < alignment && power <= SIZE_MAX / 2) {
+        power <<= 1;
+    }
+    return aligned_block(power, size);
+}
+
+void *valloc(size_t size) {
+    return aligned_block((size_t)getpagesize(), size);
+}
+
+void *pvalloc(size_t size) {
+    size_t page = (size_t)getpagesize();
+    if (size > SIZE_MAX - page) {
+        errno = ENOMEM;
+        return NULL;
+    }
+    return aligned_block(page, size ? (size + page - 1) & ~(page - 1) : page);
+}
+
+size_t malloc_usable_size(void *ptr) {
+    return ptr ? block_header(ptr)->info.size : 0;
+}
+
+// ============================================================================
+// METRICS AND TREND
+// ============================================================================
+
+/**
+ * @brief Metrics of one subsystem
+ */
+typedef struct {
+    Metric live;                        /// Bytes currently allocated
+    Metric peak;                        /// Highest live value
+    Metric allocations;                 /// Blocks allocated
+    Metric bytes;                       /// Bytes requested
+    Metric floor_growth;                /// Fitted floor growth per trend window
+    Metric growing;                     /// 1 while the floor trends up
+} SubsystemMetrics;
+
+#define SUBSYSTEM_LABEL(name) "subsystem=\"" name "\""
+
+#define SUBSYSTEM_METRICS_INIT(name) { \
+    METRIC_GAUGE_INIT_LABELED("heap_live_bytes", "Heap bytes currently allocated", \
+                              SUBSYSTEM_LABEL(name)), \
+    METRIC_GAUGE_INIT_LABELED("heap_peak_bytes", "Highest heap bytes allocated at once", \
+                              SUBSYSTEM_LABEL(name)), \
+    METRIC_COUNTER_INIT_LABELED("heap_allocations_total", "Heap blocks allocated", \
+                                SUBSYSTEM_LABEL(name)), \
+    METRIC_COUNTER_INIT_LABELED("heap_allocated_bytes_total", "Heap bytes requested", \
+                                SUBSYSTEM_LABEL(name)), \
+    METRIC_GAUGE_INIT_LABELED("heap_floor_growth_bytes", \
+                              "Fitted growth of the lowest live bytes per trend window", \
+                              SUBSYSTEM_LABEL(name)), \
+    METRIC_GAUGE_INIT_LABELED("heap_growing", "1 while live bytes trend upward", \
+                              SUBSYSTEM_LABEL(name)) }
+
+/// Same order as AllocSubsystem and subsystem_names
+static SubsystemMetrics subsystem_metrics[ALLOC_SUBSYSTEM_COUNT] = {
+    SUBSYSTEM_METRICS_INIT("other"),
+    SUBSYSTEM_METRICS_INIT("bluetooth"),
+    SUBSYSTEM_METRICS_INIT("device_manager"),
+    SUBSYSTEM_METRICS_INIT("logger"),
+    SUBSYSTEM_METRICS_INIT("reminder"),
+    SUBSYSTEM_METRICS_INIT("notifier"),
+    SUBSYSTEM_METRICS_INIT("oauth"),
+    SUBSYSTEM_METRICS_INIT("control"),
+};
+
+/**
+ * @brief Growth tracking of one subsystem (reactor thread only)
+ */
+typedef struct {
+    int64_t window_floor;               /// Lowest live value in the current window
+    int64_t floors[HEAP_TREND_WINDOWS]; /// Floors of completed windows, oldest first
+    int floor_count;                    /// Valid entries in floors
+    int growing;                        /// Floor is trending up
+    uint64_t published_allocations;     /// Counter values already added to the metrics
+    uint64_t published_bytes;
+} SubsystemTrend;
+
+static SubsystemTrend subsystem_trends[ALLOC_SUBSYSTEM_COUNT];
+
+static Reactor *sample_reactor = NULL;
+static int sample_timer_id = 0;
+static int window_samples = 0;          /// Samples taken in the current window
+static int warmed_up = 0;               /// The first window, which covers startup, has passed
+
+/**
+ * @brief Least-squares slope of the floors, in bytes per window
+ */
+static double floor_slope(const int64_t *floors, int count) {
+    if (count < 2) {
+        return 0.0;
+    }
+
+    double mean_x = (count - 1) / 2.0;
+    double mean_y = 0.0;
+    for (int i = 0; i < count; i++) {
+        mean_y += (double)floors[i];
+    }
+    mean_y /= count;
+
+    double sxy = 0.0;
+    double sxx = 0.0;
+    for (int i = 0; i < count; i++) {
+        double dx = i - mean_x;
+        sxy += dx * ((double)floors[i] - mean_y);
+        sxx += dx * dx;
+    }
+    return sxy / sxx;
+}
+
+/**
+ * @brief Close the current window of a subsystem and re-evaluate its trend
+ */
+static void close_window(AllocSubsystem subsystem) {
+    SubsystemTrend *trend = &subsystem_trends[subsystem];
+    SubsystemMetrics *metrics = &subsystem_metrics[subsystem];
+
+    if (trend->floor_count == HEAP_TREND_WINDOWS) {
+        memmove(trend->floors, trend->floors + 1, (HEAP_TREND_WINDOWS - 1) * sizeof(int64_t));
+        trend->floor_count--;
+    }
+    trend->floors[trend->floor_count++] = trend->window_floor;
+    trend->window_floor = INT64_MAX;
+
+    double slope = floor_slope(trend->floors, trend->floor_count);
+    metrics_gauge_set(&metrics->floor_growth, (int64_t)slope);
+
+    // Judge only a full history; clear at half the threshold so it does not flap
+    if (trend->floor_count < HEAP_TREND_WINDOWS) {
+        return;
+    }
+    int64_t oldest = trend->floors[0];
+    int64_t newest = trend->floors[trend->floor_count - 1];
+    double rise = slope * (trend->floor_count - 1);
+
+    if (!trend->growing && rise >= HEAP_TREND_MIN_GROWTH_BYTES && newest > oldest) {
+        trend->growing = 1;
+        metrics_gauge_set(&metrics->growing, 1);
+        LOG_WARN("Heap: %s live bytes trending up: floor %lld -> %lld bytes over %d windows "
+                 "(%+.0f bytes per %d s)",
+                 subsystem_names[subsystem], (long long)oldest, (long long)newest,
+                 trend->floor_count, slope, HEAP_TREND_WINDOW_S);
+    } else if (trend->growing && rise < HEAP_TREND_MIN_GROWTH_BYTES / 2) {
+        trend->growing = 0;
+        metrics_gauge_set(&metrics->growing, 0);
+        LOG_INFO("Heap: %s live bytes no longer trending up (floor %lld bytes)",
+                 subsystem_names[subsystem], (long long)newest);
+    }
+}
+
+/**
+ * @brief Reactor timer: publish the totals and track the window floors
+ */
+static void sample_timer(void *userdata) {
+    (void)userdata;
+
+    int window_done = ++window_samples >= HEAP_TREND_WINDOW_S * 1000LL / HEAP_STATS_INTERVAL_MS;
+    if (window_done) {
+        window_samples = 0;
+    }
+
+    // Startup fills caches and pools; its window is not a floor
+    int discard = window_done && !warmed_up;
+    if (discard) {
+        warmed_up = 1;
+    }
+
+    for (int i = 0; i < ALLOC_SUBSYSTEM_COUNT; i++) {
+        AllocSubsystemStats stats;
+        alloc_stats_read((AllocSubsystem)i, &stats);
+        SubsystemTrend *trend = &subsystem_trends[i];
+        SubsystemMetrics *metrics = &subsystem_metrics[i];
+
+        metrics_gauge_set(&metrics->live, stats.live_bytes);
+        metrics_gauge_set(&metrics->peak, stats.peak_bytes);
+        metrics_counter_add(&metrics->allocations, stats.allocations - trend->published_allocations);
+        metrics_counter_add(&metrics->bytes, stats.bytes_allocated - trend->published_bytes);
+        trend->published_allocations = stats.allocations;
+        trend->published_bytes = stats.bytes_allocated;
+
+        if (stats.live_bytes < trend->window_floor) {
+            trend->window_floor = stats.live_bytes;
+        }
+        if (discard) {
+            trend->window_floor = INT64_MAX;
+        } else if (window_done) {
+            close_window((AllocSubsystem)i);
+        }
+    }
+}
+
+#endif // DOOR_MONITOR_HEAP_STATS
+
+// ============================================================================
+// PUBLIC API
+// ============================================================================
+
+AllocSubsystem alloc_stats_enter(AllocSubsystem subsystem) {
+    AllocSubsystem previous = current_subsystem;
+    current_subsystem = subsystem;
+    return previous;
+}
+
+void alloc_stats_leave(AllocSubsystem *previous) {
+    current_subsystem = *previous;
+}
+
+const char* alloc_stats_subsystem_name(AllocSubsystem subsystem) {
+    if ((int)subsystem < 0 || subsystem >= ALLOC_SUBSYSTEM_COUNT) {
+        return "unknown";
+    }
+    return subsystem_names[subsystem];
+}
+
+void alloc_stats_read(AllocSubsystem subsystem, AllocSubsystemStats *stats) {
+    memset(stats, 0, sizeof(*stats));
+#ifdef DOOR_MONITOR_HEAP_STATS
+    if ((int)subsystem < 0 || subsystem >= ALLOC_SUBSYSTEM_COUNT) {
+        return;
+    }
+    const AllocSubsystemStats *totals = &subsystem_stats[subsystem];
+    stats->allocations = __atomic_load_n(&totals->allocations, __ATOMIC_RELAXED);
+    stats->frees = __atomic_load_n(&totals->frees, __ATOMIC_RELAXED);
+    stats->bytes_allocated = __atomic_load_n(&totals->bytes_allocated, __ATOMIC_RELAXED);
+    stats->live_bytes = __atomic_load_n(&totals->live_bytes, __ATOMIC_RELAXED);
+    stats->peak_bytes = __atomic_load_n(&totals->peak_bytes, __ATOMIC_RELAXED);
+#else
+    (void)subsystem;
+#endif
+}
+
+int alloc_stats_init(Reactor *reactor) {
+#ifdef DOOR_MONITOR_HEAP_STATS
+    if (!reactor) {
+        return ERROR_INVALID_PARAM;
+    }
+
+    for (int i = 0; i < ALLOC_SUBSYSTEM_COUNT; i++) {
+        Metric *const metrics[] = {
+            &subsystem_metrics[i].live, &subsystem_metrics[i].peak,
+            &subsystem_metrics[i].allocations, &subsystem_metrics[i].bytes,
+            &subsystem_metrics[i].floor_growth, &subsystem_metrics[i].growing
+        };
+        if (metrics_register_all(metrics, (int)(sizeof(metrics) / sizeof(metrics[0]))) != 0) {
+            LOG_WARN("Heap accounting: metrics registry full");
+        }
+        subsystem_trends[i].window_floor = INT64_MAX;
+    }
+
+    int timer_id = reactor_add_timer(reactor, HEAP_STATS_INTERVAL_MS, HEAP_STATS_INTERVAL_MS,
+                                     sample_timer, NULL);
+    if (timer_id < 0) {
+        LOG_ERROR("Heap accounting: cannot schedule sampling timer");
+        return ERROR_GENERIC;
+    }
+    sample_reactor = reactor;
+    sample_timer_id = timer_id;
+    sample_timer(NULL);
+
+    LOG_INFO("Heap accounting: %d subsystems, trend over %d windows of %d s",
+             ALLOC_SUBSYSTEM_COUNT, HEAP_TREND_WINDOWS, HEAP_TREND_WINDOW_S);
+#else
+    (void)reactor;
+    LOG_INFO("Heap accounting not built in");
+#endif
+    return 0;
+}
+
+void alloc_stats_cleanup(void) {
+#ifdef DOOR_MONITOR_HEAP_STATS
+    if (sample_timer_id > 0) {
+        reactor_cancel_timer(sample_reactor, sample_timer_id);
+        sample_timer_id = 0;
+    }
+    sample_reactor = NULL;
+#endif
+}
+
+void alloc_stats_message_begin(AllocSnapshot *snapshot) {
+#ifdef DOOR_MONITOR_ALLOC_STATS
+    memcpy(snapshot->allocations, thread_allocations, sizeof(snapshot->allocations));
+#else
+    (void)snapshot;
+#endif
+}
+
+void alloc_stats_message_end(const AllocSnapshot *snapshot) {
+#ifdef DOOR_MONITOR_ALLOC_STATS
+    uint64_t message = __atomic_add_fetch(&messages_seen, 1, __ATOMIC_RELAXED);
+    if (message <= ALLOC_CHECK_WARMUP_MESSAGES) {
+        return;
+    }
+
+    uint64_t delta[ALLOC_SUBSYSTEM_COUNT];
+    uint64_t total = 0;
+    for (int i = 0; i < ALLOC_SUBSYSTEM_COUNT; i++) {
+        delta[i] = thread_allocations[i] - snapshot->allocations[i];
+        total += delta[i];
+    }
+
+    if (total == 0) {
+        __atomic_add_fetch(&messages_checked, 1, __ATOMIC_RELAXED);
+        return;
+    }
+
+    // The failure path may allocate: the daemon aborts right after
+    char detail[256];
+    size_t length = 0;
+    for (int i = 0; i < ALLOC_SUBSYSTEM_COUNT && length < sizeof(detail); i++) {
+        length += (size_t)snprintf(detail + length, sizeof(detail) - length, "%s%s %llu",
+                                   i ? ", " : "", subsystem_names[i],
+                                   (unsigned long long)delta[i]);
+    }
+    LOG_ERROR("Allocation check failed: message %llu allocated %llu times after warm-up (%s)",
+              (unsigned long long)message, (unsigned long long)total, detail);
+    abort();
+#else
+    (void)snapshot;
+#endif
+}
+
+void alloc_stats_report(void) {
+#ifdef DOOR_MONITOR_HEAP_STATS
+    for (int i = 0; i < ALLOC_SUBSYSTEM_COUNT; i++) {
+        AllocSubsystemStats stats;
+        alloc_stats_read((AllocSubsystem)i, &stats);
+        LOG_INFO("Allocations: %-14s %10llu allocations %12llu bytes %10lld live %10lld peak",
+                 subsystem_names[i], (unsigned long long)stats.allocations,
+                 (unsigned long long)stats.bytes_allocated,
+                 (long long)stats.live_bytes, (long long)stats.peak_bytes);
+    }
+#endif
+#ifdef DOOR_MONITOR_ALLOC_STATS
+    LOG_INFO("Allocations: %llu device messages checked after %d warm-up messages, none allocated",
+             (unsigned long long)__atomic_load_n(&messages_checked, __ATOMIC_RELAXED),
+             ALLOC_CHECK_WARMUP_MESSAGES);
+#endif
+}
@@ -0,0 +1,187 @@
+/**
+ * @file alloc_stats.h
+ * @brief Per-subsystem heap accounting
+ *
+ * A gateway that runs for weeks must be able to tell which module owns
+ * its heap: json-c documents in the control socket, curl buffers and JWT
+ * strings in the notifier, log formatting and so on. Built with
+ * -DDOOR_MONITOR_HEAP_STATS (the Makefile default; WITHOUT_HEAP_STATS=1
+ * drops it), this module wraps malloc() and friends and charges every
+ * block to the subsystem the calling thread is in, as declared by
+ * ALLOC_SCOPE() at the subsystem's entry points. Each block carries a
+ * small header naming its subsystem and size, so a free is credited to
+ * the subsystem that allocated the block, whichever thread releases it.
+ *
+ * Per subsystem the reactor publishes live bytes, peak live bytes and the
+ * allocation count on the metrics endpoint. It also records the lowest
+ * live value of every HEAP_TREND_WINDOW_S window: buffers come and go,
+ * but a leak raises that floor. A subsystem whose floors rise by at least
+ * HEAP_TREND_MIN_GROWTH_BYTES across the last HEAP_TREND_WINDOWS windows
+ * is flagged in heap_growing and logged.
+ *
+ * Built with -DDOOR_MONITOR_ALLOC_STATS as well (make alloc-check), the
+ * Bluetooth server brackets each received message with
+ * ALLOC_MESSAGE_BEGIN()/ALLOC_MESSAGE_END(); after
+ * ALLOC_CHECK_WARMUP_MESSAGES messages, a message that allocated logs the
+ * per-subsystem counts and aborts the daemon.
+ *
+ * Sanitizer builds keep their own allocator, so both options are ignored
+ * there. Without them the macros expand to nothing, the allocator is not
+ * touched and the functions below do nothing.
+ *
+ * Threading:
+ * The current subsystem and the per-message counts are thread-local, the
+ * totals are atomic. alloc_stats_init() and alloc_stats_cleanup() run on
+ * the reactor thread; the rest may be called from any thread.
+ */
+
+#ifndef ALLOC_STATS_H
+#define ALLOC_STATS_H
+
+#include <stdint.h>
+
+#include "config.h"
+#include "reactor.h"
+
+// The allocation check builds on the accounting allocator
+#if defined(DOOR_MONITOR_ALLOC_STATS) && !defined(DOOR_MONITOR_HEAP_STATS)
+#define DOOR_MONITOR_HEAP_STATS
+#endif
+
+// AddressSanitizer and ThreadSanitizer replace malloc themselves
+#if defined(__SANITIZE_ADDRESS__) || defined(__SANITIZE_THREAD__)
+#undef DOOR_MONITOR_HEAP_STATS
+#undef DOOR_MONITOR_ALLOC_STATS
+#endif
+
+// ============================================================================
+// DATA STRUCTURES
+// ============================================================================
+
+/**
+ * @brief Subsystems allocations are charged to
+ */
+typedef enum {
+    ALLOC_SUBSYSTEM_OTHER = 0,          /// Outside any declared scope
+    ALLOC_SUBSYSTEM_BLUETOOTH,          /// Bluetooth server (accept, receive)
+    ALLOC_SUBSYSTEM_DEVICE_MANAGER,     /// Device registry and message parsing
+    ALLOC_SUBSYSTEM_LOGGER,             /// Log formatting and output
+    ALLOC_SUBSYSTEM_REMINDER,           /// Reminder policy
+    ALLOC_SUBSYSTEM_NOTIFIER,           /// FCM requests and the HTTP stack
+    ALLOC_SUBSYSTEM_OAUTH,              /// Service account parsing, JWT signing, token responses
+    ALLOC_SUBSYSTEM_CONTROL,            /// Control socket and metrics endpoint
+    ALLOC_SUBSYSTEM_COUNT
+} AllocSubsystem;
+
+/**
+ * @brief Per-thread allocation counts at the start of a message
+ */
+typedef struct {
+    uint64_t allocations[ALLOC_SUBSYSTEM_COUNT];
+} AllocSnapshot;
+
+/**
+ * @brief Heap totals of one subsystem since start
+ */
+typedef struct {
+    uint64_t allocations;               /// Blocks allocated (realloc counts as one)
+    uint64_t frees;                     /// Blocks released (realloc counts as one)
+    uint64_t bytes_allocated;           /// Bytes requested
+    int64_t live_bytes;                 /// Bytes currently allocated
+    int64_t peak_bytes;                 /// Highest live_bytes seen
+} AllocSubsystemStats;
+
+// ============================================================================
+// MACROS
+// ============================================================================
+
+#ifdef DOOR_MONITOR_HEAP_STATS
+
+/// Charge allocations to subsystem until the enclosing block exits (one per block)
+#define ALLOC_SCOPE(subsystem) \
+    AllocSubsystem alloc_scope_previous __attribute__((cleanup(alloc_stats_leave), unused)) = \
+        alloc_stats_enter(subsystem)
+
+#else
+
+#define ALLOC_SCOPE(subsystem) ((void)0)
+
+#endif // DOOR_MONITOR_HEAP_STATS
+
+#ifdef DOOR_MONITOR_ALLOC_STATS
+
+/// Start counting the allocations of one device message
+#define ALLOC_MESSAGE_BEGIN(snapshot) alloc_stats_message_begin(snapshot)
+
+/// Finish a device message; aborts if it allocated after warm-up
+#define ALLOC_MESSAGE_END(snapshot) alloc_stats_message_end(snapshot)
+
+#else
+
+#define ALLOC_MESSAGE_BEGIN(snapshot) ((void)(snapshot))
+#define ALLOC_MESSAGE_END(snapshot) ((void)(snapshot))
+
+#endif // DOOR_MONITOR_ALLOC_STATS
+
+// ============================================================================
+// PUBLIC API
+// ============================================================================
+
+/**
+ * @brief Make subsystem current for the calling thread
+ * @return The previous subsystem, for alloc_stats_leave()
+ */
+AllocSubsystem alloc_stats_enter(AllocSubsystem subsystem);
+
+/**
+ * @brief Restore the subsystem saved by alloc_stats_enter()
+ */
+void alloc_stats_leave(AllocSubsystem *previous);
+
+/**
+ * @brief Get the name a subsystem is reported under
+ * @param subsystem Subsystem
+ * @return Static name (e.g. "device_manager")
+ */
+const char* alloc_stats_subsystem_name(AllocSubsystem subsystem);
+
+/**
+ * @brief Read the heap totals of one subsystem
+ * @param subsystem Subsystem to read
+ * @param stats Filled with the current values (all zero without accounting)
+ */
+void alloc_stats_read(AllocSubsystem subsystem, AllocSubsystemStats *stats);
+
+/**
+ * @brief Publish the totals as metrics and start watching for growth
+ * @param reactor Event loop running the sampling timer
+ * @return 0 on success or when accounting is not built in, negative on error
+ */
+int alloc_stats_init(Reactor *reactor);
+
+/**
+ * @brief Stop the sampling timer
+ *
+ * Must run before the reactor is cleaned up. Blocks stay accounted.
+ */
+void alloc_stats_cleanup(void);
+
+/**
+ * @brief Record the calling thread's counts at the start of a message
+ */
+void alloc_stats_message_begin(AllocSnapshot *snapshot);
+
+/**
+ * @brief Check the allocations made since alloc_stats_message_begin()
+ */
+void alloc_stats_message_end(const AllocSnapshot *snapshot);
+
+/**
+ * @brief Log heap totals per subsystem, and the messages checked in
+ *        alloc-check builds
+ *
+ * Does nothing unless built with DOOR_MONITOR_HEAP_STATS.
+ */
+void alloc_stats_report(void);
+
+#endif // ALLOC_STATS_H
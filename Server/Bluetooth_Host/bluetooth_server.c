@@ -8,6 +8,10 @@
  */
 
 #include "bluetooth_server.h"
+#include "runtime_config.h"
+#include "trace.h"
+#include "metrics.h"
+#include "alloc_stats.h"
 
 // ============================================================================
 // STATIC VARIABLES AND ERROR HANDLING
@@ -15,6 +19,37 @@
 
 static char last_error_message[256] = "No error";
 
+/**
+ * @brief Peer address of either transport
+ */
+typedef union {
+    struct sockaddr generic;
+    struct sockaddr_l2 l2;
+    struct sockaddr_un un;
+} PeerAddress;
+
+static Metric connections_accepted = METRIC_COUNTER_INIT("bt_connections_accepted_total",
+    "L2CAP connections accepted from new devices");
+static Metric reconnections = METRIC_COUNTER_INIT("bt_reconnections_total",
+    "L2CAP connections from already known devices");
+static Metric connections_rejected = METRIC_COUNTER_INIT("bt_connections_rejected_total",
+    "Connections rejected because the device manager was full");
+static Metric accept_errors = METRIC_COUNTER_INIT("bt_accept_errors_total",
+    "Failed accept() calls and device registrations");
+static Metric messages_received = METRIC_COUNTER_INIT("bt_messages_received_total",
+    "Non-empty reads from client sockets");
+static Metric received_bytes = METRIC_COUNTER_INIT("bt_bytes_received_total",
+    "Bytes read from client sockets");
+static Metric receive_errors = METRIC_COUNTER_INIT("bt_receive_errors_total",
+    "Failed recv() calls on client sockets");
+static Metric disconnects = METRIC_COUNTER_INIT("bt_disconnects_total",
+    "Client disconnections handled");
+
+static Metric *const server_metrics[] = {
+    &connections_accepted, &reconnections, &connections_rejected, &accept_errors,
+    &messages_received, &received_bytes, &receive_errors, &disconnects
+};
+
 /**
  * @brief Set last error message for debugging
  * @param format Printf-style format string
@@ -37,8 +72,9 @@ int bluetooth_server_validate_config(const BluetoothServerConfig *config) {
         return ERROR_INVALID_PARAM;
     }
     
-    if (config->psm < 0x1001 || config->psm > 0xFFFF) {
-        set_last_error("Invalid PSM value: 0x%04X (must be >= 0x1001)", config->psm);
+    // psm is a uint16_t, so BLE_PSM_MAX (0xFFFF) holds by type
+    if (config->psm < BLE_PSM_MIN) {
+        set_last_error("Invalid PSM value: 0x%04X (must be >= 0x%04X)", config->psm, BLE_PSM_MIN);
         return ERROR_INVALID_PARAM;
     }
     
@@ -47,8 +83,8 @@ int bluetooth_server_validate_config(const BluetoothServerConfig *config) {
         return ERROR_INVALID_PARAM;
     }
     
-    if (config->select_timeout_sec < 1 || config->select_timeout_sec > 60) {
-        set_last_error("Invalid select timeout: %d (must be 1-60 seconds)", config->select_timeout_sec);
+    if (memchr(config->loopback_path, '\0', sizeof(config->loopback_path)) == NULL) {
+        set_last_error("Loopback path is not terminated");
         return ERROR_INVALID_PARAM;
     }
     
@@ -80,17 +116,41 @@ int bluetooth_server_init(BluetoothServer *server, DeviceManager *device_manager
     
     LOG_INFO("Initializing Bluetooth server...");
     
-    // Initialize with default configuration
+    // Initialize with the runtime configuration
+    const RuntimeConfig *runtime = runtime_config_get();
     BluetoothServerConfig default_config = {
-        .psm = BLE_PSM,
-        .max_devices = MAX_DEVICES,
-        .select_timeout_sec = NETWORK_SELECT_TIMEOUT,
+        .psm = (uint16_t)runtime->ble_psm,
+        .max_devices = runtime->max_devices,
         .socket_reuse_addr = 1
     };
     
     return bluetooth_server_init_with_config(server, device_manager, &default_config);
 }
 
+int bluetooth_server_init_loopback(BluetoothServer *server, DeviceManager *device_manager,
+                                   const char *path) {
+    if (!server || !device_manager || !path || path[0] == '\0') {
+        set_last_error("Invalid parameters");
+        return ERROR_INVALID_PARAM;
+    }
+    
+    LOG_INFO("Initializing Bluetooth server (loopback transport)...");
+    
+    const RuntimeConfig *runtime = runtime_config_get();
+    BluetoothServerConfig loopback_config = {
+        .psm = (uint16_t)runtime->ble_psm,
+        .max_devices = runtime->max_devices,
+        .socket_reuse_addr = 0
+    };
+    if (strlen(path) >= sizeof(loopback_config.loopback_path)) {
+        set_last_error("Loopback path too long: %s", path);
+        return ERROR_INVALID_PARAM;
+    }
+    snprintf(loopback_config.loopback_path, sizeof(loopback_config.loopback_path), "%s", path);
+    
+    return bluetooth_server_init_with_config(server, device_manager, &loopback_config);
+}
+
 int bluetooth_server_init_with_config(BluetoothServer *server, DeviceManager *device_manager, 
                                      const BluetoothServerConfig *config) {
     if (!server || !device_manager || !config) {
@@ -112,7 +172,47 @@ int bluetooth_server_init_with_config(BluetoothServer *server, DeviceManager *de
     server->device_manager = device_manager;
     server->running = 0;
     
-    LOG_INFO("Bluetooth server initialized with PSM 0x%04X", config->psm);
+    metrics_register_all(server_metrics, sizeof(server_metrics) / sizeof(server_metrics[0]));
+    
+    if (config->loopback_path[0] != '\0') {
+        LOG_INFO("Bluetooth server initialized on loopback socket %s", config->loopback_path);
+    } else {
+        LOG_INFO("Bluetooth server initialized with PSM 0x%04X", config->psm);
+    }
+    return SUCCESS;
+}
+
+/**
+ * @brief Create the listening socket of the loopback transport
+ * @param server Pointer to BluetoothServer structure
+ * @return 0 on success, negative on error
+ */
+static int create_loopback_socket(BluetoothServer *server) {
+    struct sockaddr_un addr = {0};
+    addr.sun_family = AF_UNIX;
+    // Terminated within sizeof(sun_path) (see bluetooth_server_validate_config())
+    snprintf(addr.sun_path, sizeof(addr.sun_path), "%s", server->config.loopback_path);
+    
+    server->server_socket = socket(AF_UNIX, SOCK_SEQPACKET | SOCK_CLOEXEC, 0);
+    if (server->server_socket < 0) {
+        set_last_error("Failed to create loopback socket: %s", strerror(errno));
+        LOG_ERROR("Socket creation failed: %s", last_error_message);
+        return ERROR_NETWORK;
+    }
+    
+    // A previous run may have left its socket file behind
+    unlink(addr.sun_path);
+    
+    if (bind(server->server_socket, (struct sockaddr *)&addr, sizeof(addr)) < 0 ||
+        listen(server->server_socket, server->config.max_devices) < 0) {
+        set_last_error("Failed to listen on %s: %s", addr.sun_path, strerror(errno));
+        LOG_ERROR("Socket bind failed: %s", last_error_message);
+        close(server->server_socket);
+        server->server_socket = -1;
+        return ERROR_NETWORK;
+    }
+    
+    LOG_INFO("Bluetooth server socket listening on loopback %s", addr.sun_path);
     return SUCCESS;
 }
 
@@ -124,6 +224,10 @@ int bluetooth_server_create_socket(BluetoothServer *server) {
     
     LOG_INFO("Creating Bluetooth server socket...");
     
+    if (server->config.loopback_path[0] != '\0') {
+        return create_loopback_socket(server);
+    }
+    
     // Create L2CAP socket
     server->server_socket = socket(AF_BLUETOOTH, SOCK_SEQPACKET, BTPROTO_L2CAP);
     if (server->server_socket < 0) {
@@ -200,10 +304,14 @@ void bluetooth_server_stop(BluetoothServer *server) {
     
     server->running = 0;
     
-    // Close server socket to break out of select() calls
+    // Stop accepting connections
     if (server->server_socket >= 0) {
+        bluetooth_server_release_socket(server, server->server_socket);
         close(server->server_socket);
         server->server_socket = -1;
+        if (server->config.loopback_path[0] != '\0') {
+            unlink(server->config.loopback_path);
+        }
     }
     
     LOG_INFO("Bluetooth server stopped");
@@ -230,20 +338,56 @@ void bluetooth_server_cleanup(BluetoothServer *server) {
 // UTILITY FUNCTIONS
 // ============================================================================
 
+/**
+ * @brief Format the MAC address of a peer of either transport
+ * @param addr Peer address from accept() or getpeername()
+ * @param addr_len Length returned with it
+ * @param client_socket Client socket, used for unnamed loopback peers
+ * @param mac_address Output buffer of at least 18 bytes
+ */
+static void peer_to_mac(const PeerAddress *addr, socklen_t addr_len, int client_socket,
+                        char *mac_address) {
+    if (addr->generic.sa_family != AF_UNIX) {
+        ba2str(&addr->l2.l2_bdaddr, mac_address);
+        return;
+    }
+    
+    // Abstract name: a leading NUL, then the prefix, then ".../<MAC>"
+    size_t name_len = addr_len > offsetof(struct sockaddr_un, sun_path)
+                    ? addr_len - offsetof(struct sockaddr_un, sun_path) : 0;
+    size_t prefix_len = strlen(BT_LOOPBACK_CLIENT_PREFIX);
+    if (name_len > prefix_len + 1 && addr->un.sun_path[0] == '\0' &&
+        memcmp(addr->un.sun_path + 1, BT_LOOPBACK_CLIENT_PREFIX, prefix_len) == 0) {
+        char name[sizeof(addr->un.sun_path)];
+        memcpy(name, addr->un.sun_path + 1, name_len - 1);
+        name[name_len - 1] = '\0';
+        
+        const char *mac = strrchr(name, '/') + 1;
+        if (bachk(mac) == 0) {
+            snprintf(mac_address, 18, "%s", mac);
+            return;
+        }
+    }
+    
+    snprintf(mac_address, 18, "02:00:00:00:%02X:%02X",
+             (client_socket >> 8) & 0xFF, client_socket & 0xFF);
+}
+
 int bluetooth_server_get_client_mac(int client_socket, char *mac_address) {
     if (client_socket < 0 || !mac_address) {
         return ERROR_INVALID_PARAM;
     }
     
-    struct sockaddr_l2 rem_addr = {0};
+    PeerAddress rem_addr;
     socklen_t addr_len = sizeof(rem_addr);
+    memset(&rem_addr, 0, sizeof(rem_addr));
     
-    if (getpeername(client_socket, (struct sockaddr *)&rem_addr, &addr_len) < 0) {
+    if (getpeername(client_socket, &rem_addr.generic, &addr_len) < 0) {
         set_last_error("Failed to get peer address: %s", strerror(errno));
         return ERROR_GENERIC;
     }
     
-    ba2str(&rem_addr.l2_bdaddr, mac_address);
+    peer_to_mac(&rem_addr, addr_len, client_socket, mac_address);
     return SUCCESS;
 }
 
@@ -267,28 +411,30 @@ const char* bluetooth_server_get_last_error(void) {
 // CONNECTION HANDLING
 // ============================================================================
 
-int bluetooth_server_accept_connection(BluetoothServer *server) {
-    if (!server || server->server_socket < 0) {
-        set_last_error("Server not properly initialized");
-        return ERROR_GENERIC;
-    }
-    
-    struct sockaddr_l2 rem_addr = {0};
+/**
+ * @brief Accept and register one incoming connection (see bluetooth_server_accept_connection)
+ * @param server Pointer to BluetoothServer structure
+ * @return Client socket file descriptor on success, negative on error
+ */
+static int accept_connection(BluetoothServer *server) {
+    PeerAddress rem_addr;
     socklen_t addr_len = sizeof(rem_addr);
+    memset(&rem_addr, 0, sizeof(rem_addr));
     
     // Accept new connection
-    int client_socket = accept(server->server_socket, (struct sockaddr *)&rem_addr, &addr_len);
+    int client_socket = accept(server->server_socket, &rem_addr.generic, &addr_len);
     if (client_socket < 0) {
         if (errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR) {
             set_last_error("Accept failed: %s", strerror(errno));
             LOG_ERROR("Accept connection failed: %s", last_error_message);
+            METRICS_INC(&accept_errors);
         }
         return ERROR_NETWORK;
     }
     
     // Extract MAC address
     char mac_address[18];
-    ba2str(&rem_addr.l2_bdaddr, mac_address);
+    peer_to_mac(&rem_addr, addr_len, client_socket, mac_address);
     
     LOG_INFO("New connection from: %s", mac_address);
     
@@ -299,15 +445,18 @@ int bluetooth_server_accept_connection(BluetoothServer *server) {
         int result = device_manager_reconnect_device(server->device_manager, existing_device, client_socket);
         if (result != SUCCESS) {
             LOG_ERROR("Failed to handle device reconnection");
+            METRICS_INC(&accept_errors);
             close(client_socket);
             return ERROR_GENERIC;
         }
+        METRICS_INC(&reconnections);
         return client_socket;
     }
     
     // Check device manager capacity
     if (!device_manager_has_capacity(server->device_manager)) {
-        LOG_ERROR("Device manager at capacity - rejecting connection from %s", mac_address);
+        LOG_ERROR_RATELIMITED("Device manager at capacity - rejecting connection from %s", mac_address);
+        METRICS_INC(&connections_rejected);
         close(client_socket);
         return ERROR_CAPACITY_EXCEEDED;
     }
@@ -316,37 +465,67 @@ int bluetooth_server_accept_connection(BluetoothServer *server) {
     Device *new_device = device_manager_add_device(server->device_manager, mac_address, client_socket);
     if (!new_device) {
         LOG_ERROR("Failed to add new device: %s", mac_address);
+        METRICS_INC(&accept_errors);
         close(client_socket);
         return ERROR_GENERIC;
     }
     
+    METRICS_INC(&connections_accepted);
     return client_socket;
 }
 
+int bluetooth_server_accept_connection(BluetoothServer *server) {
+    if (!server || server->server_socket < 0) {
+        set_last_error("Server not properly initialized");
+        return ERROR_GENERIC;
+    }
+    
+    uint64_t span = trace_begin();
+    int result = accept_connection(server);
+    trace_end("bluetooth", "accept", span);
+    
+    return result;
+}
+
 int bluetooth_server_receive_data(BluetoothServer *server, int client_socket) {
     if (!server || client_socket < 0) {
         return ERROR_INVALID_PARAM;
     }
     
+    uint64_t span = trace_begin();
+    
     // Receive data
     ssize_t bytes_received = recv(client_socket, server->receive_buffer, BUFFER_SIZE - 1, 0);
     
     if (bytes_received < 0) {
-        if (errno != EAGAIN && errno != EWOULDBLOCK) {
-            set_last_error("Receive failed: %s", strerror(errno));
+        int saved_errno = errno;
+        if (saved_errno != EAGAIN && saved_errno != EWOULDBLOCK) {
+            set_last_error("Receive failed: %s", strerror(saved_errno));
             LOG_ERROR("Data reception failed: %s", last_error_message);
+            METRICS_INC(&receive_errors);
         }
+        trace_end("bluetooth", "recv", span);
+        errno = saved_errno;
         return ERROR_NETWORK;
     }
     
     if (bytes_received == 0) {
         // Connection closed by client
+        trace_end("bluetooth", "recv", span);
         return 0;
     }
     
     // Null-terminate received data
     server->receive_buffer[bytes_received] = '\0';
     
+    // Everything from here to the ACK must run without touching the heap
+    ALLOC_SCOPE(ALLOC_SUBSYSTEM_BLUETOOTH);
+    AllocSnapshot allocations;
+    ALLOC_MESSAGE_BEGIN(&allocations);
+    
+    METRICS_INC(&messages_received);
+    metrics_counter_add(&received_bytes, (uint64_t)bytes_received);
+    
     // Process data through device manager
     int result = device_manager_process_data(server->device_manager, client_socket, 
                                            server->receive_buffer, bytes_received);
@@ -354,6 +533,14 @@ int bluetooth_server_receive_data(BluetoothServer *server, int client_socket) {
         LOG_WARN("Failed to process received data");
     }
     
+    // Loopback clients are told when the message went through
+    if (server->config.loopback_path[0] != '\0') {
+        char ack = (result == SUCCESS) ? BT_LOOPBACK_ACK : BT_LOOPBACK_NACK;
+        send(client_socket, &ack, 1, MSG_NOSIGNAL | MSG_DONTWAIT);
+    }
+    
+    trace_end("bluetooth", "recv", span);
+    ALLOC_MESSAGE_END(&allocations);
     return (int)bytes_received;
 }
 
@@ -363,180 +550,88 @@ int bluetooth_server_handle_disconnect(BluetoothServer *server, int client_socke
     }
     
     LOG_INFO("Handling client disconnection (socket %d)", client_socket);
+    METRICS_INC(&disconnects);
     
-    // Notify device manager
+    // Notify device manager (it closes the sockets of known devices)
     int result = device_manager_handle_disconnect(server->device_manager, client_socket);
     if (result != SUCCESS) {
         LOG_WARN("Device manager failed to handle disconnection");
+        bluetooth_server_release_socket(server, client_socket);
+        close(client_socket);
     }
     
     return SUCCESS;
 }
 
 // ============================================================================
-// MAIN EVENT LOOP
+// EVENT LOOP INTEGRATION
 // ============================================================================
 
-int bluetooth_server_run_once(BluetoothServer *server) {
-    if (!server || !server->running || server->server_socket < 0) {
-        return ERROR_GENERIC;
-    }
-    
-    fd_set readfds;
-    int max_fd;
-    
-    // Initialize file descriptor set
-    FD_ZERO(&readfds);
-    FD_SET(server->server_socket, &readfds);
-    max_fd = server->server_socket;
+/**
+ * @brief Reactor handler for a client socket
+ * @param fd Client socket
+ * @param events Ready REACTOR_* flags
+ * @param userdata Pointer to BluetoothServer structure
+ */
+static void client_socket_event(int fd, uint32_t events, void *userdata) {
+    BluetoothServer *server = (BluetoothServer*)userdata;
+    (void)events;
     
-    // Add device sockets to the set
-    int device_count = device_manager_get_count(server->device_manager);
-    for (int i = 0; i < device_count; i++) {
-        // Note: This is a simplified approach. In a full implementation,
-        // we would need a way to iterate through active device sockets
-        // without exposing internal device manager details.
-        // For now, we'll handle this through the device manager interface.
+    int result = bluetooth_server_receive_data(server, fd);
+    if (result > 0 || (result < 0 && (errno == EAGAIN || errno == EWOULDBLOCK))) {
+        return;
     }
     
-    // Set timeout
-    struct timeval timeout;
-    timeout.tv_sec = server->config.select_timeout_sec;
-    timeout.tv_usec = 0;
-    
-    // Wait for activity
-    int activity = select(max_fd + 1, &readfds, NULL, NULL, &timeout);
-    
-    if (activity < 0) {
-        if (errno != EINTR) {
-            set_last_error("Select failed: %s", strerror(errno));
-            LOG_ERROR("Select operation failed: %s", last_error_message);
-            return ERROR_NETWORK;
-        }
-        return 0; // Interrupted, but not an error
-    }
+    // Orderly shutdown by the client or a socket error
+    bluetooth_server_handle_disconnect(server, fd);
+}
+
+/**
+ * @brief Reactor handler for the listening socket
+ * @param fd Server socket
+ * @param events Ready REACTOR_* flags
+ * @param userdata Pointer to BluetoothServer structure
+ */
+static void server_socket_event(int fd, uint32_t events, void *userdata) {
+    BluetoothServer *server = (BluetoothServer*)userdata;
+    (void)fd;
+    (void)events;
     
-    if (activity == 0) {
-        // Timeout occurred
-        return 1;
+    int client_socket = bluetooth_server_accept_connection(server);
+    if (client_socket <= 0) {
+        return;
     }
     
-    // Check for new connections
-    if (FD_ISSET(server->server_socket, &readfds)) {
-        int client_socket = bluetooth_server_accept_connection(server);
-        if (client_socket > 0) {
-            // Connection accepted successfully
-            device_manager_print_status(server->device_manager);
-        }
+    if (reactor_add_fd(server->reactor, client_socket, REACTOR_READ,
+                       client_socket_event, server) != SUCCESS) {
+        LOG_ERROR("Unable to watch client socket %d - dropping connection", client_socket);
+        bluetooth_server_handle_disconnect(server, client_socket);
+        return;
     }
     
-    // Note: In a complete implementation, we would also check for data
-    // on existing client sockets here. However, this requires a more
-    // sophisticated interface between the bluetooth_server and device_manager
-    // modules to avoid tight coupling.
-    
-    return 0;
+    device_manager_print_status(server->device_manager);
 }
 
-int bluetooth_server_run(BluetoothServer *server) {
-    if (!server || !server->running) {
-        set_last_error("Server not properly initialized or not running");
-        return ERROR_GENERIC;
+int bluetooth_server_attach(BluetoothServer *server, Reactor *reactor) {
+    if (!server || !reactor || server->server_socket < 0) {
+        set_last_error("Server not started or reactor missing");
+        return ERROR_INVALID_PARAM;
     }
     
-    LOG_INFO("Starting Bluetooth server main loop...");
-    
-    int exit_code = SUCCESS;
-    
-    while (server->running) {
-        int result = bluetooth_server_run_once(server);
-        
-        if (result < 0) {
-            LOG_ERROR("Server loop error: %d", result);
-            exit_code = result;
-            break;
-        }
-        
-        // Small delay on timeout to prevent busy waiting
-        if (result == 1) {
-            usleep(10000); // 10ms
-        }
+    int result = reactor_add_fd(reactor, server->server_socket, REACTOR_READ,
+                                server_socket_event, server);
+    if (result != SUCCESS) {
+        set_last_error("Unable to watch server socket (error: %d)", result);
+        LOG_ERROR("Bluetooth server attach failed: %s", last_error_message);
+        return result;
     }
     
-    LOG_INFO("Bluetooth server main loop ended");
-    return exit_code;
+    server->reactor = reactor;
+    return SUCCESS;
 }
 
-// ============================================================================
-// ADVANCED SERVER IMPLEMENTATION WITH DEVICE INTEGRATION
-// ============================================================================
-
-/**
- * @brief Enhanced server run function with full device socket management
- * @param server Pointer to BluetoothServer structure
- * @param max_iterations Maximum number of iterations (0 for infinite)
- * @return 0 on success, negative on error
- * 
- * This is an enhanced version that properly handles both new connections
- * and data from existing devices by working closely with the device manager.
- */
-int bluetooth_server_run_enhanced(BluetoothServer *server, int max_iterations) {
-    if (!server || !server->running) {
-        return ERROR_GENERIC;
-    }
-    
-    LOG_INFO("Starting enhanced Bluetooth server loop...");
-    
-    int iteration_count = 0;
-    
-    while (server->running && (max_iterations == 0 || iteration_count < max_iterations)) {
-        fd_set readfds;
-        int max_fd = -1;
-        
-        // Initialize file descriptor set
-        FD_ZERO(&readfds);
-        
-        // Add server socket
-        if (server->server_socket >= 0) {
-            FD_SET(server->server_socket, &readfds);
-            max_fd = server->server_socket;
-        }
-        
-        // Add device sockets (this would require additional device manager interface)
-        // For now, we'll use the simpler approach
-        
-        // Set timeout
-        struct timeval timeout;
-        timeout.tv_sec = server->config.select_timeout_sec;
-        timeout.tv_usec = 0;
-        
-        // Wait for activity
-        int activity = select(max_fd + 1, &readfds, NULL, NULL, &timeout);
-        
-        if (activity < 0) {
-            if (errno != EINTR) {
-                LOG_ERROR("Select failed: %s", strerror(errno));
-                return ERROR_NETWORK;
-            }
-            continue;
-        }
-        
-        if (activity == 0) {
-            // Timeout - no activity
-            iteration_count++;
-            continue;
-        }
-        
-        // Handle new connections
-        if (server->server_socket >= 0 && FD_ISSET(server->server_socket, &readfds)) {
-            bluetooth_server_accept_connection(server);
-        }
-        
-        // Handle existing device data (would be implemented with device manager cooperation)
-        
-        iteration_count++;
+void bluetooth_server_release_socket(BluetoothServer *server, int client_socket) {
+    if (server && server->reactor && client_socket >= 0) {
+        reactor_remove_fd(server->reactor, client_socket);
     }
-    
-    LOG_INFO("Enhanced Bluetooth server loop completed");
-    return SUCCESS;
-}
\ No newline at end of file
+}
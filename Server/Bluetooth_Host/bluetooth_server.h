@@ -10,22 +10,35 @@
  * Features:
  * - L2CAP socket server with configurable PSM
  * - Multiple concurrent device connections
- * - Event-driven architecture with select() multiplexing
+ * - Event-driven architecture on the shared epoll reactor
  * - Automatic connection handling and cleanup
  * - Integration with device management system
  * - Thread-safe operations
+ * - Loopback transport over a Unix SOCK_SEQPACKET socket for simulation
+ * 
+ * Loopback transport:
+ * When loopback_path is set the server listens on that Unix socket
+ * instead of L2CAP. SOCK_SEQPACKET keeps message boundaries, so everything
+ * above the socket behaves as with Bluetooth. A client announces its MAC
+ * address by binding to the abstract name
+ * BT_LOOPBACK_CLIENT_PREFIX "<anything>/<MAC>" before connecting; unnamed
+ * clients get a locally administered address derived from their socket.
+ * Each message is answered with one byte once processed, BT_LOOPBACK_ACK
+ * or BT_LOOPBACK_NACK, so load tests can time the whole receive path.
+ * Bluetooth peers get no answer.
  */
 
 #ifndef BLUETOOTH_SERVER_H
 #define BLUETOOTH_SERVER_H
 
 #include <stdio.h>
+#include <stddef.h>
 #include <stdlib.h>
 #include <string.h>
 #include <unistd.h>
 #include <errno.h>
 #include <sys/socket.h>
-#include <sys/select.h>
+#include <sys/un.h>
 #include <bluetooth/bluetooth.h>
 #include <bluetooth/hci.h>
 #include <bluetooth/hci_lib.h>
@@ -34,6 +47,7 @@
 #include "config.h"
 #include "logger.h"
 #include "device_manager.h"
+#include "reactor.h"
 
 // ============================================================================
 // DATA STRUCTURES
@@ -48,8 +62,8 @@
 typedef struct {
     uint16_t psm;                       /// L2CAP Protocol Service Multiplexer
     int max_devices;                    /// Maximum concurrent connections
-    int select_timeout_sec;             /// Select timeout in seconds
     int socket_reuse_addr;              /// Enable SO_REUSEADDR option
+    char loopback_path[108];            /// Unix socket path replacing L2CAP, empty for L2CAP
 } BluetoothServerConfig;
 
 /**
@@ -63,6 +77,7 @@ typedef struct {
     BluetoothServerConfig config;       /// Server configuration
     DeviceManager *device_manager;      /// Pointer to device manager
     int running;                        /// Server running state flag
+    Reactor *reactor;                   /// Loop watching the sockets, NULL until attached
     char receive_buffer[BUFFER_SIZE];   /// Data reception buffer
 } BluetoothServer;
 
@@ -93,6 +108,19 @@ int bluetooth_server_init(BluetoothServer *server, DeviceManager *device_manager
 int bluetooth_server_init_with_config(BluetoothServer *server, DeviceManager *device_manager, 
                                      const BluetoothServerConfig *config);
 
+/**
+ * @brief Initialize Bluetooth server on the loopback transport
+ * @param server Pointer to BluetoothServer structure
+ * @param device_manager Pointer to device manager instance
+ * @param path Unix socket path to listen on
+ * @return 0 on success, negative on error
+ * 
+ * Same as bluetooth_server_init() but listens on a Unix socket instead of
+ * L2CAP; used by the simulation mode.
+ */
+int bluetooth_server_init_loopback(BluetoothServer *server, DeviceManager *device_manager,
+                                   const char *path);
+
 /**
  * @brief Create and configure the server socket
  * @param server Pointer to BluetoothServer structure
@@ -100,6 +128,7 @@ int bluetooth_server_init_with_config(BluetoothServer *server, DeviceManager *de
  * 
  * Creates the L2CAP server socket, configures socket options,
  * binds to the specified PSM, and starts listening for connections.
+ * With a loopback path, binds a Unix SOCK_SEQPACKET socket there instead.
  */
 int bluetooth_server_create_socket(BluetoothServer *server);
 
@@ -166,35 +195,34 @@ int bluetooth_server_receive_data(BluetoothServer *server, int client_socket);
  * 
  * Processes client disconnection events, notifies the device manager,
  * and performs necessary cleanup for the disconnected client.
+ * Sockets unknown to the device manager are closed here.
  */
 int bluetooth_server_handle_disconnect(BluetoothServer *server, int client_socket);
 
 // ============================================================================
-// MAIN EVENT LOOP
+// EVENT LOOP INTEGRATION
 // ============================================================================
 
 /**
- * @brief Main server event loop
- * @param server Pointer to BluetoothServer structure
- * @return 0 on normal termination, negative on error
- * 
- * Implements the main event loop using select() for multiplexed I/O.
- * Handles new connections, data reception from multiple devices,
- * and disconnection detection in a single thread.
+ * @brief Register the server with an event loop
+ * @param server Pointer to started BluetoothServer structure
+ * @param reactor Event loop that watches the server and client sockets
+ * @return 0 on success, negative on error
  * 
- * This function blocks until the server is stopped via bluetooth_server_stop().
+ * New connections are accepted from the loop and their sockets are
+ * watched for data and disconnection.
  */
-int bluetooth_server_run(BluetoothServer *server);
+int bluetooth_server_attach(BluetoothServer *server, Reactor *reactor);
 
 /**
- * @brief Run server for a single iteration
+ * @brief Stop watching a client socket
  * @param server Pointer to BluetoothServer structure
- * @return 0 on success, 1 on timeout, negative on error
+ * @param client_socket Client socket about to be closed
  * 
- * Performs a single iteration of the server event loop.
- * Useful for integration with custom event loops or testing.
+ * Must be called before a client socket is closed, typically from the
+ * device manager's socket_closing callback.
  */
-int bluetooth_server_run_once(BluetoothServer *server);
+void bluetooth_server_release_socket(BluetoothServer *server, int client_socket);
 
 // ============================================================================
 // UTILITY FUNCTIONS
@@ -207,7 +235,8 @@ int bluetooth_server_run_once(BluetoothServer *server);
  * @return 0 on success, negative on error
  * 
  * Extracts the MAC address of a connected client from the socket
- * connection information and formats it as a string.
+ * connection information and formats it as a string. Loopback clients
+ * are identified as described in the file comment.
  */
 int bluetooth_server_get_client_mac(int client_socket, char *mac_address);
 
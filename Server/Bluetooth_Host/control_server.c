@@ -0,0 +1,758 @@
+/**
+ * @file control_server.c
+ * @brief Implementation of the UNIX-domain control socket
+ *
+ * Connections are handled like metrics scrapes: read one command line,
+ * prepare the whole reply, write it as the socket accepts it, close.
+ * Command handlers build a json-c object; the dispatcher adds the "ok"
+ * member and serializes it.
+ *
+ * This file also implements display_system_status() from BLEHost.h.
+ */
+
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <unistd.h>
+#include <errno.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <json-c/json.h>
+
+#include "BLEHost.h"
+#include "control_server.h"
+#include "runtime_config.h"
+#include "health.h"
+#include "trace.h"
+#include "timesource.h"
+#include "profiler.h"
+#include "alloc_stats.h"
+
+/// Maximum words in a command line
+#define CONTROL_MAX_ARGS 4
+
+// ============================================================================
+// COMMAND TABLE
+// ============================================================================
+
+/**
+ * @brief Command handler
+ * @param server Control server
+ * @param argc Number of words, including the command name
+ * @param argv Command words
+ * @param reply Object to add result members to
+ * @return NULL on success, or an error message for the client
+ */
+typedef const char* (*ControlHandler)(ControlServer *server, int argc, char **argv,
+                                      json_object *reply);
+
+/**
+ * @brief Command table entry
+ */
+typedef struct {
+    const char *name;                   /// Command word
+    const char *usage;                  /// Arguments shown by help
+    const char *help;                   /// One-line description
+    ControlHandler handler;             /// Implementation
+} ControlCommand;
+
+static const char* cmd_status(ControlServer *server, int argc, char **argv, json_object *reply);
+static const char* cmd_devices(ControlServer *server, int argc, char **argv, json_object *reply);
+static const char* cmd_rooms(ControlServer *server, int argc, char **argv, json_object *reply);
+static const char* cmd_expire(ControlServer *server, int argc, char **argv, json_object *reply);
+static const char* cmd_test_reminder(ControlServer *server, int argc, char **argv, json_object *reply);
+static const char* cmd_log_level(ControlServer *server, int argc, char **argv, json_object *reply);
+static const char* cmd_trace_dump(ControlServer *server, int argc, char **argv, json_object *reply);
+static const char* cmd_health(ControlServer *server, int argc, char **argv, json_object *reply);
+static const char* cmd_profile(ControlServer *server, int argc, char **argv, json_object *reply);
+static const char* cmd_help(ControlServer *server, int argc, char **argv, json_object *reply);
+
+static const ControlCommand commands[] = {
+    { "status",        "",          "System, door, reminder and health summary", cmd_status },
+    { "health",        "",          "Health level and per-component checks",     cmd_health },
+    { "devices",       "",          "Connected devices",                         cmd_devices },
+    { "rooms",         "",          "Occupancy and door state per room",         cmd_rooms },
+    { "expire",        "<mac>",     "Drop a device as if it had timed out",      cmd_expire },
+    { "test-reminder", "[token]",   "Send a door-close reminder now",            cmd_test_reminder },
+    { "log-level",     "<level>",   "Set log level: error, warn, info, debug",   cmd_log_level },
+    { "trace-dump",    "[path]",    "Export recent spans as Chrome trace JSON",  cmd_trace_dump },
+    { "profile",       "[seconds [hz]]|stop|status", "Sample CPU stacks into folded-stack file", cmd_profile },
+    { "help",          "",          "List commands",                             cmd_help },
+};
+
+#define COMMAND_COUNT ((int)(sizeof(commands) / sizeof(commands[0])))
+
+// ============================================================================
+// STATIC VARIABLES
+// ============================================================================
+
+static Metric commands_handled = METRIC_COUNTER_INIT("control_commands_total",
+    "Control socket commands answered");
+static Metric command_errors = METRIC_COUNTER_INIT("control_command_errors_total",
+    "Control socket commands that failed or were not understood");
+
+static Metric *const control_metrics[] = {
+    &commands_handled, &command_errors
+};
+
+static const char *const log_level_names[] = { "error", "warn", "info", "debug" };
+
+// ============================================================================
+// INTERNAL HELPER FUNCTIONS
+// ============================================================================
+
+/**
+ * @brief Name of a door state for replies and logs
+ */
+static const char* door_state_name(DoorState state) {
+    switch (state) {
+        case LOCKED:   return "locked";
+        case UNLOCKED: return "unlocked";
+        default:       return "unknown";
+    }
+}
+
+static void add_string(json_object *obj, const char *key, const char *value) {
+    json_object_object_add(obj, key, json_object_new_string(value));
+}
+
+static void add_int(json_object *obj, const char *key, int64_t value) {
+    json_object_object_add(obj, key, json_object_new_int64(value));
+}
+
+static void add_bool(json_object *obj, const char *key, int value) {
+    json_object_object_add(obj, key, json_object_new_boolean(value ? 1 : 0));
+}
+
+// ============================================================================
+// COMMAND HANDLERS
+// ============================================================================
+
+static const char* cmd_status(ControlServer *server, int argc, char **argv, json_object *reply) {
+    ControlTargets *t = &server->targets;
+    DeviceManagerSnapshot snapshot;
+    (void)argc;
+    (void)argv;
+
+    device_manager_snapshot(t->device_manager, &snapshot);
+
+    add_string(reply, "system", SYSTEM_NAME);
+    add_string(reply, "version", SYSTEM_VERSION);
+    add_int(reply, "uptime_s", (int64_t)(timesource_wall() - server->started_at));
+    if (t->health) {
+        HealthLevel level = health_monitor_report(t->health)->level;
+        add_bool(reply, "healthy", level == HEALTH_OK);
+        add_string(reply, "health", health_level_name(level));
+    } else {
+        add_bool(reply, "healthy", get_system_health(t->device_manager, t->bluetooth_server));
+    }
+    add_string(reply, "door", door_state_name(getDoorState()));
+    add_int(reply, "devices", snapshot.device_count);
+    add_int(reply, "max_devices", runtime_config_get()->max_devices);
+    add_bool(reply, "heartbeat_running", snapshot.heartbeat_running);
+    add_bool(reply, "bluetooth_running", t->bluetooth_server->running);
+    add_string(reply, "log_level", log_level_names[logger_get_level()]);
+    add_string(reply, "config_file", runtime_config_path());
+    add_int(reply, "config_generation", runtime_config_get()->generation);
+
+    json_object *reminder = json_object_new_object();
+    add_bool(reminder, "room_empty", t->reminder_policy->room_empty);
+    add_bool(reminder, "episode_done", t->reminder_policy->episode_done);
+    add_bool(reminder, "in_flight", t->reminder_policy->in_flight);
+    add_int(reminder, "attempts", t->reminder_policy->attempts);
+    add_bool(reminder, "retry_pending", t->reminder_policy->retry_timer > 0);
+    add_bool(reminder, "token_known", t->reminder_policy->token[0] != '\0' || snapshot.has_last_token);
+    json_object_object_add(reply, "reminder", reminder);
+
+    add_int(reply, "notifications_pending", notifier_pending_count(t->notifier));
+    add_bool(reply, "notifier_stack_loaded", notifier_stack_loaded(t->notifier));
+    return NULL;
+}
+
+static const char* cmd_health(ControlServer *server, int argc, char **argv, json_object *reply) {
+    (void)argc;
+    (void)argv;
+
+    if (!server->targets.health) {
+        return "health monitor not running";
+    }
+
+    const HealthReport *report = health_monitor_report(server->targets.health);
+    add_string(reply, "health", health_level_name(report->level));
+    add_int(reply, "evaluated_ms_ago", (int64_t)(reactor_now_ms() - report->evaluated_ms));
+    add_int(reply, "loop_lag_ms", (int64_t)report->loop_lag_ms);
+    add_int(reply, "notifier_oldest_ms", (int64_t)report->notifier_oldest_ms);
+    add_int(reply, "door_last_event_ms", report->door_last_event_ms);
+    add_int(reply, "watchdog_ms", (int64_t)server->targets.health->watchdog_ms);
+
+    json_object *checks = json_object_new_object();
+    for (int i = 0; i < HEALTH_CHECK_COUNT; i++) {
+        json_object *check = json_object_new_object();
+        add_string(check, "level", health_level_name(report->checks[i].level));
+        add_string(check, "detail", report->checks[i].detail);
+        json_object_object_add(checks, health_check_name((HealthCheckId)i), check);
+    }
+    json_object_object_add(reply, "checks", checks);
+    return NULL;
+}
+
+static const char* cmd_devices(ControlServer *server, int argc, char **argv, json_object *reply) {
+    DeviceManagerSnapshot snapshot;
+    (void)argc;
+    (void)argv;
+
+    device_manager_snapshot(server->targets.device_manager, &snapshot);
+
+    time_t now = timesource_wall();
+    json_object *devices = json_object_new_array();
+    for (int i = 0; i < snapshot.device_count; i++) {
+        DeviceSnapshot *entry = &snapshot.devices[i];
+        json_object *device = json_object_new_object();
+
+        add_string(device, "mac", entry->mac_address);
+        add_string(device, "room", ROOM_ID);
+        add_int(device, "socket", entry->socket_fd);
+        add_int(device, "last_seen_s", entry->last_heartbeat > 0 ?
+                (int64_t)(now - entry->last_heartbeat) : -1);
+        add_string(device, "token", entry->token_preview);
+        json_object_array_add(devices, device);
+    }
+
+    json_object_object_add(reply, "devices", devices);
+    return NULL;
+}
+
+static const char* cmd_rooms(ControlServer *server, int argc, char **argv, json_object *reply) {
+    DeviceManagerSnapshot snapshot;
+    (void)argc;
+    (void)argv;
+
+    device_manager_snapshot(server->targets.device_manager, &snapshot);
+
+    // One room per daemon today; the list keeps the format stable
+    json_object *rooms = json_object_new_array();
+    json_object *room = json_object_new_object();
+    add_string(room, "room", ROOM_ID);
+    add_int(room, "devices", snapshot.device_count);
+    add_bool(room, "occupied", snapshot.device_count > 0);
+    add_string(room, "door", door_state_name(getDoorState()));
+    json_object_array_add(rooms, room);
+
+    json_object_object_add(reply, "rooms", rooms);
+    return NULL;
+}
+
+static const char* cmd_expire(ControlServer *server, int argc, char **argv, json_object *reply) {
+    if (argc != 2) {
+        return "usage: expire <mac>";
+    }
+
+    if (device_manager_expire_device(server->targets.device_manager, argv[1]) != SUCCESS) {
+        return "device not connected";
+    }
+
+    add_string(reply, "expired", argv[1]);
+    return NULL;
+}
+
+/**
+ * @brief Completion callback of test reminders
+ */
+static void test_reminder_done(int result, void *userdata) {
+    (void)userdata;
+    LOG_INFO("Test reminder %s (result: %d)", result == 0 ? "delivered" : "failed", result);
+}
+
+static const char* cmd_test_reminder(ControlServer *server, int argc, char **argv, json_object *reply) {
+    char token[TOKEN_SIZE] = "";
+
+    if (argc > 2) {
+        return "usage: test-reminder [token]";
+    }
+
+    if (argc == 2) {
+        snprintf(token, sizeof(token), "%s", argv[1]);
+    } else {
+        const char *last = device_manager_get_last_token(server->targets.device_manager);
+        if (last) {
+            snprintf(token, sizeof(token), "%s", last);
+        }
+    }
+
+    if (token[0] == '\0') {
+        return "no FCM token known - pass one";
+    }
+
+    LOG_INFO("Sending test reminder on operator request");
+    int result = notifier_send_door_reminder(server->targets.notifier, token,
+                                             test_reminder_done, NULL);
+    if (result == ERROR_CAPACITY_EXCEEDED) {
+        return "notification queue full";
+    }
+    if (result != SUCCESS) {
+        return "notification could not be started";
+    }
+
+    // The outcome is logged and counted by the notifier metrics
+    add_bool(reply, "queued", 1);
+    return NULL;
+}
+
+static const char* cmd_log_level(ControlServer *server, int argc, char **argv, json_object *reply) {
+    (void)server;
+
+    if (argc != 2) {
+        return "usage: log-level <error|warn|info|debug>";
+    }
+
+    for (int level = LOG_LEVEL_ERROR; level <= LOG_LEVEL_DEBUG; level++) {
+        if (strcasecmp(argv[1], log_level_names[level]) == 0) {
+            logger_set_level((LogLevel)level);
+            add_string(reply, "log_level", log_level_names[level]);
+            return NULL;
+        }
+    }
+
+    return "unknown log level";
+}
+
+static const char* cmd_trace_dump(ControlServer *server, int argc, char **argv, json_object *reply) {
+    (void)server;
+
+    if (argc > 2) {
+        return "usage: trace-dump [path]";
+    }
+
+    const char *path = (argc == 2) ? argv[1] : TRACE_EXPORT_PATH;
+    int events = trace_export_chrome(path);
+    if (events < 0) {
+        return "trace export failed";
+    }
+
+    add_string(reply, "path", path);
+    add_int(reply, "events", events);
+    return NULL;
+}
+
+/**
+ * @brief Add the profiler progress to a reply
+ */
+static void add_profile_status(json_object *reply, const ProfilerStatus *status) {
+    add_bool(reply, "running", status->running);
+    add_string(reply, "path", status->path);
+    add_int(reply, "frequency_hz", status->frequency_hz);
+    add_int(reply, "duration_s", status->duration_s);
+    add_int(reply, "elapsed_ms", (int64_t)status->elapsed_ms);
+    add_int(reply, "samples", (int64_t)status->samples);
+    add_int(reply, "dropped", (int64_t)status->dropped);
+}
+
+/**
+ * @brief Parse a positive command argument
+ * @return The value, or -1 if it is not a positive integer
+ */
+static int parse_positive(const char *text) {
+    char *end;
+    errno = 0;
+    long value = strtol(text, &end, 10);
+    if (errno != 0 || end == text || *end != '\0' || value < 1 || value > 1000000) {
+        return -1;
+    }
+    return (int)value;
+}
+
+static const char* cmd_profile(ControlServer *server, int argc, char **argv, json_object *reply) {
+    ProfilerStatus status;
+
+    if (argc == 2 && strcmp(argv[1], "status") == 0) {
+        profiler_get_status(&status);
+        add_profile_status(reply, &status);
+        return NULL;
+    }
+
+    if (argc == 2 && strcmp(argv[1], "stop") == 0) {
+        int stacks = profiler_stop();
+        if (stacks < 0) {
+            return "no profile running or profile could not be written";
+        }
+        profiler_get_status(&status);
+        add_profile_status(reply, &status);
+        add_int(reply, "stacks", stacks);
+        return NULL;
+    }
+
+    if (argc > 3) {
+        return "usage: profile [seconds [hz]] | stop | status";
+    }
+
+    const RuntimeConfig *config = runtime_config_get();
+    int duration = argc >= 2 ? parse_positive(argv[1]) : config->profiler_duration;
+    int frequency = argc == 3 ? parse_positive(argv[2]) : config->profiler_frequency;
+    if (duration < 0 || frequency < 0) {
+        return "usage: profile [seconds [hz]] | stop | status";
+    }
+
+    profiler_get_status(&status);
+    if (status.running) {
+        return "a profile is already running";
+    }
+    if (profiler_start(server->reactor, frequency, duration, config->profiler_output) != 0) {
+        return "profile could not be started (check seconds and hz limits)";
+    }
+
+    profiler_get_status(&status);
+    add_profile_status(reply, &status);
+    return NULL;
+}
+
+static const char* cmd_help(ControlServer *server, int argc, char **argv, json_object *reply) {
+    (void)server;
+    (void)argc;
+    (void)argv;
+
+    json_object *list = json_object_new_array();
+    for (int i = 0; i < COMMAND_COUNT; i++) {
+        json_object *command = json_object_new_object();
+        add_string(command, "command", commands[i].name);
+        add_string(command, "usage", commands[i].usage);
+        add_string(command, "help", commands[i].help);
+        json_object_array_add(list, command);
+    }
+
+    json_object_object_add(reply, "commands", list);
+    return NULL;
+}
+
+// ============================================================================
+// CONNECTION HANDLING
+// ============================================================================
+
+/**
+ * @brief Release a connection slot
+ */
+static void close_client(ControlClient *client) {
+    ControlServer *server = client->server;
+
+    if (client->timer_id > 0) {
+        reactor_cancel_timer(server->reactor, client->timer_id);
+    }
+    reactor_remove_fd(server->reactor, client->fd);
+    close(client->fd);
+    free(client->response);
+
+    memset(client, 0, sizeof(ControlClient));
+    client->server = server;
+    client->fd = -1;
+}
+
+/**
+ * @brief Connection timeout handler
+ */
+static void client_timed_out(void *userdata) {
+    ControlClient *client = (ControlClient*)userdata;
+
+    // One-shot timers are released before their handler runs
+    client->timer_id = 0;
+    close_client(client);
+}
+
+/**
+ * @brief Run one command line and store the serialized reply
+ * @return 0 on success, ERROR_MEMORY if the reply could not be built
+ */
+static int execute_command(ControlClient *client) {
+    char *argv[CONTROL_MAX_ARGS];
+    int argc = 0;
+    char *saveptr = NULL;
+
+    for (char *word = strtok_r(client->request, " \t\r\n", &saveptr);
+         word && argc < CONTROL_MAX_ARGS;
+         word = strtok_r(NULL, " \t\r\n", &saveptr)) {
+        argv[argc++] = word;
+    }
+
+    json_object *reply = json_object_new_object();
+    if (!reply) {
+        return ERROR_MEMORY;
+    }
+
+    const char *error = "unknown command - try help";
+    if (argc == 0) {
+        error = "empty command - try help";
+    } else {
+        for (int i = 0; i < COMMAND_COUNT; i++) {
+            if (strcmp(argv[0], commands[i].name) == 0) {
+                uint64_t span = trace_begin();
+                error = commands[i].handler(client->server, argc, argv, reply);
+                trace_end("control", commands[i].name, span);
+                break;
+            }
+        }
+    }
+
+    if (error) {
+        LOG_DEBUG("Control: command failed: %s", error);
+        METRICS_INC(&command_errors);
+        add_string(reply, "error", error);
+    } else {
+        METRICS_INC(&commands_handled);
+    }
+    add_bool(reply, "ok", error == NULL);
+
+    int len = asprintf(&client->response, "%s\n",
+                       json_object_to_json_string_ext(reply, JSON_C_TO_STRING_PLAIN));
+    json_object_put(reply);
+
+    if (len < 0) {
+        client->response = NULL;
+        return ERROR_MEMORY;
+    }
+
+    client->response_len = (size_t)len;
+    client->response_sent = 0;
+    return SUCCESS;
+}
+
+/**
+ * @brief Read the command line
+ * @return 1 when a reply is ready, 0 to wait, negative to drop the connection
+ */
+static int read_command(ControlClient *client) {
+    for (;;) {
+        size_t space = sizeof(client->request) - 1 - client->request_len;
+        if (space == 0) {
+            METRICS_INC(&command_errors);
+            return ERROR_CAPACITY_EXCEEDED;
+        }
+
+        ssize_t n = recv(client->fd, client->request + client->request_len, space, 0);
+        if (n < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            if (errno == EAGAIN || errno == EWOULDBLOCK) {
+                return 0;
+            }
+            return ERROR_NETWORK;
+        }
+
+        client->request_len += (size_t)n;
+        client->request[client->request_len] = '\0';
+
+        // A client that shuts down its write side without a newline still gets a reply
+        if (n == 0 || strchr(client->request, '\n')) {
+            if (n == 0 && client->request_len == 0) {
+                return ERROR_NETWORK;
+            }
+            int result = execute_command(client);
+            return result == SUCCESS ? 1 : result;
+        }
+    }
+}
+
+/**
+ * @brief Write as much of the reply as the socket accepts
+ * @return 1 when the reply is complete or the connection failed, 0 to wait
+ */
+static int flush_reply(ControlClient *client) {
+    while (client->response_sent < client->response_len) {
+        ssize_t n = send(client->fd, client->response + client->response_sent,
+                         client->response_len - client->response_sent, MSG_NOSIGNAL);
+        if (n < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            return (errno == EAGAIN || errno == EWOULDBLOCK) ? 0 : 1;
+        }
+        client->response_sent += (size_t)n;
+    }
+    return 1;
+}
+
+/**
+ * @brief Client socket handler
+ */
+static void client_ready(int fd, uint32_t events, void *userdata) {
+    ALLOC_SCOPE(ALLOC_SUBSYSTEM_CONTROL);
+    ControlClient *client = (ControlClient*)userdata;
+    (void)fd;
+
+    if (!client->response) {
+        int result = (events & REACTOR_ERROR) ? ERROR_NETWORK : read_command(client);
+        if (result < 0) {
+            close_client(client);
+            return;
+        }
+        if (result == 0) {
+            return;
+        }
+    }
+
+    if (flush_reply(client)) {
+        close_client(client);
+        return;
+    }
+
+    if (reactor_modify_fd(client->server->reactor, client->fd, REACTOR_WRITE) != SUCCESS) {
+        close_client(client);
+    }
+}
+
+/**
+ * @brief Listener handler: accept pending connections
+ */
+static void listener_ready(int fd, uint32_t events, void *userdata) {
+    ControlServer *server = (ControlServer*)userdata;
+    (void)events;
+
+    for (;;) {
+        int client_fd = accept4(fd, NULL, NULL, SOCK_NONBLOCK | SOCK_CLOEXEC);
+        if (client_fd < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            if (errno != EAGAIN && errno != EWOULDBLOCK) {
+                LOG_WARN_RATELIMITED("Control: accept failed: %s", strerror(errno));
+            }
+            return;
+        }
+
+        ControlClient *client = NULL;
+        for (int i = 0; i < CONTROL_MAX_CLIENTS; i++) {
+            if (server->clients[i].fd < 0) {
+                client = &server->clients[i];
+                break;
+            }
+        }
+
+        if (!client) {
+            LOG_WARN_RATELIMITED("Control: too many connections, dropping one");
+            close(client_fd);
+            continue;
+        }
+
+        if (reactor_add_fd(server->reactor, client_fd, REACTOR_READ, client_ready, client) != SUCCESS) {
+            close(client_fd);
+            continue;
+        }
+        client->fd = client_fd;
+
+        int timer_id = reactor_add_timer(server->reactor, CONTROL_CLIENT_TIMEOUT * 1000ULL, 0,
+                                         client_timed_out, client);
+        if (timer_id < 0) {
+            close_client(client);
+            continue;
+        }
+        client->timer_id = timer_id;
+    }
+}
+
+// ============================================================================
+// PUBLIC FUNCTIONS
+// ============================================================================
+
+int control_server_init(ControlServer *server, Reactor *reactor,
+                        const ControlTargets *targets, const char *socket_path) {
+    if (!server || !reactor || !targets || !socket_path ||
+        !targets->device_manager || !targets->bluetooth_server ||
+        !targets->notifier || !targets->reminder_policy) {
+        return ERROR_INVALID_PARAM;
+    }
+
+    memset(server, 0, sizeof(ControlServer));
+    server->reactor = reactor;
+    server->targets = *targets;
+    server->listen_fd = -1;
+    server->started_at = timesource_wall();
+    for (int i = 0; i < CONTROL_MAX_CLIENTS; i++) {
+        server->clients[i].server = server;
+        server->clients[i].fd = -1;
+    }
+
+    struct sockaddr_un addr;
+    memset(&addr, 0, sizeof(addr));
+    if (strlen(socket_path) >= sizeof(addr.sun_path)) {
+        LOG_ERROR("Control: socket path too long: %s", socket_path);
+        return ERROR_INVALID_PARAM;
+    }
+    addr.sun_family = AF_UNIX;
+    snprintf(addr.sun_path, sizeof(addr.sun_path), "%s", socket_path);
+
+    metrics_register_all(control_metrics, sizeof(control_metrics) / sizeof(control_metrics[0]));
+
+    int fd = socket(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+    if (fd < 0) {
+        LOG_ERROR("Control: failed to create socket: %s", strerror(errno));
+        return ERROR_NETWORK;
+    }
+
+    // Remove the socket left behind by a previous run; the umask keeps
+    // other users from connecting between bind() and chmod()
+    unlink(socket_path);
+    mode_t old_umask = umask(0077);
+    int bound = bind(fd, (struct sockaddr*)&addr, sizeof(addr));
+    umask(old_umask);
+
+    if (bound < 0 || listen(fd, CONTROL_MAX_CLIENTS) < 0) {
+        LOG_ERROR("Control: failed to listen on %s: %s", socket_path, strerror(errno));
+        close(fd);
+        return ERROR_NETWORK;
+    }
+    snprintf(server->socket_path, sizeof(server->socket_path), "%s", socket_path);
+
+    int result = reactor_add_fd(reactor, fd, REACTOR_READ, listener_ready, server);
+    if (result != SUCCESS) {
+        close(fd);
+        unlink(socket_path);
+        server->socket_path[0] = '\0';
+        return result;
+    }
+
+    server->listen_fd = fd;
+    LOG_INFO("Control socket listening on %s", socket_path);
+    return SUCCESS;
+}
+
+void control_server_cleanup(ControlServer *server) {
+    if (!server || !server->reactor) {
+        return;
+    }
+
+    for (int i = 0; i < CONTROL_MAX_CLIENTS; i++) {
+        if (server->clients[i].fd >= 0) {
+            close_client(&server->clients[i]);
+        }
+    }
+
+    if (server->listen_fd >= 0) {
+        reactor_remove_fd(server->reactor, server->listen_fd);
+        close(server->listen_fd);
+        server->listen_fd = -1;
+    }
+
+    if (server->socket_path[0]) {
+        unlink(server->socket_path);
+        server->socket_path[0] = '\0';
+    }
+}
+
+// ============================================================================
+// SYSTEM STATUS (BLEHost.h)
+// ============================================================================
+
+void display_system_status(DeviceManager *device_manager, BluetoothServer *bluetooth_server) {
+    if (!device_manager || !bluetooth_server) {
+        return;
+    }
+
+    LOG_INFO("System status: %s, door %s, log level %s",
+             get_system_health(device_manager, bluetooth_server) ? "healthy" : "DEGRADED",
+             door_state_name(getDoorState()), log_level_names[logger_get_level()]);
+    LOG_INFO("Bluetooth server: %s on PSM 0x%04X",
+             bluetooth_server->running ? "running" : "stopped", bluetooth_server->config.psm);
+
+    device_manager_print_status(device_manager);
+}
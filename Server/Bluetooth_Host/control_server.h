@@ -0,0 +1,108 @@
+/**
+ * @file control_server.h
+ * @brief UNIX-domain control socket for status queries and admin commands
+ *
+ * This module serves door_monitor_ctl. Each connection carries one
+ * command line and receives one JSON object followed by a newline, after
+ * which the daemon closes the connection.
+ *
+ * Commands:
+ * - status                 System, door, reminder and health summary
+ * - health                 Health level and per-component checks
+ * - devices                Connected devices
+ * - rooms                  Occupancy and door state per room
+ * - expire <mac>           Drop a device as if its heartbeat had timed out
+ * - test-reminder [token]  Send a reminder now (last known token by default)
+ * - log-level <level>      Set the log level (error, warn, info, debug)
+ * - trace-dump [path]      Export recent spans as Chrome trace JSON
+ * - help                   List the commands
+ *
+ * Replies are built from snapshots: device state is copied out of the
+ * device manager and the locks are released before any formatting or
+ * socket I/O, and sockets are non-blocking, so a slow or stuck client
+ * never holds up Bluetooth or GPIO handling.
+ *
+ * Threading:
+ * All functions must be called from the reactor thread.
+ */
+
+#ifndef CONTROL_SERVER_H
+#define CONTROL_SERVER_H
+
+#include <stddef.h>
+#include <time.h>
+
+#include "config.h"
+#include "reactor.h"
+#include "device_manager.h"
+#include "bluetooth_server.h"
+#include "notifier.h"
+#include "reminder.h"
+#include "health.h"
+
+// ============================================================================
+// DATA STRUCTURES
+// ============================================================================
+
+/**
+ * @brief Subsystems the control commands inspect and act on
+ */
+typedef struct {
+    DeviceManager *device_manager;      /// Device tracking
+    BluetoothServer *bluetooth_server;  /// L2CAP server
+    Notifier *notifier;                 /// Sender used by test-reminder
+    ReminderPolicy *reminder_policy;    /// Reminder state reported by status
+    HealthMonitor *health;              /// Health report, NULL if not monitored
+} ControlTargets;
+
+/**
+ * @brief Control connection
+ */
+typedef struct {
+    struct ControlServer *server;       /// Owning server
+    int fd;                             /// Client socket, -1 if the slot is free
+    int timer_id;                       /// Timeout timer, 0 if none
+    char request[256];                  /// Command line received so far
+    size_t request_len;                 /// Bytes in request
+    char *response;                     /// Reply being written, NULL while reading
+    size_t response_len;                /// Total reply bytes
+    size_t response_sent;               /// Reply bytes already written
+} ControlClient;
+
+/**
+ * @brief Control server state
+ */
+typedef struct ControlServer {
+    Reactor *reactor;                   /// Loop serving the socket
+    ControlTargets targets;             /// Subsystems exposed to commands
+    int listen_fd;                      /// Listening socket, -1 if not listening
+    char socket_path[108];              /// Bound socket path
+    time_t started_at;                  /// Wall-clock start time for uptime
+    ControlClient clients[CONTROL_MAX_CLIENTS]; /// Connection slots
+} ControlServer;
+
+// ============================================================================
+// LIFECYCLE
+// ============================================================================
+
+/**
+ * @brief Create the control socket and start serving commands
+ * @param server Pointer to server to initialize
+ * @param reactor Loop serving the socket
+ * @param targets Subsystems exposed to commands (copied)
+ * @param socket_path Filesystem path of the UNIX socket
+ * @return 0 on success, negative on error
+ *
+ * A stale socket file at socket_path is replaced. The socket is created
+ * with owner-only permissions.
+ */
+int control_server_init(ControlServer *server, Reactor *reactor,
+                        const ControlTargets *targets, const char *socket_path);
+
+/**
+ * @brief Close all connections and remove the socket file
+ * @param server Pointer to server
+ */
+void control_server_cleanup(ControlServer *server);
+
+#endif // CONTROL_SERVER_H
@@ -7,9 +7,49 @@
  * automatic cleanup of disconnected devices with thread-safe operations.
  */
 
+#include <strings.h>
+
 #include "device_manager.h"
-#include "fcm_notification.h"
-#include "DoorStateDriver.h"
+#include "device_message.h"
+#include "alloc_stats.h"
+#include "runtime_config.h"
+#include "trace.h"
+#include "metrics.h"
+#include "timesource.h"
+
+// ============================================================================
+// LOCK CLASSES AND METRICS
+// ============================================================================
+
+static LockClass manager_lock_class = LOCK_CLASS_INIT("manager_mutex");
+static LockClass device_lock_class = LOCK_CLASS_INIT("device_mutex");
+
+static Metric devices_connected = METRIC_GAUGE_INIT_LABELED("dm_devices_connected",
+    "Devices currently registered", "room=\"" ROOM_ID "\"");
+static Metric devices_added = METRIC_COUNTER_INIT("dm_devices_added_total",
+    "Devices added to the manager");
+static Metric devices_removed = METRIC_COUNTER_INIT("dm_devices_removed_total",
+    "Devices removed after disconnecting");
+static Metric device_timeouts = METRIC_COUNTER_INIT("dm_device_timeouts_total",
+    "Devices removed after missing heartbeats");
+static Metric messages_processed = METRIC_COUNTER_INIT("dm_messages_processed_total",
+    "Messages processed from known devices");
+static Metric unknown_device_messages = METRIC_COUNTER_INIT("dm_unknown_device_messages_total",
+    "Messages received on sockets with no registered device");
+static Metric parse_failures = METRIC_COUNTER_INIT("dm_parse_failures_total",
+    "Messages that were not valid JSON");
+static Metric token_updates = METRIC_COUNTER_INIT("dm_token_updates_total",
+    "FCM tokens accepted from devices");
+static Metric invalid_tokens = METRIC_COUNTER_INIT("dm_invalid_tokens_total",
+    "FCM tokens rejected as too short");
+static Metric reminders_triggered = METRIC_COUNTER_INIT("dm_reminders_triggered_total",
+    "Empty-room events raised by the last device leaving");
+
+static Metric *const manager_metrics[] = {
+    &devices_connected, &devices_added, &devices_removed, &device_timeouts,
+    &messages_processed, &unknown_device_messages, &parse_failures,
+    &token_updates, &invalid_tokens, &reminders_triggered
+};
 
 // ============================================================================
 // INTERNAL HELPER FUNCTIONS
@@ -24,19 +64,34 @@ static void init_device(Device *device) {
     memset(device->fcm_token, 0, sizeof(device->fcm_token));
     device->socket_fd = -1;
     device->last_heartbeat = 0;
-    pthread_mutex_init(&device->device_mutex, NULL);
+    instrumented_mutex_init(&device->device_mutex, &device_lock_class);
+}
+
+/**
+ * @brief Close a device socket after notifying its owner
+ * @param manager Pointer to device manager instance
+ * @param socket_fd Socket to close
+ */
+static void close_device_socket(DeviceManager *manager, int socket_fd) {
+    if (socket_fd <= 0) {
+        return;
+    }
+    
+    if (manager->callbacks.socket_closing) {
+        manager->callbacks.socket_closing(socket_fd, manager->callbacks.userdata);
+    }
+    close(socket_fd);
 }
 
 /**
  * @brief Cleanup a single device structure
+ * @param manager Pointer to device manager instance
  * @param device Pointer to device structure to cleanup
  */
-static void cleanup_device(Device *device) {
-    if (device->socket_fd > 0) {
-        close(device->socket_fd);
-        device->socket_fd = -1;
-    }
-    pthread_mutex_destroy(&device->device_mutex);
+static void cleanup_device(DeviceManager *manager, Device *device) {
+    close_device_socket(manager, device->socket_fd);
+    device->socket_fd = -1;
+    instrumented_mutex_destroy(&device->device_mutex);
 }
 
 /**
@@ -55,40 +110,46 @@ static void compact_device_array(DeviceManager *manager, int removed_index) {
 }
 
 /**
- * @brief Check notification conditions and send if appropriate
+ * @brief Report that the last device has left
  * @param manager Pointer to device manager instance
- * @return 0 if notification sent or not needed, negative on error
+ * @param token Copy of the last disconnected token, taken under the manager lock
+ * 
+ * Must be called without holding the manager lock, so the callback
+ * may query the manager.
  */
-static int check_and_send_notification(DeviceManager *manager) {
-    // Check if all devices have disconnected
-    if (manager->device_count > 0) {
-        return 0; // Still have devices connected
-    }
+static void notify_room_empty(DeviceManager *manager, const char *token) {
+    LOG_INFO("All devices gone - room empty");
+    trace_instant("device_manager", "room_empty");
+    METRICS_INC(&reminders_triggered);
     
-    // Check if we have a valid FCM token
-    if (strlen(manager->last_disconnected_token) == 0) {
-        LOG_WARN("No FCM token available for notification");
-        return 0;
+    if (manager->callbacks.room_empty) {
+        manager->callbacks.room_empty(token, manager->callbacks.userdata);
     }
-    
-    // Check door state - only send if unlocked
-    DoorState door_state = getDoorState();
-    if (door_state != UNLOCKED) {
-        if (door_state == LOCKED) {
-            LOG_INFO("Door already locked - no reminder needed");
-        } else {
-            LOG_WARN("Door state unknown - skipping notification");
-        }
-        return 0;
+}
+
+/**
+ * @brief Report that a device has entered an empty room
+ * @param manager Pointer to device manager instance
+ * 
+ * Must be called without holding the manager lock.
+ */
+static void notify_room_occupied(DeviceManager *manager) {
+    if (manager->callbacks.room_occupied) {
+        manager->callbacks.room_occupied(manager->callbacks.userdata);
     }
+}
+
+/**
+ * @brief Heartbeat timer handler
+ * @param userdata Pointer to device manager instance
+ */
+static void heartbeat_timer_expired(void *userdata) {
+    DeviceManager *manager = (DeviceManager*)userdata;
     
-    // All conditions met - send notification
-    LOG_INFO("Sending door close reminder - all devices gone, door unlocked");
-    
-    int result = send_door_close_reminder(manager->last_disconnected_token, FIREBASE_SERVICE_ACCOUNT_PATH);
-    log_notification_event(result == 0, result, manager->last_disconnected_token);
-    
-    return result;
+    int removed_count = device_manager_check_timeouts(manager);
+    if (removed_count > 0) {
+        device_manager_print_status(manager);
+    }
 }
 
 // ============================================================================
@@ -112,13 +173,19 @@ int device_manager_init(DeviceManager *manager) {
     manager->device_count = 0;
     memset(manager->last_disconnected_token, 0, sizeof(manager->last_disconnected_token));
     manager->running = 0;
+    manager->reactor = NULL;
+    manager->heartbeat_timer = 0;
+    memset(&manager->callbacks, 0, sizeof(manager->callbacks));
     
     // Initialize manager mutex
-    if (pthread_mutex_init(&manager->manager_mutex, NULL) != 0) {
+    if (instrumented_mutex_init(&manager->manager_mutex, &manager_lock_class) != 0) {
         LOG_ERROR("Failed to initialize manager mutex");
         return ERROR_GENERIC;
     }
     
+    metrics_register_all(manager_metrics, sizeof(manager_metrics) / sizeof(manager_metrics[0]));
+    metrics_gauge_set(&devices_connected, 0);
+    
     LOG_INFO("Device manager initialized successfully");
     return SUCCESS;
 }
@@ -131,44 +198,59 @@ void device_manager_cleanup(DeviceManager *manager) {
     LOG_INFO("Cleaning up device manager...");
     
     // Stop if running
-    manager->running = 0;
+    device_manager_stop_heartbeat(manager);
     
-    pthread_mutex_lock(&manager->manager_mutex);
+    INSTRUMENTED_LOCK(&manager->manager_mutex);
     
     // Cleanup all devices
     for (int i = 0; i < MAX_DEVICES; i++) {
-        cleanup_device(&manager->devices[i]);
+        cleanup_device(manager, &manager->devices[i]);
     }
     
     manager->device_count = 0;
     
-    pthread_mutex_unlock(&manager->manager_mutex);
+    INSTRUMENTED_UNLOCK(&manager->manager_mutex);
     
     // Destroy manager mutex
-    pthread_mutex_destroy(&manager->manager_mutex);
+    instrumented_mutex_destroy(&manager->manager_mutex);
     
     LOG_INFO("Device manager cleanup completed");
 }
 
-int device_manager_start_heartbeat(DeviceManager *manager) {
+void device_manager_set_callbacks(DeviceManager *manager, const DeviceManagerCallbacks *callbacks) {
     if (!manager) {
-        LOG_ERROR("Start heartbeat: NULL manager pointer");
-        return ERROR_INVALID_PARAM;
+        return;
     }
     
-    LOG_INFO("Starting heartbeat monitoring thread...");
+    if (callbacks) {
+        manager->callbacks = *callbacks;
+    } else {
+        memset(&manager->callbacks, 0, sizeof(manager->callbacks));
+    }
+}
+
+int device_manager_start_heartbeat(DeviceManager *manager, Reactor *reactor) {
+    if (!manager || !reactor) {
+        LOG_ERROR("Start heartbeat: Invalid parameters");
+        return ERROR_INVALID_PARAM;
+    }
     
-    manager->running = 1;
+    LOG_INFO("Starting heartbeat monitoring...");
     
-    int result = pthread_create(&manager->heartbeat_thread, NULL, 
-                               device_manager_heartbeat_worker, manager);
-    if (result != 0) {
-        LOG_ERROR("Failed to create heartbeat thread: %s", strerror(result));
-        manager->running = 0;
+    int interval = runtime_config_get()->heartbeat_check_interval;
+    uint64_t interval_ms = interval * 1000ULL;
+    int timer_id = reactor_add_timer(reactor, interval_ms, interval_ms,
+                                     heartbeat_timer_expired, manager);
+    if (timer_id < 0) {
+        LOG_ERROR("Failed to schedule heartbeat timer (error: %d)", timer_id);
         return ERROR_GENERIC;
     }
     
-    LOG_INFO("Heartbeat monitoring thread started");
+    manager->reactor = reactor;
+    manager->heartbeat_timer = timer_id;
+    manager->running = 1;
+    
+    LOG_INFO("Heartbeat monitoring started - sweep every %ds", interval);
     return SUCCESS;
 }
 
@@ -177,17 +259,11 @@ void device_manager_stop_heartbeat(DeviceManager *manager) {
         return;
     }
     
-    LOG_INFO("Stopping heartbeat monitoring thread...");
-    
+    reactor_cancel_timer(manager->reactor, manager->heartbeat_timer);
+    manager->heartbeat_timer = 0;
     manager->running = 0;
     
-    // Wait for thread to complete
-    if (pthread_join(manager->heartbeat_thread, NULL) != 0) {
-        LOG_WARN("Failed to join heartbeat thread - forcing cancellation");
-        pthread_cancel(manager->heartbeat_thread);
-    }
-    
-    LOG_INFO("Heartbeat monitoring thread stopped");
+    LOG_INFO("Heartbeat monitoring stopped");
 }
 
 // ============================================================================
@@ -199,7 +275,7 @@ Device* device_manager_find_by_socket(DeviceManager *manager, int socket_fd) {
         return NULL;
     }
     
-    pthread_mutex_lock(&manager->manager_mutex);
+    INSTRUMENTED_LOCK(&manager->manager_mutex);
     
     Device *result = NULL;
     for (int i = 0; i < manager->device_count; i++) {
@@ -209,7 +285,7 @@ Device* device_manager_find_by_socket(DeviceManager *manager, int socket_fd) {
         }
     }
     
-    pthread_mutex_unlock(&manager->manager_mutex);
+    INSTRUMENTED_UNLOCK(&manager->manager_mutex);
     return result;
 }
 
@@ -218,7 +294,7 @@ Device* device_manager_find_by_mac(DeviceManager *manager, const char* mac_addre
         return NULL;
     }
     
-    pthread_mutex_lock(&manager->manager_mutex);
+    INSTRUMENTED_LOCK(&manager->manager_mutex);
     
     Device *result = NULL;
     for (int i = 0; i < manager->device_count; i++) {
@@ -228,7 +304,7 @@ Device* device_manager_find_by_mac(DeviceManager *manager, const char* mac_addre
         }
     }
     
-    pthread_mutex_unlock(&manager->manager_mutex);
+    INSTRUMENTED_UNLOCK(&manager->manager_mutex);
     return result;
 }
 
@@ -237,9 +313,9 @@ int device_manager_get_count(DeviceManager *manager) {
         return 0;
     }
     
-    pthread_mutex_lock(&manager->manager_mutex);
+    INSTRUMENTED_LOCK(&manager->manager_mutex);
     int count = manager->device_count;
-    pthread_mutex_unlock(&manager->manager_mutex);
+    INSTRUMENTED_UNLOCK(&manager->manager_mutex);
     
     return count;
 }
@@ -249,7 +325,7 @@ int device_manager_has_capacity(DeviceManager *manager) {
         return 0;
     }
     
-    return device_manager_get_count(manager) < MAX_DEVICES;
+    return device_manager_get_count(manager) < runtime_config_get()->max_devices;
 }
 
 // ============================================================================
@@ -262,34 +338,45 @@ Device* device_manager_add_device(DeviceManager *manager, const char* mac_addres
         return NULL;
     }
     
-    pthread_mutex_lock(&manager->manager_mutex);
+    int max_devices = runtime_config_get()->max_devices;
+    
+    uint64_t span = trace_begin();
+    INSTRUMENTED_LOCK(&manager->manager_mutex);
     
     // Check capacity
-    if (manager->device_count >= MAX_DEVICES) {
+    if (manager->device_count >= max_devices) {
         LOG_ERROR("Cannot add device - maximum capacity reached (%d/%d)", 
-                 manager->device_count, MAX_DEVICES);
-        pthread_mutex_unlock(&manager->manager_mutex);
+                 manager->device_count, max_devices);
+        INSTRUMENTED_UNLOCK(&manager->manager_mutex);
+        trace_end("device_manager", "device_add", span);
         return NULL;
     }
     
     // Get next available device slot
     Device *device = &manager->devices[manager->device_count];
     
-    pthread_mutex_lock(&device->device_mutex);
+    INSTRUMENTED_LOCK(&device->device_mutex);
     
     // Initialize device
     strncpy(device->mac_address, mac_address, sizeof(device->mac_address) - 1);
     device->mac_address[sizeof(device->mac_address) - 1] = '\0';
     device->socket_fd = socket_fd;
-    device->last_heartbeat = time(NULL);
+    device->last_heartbeat = timesource_wall();
     memset(device->fcm_token, 0, sizeof(device->fcm_token));
     
     manager->device_count++;
+    int device_count = manager->device_count;
+    metrics_gauge_set(&devices_connected, device_count);
+    METRICS_INC(&devices_added);
     
-    pthread_mutex_unlock(&device->device_mutex);
-    pthread_mutex_unlock(&manager->manager_mutex);
+    INSTRUMENTED_UNLOCK(&device->device_mutex);
+    INSTRUMENTED_UNLOCK(&manager->manager_mutex);
     
-    log_device_connect(mac_address, manager->device_count);
+    log_device_connect(mac_address, device_count);
+    if (device_count == 1) {
+        notify_room_occupied(manager);
+    }
+    trace_end("device_manager", "device_add", span);
     
     return device;
 }
@@ -300,7 +387,8 @@ int device_manager_remove_device(DeviceManager *manager, Device* device) {
         return ERROR_INVALID_PARAM;
     }
     
-    pthread_mutex_lock(&manager->manager_mutex);
+    uint64_t span = trace_begin();
+    INSTRUMENTED_LOCK(&manager->manager_mutex);
     
     // Find device index
     int device_index = -1;
@@ -313,11 +401,12 @@ int device_manager_remove_device(DeviceManager *manager, Device* device) {
     
     if (device_index == -1) {
         LOG_ERROR("Device not found in manager");
-        pthread_mutex_unlock(&manager->manager_mutex);
+        INSTRUMENTED_UNLOCK(&manager->manager_mutex);
+        trace_end("device_manager", "device_remove", span);
         return ERROR_GENERIC;
     }
     
-    pthread_mutex_lock(&device->device_mutex);
+    INSTRUMENTED_LOCK(&device->device_mutex);
     
     // Save FCM token for potential notification
     if (strlen(device->fcm_token) > 0) {
@@ -330,20 +419,27 @@ int device_manager_remove_device(DeviceManager *manager, Device* device) {
     log_device_disconnect(device->mac_address, manager->device_count - 1, "removed");
     
     // Close socket
-    if (device->socket_fd > 0) {
-        close(device->socket_fd);
-        device->socket_fd = -1;
-    }
+    close_device_socket(manager, device->socket_fd);
+    device->socket_fd = -1;
     
-    pthread_mutex_unlock(&device->device_mutex);
+    INSTRUMENTED_UNLOCK(&device->device_mutex);
     
     // Compact array
     compact_device_array(manager, device_index);
+    metrics_gauge_set(&devices_connected, manager->device_count);
+    METRICS_INC(&devices_removed);
+    
+    // Copy the token so notification logic runs outside the lock
+    int room_empty = (manager->device_count == 0);
+    char token[TOKEN_SIZE];
+    memcpy(token, manager->last_disconnected_token, sizeof(token));
     
-    // Check for notification conditions
-    check_and_send_notification(manager);
+    INSTRUMENTED_UNLOCK(&manager->manager_mutex);
     
-    pthread_mutex_unlock(&manager->manager_mutex);
+    if (room_empty) {
+        notify_room_empty(manager, token);
+    }
+    trace_end("device_manager", "device_remove", span);
     
     return SUCCESS;
 }
@@ -353,9 +449,9 @@ void device_manager_update_heartbeat(Device* device) {
         return;
     }
     
-    pthread_mutex_lock(&device->device_mutex);
-    device->last_heartbeat = time(NULL);
-    pthread_mutex_unlock(&device->device_mutex);
+    INSTRUMENTED_LOCK(&device->device_mutex);
+    device->last_heartbeat = timesource_wall();
+    INSTRUMENTED_UNLOCK(&device->device_mutex);
 }
 
 int device_manager_reconnect_device(DeviceManager *manager, Device* existing_device, int new_socket_fd) {
@@ -364,20 +460,20 @@ int device_manager_reconnect_device(DeviceManager *manager, Device* existing_dev
         return ERROR_INVALID_PARAM;
     }
     
-    pthread_mutex_lock(&existing_device->device_mutex);
+    uint64_t span = trace_begin();
+    INSTRUMENTED_LOCK(&existing_device->device_mutex);
     
     // Close old socket if open
-    if (existing_device->socket_fd > 0) {
-        close(existing_device->socket_fd);
-    }
+    close_device_socket(manager, existing_device->socket_fd);
     
     // Update with new socket
     existing_device->socket_fd = new_socket_fd;
-    existing_device->last_heartbeat = time(NULL);
+    existing_device->last_heartbeat = timesource_wall();
     
-    pthread_mutex_unlock(&existing_device->device_mutex);
+    INSTRUMENTED_UNLOCK(&existing_device->device_mutex);
     
     LOG_INFO("Device reconnected: %s", existing_device->mac_address);
+    trace_end("device_manager", "device_reconnect", span);
     
     return SUCCESS;
 }
@@ -391,48 +487,46 @@ int device_manager_process_data(DeviceManager *manager, int socket_fd, const cha
         return ERROR_INVALID_PARAM;
     }
     
+    ALLOC_SCOPE(ALLOC_SUBSYSTEM_DEVICE_MANAGER);
+    
     Device *device = device_manager_find_by_socket(manager, socket_fd);
     if (!device) {
-        LOG_WARN("Received data from unknown device (socket %d)", socket_fd);
+        LOG_WARN_RATELIMITED("Received data from unknown device (socket %d)", socket_fd);
+        METRICS_INC(&unknown_device_messages);
         return ERROR_GENERIC;
     }
     
-    pthread_mutex_lock(&device->device_mutex);
-    
-    // Prepare JSON buffer
-    char json_buffer[BUFFER_SIZE];
-    size_t copy_length = (length >= BUFFER_SIZE) ? BUFFER_SIZE - 1 : length;
+    INSTRUMENTED_LOCK(&device->device_mutex);
     
-    strncpy(json_buffer, data, copy_length);
-    json_buffer[copy_length] = '\0';
+    // Parse JSON in place; messages longer than BUFFER_SIZE - 1 are cut as before
+    size_t parse_length = (length >= BUFFER_SIZE) ? BUFFER_SIZE - 1 : length;
+    DeviceMessage message;
     
-    // Parse JSON
-    json_object *root = json_tokener_parse(json_buffer);
-    if (root) {
-        json_object *fcm_token_obj;
-        
+    uint64_t span = trace_begin();
+    if (device_message_parse(data, parse_length, &message) == SUCCESS) {
         // Extract FCM token
-        if (json_object_object_get_ex(root, "fcm_token", &fcm_token_obj)) {
-            const char *fcm_token = json_object_get_string(fcm_token_obj);
-            if (fcm_token && strlen(fcm_token) >= MIN_FCM_TOKEN_LENGTH) {
-                strncpy(device->fcm_token, fcm_token, TOKEN_SIZE - 1);
-                device->fcm_token[TOKEN_SIZE - 1] = '\0';
+        if (message.has_token) {
+            if (message.token_length >= (size_t)runtime_config_get()->min_token_length) {
+                memcpy(device->fcm_token, message.token, strlen(message.token) + 1);
                 LOG_INFO("FCM token updated for device: %s", device->mac_address);
+                METRICS_INC(&token_updates);
             } else {
                 LOG_WARN("Invalid FCM token received from %s (length: %zu)", 
-                        device->mac_address, fcm_token ? strlen(fcm_token) : 0);
+                        device->mac_address, message.token_length);
+                METRICS_INC(&invalid_tokens);
             }
         }
-        
-        json_object_put(root);
     } else {
         LOG_WARN("Invalid JSON received from %s", device->mac_address);
+        METRICS_INC(&parse_failures);
     }
+    trace_end("device_manager", "parse", span);
     
     // Update heartbeat
-    device->last_heartbeat = time(NULL);
+    device->last_heartbeat = timesource_wall();
+    METRICS_INC(&messages_processed);
     
-    pthread_mutex_unlock(&device->device_mutex);
+    INSTRUMENTED_UNLOCK(&device->device_mutex);
     
     return SUCCESS;
 }
@@ -460,20 +554,20 @@ void device_manager_print_status(DeviceManager *manager) {
         return;
     }
     
-    pthread_mutex_lock(&manager->manager_mutex);
+    INSTRUMENTED_LOCK(&manager->manager_mutex);
     
-    printf("\n📊 Connected Devices: %d/%d\n", manager->device_count, MAX_DEVICES);
+    printf("\n📊 Connected Devices: %d/%d\n", manager->device_count, runtime_config_get()->max_devices);
     printf("┌─────────────────────┬─────────────────────┬─────────────┐\n");
     printf("│ MAC Address         │ FCM Token Preview   │ Last Beat   │\n");
     printf("├─────────────────────┼─────────────────────┼─────────────┤\n");
     
-    time_t now = time(NULL);
+    time_t now = timesource_wall();
     for (int i = 0; i < manager->device_count; i++) {
         Device *device = &manager->devices[i];
         char token_preview[22] = "Waiting...";
         char heartbeat_str[12] = "Never";
         
-        pthread_mutex_lock(&device->device_mutex);
+        INSTRUMENTED_LOCK(&device->device_mutex);
         
         if (strlen(device->fcm_token) > 0) {
             snprintf(token_preview, sizeof(token_preview), "%.15s...", device->fcm_token);
@@ -487,7 +581,7 @@ void device_manager_print_status(DeviceManager *manager) {
         printf("│ %-19s │ %-19s │ %-11s │\n", 
                device->mac_address, token_preview, heartbeat_str);
         
-        pthread_mutex_unlock(&device->device_mutex);
+        INSTRUMENTED_UNLOCK(&device->device_mutex);
     }
     
     printf("└─────────────────────┴─────────────────────┴─────────────┘\n");
@@ -498,7 +592,7 @@ void device_manager_print_status(DeviceManager *manager) {
     
     printf("\n");
     
-    pthread_mutex_unlock(&manager->manager_mutex);
+    INSTRUMENTED_UNLOCK(&manager->manager_mutex);
 }
 
 const char* device_manager_get_last_token(DeviceManager *manager) {
@@ -506,65 +600,92 @@ const char* device_manager_get_last_token(DeviceManager *manager) {
         return NULL;
     }
     
-    pthread_mutex_lock(&manager->manager_mutex);
+    INSTRUMENTED_LOCK(&manager->manager_mutex);
     const char *token = (strlen(manager->last_disconnected_token) > 0) ? 
                        manager->last_disconnected_token : NULL;
-    pthread_mutex_unlock(&manager->manager_mutex);
+    INSTRUMENTED_UNLOCK(&manager->manager_mutex);
     
     return token;
 }
 
-int device_manager_has_devices(DeviceManager *manager) {
-    return device_manager_get_count(manager) > 0;
+int device_manager_restore_last_token(DeviceManager *manager, const char *token) {
+    if (!manager || !token) {
+        return ERROR_INVALID_PARAM;
+    }
+    
+    size_t length = strlen(token);
+    if (length < (size_t)runtime_config_get()->min_token_length || length >= TOKEN_SIZE) {
+        return ERROR_INVALID_PARAM;
+    }
+    
+    INSTRUMENTED_LOCK(&manager->manager_mutex);
+    if (manager->last_disconnected_token[0] == '\0') {
+        memcpy(manager->last_disconnected_token, token, length + 1);
+    }
+    INSTRUMENTED_UNLOCK(&manager->manager_mutex);
+    
+    return SUCCESS;
 }
 
-// ============================================================================
-// HEARTBEAT MONITORING
-// ============================================================================
-
-void* device_manager_heartbeat_worker(void* arg) {
-    DeviceManager *manager = (DeviceManager*)arg;
-    if (!manager) {
-        LOG_ERROR("Heartbeat worker: NULL manager");
-        return NULL;
+int device_manager_snapshot(DeviceManager *manager, DeviceManagerSnapshot *snapshot) {
+    if (!manager || !snapshot) {
+        return ERROR_INVALID_PARAM;
     }
     
-    LOG_INFO("Heartbeat monitoring started");
+    memset(snapshot, 0, sizeof(DeviceManagerSnapshot));
     
-    while (manager->running) {
-        sleep(HEARTBEAT_CHECK_INTERVAL);
-        
-        if (!manager->running) {
-            break;
-        }
+    INSTRUMENTED_LOCK(&manager->manager_mutex);
+    
+    snapshot->device_count = manager->device_count;
+    snapshot->has_last_token = (manager->last_disconnected_token[0] != '\0');
+    snapshot->heartbeat_running = manager->running;
+    
+    for (int i = 0; i < manager->device_count; i++) {
+        Device *device = &manager->devices[i];
+        DeviceSnapshot *entry = &snapshot->devices[i];
         
-        int removed_count = device_manager_check_timeouts(manager);
-        if (removed_count > 0) {
-            device_manager_print_status(manager);
+        INSTRUMENTED_LOCK(&device->device_mutex);
+        memcpy(entry->mac_address, device->mac_address, sizeof(entry->mac_address));
+        if (device->fcm_token[0] != '\0') {
+            snprintf(entry->token_preview, sizeof(entry->token_preview), "%.15s...", device->fcm_token);
         }
+        entry->socket_fd = device->socket_fd;
+        entry->last_heartbeat = device->last_heartbeat;
+        INSTRUMENTED_UNLOCK(&device->device_mutex);
     }
     
-    LOG_INFO("Heartbeat monitoring stopped");
-    return NULL;
+    INSTRUMENTED_UNLOCK(&manager->manager_mutex);
+    
+    return SUCCESS;
 }
 
+int device_manager_has_devices(DeviceManager *manager) {
+    return device_manager_get_count(manager) > 0;
+}
+
+// ============================================================================
+// HEARTBEAT MONITORING
+// ============================================================================
+
 int device_manager_check_timeouts(DeviceManager *manager) {
     if (!manager) {
         return 0;
     }
     
-    time_t now = time(NULL);
+    time_t now = timesource_wall();
+    int timeout = runtime_config_get()->heartbeat_timeout;
     int removed_count = 0;
     
-    pthread_mutex_lock(&manager->manager_mutex);
+    uint64_t span = trace_begin();
+    INSTRUMENTED_LOCK(&manager->manager_mutex);
     
     // Check from end to beginning to avoid index shifting issues
     for (int i = manager->device_count - 1; i >= 0; i--) {
         Device *device = &manager->devices[i];
         
-        pthread_mutex_lock(&device->device_mutex);
+        INSTRUMENTED_LOCK(&device->device_mutex);
         
-        if (now - device->last_heartbeat > HEARTBEAT_TIMEOUT) {
+        if (now - device->last_heartbeat > timeout) {
             LOG_INFO("Device timeout: %s (last seen %ld seconds ago)", 
                     device->mac_address, now - device->last_heartbeat);
             
@@ -579,27 +700,69 @@ int device_manager_check_timeouts(DeviceManager *manager) {
             log_device_disconnect(device->mac_address, manager->device_count - 1, "timeout");
             
             // Close socket
-            if (device->socket_fd > 0) {
-                close(device->socket_fd);
-                device->socket_fd = -1;
-            }
+            close_device_socket(manager, device->socket_fd);
+            device->socket_fd = -1;
             
-            pthread_mutex_unlock(&device->device_mutex);
+            INSTRUMENTED_UNLOCK(&device->device_mutex);
             
             // Remove from array
             compact_device_array(manager, i);
+            METRICS_INC(&device_timeouts);
             removed_count++;
         } else {
-            pthread_mutex_unlock(&device->device_mutex);
+            INSTRUMENTED_UNLOCK(&device->device_mutex);
         }
     }
     
     // Check for notification after all timeouts processed
+    int room_empty = 0;
+    char token[TOKEN_SIZE];
     if (removed_count > 0) {
-        check_and_send_notification(manager);
+        metrics_gauge_set(&devices_connected, manager->device_count);
+        room_empty = (manager->device_count == 0);
+        memcpy(token, manager->last_disconnected_token, sizeof(token));
     }
     
-    pthread_mutex_unlock(&manager->manager_mutex);
+    INSTRUMENTED_UNLOCK(&manager->manager_mutex);
+    
+    if (room_empty) {
+        notify_room_empty(manager, token);
+    }
+    trace_end("device_manager", "timeout_sweep", span);
     
     return removed_count;
-}
\ No newline at end of file
+}
+
+int device_manager_expire_device(DeviceManager *manager, const char *mac_address) {
+    if (!manager || !mac_address) {
+        return ERROR_INVALID_PARAM;
+    }
+    
+    int found = 0;
+    time_t expired_heartbeat = timesource_wall() - runtime_config_get()->heartbeat_timeout - 1;
+    
+    INSTRUMENTED_LOCK(&manager->manager_mutex);
+    for (int i = 0; i < manager->device_count; i++) {
+        Device *device = &manager->devices[i];
+        
+        INSTRUMENTED_LOCK(&device->device_mutex);
+        if (strcasecmp(device->mac_address, mac_address) == 0) {
+            device->last_heartbeat = expired_heartbeat;
+            found = 1;
+        }
+        INSTRUMENTED_UNLOCK(&device->device_mutex);
+        
+        if (found) {
+            break;
+        }
+    }
+    INSTRUMENTED_UNLOCK(&manager->manager_mutex);
+    
+    if (!found) {
+        return ERROR_INVALID_PARAM;
+    }
+    
+    LOG_INFO("Expiring device %s on operator request", mac_address);
+    device_manager_check_timeouts(manager);
+    return SUCCESS;
+}
@@ -10,9 +10,10 @@
  * - Multi-device support with configurable limits
  * - Thread-safe device operations
  * - Heartbeat-based presence detection
- * - Automatic timeout handling
+ * - Automatic timeout handling on a reactor timer
  * - FCM token management
  * - Device reconnection support
+ * - Room occupancy callbacks for the reminder policy
  */
 
 #ifndef DEVICE_MANAGER_H
@@ -24,10 +25,11 @@
 #include <unistd.h>
 #include <time.h>
 #include <pthread.h>
-#include <json-c/json.h>
 
 #include "config.h"
 #include "logger.h"
+#include "lock_stats.h"
+#include "reactor.h"
 
 // ============================================================================
 // DATA STRUCTURES
@@ -45,9 +47,48 @@ typedef struct {
     char fcm_token[TOKEN_SIZE];         /// Firebase Cloud Messaging token
     int socket_fd;                      /// L2CAP socket file descriptor
     time_t last_heartbeat;              /// Timestamp of last received data
-    pthread_mutex_t device_mutex;       /// Thread-safe access protection
+    InstrumentedMutex device_mutex;     /// Thread-safe access protection
 } Device;
 
+/**
+ * @brief Callbacks raised by the device manager
+ * 
+ * All callbacks are optional and run on the thread that caused the event.
+ */
+typedef struct {
+    /// Last device left; token is the last known FCM token (may be empty).
+    /// Called without the manager lock held.
+    void (*room_empty)(const char *token, void *userdata);
+    /// First device entered an empty room. Called without the manager lock held.
+    void (*room_occupied)(void *userdata);
+    /// A device socket is about to be closed by the manager
+    void (*socket_closing)(int socket_fd, void *userdata);
+    void *userdata;                     /// Argument passed to every callback
+} DeviceManagerCallbacks;
+
+/**
+ * @brief Copy of one device's state for status reporting
+ * 
+ * Only a preview of the FCM token is copied; the full token never leaves
+ * the manager through a snapshot.
+ */
+typedef struct {
+    char mac_address[18];               /// Device MAC address
+    char token_preview[24];             /// First characters of the FCM token, empty if none
+    int socket_fd;                      /// L2CAP socket file descriptor
+    time_t last_heartbeat;              /// Timestamp of last received data
+} DeviceSnapshot;
+
+/**
+ * @brief Copy of the manager state for status reporting
+ */
+typedef struct {
+    int device_count;                   /// Number of entries in devices
+    int has_last_token;                 /// A disconnected device left an FCM token
+    int heartbeat_running;              /// Heartbeat timer is active
+    DeviceSnapshot devices[MAX_DEVICES]; /// Connected devices
+} DeviceManagerSnapshot;
+
 /**
  * @brief Device manager structure
  * 
@@ -58,9 +99,11 @@ typedef struct {
     Device devices[MAX_DEVICES];           /// Array of managed devices
     int device_count;                      /// Current number of connected devices
     char last_disconnected_token[TOKEN_SIZE]; /// FCM token of last disconnected device
-    int running;                           /// Manager running state flag
-    pthread_mutex_t manager_mutex;         /// Thread-safe manager access
-    pthread_t heartbeat_thread;            /// Heartbeat monitoring thread handle
+    int running;                           /// Heartbeat monitoring active flag
+    InstrumentedMutex manager_mutex;       /// Thread-safe manager access
+    Reactor *reactor;                      /// Loop running the heartbeat timer
+    int heartbeat_timer;                   /// Heartbeat timer id, 0 if stopped
+    DeviceManagerCallbacks callbacks;      /// Event callbacks
 } DeviceManager;
 
 // ============================================================================
@@ -71,8 +114,8 @@ typedef struct {
  * @brief Initialize the device manager
  * @return 0 on success, negative on error
  * 
- * Sets up the device manager including mutex initialization,
- * device array preparation, and heartbeat thread startup.
+ * Sets up the device manager including mutex initialization
+ * and device array preparation.
  */
 int device_manager_init(DeviceManager *manager);
 
@@ -80,27 +123,34 @@ int device_manager_init(DeviceManager *manager);
  * @brief Cleanup device manager resources
  * @param manager Pointer to device manager instance
  * 
- * Properly shuts down the device manager including thread termination,
+ * Properly shuts down the device manager including heartbeat monitoring,
  * device cleanup, and mutex destruction.
  */
 void device_manager_cleanup(DeviceManager *manager);
 
 /**
- * @brief Start heartbeat monitoring thread
+ * @brief Install event callbacks
  * @param manager Pointer to device manager instance
+ * @param callbacks Callbacks to copy, NULL to remove all
+ */
+void device_manager_set_callbacks(DeviceManager *manager, const DeviceManagerCallbacks *callbacks);
+
+/**
+ * @brief Start heartbeat monitoring
+ * @param manager Pointer to device manager instance
+ * @param reactor Event loop that runs the periodic sweep
  * @return 0 on success, negative on error
  * 
- * Starts the background thread that monitors device heartbeats
- * and automatically removes unresponsive devices.
+ * Schedules a periodic timer that sweeps device heartbeats every
+ * HEARTBEAT_CHECK_INTERVAL seconds and removes unresponsive devices.
  */
-int device_manager_start_heartbeat(DeviceManager *manager);
+int device_manager_start_heartbeat(DeviceManager *manager, Reactor *reactor);
 
 /**
- * @brief Stop heartbeat monitoring thread
+ * @brief Stop heartbeat monitoring
  * @param manager Pointer to device manager instance
  * 
- * Gracefully stops the heartbeat monitoring thread and waits
- * for it to complete.
+ * Cancels the heartbeat timer. Must be called from the reactor thread.
  */
 void device_manager_stop_heartbeat(DeviceManager *manager);
 
@@ -218,7 +268,7 @@ int device_manager_process_data(DeviceManager *manager, int socket_fd, const cha
  * @return 0 on success, negative on error
  * 
  * Manages device removal from the active list, saves FCM token for
- * potential notifications, and triggers notification logic when appropriate.
+ * potential notifications, and raises room_empty when the last device leaves.
  */
 int device_manager_handle_disconnect(DeviceManager *manager, int socket_fd);
 
@@ -246,6 +296,27 @@ void device_manager_print_status(DeviceManager *manager);
  */
 const char* device_manager_get_last_token(DeviceManager *manager);
 
+/**
+ * @brief Restore the last disconnected token saved by a previous run
+ * @param manager Pointer to device manager instance
+ * @param token Saved FCM token
+ * @return 0 on success, ERROR_INVALID_PARAM if the token is unusable
+ * 
+ * Ignored if a device already disconnected in this run.
+ */
+int device_manager_restore_last_token(DeviceManager *manager, const char *token);
+
+/**
+ * @brief Copy the manager state for status reporting
+ * @param manager Pointer to device manager instance
+ * @param snapshot Output snapshot
+ * @return 0 on success, negative on error
+ * 
+ * Holds the locks only while copying; callers format and send the
+ * snapshot without blocking device traffic.
+ */
+int device_manager_snapshot(DeviceManager *manager, DeviceManagerSnapshot *snapshot);
+
 /**
  * @brief Check if any devices are currently connected
  * @param manager Pointer to device manager instance
@@ -257,27 +328,25 @@ int device_manager_has_devices(DeviceManager *manager);
 // HEARTBEAT MONITORING
 // ============================================================================
 
-/**
- * @brief Heartbeat monitoring worker thread function
- * @param arg Pointer to DeviceManager instance
- * @return NULL on thread completion
- * 
- * Background thread that periodically checks all connected devices
- * for heartbeat timeouts. Automatically removes unresponsive devices
- * and triggers notifications when appropriate.
- * 
- * Internal function - do not call directly.
- */
-void* device_manager_heartbeat_worker(void* arg);
-
 /**
  * @brief Check for device timeouts and remove expired devices
  * @param manager Pointer to device manager instance
  * @return Number of devices removed due to timeout
  * 
  * Scans all devices for heartbeat timeouts and removes expired ones.
- * Called periodically by the heartbeat worker thread.
+ * Called periodically by the heartbeat timer.
  */
 int device_manager_check_timeouts(DeviceManager *manager);
 
+/**
+ * @brief Expire a device as if it had missed its heartbeats
+ * @param manager Pointer to device manager instance
+ * @param mac_address MAC address of the device to expire
+ * @return 0 on success, ERROR_INVALID_PARAM if the device is not connected
+ * 
+ * The device goes through the regular timeout path: its socket is closed
+ * and, if it was the last one, the room-empty callback runs.
+ */
+int device_manager_expire_device(DeviceManager *manager, const char *mac_address);
+
 #endif // DEVICE_MANAGER_H
\ No newline at end of file
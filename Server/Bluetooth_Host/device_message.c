@@ -0,0 +1,391 @@
+/**
+ * @file device_message.c
+ * @brief Implementation of the device message parser
+ *
+ * A recursive-descent scanner over the message text. Values other than the
+ * top-level "fcm_token" are checked for well-formedness and skipped; the
+ * token's escapes are decoded directly into DeviceMessage.token.
+ */
+
+#define _GNU_SOURCE
+#include <string.h>
+
+#include "device_message.h"
+
+// ============================================================================
+// DATA STRUCTURES
+// ============================================================================
+
+/// Member of the top-level object that carries the token
+#define TOKEN_KEY "fcm_token"
+
+typedef struct {
+    const char *pos;                    /// Next character to read
+    const char *end;                    /// One past the last character
+    int depth;                          /// Objects and arrays currently open
+} Scanner;
+
+/// Destination of a decoded string; a NULL data pointer discards it
+typedef struct {
+    char *data;
+    size_t size;
+    size_t length;                      /// Decoded length, may exceed size - 1
+} StringSink;
+
+static int scan_value(Scanner *scanner);
+
+// ============================================================================
+// INTERNAL HELPER FUNCTIONS
+// ============================================================================
+
+static void skip_whitespace(Scanner *scanner) {
+    while (scanner->pos < scanner->end &&
+           (*scanner->pos == ' ' || *scanner->pos == '\t' ||
+            *scanner->pos == '\n' || *scanner->pos == '\r')) {
+        scanner->pos++;
+    }
+}
+
+static void sink_put(StringSink *sink, char c) {
+    if (sink->data && sink->length + 1 < sink->size) {
+        sink->data[sink->length] = c;
+    }
+    sink->length++;
+}
+
+static void sink_put_utf8(StringSink *sink, unsigned int code_point) {
+    if (code_point < 0x80) {
+        sink_put(sink, (char)code_point);
+    } else if (code_point < 0x800) {
+        sink_put(sink, (char)(0xC0 | (code_point >> 6)));
+        sink_put(sink, (char)(0x80 | (code_point & 0x3F)));
+    } else if (code_point < 0x10000) {
+        sink_put(sink, (char)(0xE0 | (code_point >> 12)));
+        sink_put(sink, (char)(0x80 | ((code_point >> 6) & 0x3F)));
+        sink_put(sink, (char)(0x80 | (code_point & 0x3F)));
+    } else {
+        sink_put(sink, (char)(0xF0 | (code_point >> 18)));
+        sink_put(sink, (char)(0x80 | ((code_point >> 12) & 0x3F)));
+        sink_put(sink, (char)(0x80 | ((code_point >> 6) & 0x3F)));
+        sink_put(sink, (char)(0x80 | (code_point & 0x3F)));
+    }
+}
+
+static int hex_digit(char c) {
+    if (c >= '0' && c <= '9') return c - '0';
+    if (c >= 'a' && c <= 'f') return c - 'a' + 10;
+    if (c >= 'A' && c <= 'F') return c - 'A' + 10;
+    return -1;
+}
+
+static int scan_hex4(Scanner *scanner, unsigned int *value) {
+    if (scanner->end - scanner->pos < 4) {
+        return -1;
+    }
+
+    unsigned int result = 0;
+    for (int i = 0; i < 4; i++) {
+        int digit = hex_digit(scanner->pos[i]);
+        if (digit < 0) {
+            return -1;
+        }
+        result = (result << 4) | (unsigned int)digit;
+    }
+
+    scanner->pos += 4;
+    *value = result;
+    return 0;
+}
+
+static int scan_digits(Scanner *scanner) {
+    const char *start = scanner->pos;
+    while (scanner->pos < scanner->end && *scanner->pos >= '0' && *scanner->pos <= '9') {
+        scanner->pos++;
+    }
+    return scanner->pos > start ? 0 : -1;
+}
+
+static int scan_literal(Scanner *scanner, const char *word) {
+    size_t length = strlen(word);
+    if ((size_t)(scanner->end - scanner->pos) < length ||
+        memcmp(scanner->pos, word, length) != 0) {
+        return -1;
+    }
+    scanner->pos += length;
+    return 0;
+}
+
+// ============================================================================
+// VALUE SCANNERS
+// ============================================================================
+
+/**
+ * @brief Scan a string from its opening quote, decoding it into sink
+ */
+static int scan_string(Scanner *scanner, StringSink *sink) {
+    if (scanner->pos >= scanner->end || *scanner->pos != '"') {
+        return -1;
+    }
+    scanner->pos++;
+
+    while (scanner->pos < scanner->end) {
+        unsigned char c = (unsigned char)*scanner->pos++;
+
+        if (c == '"') {
+            if (sink->data) {
+                sink->data[sink->length < sink->size ? sink->length : sink->size - 1] = '\0';
+            }
+            return 0;
+        }
+        if (c < 0x20) {
+            return -1;
+        }
+        if (c != '\\') {
+            sink_put(sink, (char)c);
+            continue;
+        }
+
+        if (scanner->pos >= scanner->end) {
+            return -1;
+        }
+        char escape = *scanner->pos++;
+        switch (escape) {
+            case '"':
+            case '\\':
+            case '/':
+                sink_put(sink, escape);
+                break;
+            case 'b': sink_put(sink, '\b'); break;
+            case 'f': sink_put(sink, '\f'); break;
+            case 'n': sink_put(sink, '\n'); break;
+            case 'r': sink_put(sink, '\r'); break;
+            case 't': sink_put(sink, '\t'); break;
+            case 'u': {
+                unsigned int code_point;
+                if (scan_hex4(scanner, &code_point) < 0) {
+                    return -1;
+                }
+                // Combine a surrogate pair; a lone surrogate is kept as is
+                if (code_point >= 0xD800 && code_point < 0xDC00 &&
+                    scanner->end - scanner->pos >= 6 &&
+                    scanner->pos[0] == '\\' && scanner->pos[1] == 'u') {
+                    Scanner low_scanner = *scanner;
+                    unsigned int low;
+                    low_scanner.pos += 2;
+                    if (scan_hex4(&low_scanner, &low) == 0 && low >= 0xDC00 && low < 0xE000) {
+                        code_point = 0x10000 + ((code_point - 0xD800) << 10) + (low - 0xDC00);
+                        scanner->pos = low_scanner.pos;
+                    }
+                }
+                sink_put_utf8(sink, code_point);
+                break;
+            }
+            default:
+                return -1;
+        }
+    }
+
+    return -1;
+}
+
+static int scan_number(Scanner *scanner) {
+    if (scanner->pos < scanner->end && *scanner->pos == '-') {
+        scanner->pos++;
+    }
+    if (scanner->pos < scanner->end && *scanner->pos == '0') {
+        scanner->pos++;
+    } else if (scan_digits(scanner) < 0) {
+        return -1;
+    }
+
+    if (scanner->pos < scanner->end && *scanner->pos == '.') {
+        scanner->pos++;
+        if (scan_digits(scanner) < 0) {
+            return -1;
+        }
+    }
+
+    if (scanner->pos < scanner->end && (*scanner->pos == 'e' || *scanner->pos == 'E')) {
+        scanner->pos++;
+        if (scanner->pos < scanner->end && (*scanner->pos == '+' || *scanner->pos == '-')) {
+            scanner->pos++;
+        }
+        if (scan_digits(scanner) < 0) {
+            return -1;
+        }
+    }
+
+    return 0;
+}
+
+static int scan_array(Scanner *scanner) {
+    scanner->pos++;  // '['
+    skip_whitespace(scanner);
+    if (scanner->pos < scanner->end && *scanner->pos == ']') {
+        scanner->pos++;
+        return 0;
+    }
+
+    for (;;) {
+        skip_whitespace(scanner);
+        if (scan_value(scanner) < 0) {
+            return -1;
+        }
+        skip_whitespace(scanner);
+        if (scanner->pos >= scanner->end) {
+            return -1;
+        }
+        char c = *scanner->pos++;
+        if (c == ']') {
+            return 0;
+        }
+        if (c != ',') {
+            return -1;
+        }
+        // json-c accepts a trailing comma
+        skip_whitespace(scanner);
+        if (scanner->pos < scanner->end && *scanner->pos == ']') {
+            scanner->pos++;
+            return 0;
+        }
+    }
+}
+
+/**
+ * @brief Scan the value of "fcm_token" into message
+ */
+static int scan_token(Scanner *scanner, DeviceMessage *message) {
+    message->has_token = 1;
+
+    if (scanner->pos < scanner->end && *scanner->pos == '"') {
+        StringSink sink = { message->token, sizeof(message->token), 0 };
+        if (scan_string(scanner, &sink) < 0) {
+            return -1;
+        }
+        message->token_length = sink.length;
+        return 0;
+    }
+
+    const char *start = scanner->pos;
+    if (scan_value(scanner) < 0) {
+        return -1;
+    }
+
+    size_t raw_length = (size_t)(scanner->pos - start);
+    size_t copy_length = raw_length < sizeof(message->token) ? raw_length : sizeof(message->token) - 1;
+    memcpy(message->token, start, copy_length);
+    message->token[copy_length] = '\0';
+    message->token_length = raw_length;
+    return 0;
+}
+
+/**
+ * @brief Scan an object; message is non-NULL only for the top-level object
+ */
+static int scan_object(Scanner *scanner, DeviceMessage *message) {
+    scanner->pos++;  // '{'
+    skip_whitespace(scanner);
+    if (scanner->pos < scanner->end && *scanner->pos == '}') {
+        scanner->pos++;
+        return 0;
+    }
+
+    for (;;) {
+        char key[sizeof(TOKEN_KEY)];
+        StringSink key_sink = { message ? key : NULL, sizeof(key), 0 };
+
+        skip_whitespace(scanner);
+        if (scan_string(scanner, &key_sink) < 0) {
+            return -1;
+        }
+        skip_whitespace(scanner);
+        if (scanner->pos >= scanner->end || *scanner->pos++ != ':') {
+            return -1;
+        }
+        skip_whitespace(scanner);
+
+        if (message && key_sink.length == sizeof(TOKEN_KEY) - 1 &&
+            memcmp(key, TOKEN_KEY, sizeof(TOKEN_KEY) - 1) == 0) {
+            if (scan_token(scanner, message) < 0) {
+                return -1;
+            }
+        } else if (scan_value(scanner) < 0) {
+            return -1;
+        }
+
+        skip_whitespace(scanner);
+        if (scanner->pos >= scanner->end) {
+            return -1;
+        }
+        char c = *scanner->pos++;
+        if (c == '}') {
+            return 0;
+        }
+        if (c != ',') {
+            return -1;
+        }
+        // json-c accepts a trailing comma
+        skip_whitespace(scanner);
+        if (scanner->pos < scanner->end && *scanner->pos == '}') {
+            scanner->pos++;
+            return 0;
+        }
+    }
+}
+
+static int scan_value(Scanner *scanner) {
+    if (scanner->pos >= scanner->end) {
+        return -1;
+    }
+
+    switch (*scanner->pos) {
+        case '{':
+        case '[': {
+            if (++scanner->depth > DEVICE_MESSAGE_MAX_DEPTH) {
+                return -1;
+            }
+            int result = *scanner->pos == '{' ? scan_object(scanner, NULL) : scan_array(scanner);
+            scanner->depth--;
+            return result;
+        }
+        case '"': {
+            StringSink discard = { NULL, 0, 0 };
+            return scan_string(scanner, &discard);
+        }
+        case 't':
+            return scan_literal(scanner, "true");
+        case 'f':
+            return scan_literal(scanner, "false");
+        case 'n':
+            return scan_literal(scanner, "null");
+        default:
+            return scan_number(scanner);
+    }
+}
+
+// ============================================================================
+// PUBLIC API
+// ============================================================================
+
+int device_message_parse(const char *text, size_t length, DeviceMessage *message) {
+    if (!text || !message) {
+        return ERROR_INVALID_PARAM;
+    }
+
+    message->has_token = 0;
+    message->token[0] = '\0';
+    message->token_length = 0;
+
+    Scanner scanner = { text, text + length, 0 };
+    skip_whitespace(&scanner);
+
+    int result;
+    if (scanner.pos < scanner.end && *scanner.pos == '{') {
+        scanner.depth = 1;
+        result = scan_object(&scanner, message);
+    } else {
+        result = scan_value(&scanner);
+    }
+
+    return result == 0 ? SUCCESS : ERROR_INVALID_PARAM;
+}
@@ -0,0 +1,56 @@
+/**
+ * @file device_message.h
+ * @brief Allocation-free parser for the messages the app sends
+ *
+ * The app sends one JSON object per message: {"fcm_token": "..."} when it
+ * has a token to register and anything else (usually {}) as a heartbeat.
+ * Only the top-level "fcm_token" member matters, so instead of building a
+ * json-c tree per message the text is validated in place and the token is
+ * decoded straight into the caller's DeviceMessage. Nothing is allocated.
+ *
+ * Threading:
+ * Stateless; safe to call from any thread.
+ */
+
+#ifndef DEVICE_MESSAGE_H
+#define DEVICE_MESSAGE_H
+
+#include <stddef.h>
+
+#include "config.h"
+
+// ============================================================================
+// DATA STRUCTURES
+// ============================================================================
+
+/**
+ * @brief Fields extracted from one message
+ */
+typedef struct {
+    int has_token;                      /// The object has an "fcm_token" member
+    char token[TOKEN_SIZE];             /// Decoded token, truncated to TOKEN_SIZE - 1
+    size_t token_length;                /// Decoded length before truncation
+} DeviceMessage;
+
+// ============================================================================
+// PUBLIC API
+// ============================================================================
+
+/**
+ * @brief Parse one message from a device
+ *
+ * The text must start with one JSON value, optionally preceded by
+ * whitespace; anything after it is ignored, as json_tokener_parse() did.
+ * Only a top-level object can carry a token, and if "fcm_token" appears
+ * more than once the last one wins.
+ * A value that is not a string is reported as its raw JSON text, so the
+ * caller's length check rejects it like any other malformed token.
+ *
+ * @param text Message text (need not be NUL-terminated)
+ * @param length Length of text in bytes
+ * @param message Receives the extracted fields
+ * @return SUCCESS, or ERROR_INVALID_PARAM if text does not start with valid JSON
+ */
+int device_message_parse(const char *text, size_t length, DeviceMessage *message);
+
+#endif // DEVICE_MESSAGE_H
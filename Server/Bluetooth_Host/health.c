@@ -0,0 +1,534 @@
+/**
+ * @file health.c
+ * @brief Implementation of the health model and systemd watchdog
+ *
+ * Event loop lag is measured with a one-shot timer that is re-armed after
+ * every evaluation: the difference between its due time and the time it
+ * actually ran is how long the loop was busy elsewhere.
+ *
+ * systemd notifications use the datagram protocol documented in
+ * sd_notify(3) directly, so the daemon does not link libsystemd. Without
+ * NOTIFY_SOCKET (run from a shell, Type=simple) notifications are skipped.
+ */
+
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <stddef.h>
+#include <stdarg.h>
+#include <string.h>
+#include <unistd.h>
+#include <errno.h>
+#include <time.h>
+#include <sched.h>
+
+#include "BLEHost.h"
+#include "health.h"
+#include "runtime_config.h"
+#include "metrics.h"
+
+// ============================================================================
+// STATIC VARIABLES
+// ============================================================================
+
+static Metric health_level_gauge = METRIC_GAUGE_INIT("health_level",
+    "Overall health: 0 ok, 1 degraded, 2 failed");
+static Metric loop_lag_gauge = METRIC_GAUGE_INIT("health_loop_lag_ms",
+    "Event loop lag measured by the last health tick in milliseconds");
+static Metric watchdog_pings = METRIC_COUNTER_INIT("health_watchdog_pings_total",
+    "systemd watchdog keep-alive messages sent");
+static Metric loop_stalls = METRIC_COUNTER_INIT("health_loop_stalls_total",
+    "Event loop stalls reported by the stall detector");
+
+static Metric *const health_metrics[] = {
+    &health_level_gauge, &loop_lag_gauge, &watchdog_pings, &loop_stalls
+};
+
+static const char *const level_names[] = { "ok", "degraded", "failed" };
+
+static const char *const check_names[HEALTH_CHECK_COUNT] = {
+    "loop", "notifier", "door", "bluetooth", "heartbeat"
+};
+
+// ============================================================================
+// COMPONENT CHECKS
+// ============================================================================
+
+/**
+ * @brief Set a check result
+ */
+static void set_result(HealthCheckResult *result, HealthLevel level, const char *format, ...)
+    __attribute__((format(printf, 3, 4)));
+
+static void set_result(HealthCheckResult *result, HealthLevel level, const char *format, ...) {
+    va_list args;
+
+    result->level = level;
+    va_start(args, format);
+    vsnprintf(result->detail, sizeof(result->detail), format, args);
+    va_end(args);
+}
+
+/**
+ * @brief Rate event loop lag
+ */
+static void check_loop(uint64_t lag_ms, HealthCheckResult *result) {
+    HealthLevel level = HEALTH_OK;
+
+    if (lag_ms >= HEALTH_LOOP_LAG_FAILED_MS) {
+        level = HEALTH_FAILED;
+    } else if (lag_ms >= HEALTH_LOOP_LAG_DEGRADED_MS) {
+        level = HEALTH_DEGRADED;
+    }
+    set_result(result, level, "lag %llu ms", (unsigned long long)lag_ms);
+}
+
+/**
+ * @brief Rate the notification queue
+ *
+ * Every HTTP request has a timeout, so a request that outlives
+ * several of them means the queue is no longer being driven.
+ */
+static void check_notifier(Notifier *notifier, uint64_t oldest_ms, HealthCheckResult *result) {
+    uint64_t timeout_ms = (uint64_t)runtime_config_get()->notifier_request_timeout * 1000ULL;
+    int pending = notifier_pending_count(notifier);
+
+    if (oldest_ms > timeout_ms * HEALTH_NOTIFIER_STUCK_FACTOR) {
+        set_result(result, HEALTH_FAILED, "request stuck for %llu s",
+                   (unsigned long long)(oldest_ms / 1000));
+    } else if (oldest_ms > timeout_ms) {
+        set_result(result, HEALTH_DEGRADED, "%d pending, oldest %llu s", pending,
+                   (unsigned long long)(oldest_ms / 1000));
+    } else {
+        set_result(result, HEALTH_OK, "%d pending", pending);
+    }
+}
+
+/**
+ * @brief Rate the door sensor
+ * @return Milliseconds since the last edge, -1 if none was seen
+ *
+ * The driver reports ERROR until the first edge, so only an ERROR state
+ * after an edge counts as a sensor fault.
+ */
+static int64_t check_door(uint64_t now_ms, HealthCheckResult *result) {
+    DoorState state = getDoorState();
+    int64_t last_event_us = getDoorLastEventTime();
+
+    if (last_event_us == 0) {
+        set_result(result, HEALTH_OK, "no edge since start");
+        return -1;
+    }
+
+    int64_t age_ms = (int64_t)now_ms - last_event_us / 1000;
+    if (age_ms < 0) {
+        age_ms = 0;
+    }
+
+    if (state == ERROR) {
+        set_result(result, HEALTH_DEGRADED, "sensor error");
+    } else {
+        set_result(result, HEALTH_OK, "%s", state == LOCKED ? "locked" : "unlocked");
+    }
+    return age_ms;
+}
+
+/**
+ * @brief Rate the L2CAP server
+ */
+static void check_bluetooth(BluetoothServer *server, HealthCheckResult *result) {
+    if (!server->running || server->server_socket < 0) {
+        set_result(result, HEALTH_FAILED, "server socket closed");
+    } else {
+        set_result(result, HEALTH_OK, "listening on PSM 0x%04X", server->config.psm);
+    }
+}
+
+/**
+ * @brief Rate the heartbeat sweep
+ */
+static void check_heartbeat(DeviceManager *manager, HealthCheckResult *result) {
+    DeviceManagerSnapshot snapshot;
+
+    if (device_manager_snapshot(manager, &snapshot) != SUCCESS) {
+        set_result(result, HEALTH_FAILED, "device manager unavailable");
+    } else if (!snapshot.heartbeat_running) {
+        set_result(result, HEALTH_FAILED, "sweep stopped");
+    } else {
+        set_result(result, HEALTH_OK, "%d devices", snapshot.device_count);
+    }
+}
+
+// ============================================================================
+// SYSTEMD NOTIFICATION
+// ============================================================================
+
+/**
+ * @brief Connect to the systemd notification socket if there is one
+ */
+static void notify_open(HealthMonitor *monitor) {
+    const char *path = getenv("NOTIFY_SOCKET");
+    if (!path || !path[0]) {
+        return;
+    }
+
+    size_t length = strlen(path);
+    if ((path[0] != '/' && path[0] != '@') || length >= sizeof(monitor->notify_addr.sun_path)) {
+        LOG_WARN("Ignoring unsupported NOTIFY_SOCKET: %s", path);
+        return;
+    }
+
+    memset(&monitor->notify_addr, 0, sizeof(monitor->notify_addr));
+    monitor->notify_addr.sun_family = AF_UNIX;
+    memcpy(monitor->notify_addr.sun_path, path, length);
+    if (path[0] == '@') {
+        monitor->notify_addr.sun_path[0] = '\0';    // Abstract namespace
+    }
+    monitor->notify_addr_len = (socklen_t)(offsetof(struct sockaddr_un, sun_path) + length);
+
+    monitor->notify_fd = socket(AF_UNIX, SOCK_DGRAM | SOCK_CLOEXEC | SOCK_NONBLOCK, 0);
+    if (monitor->notify_fd < 0) {
+        LOG_WARN("Failed to create systemd notification socket: %s", strerror(errno));
+        return;
+    }
+
+    // WATCHDOG_PID guards against the variables leaking to a child process
+    const char *usec = getenv("WATCHDOG_USEC");
+    const char *pid = getenv("WATCHDOG_PID");
+    if (usec && (!pid || strtol(pid, NULL, 10) == (long)getpid())) {
+        monitor->watchdog_ms = strtoull(usec, NULL, 10) / 1000ULL;
+    }
+}
+
+/**
+ * @brief Send one notification message to systemd
+ */
+static void notify_send(HealthMonitor *monitor, const char *message) {
+    if (monitor->notify_fd < 0) {
+        return;
+    }
+
+    if (sendto(monitor->notify_fd, message, strlen(message), MSG_NOSIGNAL,
+               (struct sockaddr*)&monitor->notify_addr, monitor->notify_addr_len) < 0) {
+        LOG_WARN_RATELIMITED("systemd notification failed: %s", strerror(errno));
+    }
+}
+
+/**
+ * @brief Publish the health summary as the unit status line
+ *
+ * Sent only when the text changes.
+ */
+static void notify_status(HealthMonitor *monitor) {
+    const HealthReport *report = &monitor->report;
+    char message[sizeof(monitor->status)];
+
+    if (report->level == HEALTH_OK) {
+        snprintf(message, sizeof(message), "STATUS=Healthy, %s",
+                 report->checks[HEALTH_CHECK_HEARTBEAT].detail);
+    } else {
+        for (int i = 0; i < HEALTH_CHECK_COUNT; i++) {
+            if (report->checks[i].level == report->level) {
+                snprintf(message, sizeof(message), "STATUS=%s: %s %s",
+                         report->level == HEALTH_FAILED ? "Failed" : "Degraded",
+                         check_names[i], report->checks[i].detail);
+                break;
+            }
+        }
+    }
+
+    if (strcmp(message, monitor->status) != 0) {
+        memcpy(monitor->status, message, sizeof(monitor->status));
+        notify_send(monitor, message);
+    }
+}
+
+// ============================================================================
+// EVALUATION
+// ============================================================================
+
+/**
+ * @brief Run all checks and log level changes
+ */
+static void evaluate(HealthMonitor *monitor, uint64_t now_ms, uint64_t lag_ms) {
+    HealthReport *report = &monitor->report;
+    HealthLevel previous = report->level;
+
+    report->evaluated_ms = now_ms;
+    report->loop_lag_ms = lag_ms;
+    report->notifier_oldest_ms = notifier_oldest_pending_ms(monitor->targets.notifier);
+
+    check_loop(lag_ms, &report->checks[HEALTH_CHECK_LOOP]);
+    check_notifier(monitor->targets.notifier, report->notifier_oldest_ms,
+                   &report->checks[HEALTH_CHECK_NOTIFIER]);
+    report->door_last_event_ms = check_door(now_ms, &report->checks[HEALTH_CHECK_DOOR]);
+    check_bluetooth(monitor->targets.bluetooth_server, &report->checks[HEALTH_CHECK_BLUETOOTH]);
+    check_heartbeat(monitor->targets.device_manager, &report->checks[HEALTH_CHECK_HEARTBEAT]);
+
+    report->level = HEALTH_OK;
+    for (int i = 0; i < HEALTH_CHECK_COUNT; i++) {
+        if (report->checks[i].level > report->level) {
+            report->level = report->checks[i].level;
+        }
+    }
+
+    metrics_gauge_set(&health_level_gauge, report->level);
+    metrics_gauge_set(&loop_lag_gauge, (int64_t)lag_ms);
+
+    if (report->level == previous) {
+        notify_status(monitor);
+        return;
+    }
+
+    for (int i = 0; i < HEALTH_CHECK_COUNT; i++) {
+        if (report->checks[i].level != HEALTH_OK) {
+            LOG_WARN("Health %s: %s %s", level_names[report->level],
+                     check_names[i], report->checks[i].detail);
+        }
+    }
+    if (report->level == HEALTH_OK) {
+        LOG_INFO("Health recovered: ok");
+    } else if (report->level == HEALTH_FAILED && monitor->watchdog_ms > 0) {
+        LOG_ERROR("Withholding systemd watchdog pings until health recovers");
+    }
+    notify_status(monitor);
+}
+
+/**
+ * @brief Arm the next health tick
+ */
+static void schedule_tick(HealthMonitor *monitor, uint64_t now_ms);
+
+/**
+ * @brief Health timer handler
+ */
+static void health_tick(void *userdata) {
+    HealthMonitor *monitor = userdata;
+    uint64_t now = reactor_now_ms();
+    uint64_t lag = now > monitor->next_tick_ms ? now - monitor->next_tick_ms : 0;
+
+    monitor->timer_id = 0;
+    __atomic_store_n(&monitor->loop_tick_ms, now, __ATOMIC_RELEASE);
+
+    evaluate(monitor, now, lag);
+
+    if (monitor->watchdog_ms > 0 && monitor->report.level != HEALTH_FAILED) {
+        notify_send(monitor, "WATCHDOG=1");
+        METRICS_INC(&watchdog_pings);
+    }
+
+    schedule_tick(monitor, now);
+}
+
+static void schedule_tick(HealthMonitor *monitor, uint64_t now_ms) {
+    monitor->next_tick_ms = now_ms + monitor->interval_ms;
+    monitor->timer_id = reactor_add_timer(monitor->reactor, monitor->interval_ms, 0,
+                                          health_tick, monitor);
+    if (monitor->timer_id < 0) {
+        // Without the tick the watchdog starves, which is the right outcome
+        LOG_ERROR("Failed to schedule health check: %d", monitor->timer_id);
+        monitor->timer_id = 0;
+    }
+}
+
+// ============================================================================
+// STALL DETECTOR
+// ============================================================================
+
+/**
+ * @brief Stall detector thread
+ *
+ * Logs when the loop tick stops advancing and again when it resumes.
+ * It only reads the tick timestamp, so it cannot itself be blocked by
+ * whatever holds up the loop.
+ */
+static void* stall_detector(void *arg) {
+    HealthMonitor *monitor = arg;
+    uint64_t stalled_since = 0;
+
+    pthread_mutex_lock(&monitor->stall_mutex);
+    while (!monitor->stall_stop) {
+        struct timespec deadline;
+        clock_gettime(CLOCK_MONOTONIC, &deadline);
+        deadline.tv_sec += 1;
+        pthread_cond_timedwait(&monitor->stall_cond, &monitor->stall_mutex, &deadline);
+        if (monitor->stall_stop) {
+            break;
+        }
+
+        uint64_t tick = __atomic_load_n(&monitor->loop_tick_ms, __ATOMIC_ACQUIRE);
+        uint64_t now = reactor_now_ms();
+        uint64_t silent = now > tick ? now - tick : 0;
+
+        if (silent >= HEALTH_STALL_TIMEOUT_MS + monitor->interval_ms) {
+            if (stalled_since != tick) {
+                stalled_since = tick;
+                METRICS_INC(&loop_stalls);
+                LOG_ERROR("Event loop stalled: no health tick for %llu ms",
+                          (unsigned long long)silent);
+            }
+        } else if (stalled_since != 0) {
+            LOG_WARN("Event loop resumed after a stall");
+            stalled_since = 0;
+        }
+    }
+    pthread_mutex_unlock(&monitor->stall_mutex);
+
+    return NULL;
+}
+
+/**
+ * @brief Start the stall detector thread
+ */
+static int start_stall_detector(HealthMonitor *monitor) {
+    pthread_condattr_t attr;
+
+    if (pthread_mutex_init(&monitor->stall_mutex, NULL) != 0) {
+        return ERROR_GENERIC;
+    }
+    pthread_condattr_init(&attr);
+    pthread_condattr_setclock(&attr, CLOCK_MONOTONIC);
+    int result = pthread_cond_init(&monitor->stall_cond, &attr);
+    pthread_condattr_destroy(&attr);
+    if (result != 0) {
+        pthread_mutex_destroy(&monitor->stall_mutex);
+        return ERROR_GENERIC;
+    }
+
+    // Normal scheduling even when the reactor runs SCHED_FIFO: a spinning
+    // real-time loop would otherwise starve the thread meant to report it
+    pthread_attr_t thread_attr;
+    struct sched_param param = { .sched_priority = 0 };
+    pthread_attr_init(&thread_attr);
+    pthread_attr_setinheritsched(&thread_attr, PTHREAD_EXPLICIT_SCHED);
+    pthread_attr_setschedpolicy(&thread_attr, SCHED_OTHER);
+    pthread_attr_setschedparam(&thread_attr, &param);
+    result = pthread_create(&monitor->stall_thread, &thread_attr, stall_detector, monitor);
+    pthread_attr_destroy(&thread_attr);
+    if (result != 0) {
+        pthread_cond_destroy(&monitor->stall_cond);
+        pthread_mutex_destroy(&monitor->stall_mutex);
+        return ERROR_GENERIC;
+    }
+    monitor->stall_thread_running = 1;
+
+    return 0;
+}
+
+// ============================================================================
+// PUBLIC API
+// ============================================================================
+
+int health_monitor_init(HealthMonitor *monitor, Reactor *reactor, const HealthTargets *targets) {
+    if (!monitor || !reactor || !targets || !targets->device_manager ||
+        !targets->bluetooth_server || !targets->notifier) {
+        return ERROR_INVALID_PARAM;
+    }
+
+    memset(monitor, 0, sizeof(HealthMonitor));
+    monitor->targets = *targets;
+    monitor->notify_fd = -1;
+    metrics_register_all(health_metrics, sizeof(health_metrics) / sizeof(health_metrics[0]));
+
+    notify_open(monitor);
+
+    // Tick at least twice per watchdog period
+    monitor->interval_ms = HEALTH_CHECK_INTERVAL_MS;
+    if (monitor->watchdog_ms > 0 && monitor->watchdog_ms / 2 < monitor->interval_ms) {
+        monitor->interval_ms = monitor->watchdog_ms / 2 > 0 ? monitor->watchdog_ms / 2 : 1;
+    }
+
+    uint64_t now = reactor_now_ms();
+    monitor->loop_tick_ms = now;
+
+    int result = start_stall_detector(monitor);
+    if (result != 0) {
+        LOG_ERROR("Failed to start event loop stall detector");
+        if (monitor->notify_fd >= 0) {
+            close(monitor->notify_fd);
+        }
+        memset(monitor, 0, sizeof(HealthMonitor));
+        return result;
+    }
+
+    monitor->reactor = reactor;
+    evaluate(monitor, now, 0);
+    schedule_tick(monitor, now);
+
+    notify_send(monitor, "READY=1");
+    if (monitor->watchdog_ms > 0) {
+        LOG_INFO("systemd watchdog enabled: %llu ms period, health tick every %llu ms",
+                 (unsigned long long)monitor->watchdog_ms,
+                 (unsigned long long)monitor->interval_ms);
+    }
+    LOG_INFO("Health monitor started: %s", level_names[monitor->report.level]);
+
+    return 0;
+}
+
+void health_monitor_cleanup(HealthMonitor *monitor) {
+    if (!monitor || !monitor->reactor) {
+        return;
+    }
+
+    notify_send(monitor, "STOPPING=1");
+
+    if (monitor->timer_id > 0) {
+        reactor_cancel_timer(monitor->reactor, monitor->timer_id);
+        monitor->timer_id = 0;
+    }
+
+    if (monitor->stall_thread_running) {
+        pthread_mutex_lock(&monitor->stall_mutex);
+        monitor->stall_stop = 1;
+        pthread_cond_signal(&monitor->stall_cond);
+        pthread_mutex_unlock(&monitor->stall_mutex);
+        pthread_join(monitor->stall_thread, NULL);
+        pthread_cond_destroy(&monitor->stall_cond);
+        pthread_mutex_destroy(&monitor->stall_mutex);
+        monitor->stall_thread_running = 0;
+    }
+
+    if (monitor->notify_fd >= 0) {
+        close(monitor->notify_fd);
+        monitor->notify_fd = -1;
+    }
+    monitor->reactor = NULL;
+}
+
+const HealthReport* health_monitor_report(const HealthMonitor *monitor) {
+    return &monitor->report;
+}
+
+const char* health_level_name(HealthLevel level) {
+    if (level < HEALTH_OK || level > HEALTH_FAILED) {
+        return "unknown";
+    }
+    return level_names[level];
+}
+
+const char* health_check_name(HealthCheckId check) {
+    if (check < 0 || check >= HEALTH_CHECK_COUNT) {
+        return "unknown";
+    }
+    return check_names[check];
+}
+
+// ============================================================================
+// SYSTEM STATUS (BLEHost.h)
+// ============================================================================
+
+int get_system_health(DeviceManager *device_manager, BluetoothServer *bluetooth_server) {
+    HealthCheckResult door, bluetooth, heartbeat;
+
+    if (!device_manager || !bluetooth_server) {
+        return 0;
+    }
+
+    check_door(reactor_now_ms(), &door);
+    check_bluetooth(bluetooth_server, &bluetooth);
+    check_heartbeat(device_manager, &heartbeat);
+
+    return door.level == HEALTH_OK && bluetooth.level == HEALTH_OK &&
+           heartbeat.level == HEALTH_OK;
+}
@@ -0,0 +1,170 @@
+/**
+ * @file health.h
+ * @brief Health model, systemd notification and event-loop watchdog
+ *
+ * The health monitor evaluates the daemon from a reactor timer and rates
+ * each component OK, DEGRADED or FAILED:
+ * - loop: how late the health timer itself fired (event loop lag)
+ * - notifier: age of the oldest queued or in-flight notification
+ * - door: sensor state and time of the last edge
+ * - bluetooth: L2CAP listening socket
+ * - heartbeat: device timeout sweep
+ *
+ * The overall level is the worst component level. When the service runs
+ * under systemd with WatchdogSec=, the monitor pings the watchdog from
+ * the same timer, and only while nothing is FAILED: a wedged event loop
+ * or a stuck subsystem stops the pings and systemd restarts the daemon.
+ * DEGRADED conditions such as a door sensor error keep the pings going
+ * because a restart would not repair them.
+ *
+ * Since a wedged loop cannot report itself, a small stall detector thread
+ * watches the loop tick and logs an error once the loop has been silent
+ * for HEALTH_STALL_TIMEOUT_MS, so the freeze is visible before systemd
+ * acts on it.
+ *
+ * Threading:
+ * All functions must be called from the reactor thread, except
+ * health_level_name().
+ */
+
+#ifndef HEALTH_H
+#define HEALTH_H
+
+#include <stdint.h>
+#include <pthread.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+
+#include "config.h"
+#include "reactor.h"
+#include "device_manager.h"
+#include "bluetooth_server.h"
+#include "notifier.h"
+
+// ============================================================================
+// DATA STRUCTURES
+// ============================================================================
+
+/**
+ * @brief Health level, ordered from best to worst
+ */
+typedef enum {
+    HEALTH_OK = 0,                      /// Working normally
+    HEALTH_DEGRADED = 1,                /// Working with reduced function
+    HEALTH_FAILED = 2                   /// Not working; a restart is expected to help
+} HealthLevel;
+
+/**
+ * @brief Evaluated components
+ */
+typedef enum {
+    HEALTH_CHECK_LOOP = 0,
+    HEALTH_CHECK_NOTIFIER,
+    HEALTH_CHECK_DOOR,
+    HEALTH_CHECK_BLUETOOTH,
+    HEALTH_CHECK_HEARTBEAT,
+    HEALTH_CHECK_COUNT
+} HealthCheckId;
+
+/**
+ * @brief Result of one component check
+ */
+typedef struct {
+    HealthLevel level;                  /// Component level
+    char detail[64];                    /// Short explanation for operators
+} HealthCheckResult;
+
+/**
+ * @brief Outcome of one evaluation
+ */
+typedef struct {
+    HealthLevel level;                  /// Worst component level
+    uint64_t evaluated_ms;              /// Reactor time of the evaluation
+    uint64_t loop_lag_ms;               /// Lateness of the health timer
+    uint64_t notifier_oldest_ms;        /// Age of the oldest pending notification
+    int64_t door_last_event_ms;         /// Milliseconds since the last door edge, -1 if none
+    HealthCheckResult checks[HEALTH_CHECK_COUNT]; /// Per-component results
+} HealthReport;
+
+/**
+ * @brief Subsystems the monitor inspects
+ */
+typedef struct {
+    DeviceManager *device_manager;      /// Heartbeat sweep
+    BluetoothServer *bluetooth_server;  /// L2CAP server socket
+    Notifier *notifier;                 /// Notification queue
+} HealthTargets;
+
+/**
+ * @brief Health monitor state
+ */
+typedef struct HealthMonitor {
+    Reactor *reactor;                   /// Loop running the health timer
+    HealthTargets targets;              /// Inspected subsystems
+    int timer_id;                       /// Pending health timer, 0 if none
+    uint64_t interval_ms;               /// Evaluation period
+    uint64_t next_tick_ms;              /// Reactor time the timer is due
+    HealthReport report;                /// Latest evaluation
+
+    int notify_fd;                      /// systemd notification socket, -1 if none
+    struct sockaddr_un notify_addr;     /// NOTIFY_SOCKET address
+    socklen_t notify_addr_len;          /// Length of notify_addr
+    uint64_t watchdog_ms;               /// systemd watchdog period, 0 if disabled
+    char status[128];                   /// Last STATUS= line sent
+
+    uint64_t loop_tick_ms;              /// Last loop tick (shared with the stall detector)
+    int stall_stop;                     /// Asks the stall detector to exit
+    int stall_thread_running;           /// Stall detector was started
+    pthread_t stall_thread;             /// Stall detector thread
+    pthread_mutex_t stall_mutex;        /// Protects stall_cond waits
+    pthread_cond_t stall_cond;          /// Wakes the stall detector on shutdown
+} HealthMonitor;
+
+// ============================================================================
+// LIFECYCLE
+// ============================================================================
+
+/**
+ * @brief Start health monitoring and report readiness to systemd
+ * @param monitor Pointer to monitor to initialize
+ * @param reactor Event loop to measure and run the checks on
+ * @param targets Subsystems to inspect (copied)
+ * @return 0 on success, negative on error
+ *
+ * Call once every subsystem is running: this sends READY=1 when the
+ * daemon runs as a Type=notify service.
+ */
+int health_monitor_init(HealthMonitor *monitor, Reactor *reactor, const HealthTargets *targets);
+
+/**
+ * @brief Stop monitoring and report shutdown to systemd
+ * @param monitor Pointer to monitor
+ */
+void health_monitor_cleanup(HealthMonitor *monitor);
+
+// ============================================================================
+// EVALUATION
+// ============================================================================
+
+/**
+ * @brief Get the latest evaluation
+ * @param monitor Pointer to monitor
+ * @return Report updated on every health tick
+ */
+const HealthReport* health_monitor_report(const HealthMonitor *monitor);
+
+/**
+ * @brief Name of a health level
+ * @param level Health level
+ * @return "ok", "degraded" or "failed"
+ */
+const char* health_level_name(HealthLevel level);
+
+/**
+ * @brief Name of a component check
+ * @param check Component
+ * @return Short name such as "loop" or "door"
+ */
+const char* health_check_name(HealthCheckId check);
+
+#endif // HEALTH_H
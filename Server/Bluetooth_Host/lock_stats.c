@@ -0,0 +1,267 @@
+/**
+ * @file lock_stats.c
+ * @brief Implementation of instrumented mutexes with contention statistics
+ *
+ * The fast path tries the lock first; only when that fails is the
+ * acquisition counted as contended and its call site accounted. Class
+ * counters and histograms are per-thread metrics, so the fast path does
+ * no atomic read-modify-write beyond the mutex itself.
+ */
+
+#define _GNU_SOURCE
+#include <time.h>
+
+#include "lock_stats.h"
+#include "logger.h"
+
+// ============================================================================
+// STATIC VARIABLES
+// ============================================================================
+
+/// Protects registration of classes and sites (plain mutex, never instrumented)
+static pthread_mutex_t registry_mutex = PTHREAD_MUTEX_INITIALIZER;
+static LockClass *class_list = NULL;
+static LockSite *site_list = NULL;
+
+// ============================================================================
+// INTERNAL HELPER FUNCTIONS
+// ============================================================================
+
+/**
+ * @brief Read the monotonic clock in nanoseconds
+ * @return Current monotonic time
+ */
+static uint64_t now_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ULL + (uint64_t)ts.tv_nsec;
+}
+
+/**
+ * @brief Raise a maximum if the new value is larger (relaxed, best effort)
+ * @param max Pointer to stored maximum
+ * @param value Candidate value
+ */
+static void update_max(uint64_t *max, uint64_t value) {
+    uint64_t current = __atomic_load_n(max, __ATOMIC_RELAXED);
+    while (value > current &&
+           !__atomic_compare_exchange_n(max, &current, value, 1,
+                                        __ATOMIC_RELAXED, __ATOMIC_RELAXED)) {
+        // current reloaded by the failed exchange
+    }
+}
+
+/**
+ * @brief Link a lock class into the global list on first use
+ * @param lock_class Class to register
+ */
+static void register_class(LockClass *lock_class) {
+    if (__atomic_load_n(&lock_class->registered, __ATOMIC_ACQUIRE)) {
+        return;
+    }
+
+    Metric *metrics[] = {
+        &lock_class->acquisitions, &lock_class->contended,
+        &lock_class->wait_ns, &lock_class->hold_ns
+    };
+    metrics_register_all(metrics, sizeof(metrics) / sizeof(metrics[0]));
+
+    pthread_mutex_lock(&registry_mutex);
+    if (!lock_class->registered) {
+        lock_class->next = class_list;
+        class_list = lock_class;
+        __atomic_store_n(&lock_class->registered, 1, __ATOMIC_RELEASE);
+    }
+    pthread_mutex_unlock(&registry_mutex);
+}
+
+/**
+ * @brief Link a call site into the global list on its first slow acquisition
+ * @param site Site to register
+ */
+static void register_site(LockSite *site) {
+    if (__atomic_load_n(&site->registered, __ATOMIC_ACQUIRE)) {
+        return;
+    }
+
+    pthread_mutex_lock(&registry_mutex);
+    if (!site->registered) {
+        site->next = site_list;
+        site_list = site;
+        __atomic_store_n(&site->registered, 1, __ATOMIC_RELEASE);
+    }
+    pthread_mutex_unlock(&registry_mutex);
+}
+
+/**
+ * @brief Format a nanosecond duration with a readable unit
+ * @param buffer Output buffer
+ * @param buffer_size Size of the output buffer
+ * @param ns Duration in nanoseconds
+ * @return Pointer to buffer
+ */
+static const char* format_duration(char *buffer, size_t buffer_size, uint64_t ns) {
+    if (ns < 1000ULL) {
+        snprintf(buffer, buffer_size, "%lluns", (unsigned long long)ns);
+    } else if (ns < 1000000ULL) {
+        snprintf(buffer, buffer_size, "%.1fus", ns / 1000.0);
+    } else {
+        snprintf(buffer, buffer_size, "%.1fms", ns / 1000000.0);
+    }
+    return buffer;
+}
+
+// ============================================================================
+// LOCKING
+// ============================================================================
+
+int instrumented_mutex_init(InstrumentedMutex *mutex, LockClass *lock_class) {
+    if (!mutex || !lock_class) {
+        return ERROR_INVALID_PARAM;
+    }
+
+    if (pthread_mutex_init(&mutex->mutex, NULL) != 0) {
+        return ERROR_GENERIC;
+    }
+
+    mutex->lock_class = lock_class;
+    mutex->holder = NULL;
+    mutex->acquired_ns = 0;
+    mutex->counted_slow = 0;
+    register_class(lock_class);
+
+    return SUCCESS;
+}
+
+void instrumented_mutex_destroy(InstrumentedMutex *mutex) {
+    if (!mutex) {
+        return;
+    }
+
+    pthread_mutex_destroy(&mutex->mutex);
+    mutex->holder = NULL;
+}
+
+void instrumented_mutex_lock(InstrumentedMutex *mutex, LockSite *site) {
+    LockClass *lock_class = mutex->lock_class;
+    uint64_t start = now_ns();
+    uint64_t wait_ns = 0;
+    int contended = 0;
+
+    if (pthread_mutex_trylock(&mutex->mutex) != 0) {
+        pthread_mutex_lock(&mutex->mutex);
+        uint64_t acquired = now_ns();
+        wait_ns = acquired - start;
+        start = acquired;
+        contended = 1;
+
+        METRICS_INC(&lock_class->contended);
+        update_max(&lock_class->max_wait_ns, wait_ns);
+
+        register_site(site);
+        __atomic_fetch_add(&site->slow_count, 1, __ATOMIC_RELAXED);
+        __atomic_fetch_add(&site->total_wait_ns, wait_ns, __ATOMIC_RELAXED);
+    }
+
+    // Statically initialized mutexes register on first acquisition
+    if (!lock_class->registered) {
+        register_class(lock_class);
+    }
+
+    METRICS_INC(&lock_class->acquisitions);
+    metrics_histogram_observe(&lock_class->wait_ns, wait_ns);
+
+    __atomic_store_n(&mutex->acquired_ns, start, __ATOMIC_RELAXED);
+    __atomic_store_n(&mutex->holder, site, __ATOMIC_RELAXED);
+    mutex->counted_slow = contended;
+}
+
+void instrumented_mutex_unlock(InstrumentedMutex *mutex) {
+    LockClass *lock_class = mutex->lock_class;
+    LockSite *site = mutex->holder;
+    uint64_t hold_ns = now_ns() - mutex->acquired_ns;
+
+    metrics_histogram_observe(&lock_class->hold_ns, hold_ns);
+    update_max(&lock_class->max_hold_ns, hold_ns);
+
+    if (site && hold_ns >= LOCK_STATS_SLOW_HOLD_US * 1000ULL) {
+        register_site(site);
+        // A contended acquisition was counted when it got the lock
+        if (!mutex->counted_slow) {
+            __atomic_fetch_add(&site->slow_count, 1, __ATOMIC_RELAXED);
+        }
+        update_max(&site->max_hold_ns, hold_ns);
+    }
+
+    __atomic_store_n(&mutex->holder, NULL, __ATOMIC_RELAXED);
+    pthread_mutex_unlock(&mutex->mutex);
+}
+
+uint64_t instrumented_mutex_held_ns(const InstrumentedMutex *mutex, const LockSite **holder) {
+    if (!mutex) {
+        return 0;
+    }
+
+    LockSite *site = __atomic_load_n(&mutex->holder, __ATOMIC_RELAXED);
+    uint64_t acquired = __atomic_load_n(&mutex->acquired_ns, __ATOMIC_RELAXED);
+
+    if (holder) {
+        *holder = site;
+    }
+
+    if (!site) {
+        return 0;
+    }
+
+    uint64_t now = now_ns();
+    return (now > acquired) ? now - acquired : 0;
+}
+
+// ============================================================================
+// REPORTING
+// ============================================================================
+
+const LockClass* lock_stats_first_class(void) {
+    pthread_mutex_lock(&registry_mutex);
+    const LockClass *first = class_list;
+    pthread_mutex_unlock(&registry_mutex);
+    return first;
+}
+
+void lock_stats_dump(void) {
+    char p50[16], p99[16], max[16];
+
+    LOG_INFO("=== Lock statistics ===");
+
+    for (const LockClass *c = lock_stats_first_class(); c; c = c->next) {
+        uint64_t acquisitions = metrics_counter_value(&c->acquisitions);
+        uint64_t contended = metrics_counter_value(&c->contended);
+        MetricHistogramSnapshot wait, hold;
+        metrics_histogram_read(&c->wait_ns, &wait);
+        metrics_histogram_read(&c->hold_ns, &hold);
+
+        LOG_INFO("%s: %llu acquisitions, %llu contended (%.2f%%)", c->name,
+                 (unsigned long long)acquisitions, (unsigned long long)contended,
+                 acquisitions ? 100.0 * contended / acquisitions : 0.0);
+        LOG_INFO("  wait p50<=%s p99<=%s max=%s",
+                 format_duration(p50, sizeof(p50), metrics_histogram_percentile(&wait, 50)),
+                 format_duration(p99, sizeof(p99), metrics_histogram_percentile(&wait, 99)),
+                 format_duration(max, sizeof(max), __atomic_load_n(&c->max_wait_ns, __ATOMIC_RELAXED)));
+        LOG_INFO("  hold p50<=%s p99<=%s max=%s",
+                 format_duration(p50, sizeof(p50), metrics_histogram_percentile(&hold, 50)),
+                 format_duration(p99, sizeof(p99), metrics_histogram_percentile(&hold, 99)),
+                 format_duration(max, sizeof(max), __atomic_load_n(&c->max_hold_ns, __ATOMIC_RELAXED)));
+    }
+
+    pthread_mutex_lock(&registry_mutex);
+    LockSite *sites = site_list;
+    pthread_mutex_unlock(&registry_mutex);
+
+    for (LockSite *s = sites; s; s = s->next) {
+        LOG_INFO("  slow site %s:%d (%s): %llu slow, wait total=%s, max hold=%s",
+                 s->file, s->line, s->function,
+                 (unsigned long long)__atomic_load_n(&s->slow_count, __ATOMIC_RELAXED),
+                 format_duration(p50, sizeof(p50), __atomic_load_n(&s->total_wait_ns, __ATOMIC_RELAXED)),
+                 format_duration(max, sizeof(max), __atomic_load_n(&s->max_hold_ns, __ATOMIC_RELAXED)));
+    }
+}
@@ -0,0 +1,173 @@
+/**
+ * @file lock_stats.h
+ * @brief Instrumented mutexes with contention statistics
+ *
+ * This module wraps pthread mutexes to measure how long threads wait for
+ * a lock and how long they hold it. It is cheap enough to stay enabled in
+ * production and can be dumped at runtime to find locks held across slow
+ * operations such as network I/O or console output.
+ *
+ * Features:
+ * - Wait and hold time histograms per lock class (log2 nanosecond buckets)
+ * - Holder call site tracking (file, line, function)
+ * - Per call site accounting of contended and long-held acquisitions
+ * - Uncontended fast path: trylock, two clock reads, per-thread counters
+ * - Class counters and histograms exported as labeled metrics
+ *
+ * Usage:
+ * Declare one LockClass per kind of lock (several mutexes may share a
+ * class), initialize mutexes with instrumented_mutex_init() or the static
+ * initializer, and lock through INSTRUMENTED_LOCK()/INSTRUMENTED_UNLOCK().
+ */
+
+#ifndef LOCK_STATS_H
+#define LOCK_STATS_H
+
+#include <stdint.h>
+#include <pthread.h>
+
+#include "config.h"
+#include "metrics.h"
+
+// ============================================================================
+// DATA STRUCTURES
+// ============================================================================
+
+/**
+ * @brief Statistics for one acquisition call site
+ *
+ * Declared statically at each call site by INSTRUMENTED_LOCK(). Only slow
+ * acquisitions (contended, or held longer than LOCK_STATS_SLOW_HOLD_US)
+ * are accounted here, keeping the uncontended path free of site updates.
+ */
+typedef struct LockSite {
+    const char *file;                   /// Source file of the call site
+    int line;                           /// Source line of the call site
+    const char *function;               /// Function containing the call site
+    uint64_t slow_count;                /// Acquisitions that were contended, long-held or both
+    uint64_t total_wait_ns;             /// Wait time accumulated by slow acquisitions
+    uint64_t max_hold_ns;               /// Longest hold observed from this site
+    int registered;                     /// Site is linked in the global site list
+    struct LockSite *next;              /// Next registered site
+} LockSite;
+
+/**
+ * @brief Statistics shared by all mutexes of one kind
+ *
+ * Counters and histograms are per-thread metrics labeled with the class
+ * name; only the maxima are shared values.
+ */
+typedef struct LockClass {
+    const char *name;                   /// Lock class name (e.g. "manager_mutex")
+    Metric acquisitions;                /// Total acquisitions
+    Metric contended;                   /// Acquisitions that had to wait
+    Metric wait_ns;                     /// Wait time distribution (nanoseconds)
+    Metric hold_ns;                     /// Hold time distribution (nanoseconds)
+    uint64_t max_wait_ns;               /// Longest wait observed
+    uint64_t max_hold_ns;               /// Longest hold observed
+    int registered;                     /// Class is linked in the global class list
+    struct LockClass *next;             /// Next registered class
+} LockClass;
+
+/**
+ * @brief Mutex with contention instrumentation
+ *
+ * The holder fields are written only by the thread owning the mutex and
+ * read racily by diagnostics.
+ */
+typedef struct {
+    pthread_mutex_t mutex;              /// Underlying mutex
+    LockClass *lock_class;              /// Statistics class of this mutex
+    LockSite *holder;                   /// Call site currently holding the lock
+    uint64_t acquired_ns;               /// Monotonic time of the current acquisition
+    int counted_slow;                   /// Current acquisition already in its site's slow_count
+} InstrumentedMutex;
+
+/// Static initializer for LockClass (class_name must be a string literal)
+#define LOCK_CLASS_INIT(class_name) { \
+    .name = (class_name), \
+    .acquisitions = METRIC_COUNTER_INIT_LABELED("lock_acquisitions_total", \
+        "Mutex acquisitions", "lock=\"" class_name "\""), \
+    .contended = METRIC_COUNTER_INIT_LABELED("lock_contended_total", \
+        "Mutex acquisitions that had to wait", "lock=\"" class_name "\""), \
+    .wait_ns = METRIC_HISTOGRAM_INIT_LABELED("lock_wait_ns", \
+        "Mutex wait time in nanoseconds", "lock=\"" class_name "\""), \
+    .hold_ns = METRIC_HISTOGRAM_INIT_LABELED("lock_hold_ns", \
+        "Mutex hold time in nanoseconds", "lock=\"" class_name "\"") }
+
+/// Static initializer for InstrumentedMutex
+#define INSTRUMENTED_MUTEX_INITIALIZER(class_ptr) \
+    { PTHREAD_MUTEX_INITIALIZER, (class_ptr), NULL, 0, 0 }
+
+// ============================================================================
+// LOCKING
+// ============================================================================
+
+/**
+ * @brief Initialize an instrumented mutex
+ * @param mutex Pointer to mutex to initialize
+ * @param lock_class Statistics class the mutex reports into
+ * @return 0 on success, negative on error
+ */
+int instrumented_mutex_init(InstrumentedMutex *mutex, LockClass *lock_class);
+
+/**
+ * @brief Destroy an instrumented mutex
+ * @param mutex Pointer to mutex to destroy
+ *
+ * Statistics remain in the lock class.
+ */
+void instrumented_mutex_destroy(InstrumentedMutex *mutex);
+
+/**
+ * @brief Acquire an instrumented mutex
+ * @param mutex Pointer to mutex
+ * @param site Call site statistics (provided by INSTRUMENTED_LOCK)
+ */
+void instrumented_mutex_lock(InstrumentedMutex *mutex, LockSite *site);
+
+/**
+ * @brief Release an instrumented mutex
+ * @param mutex Pointer to mutex
+ */
+void instrumented_mutex_unlock(InstrumentedMutex *mutex);
+
+/**
+ * @brief Get how long the mutex has been held by its current holder
+ * @param mutex Pointer to mutex
+ * @param holder Optional output for the holding call site
+ * @return Hold duration in nanoseconds, 0 if the mutex is free
+ */
+uint64_t instrumented_mutex_held_ns(const InstrumentedMutex *mutex, const LockSite **holder);
+
+/// Acquire an instrumented mutex, accounting the enclosing call site
+#define INSTRUMENTED_LOCK(m) do { \
+    static LockSite lock_site_ = { __FILE__, __LINE__, __func__, 0, 0, 0, 0, NULL }; \
+    instrumented_mutex_lock((m), &lock_site_); \
+} while (0)
+
+/// Release an instrumented mutex
+#define INSTRUMENTED_UNLOCK(m) instrumented_mutex_unlock(m)
+
+// ============================================================================
+// REPORTING
+// ============================================================================
+
+/**
+ * @brief Get the first registered lock class
+ * @return First class, or NULL if no instrumented lock was used yet
+ *
+ * Classes are linked through LockClass.next and are never unregistered.
+ */
+const LockClass* lock_stats_first_class(void);
+
+/**
+ * @brief Log a summary of all lock classes and slow call sites
+ *
+ * Reports acquisitions, contention ratio, wait and hold percentiles
+ * and the call sites responsible for slow acquisitions.
+ * Safe to call at any time from normal thread context.
+ */
+void lock_stats_dump(void);
+
+#endif // LOCK_STATS_H
@@ -7,16 +7,42 @@
  * different system events.
  */
 
+#define _GNU_SOURCE
+#include <unistd.h>
+
 #include "logger.h"
+#include "alloc_stats.h"
+#include "lock_stats.h"
+#include "metrics.h"
+#include "timesource.h"
 
 // ============================================================================
 // STATIC VARIABLES
 // ============================================================================
 
 static LogLevel current_log_level = LOG_LEVEL_INFO;
-static pthread_mutex_t log_mutex = PTHREAD_MUTEX_INITIALIZER;
+static int ratelimit_interval = LOG_RATELIMIT_INTERVAL;
+static int ratelimit_burst = LOG_RATELIMIT_BURST;
+static LockClass log_lock_class = LOCK_CLASS_INIT("log_mutex");
+static InstrumentedMutex log_mutex = INSTRUMENTED_MUTEX_INITIALIZER(&log_lock_class);
 static int logger_initialized = 0;
 
+/// Rate-limited call sites seen so far (protected by log_mutex)
+static LogRateLimit *ratelimit_sites = NULL;
+
+/// Last time the site list was swept for ended windows (protected by log_mutex)
+static time_t ratelimit_last_sweep = 0;
+
+/// Lines written per level, indexed by LogLevel
+static Metric lines_written[] = {
+    METRIC_COUNTER_INIT_LABELED("log_lines_total", "Log lines written", "level=\"error\""),
+    METRIC_COUNTER_INIT_LABELED("log_lines_total", "Log lines written", "level=\"warn\""),
+    METRIC_COUNTER_INIT_LABELED("log_lines_total", "Log lines written", "level=\"info\""),
+    METRIC_COUNTER_INIT_LABELED("log_lines_total", "Log lines written", "level=\"debug\"")
+};
+static Metric lines_suppressed = METRIC_COUNTER_INIT("log_lines_suppressed_total",
+    "Log lines dropped by per-call-site rate limiting");
+
 // ============================================================================
 // INTERNAL HELPER FUNCTIONS
 // ============================================================================
@@ -28,10 +54,12 @@ static int logger_initialized = 0;
  * @return Pointer to buffer on success, NULL on error
  */
 static char* get_timestamp(char *buffer, size_t buffer_size) {
-    time_t now = time(NULL);
-    struct tm *tm_info = localtime(&now);
+    time_t now = timesource_wall();
+    struct tm tm_info;
     
-    if (strftime(buffer, buffer_size, LOG_TIMESTAMP_FORMAT, tm_info) == 0) {
+    // localtime() re-reads TZ and allocates on every call; localtime_r() does not
+    if (!localtime_r(&now, &tm_info) ||
+        strftime(buffer, buffer_size, LOG_TIMESTAMP_FORMAT, &tm_info) == 0) {
         return NULL;
     }
     
@@ -47,6 +75,72 @@ static int should_log(LogLevel level) {
     return (level <= current_log_level);
 }
 
+/**
+ * @brief Write one timestamped log line (log_mutex must be held)
+ * @param level_str String representation of level
+ * @param format Printf-style format string
+ * @param args Variable arguments for format string
+ */
+static void write_log_line(const char *level_str, const char *format, va_list args) {
+    ALLOC_SCOPE(ALLOC_SUBSYSTEM_LOGGER);
+    
+    // Get timestamp
+    char timestamp[32];
+    if (get_timestamp(timestamp, sizeof(timestamp)) == NULL) {
+        strcpy(timestamp, "??:??:??");
+    }
+    
+    // Print timestamp, level and formatted message
+    printf("[%s %s] ", timestamp, level_str);
+    vprintf(format, args);
+    printf("\n");
+    fflush(stdout);
+}
+
+/**
+ * @brief Write one timestamped log line from variable arguments (log_mutex must be held)
+ * @param level_str String representation of level
+ * @param format Printf-style format string
+ * @param ... Variable arguments for format string
+ */
+static void write_log_linef(const char *level_str, const char *format, ...) {
+    va_list args;
+    va_start(args, format);
+    write_log_line(level_str, format, args);
+    va_end(args);
+}
+
+/**
+ * @brief Write the summary of a site's window and start a new one (log_mutex must be held)
+ * @param limit Rate limiting state of the site
+ * @param now Current wall-clock time
+ */
+static void close_ratelimit_window(LogRateLimit *limit, time_t now) {
+    if (limit->suppressed > 0) {
+        write_log_linef(limit->level_str,
+                        "Suppressed %u similar messages in the last %lds: \"%.40s\"",
+                        limit->suppressed, (long)(now - limit->window_start), limit->format);
+    }
+    limit->window_start = now;
+    limit->emitted = 0;
+    limit->suppressed = 0;
+}
+
+/**
+ * @brief Summarize the ended windows of all sites (log_mutex must be held)
+ * @param now Current wall-clock time
+ * @param all Also close windows that are still open (shutdown)
+ */
+static void sweep_ratelimit_sites(time_t now, int all) {
+    ratelimit_last_sweep = now;
+    for (LogRateLimit *site = ratelimit_sites; site; site = site->next) {
+        if (site->suppressed > 0 &&
+            (all || now - site->window_start >= ratelimit_interval)) {
+            close_ratelimit_window(site, now);
+        }
+    }
+}
+
 // ============================================================================
 // PUBLIC FUNCTIONS
 // ============================================================================
@@ -57,11 +151,16 @@ int logger_init(void) {
     }
     
     // Initialize mutex (already done statically, but reset for safety)
-    if (pthread_mutex_init(&log_mutex, NULL) != 0) {
+    if (instrumented_mutex_init(&log_mutex, &log_lock_class) != 0) {
         fprintf(stderr, "Failed to initialize log mutex\n");
         return -1;
     }
     
+    for (size_t i = 0; i < sizeof(lines_written) / sizeof(lines_written[0]); i++) {
+        metrics_register(&lines_written[i]);
+    }
+    metrics_register(&lines_suppressed);
+    
     logger_initialized = 1;
     
     // Log initialization
@@ -76,23 +175,39 @@ void logger_cleanup(void) {
     
     LOG_INFO("Shutting down logging system");
     
-    pthread_mutex_destroy(&log_mutex);
+    // Nothing logs after this, so report what the open windows dropped
+    INSTRUMENTED_LOCK(&log_mutex);
+    sweep_ratelimit_sites(timesource_wall(), 1);
+    INSTRUMENTED_UNLOCK(&log_mutex);
+    
+    instrumented_mutex_destroy(&log_mutex);
     logger_initialized = 0;
 }
 
 void logger_set_level(LogLevel level) {
-    pthread_mutex_lock(&log_mutex);
+    INSTRUMENTED_LOCK(&log_mutex);
     current_log_level = level;
-    pthread_mutex_unlock(&log_mutex);
+    INSTRUMENTED_UNLOCK(&log_mutex);
     
     const char *level_names[] = {"ERROR", "WARN", "INFO", "DEBUG"};
     LOG_INFO("Log level set to: %s", level_names[level]);
 }
 
+void logger_set_ratelimit(int interval, int burst) {
+    if (interval <= 0 || burst <= 0) {
+        return;
+    }
+    
+    INSTRUMENTED_LOCK(&log_mutex);
+    ratelimit_interval = interval;
+    ratelimit_burst = burst;
+    INSTRUMENTED_UNLOCK(&log_mutex);
+}
+
 LogLevel logger_get_level(void) {
-    pthread_mutex_lock(&log_mutex);
+    INSTRUMENTED_LOCK(&log_mutex);
     LogLevel level = current_log_level;
-    pthread_mutex_unlock(&log_mutex);
+    INSTRUMENTED_UNLOCK(&log_mutex);
     return level;
 }
 
@@ -101,59 +216,123 @@ void log_message(const char *level, const char *format, ...) {
         logger_init(); // Auto-initialize if needed
     }
     
-    pthread_mutex_lock(&log_mutex);
+    INSTRUMENTED_LOCK(&log_mutex);
     
-    // Get timestamp
-    char timestamp[32];
-    if (get_timestamp(timestamp, sizeof(timestamp)) == NULL) {
-        strcpy(timestamp, "??:??:??");
+    va_list args;
+    va_start(args, format);
+    write_log_line(level, format, args);
+    va_end(args);
+    
+    INSTRUMENTED_UNLOCK(&log_mutex);
+}
+
+void log_message_level(LogLevel level, const char *level_str, const char *format, ...) {
+    if (!should_log(level)) {
+        return; // Filter out this log level
     }
     
-    // Print timestamp and level
-    printf("[%s %s] ", timestamp, level);
+    if (!logger_initialized) {
+        logger_init(); // Auto-initialize if needed
+    }
+    
+    INSTRUMENTED_LOCK(&log_mutex);
     
-    // Print formatted message
     va_list args;
     va_start(args, format);
-    vprintf(format, args);
+    write_log_line(level_str, format, args);
     va_end(args);
     
-    printf("\n");
-    fflush(stdout);
-    
-    pthread_mutex_unlock(&log_mutex);
+    INSTRUMENTED_UNLOCK(&log_mutex);
+    METRICS_INC(&lines_written[level]);
 }
 
-void log_message_level(LogLevel level, const char *level_str, const char *format, ...) {
+void log_message_ratelimited(LogRateLimit *limit, LogLevel level, const char *level_str,
+                             const char *format, ...) {
     if (!should_log(level)) {
-        return; // Filter out this log level
+        return;
     }
     
     if (!logger_initialized) {
         logger_init(); // Auto-initialize if needed
     }
     
-    pthread_mutex_lock(&log_mutex);
+    INSTRUMENTED_LOCK(&log_mutex);
     
-    // Get timestamp
-    char timestamp[32];
-    if (get_timestamp(timestamp, sizeof(timestamp)) == NULL) {
-        strcpy(timestamp, "??:??:??");
+    if (!limit->registered) {
+        limit->level_str = level_str;
+        limit->format = format;
+        limit->next = ratelimit_sites;
+        ratelimit_sites = limit;
+        limit->registered = 1;
     }
     
-    // Print timestamp and level
-    printf("[%s %s] ", timestamp, level_str);
+    time_t now = timesource_wall();
+    if (now - limit->window_start >= ratelimit_interval) {
+        // New window - report what the previous one dropped
+        close_ratelimit_window(limit, now);
+    }
+    
+    // Other sites may have gone quiet with messages still unreported
+    if (now != ratelimit_last_sweep) {
+        sweep_ratelimit_sites(now, 0);
+    }
+    
+    if (limit->emitted >= (unsigned int)ratelimit_burst) {
+        limit->suppressed++;
+        INSTRUMENTED_UNLOCK(&log_mutex);
+        METRICS_INC(&lines_suppressed);
+        return;
+    }
+    
+    limit->emitted++;
     
-    // Print formatted message
     va_list args;
     va_start(args, format);
-    vprintf(format, args);
+    write_log_line(level_str, format, args);
     va_end(args);
     
-    printf("\n");
-    fflush(stdout);
+    INSTRUMENTED_UNLOCK(&log_mutex);
+    METRICS_INC(&lines_written[level]);
+}
+
+void logger_flush_suppressed(void) {
+    INSTRUMENTED_LOCK(&log_mutex);
+    sweep_ratelimit_sites(timesource_wall(), 0);
+    INSTRUMENTED_UNLOCK(&log_mutex);
+}
+
+unsigned long logger_get_suppressed_count(void) {
+    return (unsigned long)metrics_counter_value(&lines_suppressed);
+}
+
+const char* log_preview(char *buffer, size_t buffer_size, const char *data, size_t data_length) {
+    if (!buffer || buffer_size == 0) {
+        return buffer;
+    }
+    
+    if (!data) {
+        snprintf(buffer, buffer_size, "(null)");
+        return buffer;
+    }
+    
+    // Reserve room for the terminator and a possible "..." suffix
+    size_t limit = (buffer_size > 4) ? buffer_size - 4 : buffer_size - 1;
+    if (limit > LOG_PREVIEW_LENGTH) {
+        limit = LOG_PREVIEW_LENGTH;
+    }
+    
+    size_t count = (data_length < limit) ? data_length : limit;
+    for (size_t i = 0; i < count; i++) {
+        unsigned char c = (unsigned char)data[i];
+        buffer[i] = (c < 0x20 || c == 0x7F) ? '.' : (char)c;
+    }
+    buffer[count] = '\0';
     
-    pthread_mutex_unlock(&log_mutex);
+    if (count < data_length && buffer_size > 4) {
+        strcat(buffer, "...");
+    }
+    
+    return buffer;
 }
 
 // ============================================================================
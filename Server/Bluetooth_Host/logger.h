@@ -8,7 +8,9 @@
  * 
  * Features:
  * - Multiple log levels (INFO, WARN, ERROR)
+ * - Levels above LOG_COMPILED_LEVEL compiled out with their format strings
  * - Automatic timestamping
+ * - Per-call-site rate limiting for repetitive messages
  * - Thread-safe operations
  * - Configurable output format
  * - Production-ready performance
@@ -37,6 +39,28 @@ typedef enum {
     LOG_LEVEL_DEBUG = 3     /// Debug messages (if compiled with DEBUG)
 } LogLevel;
 
+/**
+ * @brief Per-call-site rate limiting state
+ * 
+ * One instance lives at each rate-limited call site (see LOG_RATELIMITED).
+ * Messages are counted per site rather than matched by content, so the
+ * check happens before any formatting. Sites are linked into a list on
+ * first use so that a site which went quiet still gets its summary.
+ * Protected by the logger mutex.
+ */
+typedef struct LogRateLimit {
+    time_t window_start;                /// Start of the current window
+    unsigned int emitted;               /// Messages emitted in the current window
+    unsigned int suppressed;            /// Messages dropped in the current window
+    const char *level_str;              /// Level of the site, for its summary
+    const char *format;                 /// Format string of the site, for its summary
+    int registered;                     /// Site is linked in the global site list
+    struct LogRateLimit *next;          /// Next registered site
+} LogRateLimit;
+
+/// Static initializer for LogRateLimit
+#define LOG_RATELIMIT_INIT { 0, 0, 0, NULL, NULL, 0, NULL }
+
 // ============================================================================
 // LOGGING FUNCTIONS
 // ============================================================================
@@ -68,6 +92,15 @@ void logger_cleanup(void);
  */
 void logger_set_level(LogLevel level);
 
+/**
+ * @brief Set the rate limiting window
+ * @param interval Window length in seconds
+ * @param burst Messages emitted per window and call site
+ * 
+ * Non-positive values are ignored. Defaults come from config.h.
+ */
+void logger_set_ratelimit(int interval, int burst);
+
 /**
  * @brief Get the current log level
  * @return Current minimum log level
@@ -97,26 +130,109 @@ void log_message(const char *level, const char *format, ...);
  */
 void log_message_level(LogLevel level, const char *level_str, const char *format, ...);
 
+/**
+ * @brief Log message subject to per-call-site rate limiting
+ * @param limit Rate limiting state of the calling site
+ * @param level LogLevel enumeration value
+ * @param level_str String representation of level
+ * @param format Printf-style format string
+ * @param ... Variable arguments for format string
+ * 
+ * Emits at most LOG_RATELIMIT_BURST messages per LOG_RATELIMIT_INTERVAL
+ * seconds for the given site (see logger_set_ratelimit()). Once a window has
+ * ended, a single "suppressed N similar messages" summary is written for it,
+ * by the next rate-limited message from any site or by
+ * logger_flush_suppressed(). Suppressed messages are never formatted.
+ */
+void log_message_ratelimited(LogRateLimit *limit, LogLevel level, const char *level_str,
+                             const char *format, ...);
+
+/**
+ * @brief Write the summaries of rate limiting windows that have ended
+ * 
+ * Covers sites that dropped messages and have not logged since. Called
+ * periodically from the event loop; logger_cleanup() writes the summaries
+ * of windows still open.
+ */
+void logger_flush_suppressed(void);
+
+/**
+ * @brief Get total number of messages dropped by rate limiting
+ * @return Number of suppressed messages since startup
+ */
+unsigned long logger_get_suppressed_count(void);
+
+/**
+ * @brief Build a truncated, printable preview of a payload
+ * @param buffer Buffer to store the preview
+ * @param buffer_size Size of the buffer
+ * @param data Payload to preview (may be NULL)
+ * @param data_length Length of the payload in bytes
+ * @return Pointer to buffer
+ * 
+ * Copies at most LOG_PREVIEW_LENGTH characters of the payload, replacing
+ * control characters with '.' and appending "..." when truncated. Used to
+ * log request and response bodies without writing them out in full.
+ */
+const char* log_preview(char *buffer, size_t buffer_size, const char *data, size_t data_length);
+
 // ============================================================================
 // CONVENIENCE MACROS
 // ============================================================================
 
+/// Discard a message of a level that is not compiled in; the arguments are
+/// still type-checked, but the call and its format string are dropped
+#define LOG_COMPILED_OUT(level, level_str, fmt, ...) do { \
+    if (0) log_message_level(level, level_str, fmt, ##__VA_ARGS__); \
+} while (0)
+
 /// Log an informational message
+#if LOG_COMPILED_LEVEL >= 2
 #define LOG_INFO(fmt, ...) log_message_level(LOG_LEVEL_INFO, "INFO", fmt, ##__VA_ARGS__)
+#else
+#define LOG_INFO(fmt, ...) LOG_COMPILED_OUT(LOG_LEVEL_INFO, "INFO", fmt, ##__VA_ARGS__)
+#endif
 
 /// Log a warning message
+#if LOG_COMPILED_LEVEL >= 1
 #define LOG_WARN(fmt, ...) log_message_level(LOG_LEVEL_WARN, "WARN", fmt, ##__VA_ARGS__)
+#else
+#define LOG_WARN(fmt, ...) LOG_COMPILED_OUT(LOG_LEVEL_WARN, "WARN", fmt, ##__VA_ARGS__)
+#endif
 
 /// Log an error message
 #define LOG_ERROR(fmt, ...) log_message_level(LOG_LEVEL_ERROR, "ERROR", fmt, ##__VA_ARGS__)
 
 /// Log a debug message (only if DEBUG is defined)
-#ifdef DEBUG_LOGGING
+#if defined(DEBUG_LOGGING) && LOG_COMPILED_LEVEL >= 3
 #define LOG_DEBUG(fmt, ...) log_message_level(LOG_LEVEL_DEBUG, "DEBUG", fmt, ##__VA_ARGS__)
 #else
 #define LOG_DEBUG(fmt, ...) do { } while(0)
 #endif
 
+/// Log a message with rate limiting bound to this call site
+#define LOG_RATELIMITED(level, level_str, fmt, ...) do { \
+    static LogRateLimit log_site_limit_ = LOG_RATELIMIT_INIT; \
+    log_message_ratelimited(&log_site_limit_, level, level_str, fmt, ##__VA_ARGS__); \
+} while (0)
+
+/// Log a rate-limited informational message
+#if LOG_COMPILED_LEVEL >= 2
+#define LOG_INFO_RATELIMITED(fmt, ...) LOG_RATELIMITED(LOG_LEVEL_INFO, "INFO", fmt, ##__VA_ARGS__)
+#else
+#define LOG_INFO_RATELIMITED(fmt, ...) LOG_COMPILED_OUT(LOG_LEVEL_INFO, "INFO", fmt, ##__VA_ARGS__)
+#endif
+
+/// Log a rate-limited warning message
+#if LOG_COMPILED_LEVEL >= 1
+#define LOG_WARN_RATELIMITED(fmt, ...) LOG_RATELIMITED(LOG_LEVEL_WARN, "WARN", fmt, ##__VA_ARGS__)
+#else
+#define LOG_WARN_RATELIMITED(fmt, ...) LOG_COMPILED_OUT(LOG_LEVEL_WARN, "WARN", fmt, ##__VA_ARGS__)
+#endif
+
+/// Log a rate-limited error message
+#define LOG_ERROR_RATELIMITED(fmt, ...) LOG_RATELIMITED(LOG_LEVEL_ERROR, "ERROR", fmt, ##__VA_ARGS__)
+
 // ============================================================================
 // SPECIALIZED LOGGING FUNCTIONS
 // ============================================================================
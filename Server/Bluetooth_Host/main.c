@@ -8,12 +8,36 @@
  * and Firebase notification system.
  * 
  * System Architecture:
+ * - Event Loop: single epoll reactor driving every subsystem below
  * - Door Sensor Driver: GPIO-based door lock/unlock detection
  * - Device Manager: BLE device tracking and heartbeat monitoring
  * - Bluetooth Server: L2CAP server for BLE communication
- * - FCM Notifications: Firebase Cloud Messaging integration
+ * - FCM Notifications: non-blocking Firebase Cloud Messaging sender
+ * - Reminder Policy: decides when a door-close reminder is due
+ * - Metrics Endpoint: Prometheus scrape page served from the event loop
+ * - Control Socket: status queries and admin commands for door_monitor_ctl
+ * - Health Monitor: component checks and the systemd watchdog
+ * - Realtime: optional SCHED_FIFO, CPU pinning, mlockall, latency probe
  * - Centralized Logging: Thread-safe logging system
  * 
+ * With --simulate the same daemon runs without hardware or network: the
+ * Bluetooth server listens on a loopback socket, the door driver takes
+ * scripted edges, the notifier talks to a local FCM stand-in, and a
+ * scenario file drives all three. Adding --virtual-clock makes time jump
+ * to the next timer whenever the loop is idle, so long scenarios (token
+ * expiry, heartbeat churn, a day of reminders) play in seconds.
+ * 
+ * Startup is a dependency graph of steps run by the startup orchestrator:
+ * GPIO setup, binding the L2CAP socket, signing the OAuth request and
+ * reading the state file run on short-lived startup workers while the main
+ * thread registers everything with the event loop.
+ * 
+ * After startup all work runs on the main thread. The only other threads
+ * are the one wiringPi creates for the GPIO interrupt, which just signals
+ * an event fd, and the health monitor's stall detector, which only logs.
+ * Signals are blocked and read from a signalfd, so no work happens in
+ * asynchronous signal context.
+ * 
  * The system intelligently sends door-close reminders only when:
  * 1. All BLE devices have disconnected (no one present)
  * 2. The door sensor indicates UNLOCKED state
@@ -22,84 +46,280 @@
 
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
+#include <errno.h>
 #include <unistd.h>
+#include <getopt.h>
 #include <signal.h>
 #include <sys/types.h>
+#include <sys/stat.h>
+#include <sys/signalfd.h>
 #include <pthread.h>
 
 // System configuration and modules
 #include "config.h"
+#include "BLEHost.h"
 #include "logger.h"
+#include "lock_stats.h"
+#include "trace.h"
+#include "metrics.h"
+#include "runtime_config.h"
+#include "reactor.h"
 #include "DoorStateDriver.h"
 #include "device_manager.h"
 #include "bluetooth_server.h"
-#include "fcm_notification.h"
+#include "notifier.h"
+#include "reminder.h"
+#include "metrics_server.h"
+#include "control_server.h"
+#include "health.h"
+#include "startup.h"
+#include "state_file.h"
+#include "realtime.h"
+#include "fcm_standin.h"
+#include "simulation.h"
+#include "timesource.h"
+#include "alloc_stats.h"
+#include "status_shm.h"
+#include "profiler.h"
 
 // ============================================================================
 // GLOBAL SYSTEM VARIABLES
 // ============================================================================
 
+static Reactor g_reactor = { .epoll_fd = -1 };
 static DeviceManager g_device_manager = {0};
 static BluetoothServer g_bluetooth_server = {0};
-static volatile int g_system_running = 1;
+static Notifier g_notifier = {0};
+static ReminderPolicy g_reminder_policy = {0};
+static MetricsServer g_metrics_server = { .listen_fd = -1 };
+static ControlServer g_control_server = { .listen_fd = -1 };
+static HealthMonitor g_health_monitor = { .notify_fd = -1 };
+static StatusShm g_status_shm = {0};
+static Realtime g_realtime = { .probe_fd = -1 };
+// Zeroed so its buffers stay in .bss; fcm_standin_init() sets the descriptors
+static FcmStandin g_fcm_standin = {0};
+static Simulation g_simulation = {0};
+static const char *g_scenario_path = NULL;
+static PersistentState g_saved_state = {0};
+static int g_devices_ready = 0;
+static sigset_t g_handled_signals;
+static int g_signal_fd = -1;
+static int g_log_flush_timer = 0;
 
 // ============================================================================
-// SYSTEM INFORMATION
+// SIGNAL HANDLING
 // ============================================================================
 
-#define SYSTEM_NAME "Door Monitoring System"
-#define SYSTEM_VERSION "1.0.0"
+/**
+ * @brief Block the signals handled by the event loop
+ * 
+ * Must run before any thread is created so that every thread inherits
+ * the mask and the signals are only delivered through the signalfd.
+ */
+static void block_handled_signals(void) {
+    sigemptyset(&g_handled_signals);
+    sigaddset(&g_handled_signals, SIGINT);
+    sigaddset(&g_handled_signals, SIGTERM);
+    sigaddset(&g_handled_signals, SIGHUP);
+    sigaddset(&g_handled_signals, SIGUSR1);
+    sigaddset(&g_handled_signals, SIGUSR2);
+    sigaddset(&g_handled_signals, SIGRTMIN);
+    pthread_sigmask(SIG_BLOCK, &g_handled_signals, NULL);
+    
+    // Ignore SIGPIPE (broken pipe) to prevent crashes on socket errors
+    signal(SIGPIPE, SIG_IGN);
+}
 
-// ============================================================================
-// SIGNAL HANDLING
-// ============================================================================
+/**
+ * @brief Reactor timer: summarize messages dropped by sites that went quiet
+ */
+static void flush_log_summaries(void *userdata) {
+    (void)userdata;
+    logger_flush_suppressed();
+}
 
 /**
- * @brief Signal handler for graceful shutdown
- * @param sig Signal number received
+ * @brief (Re)arm the log summary timer for a rate limiting window
+ * @param interval_s Window length in seconds
  * 
- * Handles SIGINT and SIGTERM signals to initiate clean system shutdown.
- * Sets the running flag to false to trigger cleanup procedures.
+ * A summary is then at most one window late even if nothing else logs.
  */
-void signal_handler(int sig) {
-    const char *signal_name = (sig == SIGINT) ? "SIGINT" : 
-                             (sig == SIGTERM) ? "SIGTERM" : "UNKNOWN";
+static void schedule_log_summaries(int interval_s) {
+    if (g_log_flush_timer > 0) {
+        reactor_cancel_timer(&g_reactor, g_log_flush_timer);
+    }
     
-    LOG_INFO("Received signal %s (%d) - initiating shutdown", signal_name, sig);
-    g_system_running = 0;
+    uint64_t flush_ms = (uint64_t)interval_s * 1000;
+    g_log_flush_timer = reactor_add_timer(&g_reactor, flush_ms, flush_ms, flush_log_summaries, NULL);
+    if (g_log_flush_timer < 0) {
+        LOG_WARN("Cannot schedule log summaries; they follow the next rate-limited message");
+        g_log_flush_timer = 0;
+    }
+}
+
+/**
+ * @brief Apply the settings that other modules keep in their own state
+ * @param previous Configuration in effect before, or NULL at startup
+ * @param config New configuration
+ * 
+ * Everything else is read from runtime_config_get() where it is used.
+ * The log level is only applied when the file changes it, so a level set
+ * with door_monitor_ctl survives reloads that do not touch it.
+ */
+static void apply_runtime_config(const RuntimeConfig *previous, const RuntimeConfig *config) {
+    if (!previous || previous->log_level != config->log_level) {
+        logger_set_level((LogLevel)config->log_level);
+    }
+    logger_set_ratelimit(config->log_ratelimit_interval, config->log_ratelimit_burst);
+    if (g_log_flush_timer > 0 && previous &&
+        previous->log_ratelimit_interval != config->log_ratelimit_interval) {
+        schedule_log_summaries(config->log_ratelimit_interval);
+    }
+    trace_set_enabled(config->trace_enabled);
+}
+
+/**
+ * @brief Re-read the configuration file (SIGHUP)
+ */
+static void reload_configuration(void) {
+    const RuntimeConfig *previous = runtime_config_get();
     
-    // Stop subsystems
-    bluetooth_server_stop(&g_bluetooth_server);
-    device_manager_stop_heartbeat(&g_device_manager);
+    if (runtime_config_reload() == 0) {
+        apply_runtime_config(previous, runtime_config_get());
+    }
 }
 
 /**
- * @brief Install signal handlers for graceful shutdown
+ * @brief Reactor handler for the signalfd
+ * @param fd Signal file descriptor
+ * @param events Ready REACTOR_* flags
+ * @param userdata Unused
+ * 
+ * SIGINT and SIGTERM stop the event loop for a clean shutdown,
+ * SIGHUP reloads the configuration file, SIGUSR1 logs system status,
+ * metrics and lock statistics, SIGUSR2 exports recent spans and SIGRTMIN
+ * starts a CPU profile with the configured rate and duration.
+ */
+static void signal_event(int fd, uint32_t events, void *userdata) {
+    struct signalfd_siginfo info;
+    (void)events;
+    (void)userdata;
+    
+    while (read(fd, &info, sizeof(info)) == sizeof(info)) {
+        switch (info.ssi_signo) {
+            case SIGINT:
+            case SIGTERM:
+                LOG_INFO("Received signal %s (%u) - initiating shutdown",
+                         info.ssi_signo == SIGINT ? "SIGINT" : "SIGTERM", info.ssi_signo);
+                reactor_stop(&g_reactor);
+                break;
+            case SIGHUP:
+                reload_configuration();
+                break;
+            case SIGUSR1:
+                display_system_status(&g_device_manager, &g_bluetooth_server);
+                metrics_dump();
+                lock_stats_dump();
+                break;
+            case SIGUSR2:
+                trace_export_chrome(TRACE_EXPORT_PATH);
+                break;
+            default:
+                // SIGRTMIN is not a constant expression
+                if ((int)info.ssi_signo == SIGRTMIN) {
+                    const RuntimeConfig *config = runtime_config_get();
+                    profiler_start(&g_reactor, config->profiler_frequency,
+                                   config->profiler_duration, config->profiler_output);
+                }
+                break;
+        }
+    }
+}
+
+/**
+ * @brief Route the blocked signals into the event loop
  * @return 0 on success, negative on error
  */
 static int install_signal_handlers(void) {
-    struct sigaction sa;
-    sa.sa_handler = signal_handler;
-    sigemptyset(&sa.sa_mask);
-    sa.sa_flags = 0;
-    
-    if (sigaction(SIGINT, &sa, NULL) == -1) {
-        LOG_ERROR("Failed to install SIGINT handler");
+    g_signal_fd = signalfd(-1, &g_handled_signals, SFD_NONBLOCK | SFD_CLOEXEC);
+    if (g_signal_fd < 0) {
+        LOG_ERROR("Failed to create signalfd: %s", strerror(errno));
         return -1;
     }
     
-    if (sigaction(SIGTERM, &sa, NULL) == -1) {
-        LOG_ERROR("Failed to install SIGTERM handler");
+    if (reactor_add_fd(&g_reactor, g_signal_fd, REACTOR_READ, signal_event, NULL) != 0) {
+        LOG_ERROR("Failed to watch signalfd");
+        close(g_signal_fd);
+        g_signal_fd = -1;
         return -1;
     }
     
-    // Ignore SIGPIPE (broken pipe) to prevent crashes on socket errors
-    signal(SIGPIPE, SIG_IGN);
-    
     LOG_INFO("Signal handlers installed");
     return 0;
 }
 
+// ============================================================================
+// EVENT CALLBACKS
+// ============================================================================
+
+/**
+ * @brief Reactor handler for the door sensor event fd
+ */
+static void door_event(int fd, uint32_t events, void *userdata) {
+    (void)fd;
+    (void)events;
+    (void)userdata;
+    
+    if (consumeDoorEvents() > 0) {
+        reminder_policy_door_changed(&g_reminder_policy, getDoorState());
+        status_shm_publish(&g_status_shm);
+    }
+}
+
+/**
+ * @brief Persist the last device token if it changed
+ */
+static void save_last_token(const char *token) {
+    // A simulation must not overwrite the state of the real installation
+    if (g_scenario_path || !token || token[0] == '\0' ||
+        strcmp(token, g_saved_state.last_token) == 0) {
+        return;
+    }
+    
+    snprintf(g_saved_state.last_token, sizeof(g_saved_state.last_token), "%s", token);
+    if (state_file_save(runtime_config_get()->state_file, &g_saved_state) == 0) {
+        LOG_DEBUG("Saved last device token to %s", runtime_config_get()->state_file);
+    }
+}
+
+/**
+ * @brief Device manager callback: the last device left
+ */
+static void on_room_empty(const char *token, void *userdata) {
+    (void)userdata;
+    reminder_policy_room_empty(&g_reminder_policy, token);
+    status_shm_publish(&g_status_shm);
+    save_last_token(token);
+}
+
+/**
+ * @brief Device manager callback: someone entered the empty room
+ */
+static void on_room_occupied(void *userdata) {
+    (void)userdata;
+    reminder_policy_room_occupied(&g_reminder_policy);
+    status_shm_publish(&g_status_shm);
+}
+
+/**
+ * @brief Device manager callback: a client socket is about to be closed
+ */
+static void on_socket_closing(int socket_fd, void *userdata) {
+    (void)userdata;
+    bluetooth_server_release_socket(&g_bluetooth_server, socket_fd);
+}
+
 // ============================================================================
 // SYSTEM VALIDATION
 // ============================================================================
@@ -108,7 +328,7 @@ static int install_signal_handlers(void) {
  * @brief Check system privileges and requirements
  * @return 0 if requirements met, negative if not
  */
-static int check_system_requirements(void) {
+int check_system_requirements(void) {
     LOG_INFO("Checking system requirements...");
     
     // Check root privileges
@@ -119,9 +339,15 @@ static int check_system_requirements(void) {
     }
     LOG_INFO("Root privileges: OK");
     
+    // Profiles and trace exports are written here, never to /tmp
+    if (mkdir(DATA_DIRECTORY, 0700) != 0 && errno != EEXIST) {
+        LOG_WARN("Cannot create %s: %s", DATA_DIRECTORY, strerror(errno));
+    }
+    
     // Check Firebase service account file
-    if (access(FIREBASE_SERVICE_ACCOUNT_PATH, R_OK) != 0) {
-        LOG_WARN("Firebase service account file not accessible: %s", FIREBASE_SERVICE_ACCOUNT_PATH);
+    const char *service_account = runtime_config_get()->service_account_file;
+    if (access(service_account, R_OK) != 0) {
+        LOG_WARN("Firebase service account file not accessible: %s", service_account);
         LOG_WARN("Notifications will not work without valid Firebase credentials");
     } else {
         LOG_INFO("Firebase service account file: OK");
@@ -142,14 +368,68 @@ static int check_system_requirements(void) {
 // SUBSYSTEM INITIALIZATION
 // ============================================================================
 
+/*
+ * Each function below is one startup step (see run_startup). Steps
+ * marked "worker" run off the main thread and must not touch the reactor.
+ */
+
 /**
- * @brief Initialize door sensor driver
+ * @brief Startup step: system requirements
+ * @return 0 if requirements met, ERROR_PRIVILEGES if not
+ */
+static int check_requirements(void *userdata) {
+    (void)userdata;
+    
+    if (g_scenario_path) {
+        LOG_INFO("Simulation: no root, GPIO or Bluetooth required");
+        return 0;
+    }
+    
+    if (check_system_requirements() != 0) {
+        LOG_ERROR("System requirements not met");
+        return ERROR_PRIVILEGES;
+    }
+    return 0;
+}
+
+/**
+ * @brief Initialize the event loop and signal delivery
  * @return 0 on success, negative on error
  */
-static int init_door_sensor(void) {
+static int init_event_loop(void *userdata) {
+    (void)userdata;
+    
+    LOG_INFO("Initializing event loop...");
+    
+    if (reactor_init(&g_reactor) != 0) {
+        LOG_ERROR("Failed to initialize event loop");
+        return ERROR_GENERIC;
+    }
+    
+    if (install_signal_handlers() != 0) {
+        LOG_ERROR("Failed to install signal handlers");
+        return ERROR_GENERIC;
+    }
+    
+    schedule_log_summaries(runtime_config_get()->log_ratelimit_interval);
+    
+    return 0;
+}
+
+/**
+ * @brief Initialize door sensor driver (worker)
+ * @return 0 on success, negative on error
+ */
+static int init_door_sensor(void *userdata) {
+    (void)userdata;
+    
     LOG_INFO("Initializing door sensor driver...");
     
-    int result = init(); // DoorStateDriver init function
+    // Interrupt thread priority and affinity are applied from that thread
+    setDoorIsrThreadHook(realtime_isr_thread_setup);
+    
+    // DoorStateDriver init function, or its scripted counterpart
+    int result = g_scenario_path ? initSimulated() : init();
     if (result != 0) {
         LOG_ERROR("Failed to initialize door sensor (error: %d)", result);
         
@@ -167,6 +447,9 @@ static int init_door_sensor(void) {
             case -4:
                 LOG_ERROR("Pull-down resistor setup failed - hardware issue");
                 break;
+            case -5:
+                LOG_ERROR("Door event fd creation failed - check file descriptor limits");
+                break;
             default:
                 LOG_ERROR("Unknown door sensor initialization error");
         }
@@ -174,7 +457,126 @@ static int init_door_sensor(void) {
         return ERROR_HARDWARE_INIT;
     }
     
-    LOG_INFO("Door sensor initialized successfully on GPIO pin %d", DOOR_SENSOR_PIN);
+    if (g_scenario_path) {
+        LOG_INFO("Door sensor simulated - edges come from the scenario");
+    } else {
+        LOG_INFO("Door sensor initialized successfully on GPIO pin %d", DOOR_SENSOR_PIN);
+    }
+    return 0;
+}
+
+/**
+ * @brief Watch the door sensor event fd from the event loop
+ * @return 0 on success, negative on error
+ *
+ * Edges seen since init_door_sensor() are already counted on the event
+ * fd, so none are lost while the rest of startup runs.
+ */
+static int watch_door_sensor(void *userdata) {
+    (void)userdata;
+    
+    if (reactor_add_fd(&g_reactor, getDoorEventFd(), REACTOR_READ, door_event, NULL) != 0) {
+        LOG_ERROR("Failed to watch door sensor events");
+        return ERROR_HARDWARE_INIT;
+    }
+    return 0;
+}
+
+/**
+ * @brief Apply real-time options to the reactor thread and start the latency probe
+ * @return 0 on success, negative on error
+ */
+static int init_realtime(void *userdata) {
+    (void)userdata;
+    
+    if (realtime_init(&g_realtime, &g_reactor) != 0) {
+        LOG_ERROR("Failed to initialize real-time options");
+        return ERROR_GENERIC;
+    }
+    return 0;
+}
+
+/**
+ * @brief Initialize the notifier and the reminder policy
+ * @return 0 on success, negative on error
+ */
+static int init_notifications(void *userdata) {
+    (void)userdata;
+    
+    LOG_INFO("Initializing notification system...");
+    
+    int result = notifier_init(&g_notifier, &g_reactor, runtime_config_get()->service_account_file);
+    if (result != 0) {
+        LOG_ERROR("Failed to initialize notifier (error: %d)", result);
+        return ERROR_GENERIC;
+    }
+    
+    if (g_scenario_path &&
+        notifier_set_endpoints(&g_notifier, g_fcm_standin.token_url, g_fcm_standin.send_url) != 0) {
+        LOG_ERROR("Failed to point the notifier at the FCM stand-in");
+        return ERROR_GENERIC;
+    }
+    
+    result = reminder_policy_init(&g_reminder_policy, &g_reactor, &g_notifier, getDoorState());
+    if (result != 0) {
+        LOG_ERROR("Failed to initialize reminder policy (error: %d)", result);
+        return ERROR_GENERIC;
+    }
+    
+    return 0;
+}
+
+/**
+ * @brief Sign the OAuth token request ahead of time (worker)
+ * @return Always 0; notifications still work without it
+ */
+static int prepare_credentials(void *userdata) {
+    (void)userdata;
+    
+    if (!runtime_config_get()->notifier_warm_up) {
+        return 0;
+    }
+    
+    if (notifier_prepare_credentials(&g_notifier) != 0) {
+        LOG_WARN("Could not prepare Firebase credentials - notifications may fail");
+    }
+    return 0;
+}
+
+/**
+ * @brief Start fetching the OAuth token so the first notification is fast
+ * @return Always 0; the fetch is retried on the first notification
+ */
+static int warm_up_notifier(void *userdata) {
+    (void)userdata;
+    
+    if (!runtime_config_get()->notifier_warm_up) {
+        LOG_INFO("Notifier warm-up disabled - HTTP stack loads on the first reminder");
+        return 0;
+    }
+    
+    if (notifier_warm_up(&g_notifier) != 0) {
+        LOG_WARN("OAuth token warm-up not started");
+    }
+    return 0;
+}
+
+/**
+ * @brief Read the persistent state file (worker)
+ * @return Always 0; a missing or unreadable file means a fresh start
+ */
+static int load_saved_state(void *userdata) {
+    (void)userdata;
+    
+    if (g_scenario_path) {
+        LOG_INFO("Simulation: state file not used");
+        return 0;
+    }
+    
+    const char *path = runtime_config_get()->state_file;
+    if (state_file_load(path, &g_saved_state) != 0) {
+        LOG_INFO("No saved state in %s", path);
+    }
     return 0;
 }
 
@@ -182,7 +584,9 @@ static int init_door_sensor(void) {
  * @brief Initialize device manager
  * @return 0 on success, negative on error
  */
-static int init_device_manager(void) {
+static int init_device_manager(void *userdata) {
+    (void)userdata;
+    
     LOG_INFO("Initializing device manager...");
     
     int result = device_manager_init(&g_device_manager);
@@ -191,27 +595,47 @@ static int init_device_manager(void) {
         return ERROR_GENERIC;
     }
     
+    DeviceManagerCallbacks callbacks = {
+        .room_empty = on_room_empty,
+        .room_occupied = on_room_occupied,
+        .socket_closing = on_socket_closing,
+        .userdata = NULL
+    };
+    device_manager_set_callbacks(&g_device_manager, &callbacks);
+    
     // Start heartbeat monitoring
-    result = device_manager_start_heartbeat(&g_device_manager);
+    result = device_manager_start_heartbeat(&g_device_manager, &g_reactor);
     if (result != 0) {
         LOG_ERROR("Failed to start heartbeat monitoring (error: %d)", result);
         device_manager_cleanup(&g_device_manager);
         return ERROR_GENERIC;
     }
+    g_devices_ready = 1;
+    
+    // Restore the recipient for reminders sent before any device reconnects
+    if (g_saved_state.last_token[0] != '\0' &&
+        device_manager_restore_last_token(&g_device_manager, g_saved_state.last_token) == 0) {
+        LOG_INFO("Restored last device token from state file");
+    }
     
     LOG_INFO("Device manager initialized - max devices: %d, timeout: %ds", 
-             MAX_DEVICES, HEARTBEAT_TIMEOUT);
+             runtime_config_get()->max_devices, runtime_config_get()->heartbeat_timeout);
     return 0;
 }
 
 /**
- * @brief Initialize Bluetooth server
+ * @brief Initialize the Bluetooth server and bind its socket (worker)
  * @return 0 on success, negative on error
  */
-static int init_bluetooth_server(void) {
+static int init_bluetooth_server(void *userdata) {
+    (void)userdata;
+    
     LOG_INFO("Initializing Bluetooth server...");
     
-    int result = bluetooth_server_init(&g_bluetooth_server, &g_device_manager);
+    int result = g_scenario_path
+        ? bluetooth_server_init_loopback(&g_bluetooth_server, &g_device_manager,
+                                         SIMULATION_BT_SOCKET_PATH)
+        : bluetooth_server_init(&g_bluetooth_server, &g_device_manager);
     if (result != 0) {
         LOG_ERROR("Failed to initialize Bluetooth server (error: %d)", result);
         return ERROR_GENERIC;
@@ -224,85 +648,330 @@ static int init_bluetooth_server(void) {
         return ERROR_GENERIC;
     }
     
-    LOG_INFO("Bluetooth server started on PSM 0x%04X", BLE_PSM);
     return 0;
 }
 
-// ============================================================================
-// SYSTEM CLEANUP
-// ============================================================================
+/**
+ * @brief Accept Bluetooth connections from the event loop
+ * @return 0 on success, negative on error
+ */
+static int attach_bluetooth_server(void *userdata) {
+    (void)userdata;
+    
+    int result = bluetooth_server_attach(&g_bluetooth_server, &g_reactor);
+    if (result != 0) {
+        LOG_ERROR("Failed to attach Bluetooth server to event loop (error: %d)", result);
+        bluetooth_server_cleanup(&g_bluetooth_server);
+        return ERROR_GENERIC;
+    }
+    
+    LOG_INFO("Bluetooth server started on PSM 0x%04X", g_bluetooth_server.config.psm);
+    startup_mark_accepting();
+    return 0;
+}
 
 /**
- * @brief Perform complete system cleanup
+ * @brief Start health monitoring and report readiness to systemd
+ * @return 0 on success, negative on error
  */
-static void cleanup_system(void) {
-    LOG_INFO("Performing system cleanup...");
+static int init_health_monitor(void *userdata) {
+    (void)userdata;
     
-    // Stop and cleanup Bluetooth server
-    bluetooth_server_stop(&g_bluetooth_server);
-    bluetooth_server_cleanup(&g_bluetooth_server);
-    LOG_INFO("Bluetooth server cleaned up");
+    HealthTargets targets = {
+        .device_manager = &g_device_manager,
+        .bluetooth_server = &g_bluetooth_server,
+        .notifier = &g_notifier
+    };
     
-    // Stop and cleanup device manager
-    device_manager_stop_heartbeat(&g_device_manager);
-    device_manager_cleanup(&g_device_manager);
-    LOG_INFO("Device manager cleaned up");
+    int result = health_monitor_init(&g_health_monitor, &g_reactor, &targets);
+    if (result != 0) {
+        LOG_ERROR("Failed to start health monitor: %d", result);
+        return ERROR_GENERIC;
+    }
+    return 0;
+}
+
+/**
+ * @brief Start the Prometheus metrics endpoint
+ * @return Always 0; the daemon runs without the endpoint
+ */
+static int init_metrics_endpoint(void *userdata) {
+    (void)userdata;
     
-    // Note: Door sensor driver doesn't require explicit cleanup
-    // as it uses static resources and interrupt handlers
+    int result = metrics_server_init(&g_metrics_server, &g_reactor,
+                                     runtime_config_get()->metrics_listen_address);
+    if (result != 0) {
+        LOG_WARN("Metrics endpoint unavailable (error: %d) - use SIGUSR1 for metrics", result);
+    }
+    return 0;
+}
+
+/**
+ * @brief Start the control socket
+ * @return Always 0; the daemon runs without the control socket
+ */
+static int init_control_socket(void *userdata) {
+    (void)userdata;
     
-    LOG_INFO("System cleanup completed");
+    ControlTargets targets = {
+        .device_manager = &g_device_manager,
+        .bluetooth_server = &g_bluetooth_server,
+        .notifier = &g_notifier,
+        .reminder_policy = &g_reminder_policy,
+        .health = g_health_monitor.reactor ? &g_health_monitor : NULL
+    };
+    
+    int result = control_server_init(&g_control_server, &g_reactor, &targets,
+                                     runtime_config_get()->control_socket_path);
+    if (result != 0) {
+        LOG_WARN("Control socket unavailable (error: %d)", result);
+    }
+    return 0;
 }
 
-// ============================================================================
-// NOTIFICATION INTEGRATION
-// ============================================================================
+/**
+ * @brief Publish the shared-memory status segment
+ * @return Always 0; the daemon runs without the segment
+ */
+static int init_status_segment(void *userdata) {
+    (void)userdata;
+    
+    int result = status_shm_init(&g_status_shm, &g_reactor,
+                                 g_health_monitor.reactor ? &g_health_monitor : NULL,
+                                 runtime_config_get()->status_shm_path);
+    if (result != 0) {
+        LOG_WARN("Status segment unavailable (error: %d)", result);
+    }
+    return 0;
+}
 
 /**
- * @brief Check and send door close notification if conditions are met
- * @return 0 if notification sent or not needed, negative on error
+ * @brief Publish per-subsystem heap totals and watch them for growth
+ * @return Always 0; the daemon runs without heap metrics
  */
-static int check_door_notification(void) {
-    // Check if all devices have disconnected
-    if (device_manager_has_devices(&g_device_manager)) {
-        return 0; // Still have devices connected
+static int init_heap_stats(void *userdata) {
+    (void)userdata;
+    
+    int result = alloc_stats_init(&g_reactor);
+    if (result != 0) {
+        LOG_WARN("Heap metrics unavailable (error: %d)", result);
     }
+    return 0;
+}
+
+/**
+ * @brief Start the local FCM stand-in (simulation only)
+ * @return 0 on success, negative on error
+ */
+static int init_fcm_standin(void *userdata) {
+    (void)userdata;
     
-    // Get FCM token from last disconnected device
-    const char* fcm_token = device_manager_get_last_token(&g_device_manager);
-    if (!fcm_token || strlen(fcm_token) == 0) {
-        LOG_WARN("No FCM token available for notification");
+    if (!g_scenario_path) {
         return 0;
     }
     
-    // Check door state
-    DoorState door_state = getDoorState();
-    if (door_state != UNLOCKED) {
-        if (door_state == LOCKED) {
-            LOG_INFO("Door already locked - no reminder needed");
-        } else {
-            LOG_WARN("Door state unknown - skipping notification");
-        }
+    if (fcm_standin_init(&g_fcm_standin, &g_reactor) != 0) {
+        LOG_ERROR("Failed to start the FCM stand-in");
+        return ERROR_NETWORK;
+    }
+    return 0;
+}
+
+/**
+ * @brief Start playing the scenario once everything is up (simulation only)
+ * @return 0 on success, negative on error
+ */
+static int start_scenario(void *userdata) {
+    (void)userdata;
+    
+    if (!g_scenario_path) {
         return 0;
     }
     
-    // All conditions met - send notification
-    LOG_INFO("Sending door close reminder - all devices gone, door unlocked");
+    if (simulation_start(&g_simulation, &g_reactor, SIMULATION_BT_SOCKET_PATH, &g_fcm_standin) != 0) {
+        LOG_ERROR("Failed to start the scenario");
+        return ERROR_GENERIC;
+    }
+    return 0;
+}
+
+// ============================================================================
+// STARTUP PLAN
+// ============================================================================
+
+/**
+ * @brief Startup step indices, used for dependency masks
+ */
+enum {
+    STEP_REQUIREMENTS = 0,
+    STEP_EVENT_LOOP,
+    STEP_REALTIME,
+    STEP_DOOR_SENSOR,
+    STEP_DOOR_EVENTS,
+    STEP_FCM_STANDIN,
+    STEP_NOTIFIER,
+    STEP_CREDENTIALS,
+    STEP_OAUTH_WARMUP,
+    STEP_SAVED_STATE,
+    STEP_DEVICES,
+    STEP_BLUETOOTH_SOCKET,
+    STEP_BLUETOOTH_ATTACH,
+    STEP_HEALTH,
+    STEP_METRICS_ENDPOINT,
+    STEP_CONTROL_SOCKET,
+    STEP_STATUS_SEGMENT,
+    STEP_HEAP_STATS,
+    STEP_SCENARIO,
+    STEP_COUNT
+};
+
+/**
+ * @brief Bring up every subsystem
+ * @return 0 on success, otherwise the error of the first failed step
+ *
+ * The reminder policy needs the initial door state, device callbacks feed
+ * the reminder policy, and the health monitor reports READY=1, so it
+ * waits for everything it inspects. The simulation steps do nothing
+ * unless --simulate is given; the scenario starts last.
+ */
+static int run_startup(void) {
+    static StartupStep steps[STEP_COUNT] = {
+        [STEP_REQUIREMENTS] = { "requirements", check_requirements, NULL, 0, 0 },
+        [STEP_EVENT_LOOP] = { "event_loop", init_event_loop, NULL,
+            STARTUP_DEP(STEP_REQUIREMENTS), 0 },
+        [STEP_REALTIME] = { "realtime", init_realtime, NULL,
+            STARTUP_DEP(STEP_EVENT_LOOP), 0 },
+        [STEP_DOOR_SENSOR] = { "gpio", init_door_sensor, NULL,
+            STARTUP_DEP(STEP_REQUIREMENTS), 1 },
+        [STEP_DOOR_EVENTS] = { "door_events", watch_door_sensor, NULL,
+            STARTUP_DEP(STEP_EVENT_LOOP) | STARTUP_DEP(STEP_DOOR_SENSOR), 0 },
+        [STEP_FCM_STANDIN] = { "fcm_standin", init_fcm_standin, NULL,
+            STARTUP_DEP(STEP_EVENT_LOOP), 0 },
+        [STEP_NOTIFIER] = { "notifier", init_notifications, NULL,
+            STARTUP_DEP(STEP_DOOR_EVENTS) | STARTUP_DEP(STEP_FCM_STANDIN), 0 },
+        [STEP_CREDENTIALS] = { "credentials", prepare_credentials, NULL,
+            STARTUP_DEP(STEP_NOTIFIER), 1 },
+        [STEP_OAUTH_WARMUP] = { "oauth_warmup", warm_up_notifier, NULL,
+            STARTUP_DEP(STEP_CREDENTIALS), 0 },
+        [STEP_SAVED_STATE] = { "state", load_saved_state, NULL,
+            STARTUP_DEP(STEP_REQUIREMENTS), 1 },
+        [STEP_DEVICES] = { "devices", init_device_manager, NULL,
+            STARTUP_DEP(STEP_NOTIFIER) | STARTUP_DEP(STEP_SAVED_STATE), 0 },
+        [STEP_BLUETOOTH_SOCKET] = { "bluetooth_socket", init_bluetooth_server, NULL,
+            STARTUP_DEP(STEP_REQUIREMENTS), 1 },
+        [STEP_BLUETOOTH_ATTACH] = { "bluetooth_attach", attach_bluetooth_server, NULL,
+            STARTUP_DEP(STEP_DEVICES) | STARTUP_DEP(STEP_BLUETOOTH_SOCKET), 0 },
+        [STEP_HEALTH] = { "health", init_health_monitor, NULL,
+            STARTUP_DEP(STEP_REALTIME) | STARTUP_DEP(STEP_OAUTH_WARMUP) |
+            STARTUP_DEP(STEP_BLUETOOTH_ATTACH), 0 },
+        [STEP_METRICS_ENDPOINT] = { "metrics_endpoint", init_metrics_endpoint, NULL,
+            STARTUP_DEP(STEP_EVENT_LOOP), 0 },
+        [STEP_CONTROL_SOCKET] = { "control_socket", init_control_socket, NULL,
+            STARTUP_DEP(STEP_HEALTH), 0 },
+        [STEP_STATUS_SEGMENT] = { "status_segment", init_status_segment, NULL,
+            STARTUP_DEP(STEP_HEALTH), 0 },
+        [STEP_HEAP_STATS] = { "heap_stats", init_heap_stats, NULL,
+            STARTUP_DEP(STEP_EVENT_LOOP), 0 },
+        [STEP_SCENARIO] = { "scenario", start_scenario, NULL,
+            STARTUP_DEP(STEP_METRICS_ENDPOINT) | STARTUP_DEP(STEP_CONTROL_SOCKET) |
+            STARTUP_DEP(STEP_STATUS_SEGMENT), 0 },
+    };
     
-    int result = send_door_close_reminder(fcm_token, FIREBASE_SERVICE_ACCOUNT_PATH);
-    if (result == 0) {
-        LOG_INFO("Door close reminder sent successfully");
-    } else {
-        LOG_ERROR("Failed to send door close reminder (error: %d)", result);
+    return startup_run(steps, STEP_COUNT, STARTUP_WORKERS);
+}
+
+// ============================================================================
+// SYSTEM CLEANUP
+// ============================================================================
+
+/**
+ * @brief Perform complete system cleanup
+ */
+static void cleanup_system(void) {
+    LOG_INFO("Performing system cleanup...");
+    
+    // Tell systemd we are stopping before anything is torn down
+    health_monitor_cleanup(&g_health_monitor);
+    
+    // Close operator connections and mark the status segment stopped
+    status_shm_cleanup(&g_status_shm);
+    control_server_cleanup(&g_control_server);
+    metrics_server_cleanup(&g_metrics_server);
+    
+    // Simulated devices leave before their server goes away
+    simulation_cleanup(&g_simulation);
+    
+    // Stop and cleanup Bluetooth server
+    bluetooth_server_stop(&g_bluetooth_server);
+    bluetooth_server_cleanup(&g_bluetooth_server);
+    LOG_INFO("Bluetooth server cleaned up");
+    
+    // Keep the last token for the next start, then stop the device manager
+    // (never initialized if startup failed early)
+    if (g_devices_ready) {
+        save_last_token(device_manager_get_last_token(&g_device_manager));
+        device_manager_stop_heartbeat(&g_device_manager);
+        device_manager_cleanup(&g_device_manager);
+        LOG_INFO("Device manager cleaned up");
+    }
+    
+    // Abort pending reminders
+    reminder_policy_cleanup(&g_reminder_policy);
+    notifier_cleanup(&g_notifier);
+    fcm_standin_cleanup(&g_fcm_standin);
+    LOG_INFO("Notification system cleaned up");
+    
+    // Note: Door sensor driver doesn't require explicit cleanup
+    // as it uses static resources and interrupt handlers
+    
+    realtime_cleanup(&g_realtime);
+    
+    // A profile still recording is written before its timer goes away
+    profiler_cleanup();
+    alloc_stats_cleanup();
+    
+    // Tear down the event loop last; the subsystems above unregister from it
+    if (g_signal_fd >= 0) {
+        reactor_remove_fd(&g_reactor, g_signal_fd);
+        close(g_signal_fd);
+        g_signal_fd = -1;
     }
+    reactor_cleanup(&g_reactor);
     
-    return result;
+    LOG_INFO("System cleanup completed");
 }
 
 // ============================================================================
 // MAIN ENTRY POINT
 // ============================================================================
 
+/**
+ * @brief Print command-line help
+ * @param program Program name
+ */
+static void print_usage(const char *program) {
+    printf("Usage: %s [options]\n", program);
+    printf("Options:\n");
+    printf("  -c, --config FILE  Read settings from FILE (default %s, optional)\n", CONFIG_FILE_PATH);
+    printf("  -s, --simulate FILE  Play scenario FILE against a loopback Bluetooth socket,\n");
+    printf("                     a scripted door and a local FCM stand-in\n");
+    printf("  -V, --virtual-clock  With --simulate: skip idle time instead of waiting for it\n");
+    printf("  -h, --help         Show this help message\n");
+    printf("\nSignals:\n");
+    printf("  SIGHUP        Reload the configuration file\n");
+    printf("  SIGUSR1       Log system status, metrics and lock contention statistics\n");
+    printf("  SIGUSR2       Export recent spans to %s\n", TRACE_EXPORT_PATH);
+    printf("  SIGRTMIN      Profile CPU stacks for %d s into %s\n", PROFILER_DURATION_S, PROFILER_OUTPUT_PATH);
+    printf("\nMetrics:\n");
+    printf("  GET /metrics on %s (Prometheus text format)\n", METRICS_LISTEN_ADDRESS);
+    printf("\nControl:\n");
+    printf("  door_monitor_ctl help (socket %s)\n", CONTROL_SOCKET_PATH);
+    printf("\nDoor Monitoring System v%s\n", SYSTEM_VERSION);
+    printf("Monitors door state and BLE device presence for smart notifications.\n");
+    printf("\nRequires root privileges for GPIO and Bluetooth access (not with --simulate).\n");
+    printf("Defaults are compiled in from config.h; the configuration file overrides them.\n");
+}
+
 /**
  * @brief Main entry point for Door Monitoring System
  * @param argc Argument count
@@ -310,61 +979,87 @@ static int check_door_notification(void) {
  * @return 0 on success, non-zero on error
  */
 int main(int argc, char *argv[]) {
+    startup_mark_origin();
+    
     int exit_code = 0;
+    const char *config_path = CONFIG_FILE_PATH;
+    int config_required = 0;
+    
+    static const struct option long_options[] = {
+        { "config",   required_argument, NULL, 'c' },
+        { "simulate", required_argument, NULL, 's' },
+        { "virtual-clock", no_argument,  NULL, 'V' },
+        { "help",     no_argument,       NULL, 'h' },
+        { NULL,       0,                 NULL, 0   }
+    };
+    int virtual_clock = 0;
+    int opt;
+    while ((opt = getopt_long(argc, argv, "c:s:Vh", long_options, NULL)) != -1) {
+        switch (opt) {
+            case 'c':
+                config_path = optarg;
+                config_required = 1;
+                break;
+            case 's':
+                g_scenario_path = optarg;
+                break;
+            case 'V':
+                virtual_clock = 1;
+                break;
+            case 'h':
+                print_usage(argv[0]);
+                return 0;
+            default:
+                fprintf(stderr, "Try '%s --help' for more information.\n", argv[0]);
+                return ERROR_INVALID_PARAM;
+        }
+    }
+    
+    // Real devices and Google run on real time
+    if (virtual_clock && !g_scenario_path) {
+        fprintf(stderr, "--virtual-clock requires --simulate\n");
+        return ERROR_INVALID_PARAM;
+    }
+    if (virtual_clock) {
+        timesource_use_virtual();
+    }
+    
+    // Signals are consumed by the event loop; block them before any thread starts
+    block_handled_signals();
     
     // Initialize logging system
     if (logger_init() != 0) {
         fprintf(stderr, "Failed to initialize logging system\n");
         return ERROR_GENERIC;
     }
+    trace_set_thread_name("main");
     
     // Log system startup
     log_system_startup(SYSTEM_NAME, SYSTEM_VERSION);
     
-    // Check if help was requested
-    if (argc > 1 && (strcmp(argv[1], "-h") == 0 || strcmp(argv[1], "--help") == 0)) {
-        printf("Usage: %s [options]\n", argv[0]);
-        printf("Options:\n");
-        printf("  -h, --help    Show this help message\n");
-        printf("\nDoor Monitoring System v%s\n", SYSTEM_VERSION);
-        printf("Monitors door state and BLE device presence for smart notifications.\n");
-        printf("\nRequires root privileges for GPIO and Bluetooth access.\n");
-        printf("Configure system parameters in config.h\n");
-        return 0;
-    }
-    
-    // Install signal handlers
-    if (install_signal_handlers() != 0) {
-        LOG_ERROR("Failed to install signal handlers");
-        exit_code = ERROR_GENERIC;
-        goto cleanup;
-    }
-    
-    // Check system requirements
-    if (check_system_requirements() != 0) {
-        LOG_ERROR("System requirements not met");
-        exit_code = ERROR_PRIVILEGES;
-        goto cleanup;
-    }
-    
-    // Initialize door sensor driver
-    if (init_door_sensor() != 0) {
-        LOG_ERROR("Door sensor initialization failed");
-        exit_code = ERROR_HARDWARE_INIT;
+    // Load the configuration file; an explicitly named file must exist
+    int result = runtime_config_init(config_path, config_required);
+    if (result != 0) {
+        LOG_ERROR("Configuration could not be loaded from %s", config_path);
+        exit_code = result;
         goto cleanup;
     }
+    apply_runtime_config(NULL, runtime_config_get());
     
-    // Initialize device manager
-    if (init_device_manager() != 0) {
-        LOG_ERROR("Device manager initialization failed");
-        exit_code = ERROR_GENERIC;
-        goto cleanup;
+    // A broken scenario is reported before anything starts
+    if (g_scenario_path) {
+        result = simulation_load(&g_simulation, g_scenario_path);
+        if (result != 0) {
+            exit_code = result;
+            goto cleanup;
+        }
     }
     
-    // Initialize Bluetooth server
-    if (init_bluetooth_server() != 0) {
-        LOG_ERROR("Bluetooth server initialization failed");
-        exit_code = ERROR_GENERIC;
+    // Bring up the subsystems; independent steps run concurrently
+    result = run_startup();
+    if (result != 0) {
+        LOG_ERROR("Startup failed (error: %d)", result);
+        exit_code = result;
         goto cleanup;
     }
     
@@ -373,27 +1068,18 @@ int main(int argc, char *argv[]) {
     LOG_INFO("Press Ctrl+C to stop");
     
     // Main event loop
-    while (g_system_running) {
-        int result = bluetooth_server_run_once(&g_bluetooth_server);
-        
-        if (result < 0) {
-            LOG_ERROR("Bluetooth server error: %d", result);
-            break;
-        }
-        
-        // Check for notification conditions after each iteration
-        // This integrates door state monitoring with device management
-        check_door_notification();
-        
-        // Small delay to prevent busy waiting
-        if (result == 1) { // Timeout occurred
-            usleep(10000); // 10ms
-        }
+    if (reactor_run(&g_reactor) != 0) {
+        LOG_ERROR("Event loop terminated with an error");
+        exit_code = ERROR_GENERIC;
     }
     
 cleanup:
     // System cleanup
     cleanup_system();
+    runtime_config_cleanup();
+    
+    // Heap totals per subsystem (builds with heap accounting only)
+    alloc_stats_report();
     
     // Log system shutdown
     log_system_shutdown(SYSTEM_NAME);
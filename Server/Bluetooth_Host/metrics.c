@@ -0,0 +1,475 @@
+/**
+ * @file metrics.c
+ * @brief Implementation of per-thread counters, gauges and histograms
+ *
+ * Each thread owns a cache-line aligned block of METRICS_MAX_SLOTS 64-bit
+ * slots, allocated on its first update. Only the owning thread writes a
+ * block, so an update is a relaxed load and store rather than an atomic
+ * add. Readers sum the slot over every block under the registry mutex,
+ * which writers never take after their first update, so reading (and
+ * a Prometheus scrape) does not slow down the instrumented code paths.
+ * When a thread exits, its block is folded into the retired block.
+ */
+
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdarg.h>
+#include <pthread.h>
+
+#include "metrics.h"
+#include "logger.h"
+
+// ============================================================================
+// DATA STRUCTURES
+// ============================================================================
+
+/// Cache line size used to align per-thread blocks
+#define METRICS_CACHE_LINE 64
+
+/// Slots used by one histogram: buckets, count and sum
+#define HISTOGRAM_SLOTS (METRICS_HISTOGRAM_BUCKETS + 2)
+
+/**
+ * @brief Per-thread slot block
+ */
+typedef struct MetricsBlock {
+    uint64_t values[METRICS_MAX_SLOTS]; /// Slot values written by the owning thread
+    struct MetricsBlock *next;          /// Next live block
+} __attribute__((aligned(METRICS_CACHE_LINE))) MetricsBlock;
+
+// ============================================================================
+// STATIC VARIABLES
+// ============================================================================
+
+/// Protects registration, the block list and the retired block
+static pthread_mutex_t registry_mutex = PTHREAD_MUTEX_INITIALIZER;
+static Metric *metric_head = NULL;
+static Metric *metric_tail = NULL;
+static int next_slot = 0;
+
+static MetricsBlock *block_list = NULL;
+static MetricsBlock retired_block;
+
+static pthread_once_t block_key_once = PTHREAD_ONCE_INIT;
+static pthread_key_t block_key;
+static __thread MetricsBlock *thread_block = NULL;
+
+// ============================================================================
+// INTERNAL HELPER FUNCTIONS
+// ============================================================================
+
+/**
+ * @brief Fold an exiting thread's block into the retired block
+ * @param arg Block of the exiting thread
+ */
+static void retire_block(void *arg) {
+    MetricsBlock *block = (MetricsBlock*)arg;
+
+    pthread_mutex_lock(&registry_mutex);
+
+    for (MetricsBlock **link = &block_list; *link; link = &(*link)->next) {
+        if (*link == block) {
+            *link = block->next;
+            break;
+        }
+    }
+
+    for (int i = 0; i < METRICS_MAX_SLOTS; i++) {
+        retired_block.values[i] += block->values[i];
+    }
+
+    pthread_mutex_unlock(&registry_mutex);
+
+    thread_block = NULL;
+    free(block);
+}
+
+/**
+ * @brief Create the thread-exit key
+ */
+static void create_block_key(void) {
+    pthread_key_create(&block_key, retire_block);
+}
+
+/**
+ * @brief Get (allocating on first use) the calling thread's block
+ * @return Thread block, or NULL if allocation failed
+ */
+static MetricsBlock* get_thread_block(void) {
+    if (thread_block) {
+        return thread_block;
+    }
+
+    void *memory = NULL;
+    if (posix_memalign(&memory, METRICS_CACHE_LINE, sizeof(MetricsBlock)) != 0) {
+        return NULL;
+    }
+
+    MetricsBlock *block = (MetricsBlock*)memory;
+    memset(block, 0, sizeof(MetricsBlock));
+
+    pthread_once(&block_key_once, create_block_key);
+    pthread_setspecific(block_key, block);
+
+    pthread_mutex_lock(&registry_mutex);
+    block->next = block_list;
+    block_list = block;
+    pthread_mutex_unlock(&registry_mutex);
+
+    thread_block = block;
+    return block;
+}
+
+/**
+ * @brief Ensure a metric is registered before its slots are used
+ * @param metric Metric to check
+ * @return 1 if the metric is usable, 0 otherwise
+ */
+static int ensure_registered(Metric *metric) {
+    if (__atomic_load_n(&metric->registered, __ATOMIC_ACQUIRE)) {
+        return 1;
+    }
+    return metrics_register(metric) == SUCCESS;
+}
+
+/**
+ * @brief Add to a slot of the calling thread (single writer, no RMW)
+ * @param block Thread block
+ * @param slot Slot index
+ * @param value Amount to add
+ */
+static void slot_add(MetricsBlock *block, int slot, uint64_t value) {
+    uint64_t *target = &block->values[slot];
+    __atomic_store_n(target, __atomic_load_n(target, __ATOMIC_RELAXED) + value, __ATOMIC_RELAXED);
+}
+
+/**
+ * @brief Sum one slot over all threads (registry_mutex must be held)
+ * @param slot Slot index
+ * @return Aggregated value
+ */
+static uint64_t slot_sum(int slot) {
+    uint64_t total = retired_block.values[slot];
+    for (MetricsBlock *block = block_list; block; block = block->next) {
+        total += __atomic_load_n(&block->values[slot], __ATOMIC_RELAXED);
+    }
+    return total;
+}
+
+/**
+ * @brief Map a value to its log2 histogram bucket
+ * @param value Observed value
+ * @return Bucket index in the range [0, METRICS_HISTOGRAM_BUCKETS)
+ */
+static int bucket_for(uint64_t value) {
+    int bucket = (value > 1) ? 63 - __builtin_clzll(value) : 0;
+    return (bucket < METRICS_HISTOGRAM_BUCKETS) ? bucket : METRICS_HISTOGRAM_BUCKETS - 1;
+}
+
+// ============================================================================
+// REGISTRATION
+// ============================================================================
+
+int metrics_register(Metric *metric) {
+    if (!metric) {
+        return ERROR_INVALID_PARAM;
+    }
+
+    if (__atomic_load_n(&metric->registered, __ATOMIC_ACQUIRE)) {
+        return SUCCESS;
+    }
+
+    int needed = 0;
+    if (metric->type == METRIC_COUNTER) {
+        needed = 1;
+    } else if (metric->type == METRIC_HISTOGRAM) {
+        needed = HISTOGRAM_SLOTS;
+    }
+
+    pthread_mutex_lock(&registry_mutex);
+
+    if (!metric->registered) {
+        if (next_slot + needed > METRICS_MAX_SLOTS) {
+            pthread_mutex_unlock(&registry_mutex);
+            return ERROR_CAPACITY_EXCEEDED;
+        }
+
+        metric->slot = next_slot;
+        next_slot += needed;
+        metric->next = NULL;
+
+        if (metric_tail) {
+            __atomic_store_n(&metric_tail->next, metric, __ATOMIC_RELEASE);
+        } else {
+            __atomic_store_n(&metric_head, metric, __ATOMIC_RELEASE);
+        }
+        metric_tail = metric;
+
+        __atomic_store_n(&metric->registered, 1, __ATOMIC_RELEASE);
+    }
+
+    pthread_mutex_unlock(&registry_mutex);
+    return SUCCESS;
+}
+
+int metrics_register_all(Metric *const *metrics, int count) {
+    int result = SUCCESS;
+    for (int i = 0; i < count; i++) {
+        if (metrics_register(metrics[i]) != SUCCESS) {
+            result = ERROR_CAPACITY_EXCEEDED;
+        }
+    }
+    return result;
+}
+
+// ============================================================================
+// UPDATES
+// ============================================================================
+
+void metrics_counter_add(Metric *metric, uint64_t value) {
+    if (!ensure_registered(metric)) {
+        return;
+    }
+
+    MetricsBlock *block = get_thread_block();
+    if (block) {
+        slot_add(block, metric->slot, value);
+    }
+}
+
+void metrics_histogram_observe(Metric *metric, uint64_t value) {
+    if (!ensure_registered(metric)) {
+        return;
+    }
+
+    MetricsBlock *block = get_thread_block();
+    if (!block) {
+        return;
+    }
+
+    slot_add(block, metric->slot + bucket_for(value), 1);
+    slot_add(block, metric->slot + METRICS_HISTOGRAM_BUCKETS, 1);
+    slot_add(block, metric->slot + METRICS_HISTOGRAM_BUCKETS + 1, value);
+}
+
+void metrics_gauge_set(Metric *metric, int64_t value) {
+    if (!ensure_registered(metric)) {
+        return;
+    }
+
+    __atomic_store_n(&metric->gauge, value, __ATOMIC_RELAXED);
+}
+
+// ============================================================================
+// READING
+// ============================================================================
+
+const Metric* metrics_first(void) {
+    return __atomic_load_n(&metric_head, __ATOMIC_ACQUIRE);
+}
+
+uint64_t metrics_counter_value(const Metric *metric) {
+    if (!metric || !__atomic_load_n(&metric->registered, __ATOMIC_ACQUIRE)) {
+        return 0;
+    }
+
+    pthread_mutex_lock(&registry_mutex);
+    uint64_t value = slot_sum(metric->slot);
+    pthread_mutex_unlock(&registry_mutex);
+
+    return value;
+}
+
+int64_t metrics_gauge_value(const Metric *metric) {
+    if (!metric) {
+        return 0;
+    }
+    return __atomic_load_n(&metric->gauge, __ATOMIC_RELAXED);
+}
+
+void metrics_histogram_read(const Metric *metric, MetricHistogramSnapshot *snapshot) {
+    if (!snapshot) {
+        return;
+    }
+
+    memset(snapshot, 0, sizeof(*snapshot));
+
+    if (!metric || !__atomic_load_n(&metric->registered, __ATOMIC_ACQUIRE)) {
+        return;
+    }
+
+    pthread_mutex_lock(&registry_mutex);
+    for (int i = 0; i < METRICS_HISTOGRAM_BUCKETS; i++) {
+        snapshot->buckets[i] = slot_sum(metric->slot + i);
+    }
+    snapshot->count = slot_sum(metric->slot + METRICS_HISTOGRAM_BUCKETS);
+    snapshot->sum = slot_sum(metric->slot + METRICS_HISTOGRAM_BUCKETS + 1);
+    pthread_mutex_unlock(&registry_mutex);
+}
+
+uint64_t metrics_histogram_percentile(const MetricHistogramSnapshot *snapshot, double percentile) {
+    uint64_t total = 0;
+    for (int i = 0; i < METRICS_HISTOGRAM_BUCKETS; i++) {
+        total += snapshot->buckets[i];
+    }
+
+    if (total == 0) {
+        return 0;
+    }
+
+    uint64_t target = (uint64_t)(total * (percentile / 100.0));
+    uint64_t seen = 0;
+    for (int i = 0; i < METRICS_HISTOGRAM_BUCKETS; i++) {
+        seen += snapshot->buckets[i];
+        if (seen > target || i == METRICS_HISTOGRAM_BUCKETS - 1) {
+            return 2ULL << i;
+        }
+    }
+
+    return 0;
+}
+
+void metrics_dump(void) {
+    LOG_INFO("=== Metrics ===");
+
+    for (const Metric *m = metrics_first(); m; m = __atomic_load_n(&m->next, __ATOMIC_ACQUIRE)) {
+        const char *open = m->labels ? "{" : "";
+        const char *labels = m->labels ? m->labels : "";
+        const char *close = m->labels ? "}" : "";
+
+        if (m->type == METRIC_HISTOGRAM) {
+            MetricHistogramSnapshot snapshot;
+            metrics_histogram_read(m, &snapshot);
+            LOG_INFO("%s%s%s%s: count=%llu sum=%llu p50<=%llu p99<=%llu",
+                     m->name, open, labels, close,
+                     (unsigned long long)snapshot.count, (unsigned long long)snapshot.sum,
+                     (unsigned long long)metrics_histogram_percentile(&snapshot, 50),
+                     (unsigned long long)metrics_histogram_percentile(&snapshot, 99));
+        } else if (m->type == METRIC_GAUGE) {
+            LOG_INFO("%s%s%s%s = %lld", m->name, open, labels, close,
+                     (long long)metrics_gauge_value(m));
+        } else {
+            LOG_INFO("%s%s%s%s = %llu", m->name, open, labels, close,
+                     (unsigned long long)metrics_counter_value(m));
+        }
+    }
+}
+
+// ============================================================================
+// PROMETHEUS EXPOSITION
+// ============================================================================
+
+/**
+ * @brief Output cursor that keeps counting once the buffer is full
+ */
+typedef struct {
+    char *buffer;                       /// Output buffer
+    size_t size;                        /// Buffer size
+    size_t length;                      /// Length of the complete output so far
+} RenderCursor;
+
+/**
+ * @brief Append formatted text to a render cursor
+ * @param cursor Output cursor
+ * @param format Printf-style format string
+ */
+static void render_append(RenderCursor *cursor, const char *format, ...)
+    __attribute__((format(printf, 2, 3)));
+
+static void render_append(RenderCursor *cursor, const char *format, ...) {
+    char *target = NULL;
+    size_t available = 0;
+    if (cursor->length < cursor->size) {
+        target = cursor->buffer + cursor->length;
+        available = cursor->size - cursor->length;
+    }
+
+    va_list args;
+    va_start(args, format);
+    int written = vsnprintf(target, available, format, args);
+    va_end(args);
+
+    if (written > 0) {
+        cursor->length += (size_t)written;
+    }
+}
+
+/**
+ * @brief Render the samples of one metric
+ * @param cursor Output cursor
+ * @param m Metric to render
+ */
+static void render_samples(RenderCursor *cursor, const Metric *m) {
+    const char *labels = m->labels ? m->labels : "";
+    const char *separator = m->labels ? "," : "";
+
+    if (m->type == METRIC_COUNTER) {
+        render_append(cursor, "%s%s%s%s %llu\n", m->name,
+                      m->labels ? "{" : "", labels, m->labels ? "}" : "",
+                      (unsigned long long)metrics_counter_value(m));
+        return;
+    }
+
+    if (m->type == METRIC_GAUGE) {
+        render_append(cursor, "%s%s%s%s %lld\n", m->name,
+                      m->labels ? "{" : "", labels, m->labels ? "}" : "",
+                      (long long)metrics_gauge_value(m));
+        return;
+    }
+
+    MetricHistogramSnapshot snapshot;
+    metrics_histogram_read(m, &snapshot);
+
+    // The last log2 bucket is open-ended, so it only appears in +Inf
+    uint64_t cumulative = 0;
+    for (int i = 0; i < METRICS_HISTOGRAM_BUCKETS - 1; i++) {
+        cumulative += snapshot.buckets[i];
+        render_append(cursor, "%s_bucket{%s%sle=\"%llu\"} %llu\n", m->name, labels, separator,
+                      (unsigned long long)((2ULL << i) - 1), (unsigned long long)cumulative);
+    }
+    render_append(cursor, "%s_bucket{%s%sle=\"+Inf\"} %llu\n", m->name, labels, separator,
+                  (unsigned long long)snapshot.count);
+    render_append(cursor, "%s_sum%s%s%s %llu\n", m->name,
+                  m->labels ? "{" : "", labels, m->labels ? "}" : "",
+                  (unsigned long long)snapshot.sum);
+    render_append(cursor, "%s_count%s%s%s %llu\n", m->name,
+                  m->labels ? "{" : "", labels, m->labels ? "}" : "",
+                  (unsigned long long)snapshot.count);
+}
+
+size_t metrics_render_prometheus(char *buffer, size_t size) {
+    static const char *const type_names[] = { "counter", "gauge", "histogram" };
+    RenderCursor cursor = { buffer, buffer ? size : 0, 0 };
+
+    if (cursor.size > 0) {
+        cursor.buffer[0] = '\0';
+    }
+
+    for (const Metric *m = metrics_first(); m; m = __atomic_load_n(&m->next, __ATOMIC_ACQUIRE)) {
+        // A name already rendered with an earlier series is complete
+        int seen = 0;
+        for (const Metric *prev = metrics_first(); prev != m; prev = prev->next) {
+            if (strcmp(prev->name, m->name) == 0) {
+                seen = 1;
+                break;
+            }
+        }
+        if (seen) {
+            continue;
+        }
+
+        render_append(&cursor, "# HELP %s %s\n", m->name, m->help);
+        render_append(&cursor, "# TYPE %s %s\n", m->name, type_names[m->type]);
+
+        for (const Metric *series = m; series;
+             series = __atomic_load_n(&series->next, __ATOMIC_ACQUIRE)) {
+            if (strcmp(series->name, m->name) == 0) {
+                render_samples(&cursor, series);
+            }
+        }
+    }
+
+    return cursor.length;
+}
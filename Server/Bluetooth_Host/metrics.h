@@ -0,0 +1,212 @@
+/**
+ * @file metrics.h
+ * @brief Low-overhead counters, gauges and histograms
+ *
+ * This module provides the runtime counters of the daemon: connections
+ * accepted, bytes received, parse failures, timeouts, notifications,
+ * lock waits and so on. Counters and histograms are kept in per-thread
+ * slot blocks and only summed when read, so updating them costs a plain
+ * load and store on memory no other thread writes.
+ *
+ * Features:
+ * - Per-thread, cache-line aligned slot blocks (no false sharing)
+ * - No atomic read-modify-write on the update path
+ * - Log2 histograms with count and sum
+ * - Optional Prometheus-style label set per metric
+ * - Values of exited threads are folded into a retired block
+ *
+ * Usage:
+ * Declare each metric statically with one of the METRIC_*_INIT
+ * initializers, register it from the module's init function so it is
+ * reported even before its first update, and update it with
+ * metrics_counter_add(), metrics_histogram_observe() or metrics_gauge_set().
+ */
+
+#ifndef METRICS_H
+#define METRICS_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "config.h"
+
+// ============================================================================
+// DATA STRUCTURES
+// ============================================================================
+
+/// Number of log2 buckets per histogram (bucket 31 covers >= 2^31)
+#define METRICS_HISTOGRAM_BUCKETS 32
+
+/**
+ * @brief Kind of metric
+ */
+typedef enum {
+    METRIC_COUNTER = 0,                 /// Monotonic counter
+    METRIC_GAUGE,                       /// Value set by its owner
+    METRIC_HISTOGRAM                    /// Log2 distribution with count and sum
+} MetricType;
+
+/**
+ * @brief Metric descriptor
+ *
+ * Declared statically by the owning module. Counters and histograms own
+ * a range of per-thread slots assigned at registration; gauges keep a
+ * single shared value.
+ */
+typedef struct Metric {
+    const char *name;                   /// Metric name (e.g. "bt_bytes_received_total")
+    const char *help;                   /// One-line description
+    const char *labels;                 /// Label set without braces, or NULL
+    MetricType type;                    /// Kind of metric
+    int slot;                           /// First per-thread slot (valid once registered)
+    int64_t gauge;                      /// Current value (gauges only)
+    int registered;                     /// Metric is linked in the global list
+    struct Metric *next;                /// Next registered metric
+} Metric;
+
+/**
+ * @brief Aggregated histogram values
+ */
+typedef struct {
+    uint64_t buckets[METRICS_HISTOGRAM_BUCKETS]; /// Observations per log2 bucket
+    uint64_t count;                     /// Total observations
+    uint64_t sum;                       /// Sum of observed values
+} MetricHistogramSnapshot;
+
+/// Static initializer for a counter
+#define METRIC_COUNTER_INIT(metric_name, metric_help) \
+    { (metric_name), (metric_help), NULL, METRIC_COUNTER, -1, 0, 0, NULL }
+
+/// Static initializer for a counter with a label set (e.g. "lock=\"log\"")
+#define METRIC_COUNTER_INIT_LABELED(metric_name, metric_help, metric_labels) \
+    { (metric_name), (metric_help), (metric_labels), METRIC_COUNTER, -1, 0, 0, NULL }
+
+/// Static initializer for a gauge
+#define METRIC_GAUGE_INIT(metric_name, metric_help) \
+    { (metric_name), (metric_help), NULL, METRIC_GAUGE, -1, 0, 0, NULL }
+
+/// Static initializer for a gauge with a label set
+#define METRIC_GAUGE_INIT_LABELED(metric_name, metric_help, metric_labels) \
+    { (metric_name), (metric_help), (metric_labels), METRIC_GAUGE, -1, 0, 0, NULL }
+
+/// Static initializer for a histogram
+#define METRIC_HISTOGRAM_INIT(metric_name, metric_help) \
+    { (metric_name), (metric_help), NULL, METRIC_HISTOGRAM, -1, 0, 0, NULL }
+
+/// Static initializer for a histogram with a label set
+#define METRIC_HISTOGRAM_INIT_LABELED(metric_name, metric_help, metric_labels) \
+    { (metric_name), (metric_help), (metric_labels), METRIC_HISTOGRAM, -1, 0, 0, NULL }
+
+// ============================================================================
+// REGISTRATION
+// ============================================================================
+
+/**
+ * @brief Register a metric so it is reported
+ * @param metric Metric descriptor (must stay valid for the process lifetime)
+ * @return 0 on success, ERROR_CAPACITY_EXCEEDED if METRICS_MAX_SLOTS is used up
+ *
+ * Registering twice is harmless. Metrics updated before registration
+ * register themselves on first use.
+ */
+int metrics_register(Metric *metric);
+
+/**
+ * @brief Register several metrics
+ * @param metrics Array of metric pointers
+ * @param count Number of entries
+ * @return 0 on success, negative if any registration failed
+ */
+int metrics_register_all(Metric *const *metrics, int count);
+
+// ============================================================================
+// UPDATES
+// ============================================================================
+
+/**
+ * @brief Add to a counter
+ * @param metric Counter to update
+ * @param value Amount to add
+ */
+void metrics_counter_add(Metric *metric, uint64_t value);
+
+/// Increment a counter by one
+#define METRICS_INC(metric) metrics_counter_add((metric), 1)
+
+/**
+ * @brief Record one histogram observation
+ * @param metric Histogram to update
+ * @param value Observed value (unit is part of the metric name)
+ */
+void metrics_histogram_observe(Metric *metric, uint64_t value);
+
+/**
+ * @brief Set a gauge
+ * @param metric Gauge to update
+ * @param value New value
+ */
+void metrics_gauge_set(Metric *metric, int64_t value);
+
+// ============================================================================
+// READING
+// ============================================================================
+
+/**
+ * @brief Get the first registered metric
+ * @return First metric, or NULL if none is registered
+ *
+ * Metrics are linked through Metric.next in registration order and are
+ * never unregistered.
+ */
+const Metric* metrics_first(void);
+
+/**
+ * @brief Read a counter summed over all threads
+ * @param metric Counter to read
+ * @return Current total
+ */
+uint64_t metrics_counter_value(const Metric *metric);
+
+/**
+ * @brief Read a gauge
+ * @param metric Gauge to read
+ * @return Current value
+ */
+int64_t metrics_gauge_value(const Metric *metric);
+
+/**
+ * @brief Read a histogram summed over all threads
+ * @param metric Histogram to read
+ * @param snapshot Output for the aggregated values
+ */
+void metrics_histogram_read(const Metric *metric, MetricHistogramSnapshot *snapshot);
+
+/**
+ * @brief Estimate a percentile from a histogram snapshot
+ * @param snapshot Aggregated histogram
+ * @param percentile Percentile in the range 0-100
+ * @return Upper bound of the bucket containing the percentile
+ */
+uint64_t metrics_histogram_percentile(const MetricHistogramSnapshot *snapshot, double percentile);
+
+/**
+ * @brief Log the current value of every registered metric
+ *
+ * Histograms are reported as count, p50 and p99 bucket bounds.
+ */
+void metrics_dump(void);
+
+/**
+ * @brief Render every registered metric in Prometheus text format
+ * @param buffer Output buffer (can be NULL when size is 0)
+ * @param size Size of the output buffer
+ * @return Length of the complete exposition, excluding the NUL terminator
+ *
+ * Like snprintf(), output is truncated when the buffer is too small and
+ * the return value tells the size to retry with. Series sharing a name
+ * are grouped under one HELP/TYPE header. Histogram buckets use the
+ * inclusive upper bounds 1, 3, 7, ... 2^31-1 and +Inf.
+ */
+size_t metrics_render_prometheus(char *buffer, size_t size);
+
+#endif // METRICS_H
@@ -0,0 +1,461 @@
+/**
+ * @file metrics_server.c
+ * @brief Implementation of the Prometheus scrape endpoint
+ *
+ * Each connection reads one request head, renders the registry into a
+ * heap buffer and writes it back as the socket accepts it, then closes.
+ * Keep-alive is not supported; collectors reconnect for every scrape.
+ */
+
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <errno.h>
+#include <time.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+
+#include "metrics_server.h"
+#include "logger.h"
+#include "metrics.h"
+#include "trace.h"
+#include "alloc_stats.h"
+#include "timesource.h"
+
+/// Space reserved in front of the page for the response head
+#define RESPONSE_HEAD_SPACE 256
+
+// ============================================================================
+// STATIC VARIABLES
+// ============================================================================
+
+static Metric scrapes = METRIC_COUNTER_INIT("metrics_scrapes_total",
+    "Metrics pages served");
+static Metric scrape_errors = METRIC_COUNTER_INIT("metrics_scrape_errors_total",
+    "Scrape connections rejected, timed out or answered with an error");
+static Metric render_duration = METRIC_HISTOGRAM_INIT("metrics_render_duration_us",
+    "Time to render the metrics page in microseconds");
+
+static Metric *const server_metrics[] = {
+    &scrapes, &scrape_errors, &render_duration
+};
+
+// ============================================================================
+// INTERNAL HELPER FUNCTIONS
+// ============================================================================
+
+/**
+ * @brief Release a connection slot
+ */
+static void close_client(MetricsClient *client) {
+    MetricsServer *server = client->server;
+
+    if (client->timer_id > 0) {
+        reactor_cancel_timer(server->reactor, client->timer_id);
+    }
+    reactor_remove_fd(server->reactor, client->fd);
+    close(client->fd);
+    trace_end("metrics", "scrape", client->span);
+    free(client->response);
+
+    memset(client, 0, sizeof(MetricsClient));
+    client->server = server;
+    client->fd = -1;
+}
+
+/**
+ * @brief Connection timeout handler
+ */
+static void client_timed_out(void *userdata) {
+    MetricsClient *client = (MetricsClient*)userdata;
+
+    // One-shot timers are released before their handler runs
+    client->timer_id = 0;
+    METRICS_INC(&scrape_errors);
+    close_client(client);
+}
+
+/**
+ * @brief Write as much of the response as the socket accepts
+ * @return 1 when the response is complete or the connection failed, 0 to wait
+ */
+static int flush_response(MetricsClient *client) {
+    while (client->response_sent < client->response_len) {
+        ssize_t n = send(client->fd, client->response + client->response_sent,
+                         client->response_len - client->response_sent, MSG_NOSIGNAL);
+        if (n < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            if (errno == EAGAIN || errno == EWOULDBLOCK) {
+                return 0;
+            }
+            LOG_DEBUG("Metrics: send failed: %s", strerror(errno));
+            METRICS_INC(&scrape_errors);
+            return 1;
+        }
+        client->response_sent += (size_t)n;
+    }
+    return 1;
+}
+
+/**
+ * @brief Prepare a short error response
+ */
+static int set_error_response(MetricsClient *client, const char *status, const char *extra_headers) {
+    char *response = NULL;
+    int len = asprintf(&response,
+                       "HTTP/1.1 %s\r\n"
+                       "Content-Type: text/plain; charset=utf-8\r\n"
+                       "Content-Length: %zu\r\n"
+                       "%s"
+                       "Connection: close\r\n"
+                       "\r\n"
+                       "%s\n",
+                       status, strlen(status) + 1, extra_headers, status);
+    if (len < 0) {
+        return ERROR_MEMORY;
+    }
+
+    METRICS_INC(&scrape_errors);
+    client->response = response;
+    client->response_len = (size_t)len;
+    client->response_sent = 0;
+    return SUCCESS;
+}
+
+/**
+ * @brief Render the metrics page behind its response head
+ *
+ * The page is rendered after RESPONSE_HEAD_SPACE bytes and the head is
+ * copied right in front of it once the length is known, so sending
+ * starts at response_sent instead of offset 0.
+ */
+static int set_metrics_response(MetricsClient *client) {
+    uint64_t start = timesource_real_us();
+    size_t capacity = METRICS_RESPONSE_SIZE;
+    char *buffer = NULL;
+    size_t body_len = 0;
+
+    // Series registered between the two passes can make the page grow again
+    for (int attempt = 0; attempt < 3; attempt++) {
+        char *grown = realloc(buffer, capacity);
+        if (!grown) {
+            free(buffer);
+            return ERROR_MEMORY;
+        }
+        buffer = grown;
+
+        body_len = metrics_render_prometheus(buffer + RESPONSE_HEAD_SPACE,
+                                             capacity - RESPONSE_HEAD_SPACE);
+        if (body_len < capacity - RESPONSE_HEAD_SPACE) {
+            break;
+        }
+        capacity = RESPONSE_HEAD_SPACE + body_len + 1024;
+    }
+
+    if (body_len >= capacity - RESPONSE_HEAD_SPACE) {
+        free(buffer);
+        return ERROR_CAPACITY_EXCEEDED;
+    }
+
+    char head[RESPONSE_HEAD_SPACE];
+    int head_len = snprintf(head, sizeof(head),
+                            "HTTP/1.1 200 OK\r\n"
+                            "Content-Type: text/plain; version=0.0.4; charset=utf-8\r\n"
+                            "Content-Length: %zu\r\n"
+                            "Connection: close\r\n"
+                            "\r\n",
+                            body_len);
+    memcpy(buffer + RESPONSE_HEAD_SPACE - head_len, head, (size_t)head_len);
+
+    client->response = buffer;
+    client->response_sent = (size_t)(RESPONSE_HEAD_SPACE - head_len);
+    client->response_len = RESPONSE_HEAD_SPACE + body_len;
+
+    METRICS_INC(&scrapes);
+    metrics_histogram_observe(&render_duration, timesource_real_us() - start);
+    return SUCCESS;
+}
+
+/**
+ * @brief Choose the response for a complete request head
+ */
+static int handle_request(MetricsClient *client) {
+    char method[8];
+    char path[256];
+
+    if (sscanf(client->request, "%7s %255s", method, path) != 2) {
+        return set_error_response(client, "400 Bad Request", "");
+    }
+
+    if (strcmp(method, "GET") != 0) {
+        return set_error_response(client, "405 Method Not Allowed", "Allow: GET\r\n");
+    }
+
+    // Collectors may append query parameters; they are ignored
+    size_t path_len = strcspn(path, "?");
+    if (path_len != strlen("/metrics") || strncmp(path, "/metrics", path_len) != 0) {
+        return set_error_response(client, "404 Not Found", "");
+    }
+
+    return set_metrics_response(client);
+}
+
+/**
+ * @brief Read the request head
+ * @return 1 when a response is ready, 0 to wait, negative to drop the connection
+ */
+static int read_request(MetricsClient *client) {
+    for (;;) {
+        size_t space = sizeof(client->request) - 1 - client->request_len;
+        if (space == 0) {
+            int result = set_error_response(client, "431 Request Header Fields Too Large", "");
+            return result == SUCCESS ? 1 : result;
+        }
+
+        ssize_t n = recv(client->fd, client->request + client->request_len, space, 0);
+        if (n < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            if (errno == EAGAIN || errno == EWOULDBLOCK) {
+                return 0;
+            }
+            return ERROR_NETWORK;
+        }
+        if (n == 0) {
+            return ERROR_NETWORK;
+        }
+
+        client->request_len += (size_t)n;
+        client->request[client->request_len] = '\0';
+
+        if (strstr(client->request, "\r\n\r\n") || strstr(client->request, "\n\n")) {
+            int result = handle_request(client);
+            return result == SUCCESS ? 1 : result;
+        }
+    }
+}
+
+/**
+ * @brief Client socket handler
+ */
+static void client_ready(int fd, uint32_t events, void *userdata) {
+    ALLOC_SCOPE(ALLOC_SUBSYSTEM_CONTROL);
+    MetricsClient *client = (MetricsClient*)userdata;
+    (void)fd;
+
+    if (!client->response) {
+        int result = (events & REACTOR_ERROR) ? ERROR_NETWORK : read_request(client);
+        if (result < 0) {
+            if (result != ERROR_NETWORK) {
+                METRICS_INC(&scrape_errors);
+            }
+            close_client(client);
+            return;
+        }
+        if (result == 0) {
+            return;
+        }
+    }
+
+    if (flush_response(client)) {
+        close_client(client);
+        return;
+    }
+
+    if (reactor_modify_fd(client->server->reactor, client->fd, REACTOR_WRITE) != SUCCESS) {
+        close_client(client);
+    }
+}
+
+/**
+ * @brief Listener handler: accept pending connections
+ */
+static void listener_ready(int fd, uint32_t events, void *userdata) {
+    MetricsServer *server = (MetricsServer*)userdata;
+    (void)events;
+
+    for (;;) {
+        int client_fd = accept4(fd, NULL, NULL, SOCK_NONBLOCK | SOCK_CLOEXEC);
+        if (client_fd < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            if (errno != EAGAIN && errno != EWOULDBLOCK) {
+                LOG_WARN_RATELIMITED("Metrics: accept failed: %s", strerror(errno));
+            }
+            return;
+        }
+
+        MetricsClient *client = NULL;
+        for (int i = 0; i < METRICS_MAX_CLIENTS; i++) {
+            if (server->clients[i].fd < 0) {
+                client = &server->clients[i];
+                break;
+            }
+        }
+
+        if (!client) {
+            LOG_WARN_RATELIMITED("Metrics: too many concurrent scrapes, dropping connection");
+            METRICS_INC(&scrape_errors);
+            close(client_fd);
+            continue;
+        }
+
+        if (reactor_add_fd(server->reactor, client_fd, REACTOR_READ, client_ready, client) != SUCCESS) {
+            METRICS_INC(&scrape_errors);
+            close(client_fd);
+            continue;
+        }
+
+        client->fd = client_fd;
+        client->span = trace_begin();
+
+        int timer_id = reactor_add_timer(server->reactor, METRICS_CLIENT_TIMEOUT * 1000ULL, 0,
+                                         client_timed_out, client);
+        if (timer_id < 0) {
+            METRICS_INC(&scrape_errors);
+            close_client(client);
+            continue;
+        }
+        client->timer_id = timer_id;
+    }
+}
+
+/**
+ * @brief Create, bind and listen on the configured address
+ * @return Listening socket on success, negative on error
+ */
+static int open_listener(MetricsServer *server, const char *address) {
+    struct sockaddr_storage addr;
+    socklen_t addr_len;
+    memset(&addr, 0, sizeof(addr));
+
+    if (address[0] == '/') {
+        struct sockaddr_un *un = (struct sockaddr_un*)&addr;
+        if (strlen(address) >= sizeof(un->sun_path)) {
+            LOG_ERROR("Metrics: socket path too long: %s", address);
+            return ERROR_INVALID_PARAM;
+        }
+        un->sun_family = AF_UNIX;
+        snprintf(un->sun_path, sizeof(un->sun_path), "%s", address);
+        addr_len = sizeof(struct sockaddr_un);
+    } else {
+        struct sockaddr_in *in = (struct sockaddr_in*)&addr;
+        char host[64];
+        const char *colon = strrchr(address, ':');
+        char *end = NULL;
+
+        if (!colon || (size_t)(colon - address) >= sizeof(host)) {
+            LOG_ERROR("Metrics: invalid listen address: %s", address);
+            return ERROR_INVALID_PARAM;
+        }
+
+        long port = strtol(colon + 1, &end, 10);
+        memcpy(host, address, (size_t)(colon - address));
+        host[colon - address] = '\0';
+
+        in->sin_family = AF_INET;
+        in->sin_port = htons((uint16_t)port);
+        if (*end != '\0' || port <= 0 || port > 65535 ||
+            inet_pton(AF_INET, host[0] ? host : "0.0.0.0", &in->sin_addr) != 1) {
+            LOG_ERROR("Metrics: invalid listen address: %s", address);
+            return ERROR_INVALID_PARAM;
+        }
+        addr_len = sizeof(struct sockaddr_in);
+    }
+
+    int fd = socket(addr.ss_family, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+    if (fd < 0) {
+        LOG_ERROR("Metrics: failed to create socket: %s", strerror(errno));
+        return ERROR_NETWORK;
+    }
+
+    if (addr.ss_family == AF_UNIX) {
+        // Remove the socket left behind by a previous run
+        unlink(address);
+    } else {
+        int reuse = 1;
+        setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &reuse, sizeof(reuse));
+    }
+
+    if (bind(fd, (struct sockaddr*)&addr, addr_len) < 0 ||
+        listen(fd, METRICS_MAX_CLIENTS) < 0) {
+        LOG_ERROR("Metrics: failed to listen on %s: %s", address, strerror(errno));
+        close(fd);
+        return ERROR_NETWORK;
+    }
+
+    if (addr.ss_family == AF_UNIX) {
+        snprintf(server->unix_path, sizeof(server->unix_path), "%s", address);
+    }
+
+    return fd;
+}
+
+// ============================================================================
+// PUBLIC FUNCTIONS
+// ============================================================================
+
+int metrics_server_init(MetricsServer *server, Reactor *reactor, const char *address) {
+    if (!server || !reactor || !address || address[0] == '\0') {
+        return ERROR_INVALID_PARAM;
+    }
+
+    memset(server, 0, sizeof(MetricsServer));
+    server->reactor = reactor;
+    server->listen_fd = -1;
+    for (int i = 0; i < METRICS_MAX_CLIENTS; i++) {
+        server->clients[i].server = server;
+        server->clients[i].fd = -1;
+    }
+
+    metrics_register_all(server_metrics, sizeof(server_metrics) / sizeof(server_metrics[0]));
+
+    int fd = open_listener(server, address);
+    if (fd < 0) {
+        return fd;
+    }
+
+    int result = reactor_add_fd(reactor, fd, REACTOR_READ, listener_ready, server);
+    if (result != SUCCESS) {
+        close(fd);
+        if (server->unix_path[0]) {
+            unlink(server->unix_path);
+        }
+        return result;
+    }
+
+    server->listen_fd = fd;
+    LOG_INFO("Metrics endpoint listening on %s", address);
+    return SUCCESS;
+}
+
+void metrics_server_cleanup(MetricsServer *server) {
+    if (!server || !server->reactor) {
+        return;
+    }
+
+    for (int i = 0; i < METRICS_MAX_CLIENTS; i++) {
+        if (server->clients[i].fd >= 0) {
+            close_client(&server->clients[i]);
+        }
+    }
+
+    if (server->listen_fd >= 0) {
+        reactor_remove_fd(server->reactor, server->listen_fd);
+        close(server->listen_fd);
+        server->listen_fd = -1;
+    }
+
+    if (server->unix_path[0]) {
+        unlink(server->unix_path);
+        server->unix_path[0] = '\0';
+    }
+}
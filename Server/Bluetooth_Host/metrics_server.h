@@ -0,0 +1,77 @@
+/**
+ * @file metrics_server.h
+ * @brief Prometheus scrape endpoint served from the reactor
+ *
+ * This module exposes the metrics registry over HTTP so a collector can
+ * poll the daemon instead of waiting for SIGUSR1 dumps. The listener and
+ * its connections are ordinary reactor fds; a scrape renders the
+ * registry in Prometheus text format from the per-thread slot blocks,
+ * so it never takes a lock used by the Bluetooth, GPIO or logging paths.
+ *
+ * Features:
+ * - TCP ("host:port") or UNIX socket (absolute path) listener
+ * - GET /metrics in text exposition format 0.0.4
+ * - Non-blocking reads and writes with a per-connection timeout
+ * - Bounded number of concurrent scrapes
+ *
+ * Threading:
+ * All functions must be called from the reactor thread.
+ */
+
+#ifndef METRICS_SERVER_H
+#define METRICS_SERVER_H
+
+#include <stddef.h>
+
+#include "config.h"
+#include "reactor.h"
+
+// ============================================================================
+// DATA STRUCTURES
+// ============================================================================
+
+/**
+ * @brief Scrape connection
+ */
+typedef struct {
+    struct MetricsServer *server;       /// Owning server
+    int fd;                             /// Client socket, -1 if the slot is free
+    int timer_id;                       /// Timeout timer, 0 if none
+    char request[512];                  /// Request head received so far
+    size_t request_len;                 /// Bytes in request
+    char *response;                     /// Response being written, NULL while reading
+    size_t response_len;                /// Total response bytes
+    size_t response_sent;               /// Response bytes already written
+    uint64_t span;                      /// Trace span start
+} MetricsClient;
+
+/**
+ * @brief Metrics endpoint state
+ */
+typedef struct MetricsServer {
+    Reactor *reactor;                   /// Loop serving the endpoint
+    int listen_fd;                      /// Listening socket, -1 if not listening
+    char unix_path[108];                /// Socket path to unlink on cleanup, empty for TCP
+    MetricsClient clients[METRICS_MAX_CLIENTS]; /// Connection slots
+} MetricsServer;
+
+// ============================================================================
+// LIFECYCLE
+// ============================================================================
+
+/**
+ * @brief Start listening for scrapes
+ * @param server Pointer to server to initialize
+ * @param reactor Loop serving the endpoint
+ * @param address "host:port" for TCP, or an absolute path for a UNIX socket
+ * @return 0 on success, negative on error
+ */
+int metrics_server_init(MetricsServer *server, Reactor *reactor, const char *address);
+
+/**
+ * @brief Close the listener and all scrape connections
+ * @param server Pointer to server
+ */
+void metrics_server_cleanup(MetricsServer *server);
+
+#endif // METRICS_SERVER_H
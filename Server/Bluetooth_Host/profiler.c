@@ -0,0 +1,611 @@
+/**
+ * @file profiler.c
+ * @brief Implementation of the on-demand sampling profiler
+ *
+ * The SIGPROF handler claims a slot in the sample buffer with an atomic
+ * increment and fills it with backtrace(); it takes no lock and does not
+ * allocate, because the unwinder is loaded before the first signal.
+ * Stopping disarms the timer, clears the sampling flag and waits for
+ * handlers still running on other threads before the buffer is read.
+ *
+ * Writing sorts the samples so identical stacks are adjacent, then
+ * resolves each distinct stack once: addresses in the executable through
+ * its own .symtab (static functions included), others through dladdr().
+ */
+
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <signal.h>
+#include <sched.h>
+#include <unistd.h>
+#include <dlfcn.h>
+#include <elf.h>
+#include <link.h>
+#include <execinfo.h>
+#include <ucontext.h>
+#include <sys/stat.h>
+#include <sys/time.h>
+#include <sys/syscall.h>
+
+#include "profiler.h"
+#include "logger.h"
+#include "trace.h"
+
+// ============================================================================
+// DATA STRUCTURES
+// ============================================================================
+
+/**
+ * @brief One recorded stack, innermost frame first
+ */
+typedef struct {
+    int tid;                            /// Interrupted thread
+    int depth;                          /// Valid entries in frames
+    void *frames[PROFILER_MAX_DEPTH];   /// Program counter, then return addresses
+} ProfileSample;
+
+/**
+ * @brief Function symbol of the executable
+ */
+typedef struct {
+    uintptr_t address;                  /// Link-time start address
+    uintptr_t size;                     /// Size in bytes, 0 if unknown
+    const char *name;                   /// Name inside SymbolTable.image
+} Symbol;
+
+/**
+ * @brief Symbols of the executable, loaded while a profile is written
+ */
+typedef struct {
+    char *image;                        /// Contents of /proc/self/exe
+    Symbol *symbols;                    /// Function symbols sorted by address
+    size_t count;                       /// Entries in symbols
+    uintptr_t bias;                     /// Load bias (run-time minus link-time address)
+    uintptr_t start;                    /// First mapped address of the executable
+    uintptr_t end;                      /// One past the last mapped address
+} SymbolTable;
+
+/// Thread names resolved while writing one profile
+typedef struct {
+    int tid;
+    char name[16];
+} ThreadName;
+
+/// Frames the handler may see above the interrupted one (handler, trampoline)
+#define SIGNAL_FRAMES 4
+
+/// Distinct threads named in one profile
+#define MAX_THREAD_NAMES 64
+
+// ============================================================================
+// STATIC VARIABLES
+// ============================================================================
+
+/// Sample buffer, allocated while a profile runs
+static ProfileSample *samples = NULL;
+static uint32_t sample_capacity = 0;
+
+/// Slots claimed and samples lost to a full buffer (atomic)
+static uint32_t sample_next = 0;
+static uint32_t samples_dropped = 0;
+
+/// Handler records samples while set; handlers in progress (atomic, seq_cst)
+static int sampling = 0;
+static int handlers_running = 0;
+
+static Reactor *profile_reactor = NULL;
+static int stop_timer_id = 0;
+static uint64_t started_ms = 0;
+static ProfilerStatus status = {0};
+
+// ============================================================================
+// SIGNAL HANDLER
+// ============================================================================
+
+/**
+ * @brief Program counter of the interrupted code, NULL if unknown
+ */
+static void* interrupted_pc(void *context) {
+    ucontext_t *uc = (ucontext_t*)context;
+#if defined(__x86_64__)
+    return (void*)uc->uc_mcontext.gregs[REG_RIP];
+#elif defined(__i386__)
+    return (void*)uc->uc_mcontext.gregs[REG_EIP];
+#elif defined(__aarch64__)
+    return (void*)uc->uc_mcontext.pc;
+#elif defined(__arm__)
+    return (void*)uc->uc_mcontext.arm_pc;
+#else
+    (void)uc;
+    return NULL;
+#endif
+}
+
+/**
+ * @brief SIGPROF handler: record the interrupted thread's stack
+ */
+static void sample_handler(int signo, siginfo_t *info, void *context) {
+    (void)signo;
+    (void)info;
+    int saved_errno = errno;
+
+    __atomic_add_fetch(&handlers_running, 1, __ATOMIC_SEQ_CST);
+    if (__atomic_load_n(&sampling, __ATOMIC_SEQ_CST)) {
+        uint32_t index = __atomic_fetch_add(&sample_next, 1, __ATOMIC_RELAXED);
+        if (index < sample_capacity) {
+            void *frames[PROFILER_MAX_DEPTH + SIGNAL_FRAMES];
+            int depth = backtrace(frames, PROFILER_MAX_DEPTH + SIGNAL_FRAMES);
+
+            // Drop the handler's own frames: start at the interrupted PC
+            void *pc = interrupted_pc(context);
+            int first = 0;
+            while (first < depth && first < SIGNAL_FRAMES && frames[first] != pc) {
+                first++;
+            }
+            if (first == depth || first == SIGNAL_FRAMES) {
+                first = depth > 2 ? 2 : depth;
+            }
+
+            ProfileSample *sample = &samples[index];
+            sample->tid = (int)syscall(SYS_gettid);
+            sample->depth = depth - first > PROFILER_MAX_DEPTH ? PROFILER_MAX_DEPTH : depth - first;
+            memcpy(sample->frames, frames + first, (size_t)sample->depth * sizeof(void*));
+        } else {
+            __atomic_add_fetch(&samples_dropped, 1, __ATOMIC_RELAXED);
+        }
+    }
+    __atomic_sub_fetch(&handlers_running, 1, __ATOMIC_SEQ_CST);
+
+    errno = saved_errno;
+}
+
+// ============================================================================
+// SYMBOLS
+// ============================================================================
+
+/**
+ * @brief dl_iterate_phdr callback: record the executable's mapping
+ *
+ * The executable is always the first object reported.
+ */
+static int find_executable(struct dl_phdr_info *info, size_t size, void *data) {
+    (void)size;
+    SymbolTable *table = (SymbolTable*)data;
+
+    table->bias = (uintptr_t)info->dlpi_addr;
+    table->start = UINTPTR_MAX;
+    for (int i = 0; i < info->dlpi_phnum; i++) {
+        const ElfW(Phdr) *phdr = &info->dlpi_phdr[i];
+        if (phdr->p_type != PT_LOAD) {
+            continue;
+        }
+        uintptr_t start = table->bias + phdr->p_vaddr;
+        if (start < table->start) {
+            table->start = start;
+        }
+        if (start + phdr->p_memsz > table->end) {
+            table->end = start + phdr->p_memsz;
+        }
+    }
+    return 1;
+}
+
+static int compare_symbols(const void *a, const void *b) {
+    const Symbol *left = (const Symbol*)a;
+    const Symbol *right = (const Symbol*)b;
+    return (left->address > right->address) - (left->address < right->address);
+}
+
+/**
+ * @brief Read /proc/self/exe into memory
+ * @return File contents (caller frees), NULL on error
+ */
+static char* read_executable(size_t *size) {
+    int fd = open("/proc/self/exe", O_RDONLY | O_CLOEXEC);
+    if (fd < 0) {
+        return NULL;
+    }
+
+    struct stat st;
+    char *image = NULL;
+    if (fstat(fd, &st) == 0 && st.st_size > 0) {
+        image = malloc((size_t)st.st_size);
+    }
+
+    size_t total = 0;
+    while (image && total < (size_t)st.st_size) {
+        ssize_t n = read(fd, image + total, (size_t)st.st_size - total);
+        if (n <= 0) {
+            free(image);
+            image = NULL;
+            break;
+        }
+        total += (size_t)n;
+    }
+    close(fd);
+
+    *size = total;
+    return image;
+}
+
+/**
+ * @brief Load the function symbols of the executable
+ *
+ * A stripped executable leaves the table empty; its frames are then
+ * reported as offsets.
+ */
+static void symbols_load(SymbolTable *table) {
+    memset(table, 0, sizeof(SymbolTable));
+    dl_iterate_phdr(find_executable, table);
+
+    size_t size = 0;
+    table->image = read_executable(&size);
+    if (!table->image || size < sizeof(ElfW(Ehdr))) {
+        return;
+    }
+
+    const ElfW(Ehdr) *ehdr = (const ElfW(Ehdr)*)table->image;
+    if (memcmp(ehdr->e_ident, ELFMAG, SELFMAG) != 0 || ehdr->e_shentsize != sizeof(ElfW(Shdr)) ||
+        ehdr->e_shoff == 0 || ehdr->e_shoff + (size_t)ehdr->e_shnum * sizeof(ElfW(Shdr)) > size) {
+        return;
+    }
+
+    const ElfW(Shdr) *sections = (const ElfW(Shdr)*)(table->image + ehdr->e_shoff);
+    for (int i = 0; i < ehdr->e_shnum; i++) {
+        const ElfW(Shdr) *symtab = &sections[i];
+        if (symtab->sh_type != SHT_SYMTAB || symtab->sh_link >= ehdr->e_shnum ||
+            symtab->sh_offset + symtab->sh_size > size) {
+            continue;
+        }
+        const ElfW(Shdr) *strtab = &sections[symtab->sh_link];
+        if (strtab->sh_offset + strtab->sh_size > size) {
+            continue;
+        }
+
+        const ElfW(Sym) *entries = (const ElfW(Sym)*)(table->image + symtab->sh_offset);
+        size_t entry_count = symtab->sh_size / sizeof(ElfW(Sym));
+        table->symbols = malloc(entry_count * sizeof(Symbol));
+        if (!table->symbols) {
+            return;
+        }
+
+        for (size_t j = 0; j < entry_count; j++) {
+            const ElfW(Sym) *entry = &entries[j];
+            if (ELF32_ST_TYPE(entry->st_info) != STT_FUNC || entry->st_value == 0 ||
+                entry->st_shndx == SHN_UNDEF || entry->st_name >= strtab->sh_size) {
+                continue;
+            }
+            Symbol *symbol = &table->symbols[table->count++];
+            symbol->address = (uintptr_t)entry->st_value;
+            symbol->size = (uintptr_t)entry->st_size;
+            symbol->name = table->image + strtab->sh_offset + entry->st_name;
+        }
+        qsort(table->symbols, table->count, sizeof(Symbol), compare_symbols);
+        return;
+    }
+}
+
+static void symbols_free(SymbolTable *table) {
+    free(table->symbols);
+    free(table->image);
+    memset(table, 0, sizeof(SymbolTable));
+}
+
+/**
+ * @brief Find the executable's function containing a link-time address
+ */
+static const char* symbols_lookup(const SymbolTable *table, uintptr_t address) {
+    size_t low = 0;
+    size_t high = table->count;
+    while (low < high) {
+        size_t middle = low + (high - low) / 2;
+        if (table->symbols[middle].address <= address) {
+            low = middle + 1;
+        } else {
+            high = middle;
+        }
+    }
+    if (low == 0) {
+        return NULL;
+    }
+
+    const Symbol *symbol = &table->symbols[low - 1];
+    if (symbol->size > 0 && address >= symbol->address + symbol->size) {
+        return NULL;
+    }
+    return symbol->name;
+}
+
+/**
+ * @brief Name one frame for the folded output
+ * @param address Code address; return addresses are already moved into the call
+ */
+static void resolve_frame(const SymbolTable *table, uintptr_t address, char *name, size_t size) {
+    if (address >= table->start && address < table->end) {
+        const char *symbol = symbols_lookup(table, address - table->bias);
+        if (symbol) {
+            snprintf(name, size, "%s", symbol);
+            return;
+        }
+    }
+
+    Dl_info info;
+    if (dladdr((void*)address, &info) && info.dli_fname) {
+        if (info.dli_sname) {
+            snprintf(name, size, "%s", info.dli_sname);
+        } else {
+            const char *file = strrchr(info.dli_fname, '/');
+            snprintf(name, size, "%s+0x%lx", file ? file + 1 : info.dli_fname,
+                     (unsigned long)(address - (uintptr_t)info.dli_fbase));
+        }
+        return;
+    }
+
+    snprintf(name, size, "0x%lx", (unsigned long)address);
+}
+
+/**
+ * @brief Name of a sampled thread, cached for the profile being written
+ */
+static const char* thread_name(ThreadName *names, int *count, int tid) {
+    for (int i = 0; i < *count; i++) {
+        if (names[i].tid == tid) {
+            return names[i].name;
+        }
+    }
+
+    static char fallback[16];
+    ThreadName *entry = *count < MAX_THREAD_NAMES ? &names[(*count)++] : NULL;
+    char *name = entry ? entry->name : fallback;
+    if (entry) {
+        entry->tid = tid;
+    }
+
+    if (trace_get_thread_name(tid, name, sizeof(names[0].name)) != 0) {
+        snprintf(name, sizeof(names[0].name), "thread-%d", tid);
+    }
+    return name;
+}
+
+// ============================================================================
+// OUTPUT
+// ============================================================================
+
+static int compare_samples(const void *a, const void *b) {
+    const ProfileSample *left = *(const ProfileSample *const *)a;
+    const ProfileSample *right = *(const ProfileSample *const *)b;
+
+    if (left->tid != right->tid) {
+        return left->tid < right->tid ? -1 : 1;
+    }
+    if (left->depth != right->depth) {
+        return left->depth < right->depth ? -1 : 1;
+    }
+    return memcmp(left->frames, right->frames, (size_t)left->depth * sizeof(void*));
+}
+
+/**
+ * @brief Write the recorded samples as folded stacks
+ * @return Distinct stacks written, negative on error
+ */
+static int write_folded(const char *path, uint32_t count) {
+    ProfileSample **order = malloc((count > 0 ? count : 1) * sizeof(ProfileSample*));
+    if (!order) {
+        return ERROR_MEMORY;
+    }
+    for (uint32_t i = 0; i < count; i++) {
+        order[i] = &samples[i];
+    }
+    qsort(order, count, sizeof(ProfileSample*), compare_samples);
+
+    // The temporary file is created exclusively (never through a planted
+    // symlink) and renamed over the output, which replaces a link there
+    char temp_path[512];
+    snprintf(temp_path, sizeof(temp_path), "%s.XXXXXX", path);
+    int fd = mkostemp(temp_path, O_CLOEXEC);
+    FILE *file = (fd >= 0) ? fdopen(fd, "w") : NULL;
+    if (!file) {
+        LOG_WARN("Profiler: cannot write %s: %s", temp_path, strerror(errno));
+        if (fd >= 0) {
+            close(fd);
+            unlink(temp_path);
+        }
+        free(order);
+        return ERROR_GENERIC;
+    }
+
+    SymbolTable table;
+    symbols_load(&table);
+    ThreadName names[MAX_THREAD_NAMES];
+    int name_count = 0;
+    int stacks = 0;
+
+    for (uint32_t i = 0; i < count; ) {
+        uint32_t run = 1;
+        while (i + run < count && compare_samples(&order[i], &order[i + run]) == 0) {
+            run++;
+        }
+
+        const ProfileSample *sample = order[i];
+        fputs(thread_name(names, &name_count, sample->tid), file);
+        for (int f = sample->depth - 1; f >= 0; f--) {
+            // Return addresses point after the call; look up the call itself
+            uintptr_t address = (uintptr_t)sample->frames[f] - (f > 0 ? 1 : 0);
+            char frame[128];
+            resolve_frame(&table, address, frame, sizeof(frame));
+            fprintf(file, ";%s", frame);
+        }
+        fprintf(file, " %u\n", run);
+
+        stacks++;
+        i += run;
+    }
+
+    symbols_free(&table);
+    free(order);
+
+    int failed = ferror(file);
+    if (fclose(file) != 0 || failed || rename(temp_path, path) != 0) {
+        LOG_WARN("Profiler: failed to write %s", path);
+        unlink(temp_path);
+        return ERROR_GENERIC;
+    }
+    return stacks;
+}
+
+/**
+ * @brief Reactor timer: the requested duration is over
+ */
+static void stop_timer(void *userdata) {
+    (void)userdata;
+    stop_timer_id = 0;
+    profiler_stop();
+}
+
+// ============================================================================
+// PUBLIC API
+// ============================================================================
+
+int profiler_start(Reactor *reactor, int frequency_hz, int duration_s, const char *path) {
+    if (!reactor || !path || path[0] == '\0' || strlen(path) >= sizeof(status.path) ||
+        frequency_hz < 1 || frequency_hz > PROFILER_MAX_FREQUENCY_HZ ||
+        duration_s < 1 || duration_s > PROFILER_MAX_DURATION_S) {
+        return ERROR_INVALID_PARAM;
+    }
+    if (status.running) {
+        LOG_WARN("Profiler: a profile is already running until %d s", status.duration_s);
+        return ERROR_INVALID_PARAM;
+    }
+
+    // Every CPU can use up its share of CPU time
+    long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+    uint64_t capacity = (uint64_t)frequency_hz * (uint64_t)duration_s * (uint64_t)(cpus > 0 ? cpus : 1);
+    if (capacity > PROFILER_MAX_SAMPLES) {
+        capacity = PROFILER_MAX_SAMPLES;
+    }
+
+    samples = calloc((size_t)capacity, sizeof(ProfileSample));
+    if (!samples) {
+        LOG_ERROR("Profiler: cannot allocate %llu samples", (unsigned long long)capacity);
+        return ERROR_MEMORY;
+    }
+    sample_capacity = (uint32_t)capacity;
+    __atomic_store_n(&sample_next, 0, __ATOMIC_RELAXED);
+    __atomic_store_n(&samples_dropped, 0, __ATOMIC_RELAXED);
+
+    // The first backtrace() loads the unwinder, which must not happen in the handler
+    void *probe[2];
+    backtrace(probe, 2);
+
+    struct sigaction action;
+    memset(&action, 0, sizeof(action));
+    action.sa_sigaction = sample_handler;
+    action.sa_flags = SA_SIGINFO | SA_RESTART;
+    sigemptyset(&action.sa_mask);
+    if (sigaction(SIGPROF, &action, NULL) != 0) {
+        LOG_ERROR("Profiler: cannot install SIGPROF handler: %s", strerror(errno));
+        free(samples);
+        samples = NULL;
+        return ERROR_GENERIC;
+    }
+    __atomic_store_n(&sampling, 1, __ATOMIC_SEQ_CST);
+
+    long interval_us = 1000000L / frequency_hz;
+    struct itimerval timer = {
+        .it_interval = { .tv_sec = interval_us / 1000000L, .tv_usec = interval_us % 1000000L },
+        .it_value = { .tv_sec = interval_us / 1000000L, .tv_usec = interval_us % 1000000L }
+    };
+    int timer_id = -1;
+    if (setitimer(ITIMER_PROF, &timer, NULL) == 0) {
+        timer_id = reactor_add_timer(reactor, (uint64_t)duration_s * 1000, 0, stop_timer, NULL);
+    }
+    if (timer_id < 0) {
+        LOG_ERROR("Profiler: cannot start the sampling timer");
+        struct itimerval off;
+        memset(&off, 0, sizeof(off));
+        setitimer(ITIMER_PROF, &off, NULL);
+        __atomic_store_n(&sampling, 0, __ATOMIC_SEQ_CST);
+        while (__atomic_load_n(&handlers_running, __ATOMIC_SEQ_CST) > 0) {
+            sched_yield();
+        }
+        signal(SIGPROF, SIG_IGN);
+        free(samples);
+        samples = NULL;
+        return ERROR_GENERIC;
+    }
+
+    profile_reactor = reactor;
+    stop_timer_id = timer_id;
+    started_ms = reactor_now_ms();
+    memset(&status, 0, sizeof(status));
+    status.running = 1;
+    status.frequency_hz = frequency_hz;
+    status.duration_s = duration_s;
+    snprintf(status.path, sizeof(status.path), "%s", path);
+
+    LOG_INFO("Profiler: sampling at %d Hz for %d s (room for %u samples), output %s",
+             frequency_hz, duration_s, sample_capacity, path);
+    return 0;
+}
+
+int profiler_stop(void) {
+    if (!status.running) {
+        return ERROR_INVALID_PARAM;
+    }
+
+    if (stop_timer_id > 0) {
+        reactor_cancel_timer(profile_reactor, stop_timer_id);
+        stop_timer_id = 0;
+    }
+
+    // Disarm, then wait for handlers still writing on other threads
+    struct itimerval off;
+    memset(&off, 0, sizeof(off));
+    setitimer(ITIMER_PROF, &off, NULL);
+    __atomic_store_n(&sampling, 0, __ATOMIC_SEQ_CST);
+    while (__atomic_load_n(&handlers_running, __ATOMIC_SEQ_CST) > 0) {
+        sched_yield();
+    }
+    // A SIGPROF still pending must not reach the default action (terminate)
+    signal(SIGPROF, SIG_IGN);
+
+    uint32_t claimed = __atomic_load_n(&sample_next, __ATOMIC_RELAXED);
+    uint32_t count = claimed < sample_capacity ? claimed : sample_capacity;
+    status.running = 0;
+    status.elapsed_ms = reactor_now_ms() - started_ms;
+    status.samples = count;
+    status.dropped = __atomic_load_n(&samples_dropped, __ATOMIC_RELAXED);
+
+    uint64_t write_start = reactor_now_ms();
+    int stacks = write_folded(status.path, count);
+    free(samples);
+    samples = NULL;
+    sample_capacity = 0;
+
+    if (stacks >= 0) {
+        LOG_INFO("Profiler: wrote %d stacks from %llu samples (%llu dropped) to %s in %llu ms",
+                 stacks, (unsigned long long)status.samples, (unsigned long long)status.dropped,
+                 status.path, (unsigned long long)(reactor_now_ms() - write_start));
+    }
+    return stacks;
+}
+
+void profiler_get_status(ProfilerStatus *out) {
+    *out = status;
+    if (status.running) {
+        uint32_t claimed = __atomic_load_n(&sample_next, __ATOMIC_RELAXED);
+        out->elapsed_ms = reactor_now_ms() - started_ms;
+        out->samples = claimed < sample_capacity ? claimed : sample_capacity;
+        out->dropped = __atomic_load_n(&samples_dropped, __ATOMIC_RELAXED);
+    }
+}
+
+void profiler_cleanup(void) {
+    if (status.running) {
+        profiler_stop();
+    }
+}
@@ -0,0 +1,88 @@
+/**
+ * @file profiler.h
+ * @brief On-demand CPU sampling profiler writing folded stacks
+ *
+ * For gateways in the field where perf cannot be attached: an operator
+ * starts a profile with "door_monitor_ctl profile" or SIGRTMIN, and after
+ * the given duration the daemon writes one line per distinct stack,
+ * "thread;outermost;...;innermost count", which flamegraph.pl and
+ * speedscope read directly.
+ *
+ * Sampling uses ITIMER_PROF: the kernel sends SIGPROF every 1/frequency
+ * seconds of CPU time consumed by the process, to the thread that was
+ * running, and the handler records that thread's stack with backtrace().
+ * Threads that sleep cost nothing and do not appear, so the profile shows
+ * where CPU time goes. Samples go to a buffer allocated when the profile
+ * starts; symbols are resolved only when it is written, from the
+ * executable's symbol table and dladdr() for shared libraries.
+ *
+ * While no profile runs there is no timer, no signal handler and no
+ * buffer, so an idle profiler costs nothing.
+ *
+ * Threading:
+ * All functions must be called from the reactor thread. The signal
+ * handler runs on whichever thread was interrupted.
+ */
+
+#ifndef PROFILER_H
+#define PROFILER_H
+
+#include <stdint.h>
+
+#include "config.h"
+#include "reactor.h"
+
+// ============================================================================
+// DATA STRUCTURES
+// ============================================================================
+
+/**
+ * @brief Progress of the current or last profile
+ */
+typedef struct {
+    int running;                        /// A profile is being recorded
+    int frequency_hz;                   /// Samples per CPU second
+    int duration_s;                     /// Requested duration
+    uint64_t elapsed_ms;                /// Time since the profile started
+    uint64_t samples;                   /// Samples recorded
+    uint64_t dropped;                   /// Samples lost because the buffer was full
+    char path[256];                     /// Output file
+} ProfilerStatus;
+
+// ============================================================================
+// PUBLIC API
+// ============================================================================
+
+/**
+ * @brief Start recording a profile
+ * @param reactor Event loop that ends the profile after duration_s
+ * @param frequency_hz Samples per CPU second (1 to PROFILER_MAX_FREQUENCY_HZ)
+ * @param duration_s Seconds to record (1 to PROFILER_MAX_DURATION_S)
+ * @param path File the folded stacks are written to
+ * @return 0 on success, ERROR_INVALID_PARAM for out-of-range arguments or
+ *         when a profile is already running, ERROR_MEMORY or ERROR_GENERIC
+ *         if sampling could not be set up
+ */
+int profiler_start(Reactor *reactor, int frequency_hz, int duration_s, const char *path);
+
+/**
+ * @brief End the running profile early and write it
+ * @return Distinct stacks written, negative if no profile runs or the
+ *         file could not be written
+ */
+int profiler_stop(void);
+
+/**
+ * @brief Get the progress of the current or last profile
+ * @param status Filled with the current values
+ */
+void profiler_get_status(ProfilerStatus *status);
+
+/**
+ * @brief Write a running profile before shutdown
+ *
+ * Must run before the reactor is cleaned up.
+ */
+void profiler_cleanup(void);
+
+#endif // PROFILER_H
@@ -0,0 +1,485 @@
+/**
+ * @file reactor.c
+ * @brief Implementation of the single-threaded event loop
+ *
+ * Fd registrations live in a fixed table; the epoll user data carries the
+ * table slot and its generation so that events fetched for an fd removed
+ * earlier in the same batch are recognised and dropped. Timers live in a
+ * fixed slot table ordered by a binary min-heap of deadlines.
+ *
+ * Timer deadlines are on the timesource clock. With the virtual clock the
+ * loop does not sleep until the earliest deadline: it polls, waiting up to
+ * VIRTUAL_CLOCK_IDLE_MS of real time only if a handler announced I/O with
+ * timesource_expect_io(), and if nothing arrives moves the clock to the
+ * deadline.
+ */
+
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/epoll.h>
+
+#include "reactor.h"
+#include "timesource.h"
+#include "logger.h"
+#include "metrics.h"
+
+// ============================================================================
+// STATIC VARIABLES
+// ============================================================================
+
+static Metric loop_iterations = METRIC_COUNTER_INIT("reactor_iterations_total",
+    "Event loop iterations");
+static Metric fd_events = METRIC_COUNTER_INIT("reactor_fd_events_total",
+    "Fd events dispatched");
+static Metric timers_fired = METRIC_COUNTER_INIT("reactor_timers_fired_total",
+    "Timer expiries dispatched");
+static Metric handler_duration = METRIC_HISTOGRAM_INIT("reactor_handler_duration_us",
+    "Time spent in one fd or timer handler in microseconds");
+static Metric timer_lag = METRIC_HISTOGRAM_INIT("reactor_timer_lag_ms",
+    "Delay between a timer deadline and its dispatch in milliseconds");
+static Metric clock_jumps = METRIC_COUNTER_INIT("reactor_clock_jumps_total",
+    "Times the virtual clock jumped to the next timer deadline");
+
+static Metric *const reactor_metrics[] = {
+    &loop_iterations, &fd_events, &timers_fired, &handler_duration, &timer_lag,
+    &clock_jumps
+};
+
+// ============================================================================
+// INTERNAL HELPER FUNCTIONS
+// ============================================================================
+
+/**
+ * @brief Convert REACTOR_* flags to epoll events
+ * @param events REACTOR_READ/REACTOR_WRITE mask
+ * @return epoll event mask
+ */
+static uint32_t to_epoll_events(uint32_t events) {
+    uint32_t result = 0;
+    if (events & REACTOR_READ) {
+        result |= EPOLLIN;
+    }
+    if (events & REACTOR_WRITE) {
+        result |= EPOLLOUT;
+    }
+    return result;
+}
+
+/**
+ * @brief Convert epoll events to REACTOR_* flags
+ * @param events epoll event mask
+ * @return REACTOR_* mask
+ */
+static uint32_t from_epoll_events(uint32_t events) {
+    uint32_t result = 0;
+    if (events & (EPOLLIN | EPOLLRDHUP)) {
+        result |= REACTOR_READ;
+    }
+    if (events & EPOLLOUT) {
+        result |= REACTOR_WRITE;
+    }
+    if (events & (EPOLLERR | EPOLLHUP)) {
+        result |= REACTOR_ERROR;
+    }
+    return result;
+}
+
+/**
+ * @brief Find the table slot of a registered fd
+ * @param reactor Pointer to reactor
+ * @param fd File descriptor
+ * @return Slot index, or -1 if not registered
+ */
+static int find_fd_slot(const Reactor *reactor, int fd) {
+    for (int i = 0; i < REACTOR_MAX_FDS; i++) {
+        if (reactor->fds[i].fd == fd) {
+            return i;
+        }
+    }
+    return -1;
+}
+
+/**
+ * @brief Swap two heap entries and update their back references
+ * @param reactor Pointer to reactor
+ * @param a First heap index
+ * @param b Second heap index
+ */
+static void heap_swap(Reactor *reactor, int a, int b) {
+    int slot_a = reactor->heap[a];
+    int slot_b = reactor->heap[b];
+    reactor->heap[a] = slot_b;
+    reactor->heap[b] = slot_a;
+    reactor->timers[slot_b].heap_index = a;
+    reactor->timers[slot_a].heap_index = b;
+}
+
+/**
+ * @brief Restore heap order around one entry
+ * @param reactor Pointer to reactor
+ * @param index Heap index whose deadline changed
+ */
+static void heap_fix(Reactor *reactor, int index) {
+    // Sift up
+    while (index > 0) {
+        int parent = (index - 1) / 2;
+        if (reactor->timers[reactor->heap[parent]].deadline_ms <=
+            reactor->timers[reactor->heap[index]].deadline_ms) {
+            break;
+        }
+        heap_swap(reactor, index, parent);
+        index = parent;
+    }
+
+    // Sift down
+    for (;;) {
+        int smallest = index;
+        int left = 2 * index + 1;
+        int right = left + 1;
+
+        if (left < reactor->heap_size &&
+            reactor->timers[reactor->heap[left]].deadline_ms <
+            reactor->timers[reactor->heap[smallest]].deadline_ms) {
+            smallest = left;
+        }
+        if (right < reactor->heap_size &&
+            reactor->timers[reactor->heap[right]].deadline_ms <
+            reactor->timers[reactor->heap[smallest]].deadline_ms) {
+            smallest = right;
+        }
+        if (smallest == index) {
+            break;
+        }
+        heap_swap(reactor, index, smallest);
+        index = smallest;
+    }
+}
+
+/**
+ * @brief Remove a timer from the heap and free its slot
+ * @param reactor Pointer to reactor
+ * @param slot Timer slot index
+ */
+static void release_timer(Reactor *reactor, int slot) {
+    ReactorTimer *timer = &reactor->timers[slot];
+    int index = timer->heap_index;
+
+    reactor->heap_size--;
+    if (index != reactor->heap_size) {
+        heap_swap(reactor, index, reactor->heap_size);
+        heap_fix(reactor, index);
+    }
+
+    timer->heap_index = -1;
+    timer->handler = NULL;
+    timer->generation++;
+}
+
+/**
+ * @brief Dispatch all timers whose deadline has passed
+ * @param reactor Pointer to reactor
+ */
+static void run_due_timers(Reactor *reactor) {
+    uint64_t now = reactor_now_ms();
+
+    while (reactor->heap_size > 0) {
+        int slot = reactor->heap[0];
+        ReactorTimer *timer = &reactor->timers[slot];
+        if (timer->deadline_ms > now) {
+            break;
+        }
+
+        metrics_histogram_observe(&timer_lag, now - timer->deadline_ms);
+
+        ReactorTimerHandler handler = timer->handler;
+        void *userdata = timer->userdata;
+
+        if (timer->interval_ms > 0) {
+            // Skip missed periods instead of firing them back to back
+            timer->deadline_ms += timer->interval_ms;
+            if (timer->deadline_ms <= now) {
+                timer->deadline_ms = now + timer->interval_ms;
+            }
+            heap_fix(reactor, timer->heap_index);
+        } else {
+            release_timer(reactor, slot);
+        }
+
+        uint64_t start = timesource_real_us();
+        handler(userdata);
+        metrics_histogram_observe(&handler_duration, timesource_real_us() - start);
+        METRICS_INC(&timers_fired);
+    }
+}
+
+// ============================================================================
+// LIFECYCLE
+// ============================================================================
+
+int reactor_init(Reactor *reactor) {
+    if (!reactor) {
+        return ERROR_INVALID_PARAM;
+    }
+
+    memset(reactor, 0, sizeof(Reactor));
+
+    for (int i = 0; i < REACTOR_MAX_FDS; i++) {
+        reactor->fds[i].fd = -1;
+    }
+    for (int i = 0; i < REACTOR_MAX_TIMERS; i++) {
+        reactor->timers[i].heap_index = -1;
+    }
+
+    reactor->epoll_fd = epoll_create1(EPOLL_CLOEXEC);
+    if (reactor->epoll_fd < 0) {
+        LOG_ERROR("Reactor: epoll_create1 failed: %s", strerror(errno));
+        return ERROR_GENERIC;
+    }
+
+    metrics_register_all(reactor_metrics, sizeof(reactor_metrics) / sizeof(reactor_metrics[0]));
+
+    return SUCCESS;
+}
+
+void reactor_cleanup(Reactor *reactor) {
+    if (!reactor || reactor->epoll_fd < 0) {
+        return;
+    }
+
+    close(reactor->epoll_fd);
+    reactor->epoll_fd = -1;
+    reactor->heap_size = 0;
+}
+
+int reactor_run(Reactor *reactor) {
+    if (!reactor || reactor->epoll_fd < 0) {
+        return ERROR_GENERIC;
+    }
+
+    reactor->running = 1;
+    LOG_INFO("Event loop started");
+
+    int exit_code = SUCCESS;
+    while (reactor->running) {
+        int result = reactor_run_once(reactor, -1);
+        if (result < 0) {
+            exit_code = result;
+            break;
+        }
+    }
+
+    LOG_INFO("Event loop stopped");
+    return exit_code;
+}
+
+int reactor_run_once(Reactor *reactor, int max_wait_ms) {
+    if (!reactor || reactor->epoll_fd < 0) {
+        return ERROR_GENERIC;
+    }
+
+    // Sleep until the earliest timer unless an fd becomes ready first
+    int timeout = max_wait_ms;
+    if (reactor->heap_size > 0) {
+        uint64_t now = reactor_now_ms();
+        uint64_t deadline = reactor->timers[reactor->heap[0]].deadline_ms;
+        uint64_t until = (deadline > now) ? deadline - now : 0;
+        if (timeout < 0 || until < (uint64_t)timeout) {
+            timeout = (int)until;
+        }
+    }
+
+    // A virtual clock only waits for I/O a handler said is under way
+    int wait = timeout;
+    if (timesource_is_virtual() && timeout > 0) {
+        wait = timesource_take_expected_io()
+               ? (timeout < VIRTUAL_CLOCK_IDLE_MS ? timeout : VIRTUAL_CLOCK_IDLE_MS) : 0;
+    }
+
+    struct epoll_event events[REACTOR_MAX_EVENTS];
+    int count = epoll_wait(reactor->epoll_fd, events, REACTOR_MAX_EVENTS, wait);
+    if (count < 0) {
+        if (errno == EINTR) {
+            return 0;
+        }
+        LOG_ERROR("Reactor: epoll_wait failed: %s", strerror(errno));
+        return ERROR_GENERIC;
+    }
+
+    if (count == 0 && timeout > 0 && timesource_is_virtual()) {
+        timesource_advance_to_ms(reactor_now_ms() + (uint64_t)timeout);
+        METRICS_INC(&clock_jumps);
+    }
+
+    METRICS_INC(&loop_iterations);
+
+    for (int i = 0; i < count; i++) {
+        int slot = (int)(events[i].data.u64 & 0xFFFFFFFFu);
+        uint32_t generation = (uint32_t)(events[i].data.u64 >> 32);
+        ReactorFd *entry = &reactor->fds[slot];
+
+        // Removed (or removed and reused) by an earlier handler of this batch
+        if (entry->fd < 0 || entry->generation != generation) {
+            continue;
+        }
+
+        uint64_t start = timesource_real_us();
+        entry->handler(entry->fd, from_epoll_events(events[i].events), entry->userdata);
+        metrics_histogram_observe(&handler_duration, timesource_real_us() - start);
+    }
+    metrics_counter_add(&fd_events, (uint64_t)count);
+
+    run_due_timers(reactor);
+
+    return count;
+}
+
+void reactor_stop(Reactor *reactor) {
+    if (reactor) {
+        reactor->running = 0;
+    }
+}
+
+uint64_t reactor_now_ms(void) {
+    return timesource_now_ms();
+}
+
+// ============================================================================
+// FD REGISTRATION
+// ============================================================================
+
+int reactor_add_fd(Reactor *reactor, int fd, uint32_t events,
+                   ReactorFdHandler handler, void *userdata) {
+    if (!reactor || fd < 0 || !handler) {
+        return ERROR_INVALID_PARAM;
+    }
+
+    if (find_fd_slot(reactor, fd) >= 0) {
+        LOG_ERROR("Reactor: fd %d is already registered", fd);
+        return ERROR_INVALID_PARAM;
+    }
+
+    int slot = find_fd_slot(reactor, -1);
+    if (slot < 0) {
+        LOG_ERROR_RATELIMITED("Reactor: fd table full (%d entries)", REACTOR_MAX_FDS);
+        return ERROR_CAPACITY_EXCEEDED;
+    }
+
+    ReactorFd *entry = &reactor->fds[slot];
+    entry->generation++;
+
+    struct epoll_event event = {0};
+    event.events = to_epoll_events(events) | EPOLLRDHUP;
+    event.data.u64 = ((uint64_t)entry->generation << 32) | (uint32_t)slot;
+
+    if (epoll_ctl(reactor->epoll_fd, EPOLL_CTL_ADD, fd, &event) != 0) {
+        LOG_ERROR("Reactor: cannot watch fd %d: %s", fd, strerror(errno));
+        return ERROR_GENERIC;
+    }
+
+    entry->fd = fd;
+    entry->handler = handler;
+    entry->userdata = userdata;
+
+    return SUCCESS;
+}
+
+int reactor_modify_fd(Reactor *reactor, int fd, uint32_t events) {
+    if (!reactor || fd < 0) {
+        return ERROR_INVALID_PARAM;
+    }
+
+    int slot = find_fd_slot(reactor, fd);
+    if (slot < 0) {
+        return ERROR_INVALID_PARAM;
+    }
+
+    struct epoll_event event = {0};
+    event.events = to_epoll_events(events) | EPOLLRDHUP;
+    event.data.u64 = ((uint64_t)reactor->fds[slot].generation << 32) | (uint32_t)slot;
+
+    if (epoll_ctl(reactor->epoll_fd, EPOLL_CTL_MOD, fd, &event) != 0) {
+        LOG_ERROR("Reactor: cannot modify fd %d: %s", fd, strerror(errno));
+        return ERROR_GENERIC;
+    }
+
+    return SUCCESS;
+}
+
+int reactor_remove_fd(Reactor *reactor, int fd) {
+    if (!reactor || fd < 0) {
+        return ERROR_INVALID_PARAM;
+    }
+
+    int slot = find_fd_slot(reactor, fd);
+    if (slot < 0) {
+        return ERROR_INVALID_PARAM;
+    }
+
+    epoll_ctl(reactor->epoll_fd, EPOLL_CTL_DEL, fd, NULL);
+
+    ReactorFd *entry = &reactor->fds[slot];
+    entry->fd = -1;
+    entry->handler = NULL;
+    entry->userdata = NULL;
+    entry->generation++;
+
+    return SUCCESS;
+}
+
+// ============================================================================
+// TIMERS
+// ============================================================================
+
+int reactor_add_timer(Reactor *reactor, uint64_t delay_ms, uint64_t interval_ms,
+                      ReactorTimerHandler handler, void *userdata) {
+    if (!reactor || !handler) {
+        return ERROR_INVALID_PARAM;
+    }
+
+    int slot = -1;
+    for (int i = 0; i < REACTOR_MAX_TIMERS; i++) {
+        if (reactor->timers[i].heap_index < 0) {
+            slot = i;
+            break;
+        }
+    }
+
+    if (slot < 0) {
+        LOG_ERROR_RATELIMITED("Reactor: timer table full (%d entries)", REACTOR_MAX_TIMERS);
+        return ERROR_CAPACITY_EXCEEDED;
+    }
+
+    ReactorTimer *timer = &reactor->timers[slot];
+    timer->deadline_ms = reactor_now_ms() + delay_ms;
+    timer->interval_ms = interval_ms;
+    timer->handler = handler;
+    timer->userdata = userdata;
+
+    timer->heap_index = reactor->heap_size;
+    reactor->heap[reactor->heap_size++] = slot;
+    heap_fix(reactor, timer->heap_index);
+
+    // Id encodes slot and generation so stale ids never cancel a reused slot
+    return (int)((timer->generation & 0xFFFFFu) * REACTOR_MAX_TIMERS) + slot + 1;
+}
+
+int reactor_cancel_timer(Reactor *reactor, int timer_id) {
+    if (!reactor || timer_id <= 0) {
+        return ERROR_INVALID_PARAM;
+    }
+
+    int slot = (timer_id - 1) % REACTOR_MAX_TIMERS;
+    uint32_t generation = (uint32_t)((timer_id - 1) / REACTOR_MAX_TIMERS);
+    ReactorTimer *timer = &reactor->timers[slot];
+
+    if (timer->heap_index < 0 || (timer->generation & 0xFFFFFu) != generation) {
+        return ERROR_INVALID_PARAM;
+    }
+
+    release_timer(reactor, slot);
+    return SUCCESS;
+}
@@ -0,0 +1,198 @@
+/**
+ * @file reactor.h
+ * @brief Single-threaded event loop for sockets, timers and event fds
+ *
+ * This module is the core of the daemon: one thread waits in epoll_wait()
+ * and dispatches every event source - the L2CAP server and client sockets,
+ * the GPIO event fd, the signal fd and the notifier's HTTP sockets - to the
+ * handler its owner registered. Periodic work such as the heartbeat sweep
+ * and HTTP timeouts runs from the timer heap of the same loop.
+ *
+ * Features:
+ * - epoll-based fd readiness dispatch
+ * - One-shot and periodic timers on a binary min-heap
+ * - Safe removal of any fd or timer from inside a handler
+ * - Loop, handler and timer lag metrics
+ *
+ * Threading:
+ * All functions must be called from the reactor thread, except
+ * reactor_init() and reactor_cleanup() which run before and after the loop.
+ */
+
+#ifndef REACTOR_H
+#define REACTOR_H
+
+#include <stdint.h>
+
+#include "config.h"
+
+// ============================================================================
+// DATA STRUCTURES
+// ============================================================================
+
+/// Fd is readable
+#define REACTOR_READ 0x01
+/// Fd is writable
+#define REACTOR_WRITE 0x02
+/// Error or hangup on the fd (always reported, never requested)
+#define REACTOR_ERROR 0x04
+
+/**
+ * @brief Fd event handler
+ * @param fd File descriptor with pending events
+ * @param events REACTOR_* flags that are ready
+ * @param userdata Pointer given at registration
+ */
+typedef void (*ReactorFdHandler)(int fd, uint32_t events, void *userdata);
+
+/**
+ * @brief Timer handler
+ * @param userdata Pointer given at registration
+ */
+typedef void (*ReactorTimerHandler)(void *userdata);
+
+/**
+ * @brief Registered fd
+ */
+typedef struct {
+    int fd;                             /// Watched fd, -1 if the slot is free
+    uint32_t generation;                /// Incremented on reuse to drop stale events
+    ReactorFdHandler handler;           /// Event handler
+    void *userdata;                     /// Handler argument
+} ReactorFd;
+
+/**
+ * @brief Registered timer
+ */
+typedef struct {
+    uint64_t deadline_ms;               /// Monotonic expiry time
+    uint64_t interval_ms;               /// Period, 0 for one-shot timers
+    ReactorTimerHandler handler;        /// Expiry handler
+    void *userdata;                     /// Handler argument
+    uint32_t generation;                /// Incremented on reuse to reject stale ids
+    int heap_index;                     /// Position in the heap, -1 if the slot is free
+} ReactorTimer;
+
+/**
+ * @brief Reactor state
+ */
+typedef struct {
+    int epoll_fd;                       /// epoll instance
+    int running;                        /// Loop runs while non-zero
+    ReactorFd fds[REACTOR_MAX_FDS];     /// Fd registrations
+    ReactorTimer timers[REACTOR_MAX_TIMERS]; /// Timer slots
+    int heap[REACTOR_MAX_TIMERS];       /// Timer slot indices ordered by deadline
+    int heap_size;                      /// Active timers
+} Reactor;
+
+// ============================================================================
+// LIFECYCLE
+// ============================================================================
+
+/**
+ * @brief Initialize a reactor
+ * @param reactor Pointer to reactor to initialize
+ * @return 0 on success, negative on error
+ */
+int reactor_init(Reactor *reactor);
+
+/**
+ * @brief Release reactor resources
+ * @param reactor Pointer to reactor
+ *
+ * Registered fds are not closed; their owners close them.
+ */
+void reactor_cleanup(Reactor *reactor);
+
+/**
+ * @brief Run the loop until reactor_stop() is called
+ * @param reactor Pointer to reactor
+ * @return 0 on normal termination, negative on error
+ */
+int reactor_run(Reactor *reactor);
+
+/**
+ * @brief Wait for and dispatch one batch of events and due timers
+ * @param reactor Pointer to reactor
+ * @param max_wait_ms Upper bound on the wait, -1 to wait for the next timer
+ * @return Number of fd events dispatched, negative on error
+ */
+int reactor_run_once(Reactor *reactor, int max_wait_ms);
+
+/**
+ * @brief Ask the loop to return after the current iteration
+ * @param reactor Pointer to reactor
+ */
+void reactor_stop(Reactor *reactor);
+
+/**
+ * @brief Read the monotonic clock used for timers (see timesource.h)
+ * @return Milliseconds since an arbitrary epoch
+ */
+uint64_t reactor_now_ms(void);
+
+// ============================================================================
+// FD REGISTRATION
+// ============================================================================
+
+/**
+ * @brief Watch an fd
+ * @param reactor Pointer to reactor
+ * @param fd File descriptor (must not be registered yet)
+ * @param events REACTOR_READ and/or REACTOR_WRITE
+ * @param handler Handler called when the fd is ready
+ * @param userdata Handler argument
+ * @return 0 on success, ERROR_CAPACITY_EXCEEDED if REACTOR_MAX_FDS is reached,
+ *         other negative values on error
+ */
+int reactor_add_fd(Reactor *reactor, int fd, uint32_t events,
+                   ReactorFdHandler handler, void *userdata);
+
+/**
+ * @brief Change the events watched on a registered fd
+ * @param reactor Pointer to reactor
+ * @param fd Registered file descriptor
+ * @param events New REACTOR_READ/REACTOR_WRITE mask
+ * @return 0 on success, negative on error
+ */
+int reactor_modify_fd(Reactor *reactor, int fd, uint32_t events);
+
+/**
+ * @brief Stop watching an fd
+ * @param reactor Pointer to reactor
+ * @param fd Registered file descriptor
+ * @return 0 on success, negative if the fd was not registered
+ *
+ * Must be called before the fd is closed. Events already fetched for the
+ * fd in the current iteration are discarded.
+ */
+int reactor_remove_fd(Reactor *reactor, int fd);
+
+// ============================================================================
+// TIMERS
+// ============================================================================
+
+/**
+ * @brief Schedule a timer
+ * @param reactor Pointer to reactor
+ * @param delay_ms Delay before the first expiry
+ * @param interval_ms Period for repeating timers, 0 for one-shot
+ * @param handler Expiry handler
+ * @param userdata Handler argument
+ * @return Timer id (> 0) on success, negative on error
+ *
+ * A one-shot timer is released before its handler runs, so the handler
+ * may schedule a new timer.
+ */
+int reactor_add_timer(Reactor *reactor, uint64_t delay_ms, uint64_t interval_ms,
+                      ReactorTimerHandler handler, void *userdata);
+
+/**
+ * @brief Cancel a timer
+ * @param reactor Pointer to reactor
+ * @param timer_id Id returned by reactor_add_timer()
+ * @return 0 on success, negative if the timer already expired or is unknown
+ */
+int reactor_cancel_timer(Reactor *reactor, int timer_id);
+
+#endif // REACTOR_H
@@ -0,0 +1,297 @@
+/**
+ * @file realtime.c
+ * @brief Implementation of the real-time options and the latency probe
+ *
+ * The latency probe is a periodic timerfd armed on absolute deadlines.
+ * When the reactor reads it, the distance between now and the first
+ * expiration it has not seen yet is how late the thread got to run:
+ * scheduler delay plus whatever the loop was busy with.
+ */
+
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include <time.h>
+#include <sched.h>
+#include <malloc.h>
+#include <pthread.h>
+#include <sys/mman.h>
+#include <sys/timerfd.h>
+
+#include "realtime.h"
+#include "runtime_config.h"
+#include "logger.h"
+#include "metrics.h"
+#include "timesource.h"
+
+// ============================================================================
+// STATIC VARIABLES
+// ============================================================================
+
+static Metric sched_latency = METRIC_HISTOGRAM_INIT("sched_latency_us",
+    "Reactor wake-up latency for the periodic probe timer in microseconds");
+static Metric sched_latency_max = METRIC_GAUGE_INIT("sched_latency_max_us",
+    "Worst reactor wake-up latency since start in microseconds");
+static Metric memory_locked = METRIC_GAUGE_INIT("realtime_memory_locked",
+    "1 if the daemon's memory is locked with mlockall()");
+
+static Metric *const realtime_metrics[] = {
+    &sched_latency, &sched_latency_max, &memory_locked
+};
+
+// ============================================================================
+// INTERNAL HELPER FUNCTIONS
+// ============================================================================
+
+/**
+ * @brief Parse a CPU list such as "0", "2-3" or "0,2-3"
+ * @return 0 on success, -1 if the list is malformed or empty
+ */
+static int parse_cpu_list(const char *text, cpu_set_t *set) {
+    const char *cursor = text;
+
+    CPU_ZERO(set);
+    while (*cursor) {
+        char *end;
+        long first = strtol(cursor, &end, 10);
+        if (end == cursor || first < 0 || first >= CPU_SETSIZE) {
+            return -1;
+        }
+
+        long last = first;
+        cursor = end;
+        if (*cursor == '-') {
+            cursor++;
+            last = strtol(cursor, &end, 10);
+            if (end == cursor || last < first || last >= CPU_SETSIZE) {
+                return -1;
+            }
+            cursor = end;
+        }
+
+        for (long cpu = first; cpu <= last; cpu++) {
+            CPU_SET((int)cpu, set);
+        }
+
+        if (*cursor == ',') {
+            cursor++;
+        } else if (*cursor != '\0') {
+            return -1;
+        }
+    }
+
+    return CPU_COUNT(set) > 0 ? 0 : -1;
+}
+
+/**
+ * @brief Pin the calling thread and give it a SCHED_FIFO priority
+ * @param thread Thread name for log messages
+ * @param priority SCHED_FIFO priority, 0 to keep the current policy
+ * @param cpus CPU list, empty to keep the current affinity
+ * @return Priority actually applied, 0 if none
+ */
+static int apply_thread_settings(const char *thread, int priority, const char *cpus) {
+    if (cpus[0] != '\0') {
+        cpu_set_t set;
+        if (parse_cpu_list(cpus, &set) != 0) {
+            LOG_WARN("Realtime: invalid CPU list \"%s\" for the %s thread", cpus, thread);
+        } else {
+            int error = pthread_setaffinity_np(pthread_self(), sizeof(set), &set);
+            if (error != 0) {
+                LOG_WARN("Realtime: cannot pin the %s thread to CPUs %s: %s",
+                         thread, cpus, strerror(error));
+            } else {
+                LOG_INFO("Realtime: %s thread pinned to CPUs %s", thread, cpus);
+            }
+        }
+    }
+
+    if (priority > 0) {
+        struct sched_param param = { .sched_priority = priority };
+        int error = pthread_setschedparam(pthread_self(), SCHED_FIFO, &param);
+        if (error != 0) {
+            LOG_WARN("Realtime: cannot give the %s thread SCHED_FIFO priority %d: %s",
+                     thread, priority, strerror(error));
+            return 0;
+        }
+        LOG_INFO("Realtime: %s thread runs SCHED_FIFO priority %d", thread, priority);
+    }
+
+    return priority;
+}
+
+/**
+ * @brief Touch the stack the reactor thread may grow into
+ */
+static void __attribute__((noinline)) prefault_stack(void) {
+    volatile unsigned char buffer[RT_PREFAULT_STACK_KB * 1024];
+    long page = sysconf(_SC_PAGESIZE);
+
+    for (size_t offset = 0; offset < sizeof(buffer); offset += (size_t)page) {
+        buffer[offset] = 0;
+    }
+}
+
+/**
+ * @brief Fault in a heap reserve and keep it in the allocator
+ */
+static void prefault_heap(size_t bytes) {
+    long page = sysconf(_SC_PAGESIZE);
+
+    if (bytes == 0) {
+        return;
+    }
+
+    // Freed memory stays in the heap instead of going back to the kernel,
+    // so later allocations reuse these resident pages
+    mallopt(M_TRIM_THRESHOLD, -1);
+    mallopt(M_MMAP_MAX, 0);
+
+    unsigned char *reserve = malloc(bytes);
+    if (!reserve) {
+        LOG_WARN("Realtime: cannot allocate the %zu KiB heap reserve", bytes / 1024);
+        return;
+    }
+    for (size_t offset = 0; offset < bytes; offset += (size_t)page) {
+        ((volatile unsigned char*)reserve)[offset] = 0;
+    }
+    free(reserve);
+}
+
+/**
+ * @brief Lock the process memory and pre-fault the reserves
+ * @return 1 if memory is locked, 0 otherwise
+ */
+static int lock_memory(size_t heap_bytes) {
+    int flags = MCL_CURRENT | MCL_FUTURE;
+#ifdef MCL_ONFAULT
+    // Lock pages as they are touched rather than pinning every mapping up
+    // front, so untouched thread stacks and library pages cost nothing
+    flags |= MCL_ONFAULT;
+#endif
+
+    if (mlockall(flags) != 0) {
+        LOG_WARN("Realtime: mlockall failed: %s", strerror(errno));
+        return 0;
+    }
+
+    prefault_stack();
+    prefault_heap(heap_bytes);
+
+    LOG_INFO("Realtime: memory locked, %d KiB stack and %zu KiB heap pre-faulted",
+             RT_PREFAULT_STACK_KB, heap_bytes / 1024);
+    return 1;
+}
+
+// ============================================================================
+// LATENCY PROBE
+// ============================================================================
+
+/**
+ * @brief Reactor handler for the probe timerfd
+ */
+static void probe_event(int fd, uint32_t events, void *userdata) {
+    Realtime *realtime = (Realtime*)userdata;
+    uint64_t expirations = 0;
+    (void)events;
+
+    if (read(fd, &expirations, sizeof(expirations)) != sizeof(expirations) || expirations == 0) {
+        return;
+    }
+
+    // Measure against the first expiration not seen yet, so a long stall
+    // counts in full even though the timer kept expiring meanwhile
+    uint64_t now = timesource_real_us();
+    uint64_t due = realtime->probe_deadline_us + realtime->probe_interval_us;
+    realtime->probe_deadline_us += expirations * realtime->probe_interval_us;
+
+    uint64_t latency = now > due ? now - due : 0;
+    metrics_histogram_observe(&sched_latency, latency);
+    if (latency > realtime->latency_max_us) {
+        realtime->latency_max_us = latency;
+        metrics_gauge_set(&sched_latency_max, (int64_t)latency);
+    }
+}
+
+/**
+ * @brief Arm the probe timerfd and watch it from the reactor
+ * @return 0 on success, negative on error
+ */
+static int start_probe(Realtime *realtime) {
+    if (RT_LATENCY_PROBE_MS <= 0) {
+        return SUCCESS;
+    }
+
+    realtime->probe_fd = timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK | TFD_CLOEXEC);
+    if (realtime->probe_fd < 0) {
+        LOG_ERROR("Realtime: timerfd_create failed: %s", strerror(errno));
+        return ERROR_GENERIC;
+    }
+
+    realtime->probe_interval_us = (uint64_t)RT_LATENCY_PROBE_MS * 1000ULL;
+    realtime->probe_deadline_us = timesource_real_us();
+
+    uint64_t first = realtime->probe_deadline_us + realtime->probe_interval_us;
+    struct itimerspec spec = {
+        .it_interval = { .tv_sec = RT_LATENCY_PROBE_MS / 1000,
+                         .tv_nsec = (RT_LATENCY_PROBE_MS % 1000) * 1000000L },
+        .it_value = { .tv_sec = (time_t)(first / 1000000ULL),
+                      .tv_nsec = (long)(first % 1000000ULL) * 1000L }
+    };
+
+    if (timerfd_settime(realtime->probe_fd, TFD_TIMER_ABSTIME, &spec, NULL) != 0 ||
+        reactor_add_fd(realtime->reactor, realtime->probe_fd, REACTOR_READ,
+                       probe_event, realtime) != SUCCESS) {
+        LOG_ERROR("Realtime: cannot start the latency probe");
+        close(realtime->probe_fd);
+        realtime->probe_fd = -1;
+        return ERROR_GENERIC;
+    }
+
+    return SUCCESS;
+}
+
+// ============================================================================
+// PUBLIC API
+// ============================================================================
+
+int realtime_init(Realtime *realtime, Reactor *reactor) {
+    if (!realtime || !reactor) {
+        return ERROR_INVALID_PARAM;
+    }
+
+    memset(realtime, 0, sizeof(Realtime));
+    realtime->reactor = reactor;
+    realtime->probe_fd = -1;
+
+    metrics_register_all(realtime_metrics, sizeof(realtime_metrics) / sizeof(realtime_metrics[0]));
+
+    const RuntimeConfig *config = runtime_config_get();
+    if (config->lock_memory) {
+        realtime->memory_locked = lock_memory((size_t)config->prefault_heap_kb * 1024);
+        metrics_gauge_set(&memory_locked, realtime->memory_locked);
+    }
+
+    realtime->priority = apply_thread_settings("reactor", config->rt_priority,
+                                               config->cpu_affinity);
+
+    return start_probe(realtime);
+}
+
+void realtime_cleanup(Realtime *realtime) {
+    if (!realtime || realtime->probe_fd < 0) {
+        return;
+    }
+
+    reactor_remove_fd(realtime->reactor, realtime->probe_fd);
+    close(realtime->probe_fd);
+    realtime->probe_fd = -1;
+}
+
+void realtime_isr_thread_setup(void) {
+    const RuntimeConfig *config = runtime_config_get();
+    apply_thread_settings("door interrupt", config->rt_isr_priority, config->isr_cpu_affinity);
+}
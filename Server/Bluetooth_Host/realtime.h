@@ -0,0 +1,85 @@
+/**
+ * @file realtime.h
+ * @brief Real-time scheduling, CPU pinning, memory locking and latency probe
+ *
+ * The daemon shares a small board with other services. These options keep
+ * the door and presence pipeline responsive when the rest of the system
+ * is busy:
+ * - rt_priority / rt_isr_priority: SCHED_FIFO priority of the reactor
+ *   thread and of the wiringPi interrupt thread (0 leaves SCHED_OTHER)
+ * - cpu_affinity / isr_cpu_affinity: CPU lists such as "0" or "1-2,3"
+ * - lock_memory: mlockall() so pages the daemon has touched are never
+ *   evicted, then pre-fault the reactor stack and a heap reserve so the
+ *   first reminder or burst of connections does not page-fault either
+ *
+ * All options are restart-only and off by default. A failed option (for
+ * example without CAP_SYS_NICE or CAP_IPC_LOCK) is logged and skipped.
+ *
+ * wiringPi creates its interrupt thread internally, so the interrupt
+ * thread settings are applied by that thread itself on the first edge
+ * (see setDoorIsrThreadHook()).
+ *
+ * Whatever the options, a latency probe measures how late the reactor
+ * thread wakes up for a periodic timerfd and exports the result as the
+ * sched_latency_us histogram and the sched_latency_max_us gauge.
+ *
+ * Threading:
+ * realtime_init() and realtime_cleanup() must be called from the reactor
+ * thread; realtime_isr_thread_setup() runs on the interrupt thread.
+ */
+
+#ifndef REALTIME_H
+#define REALTIME_H
+
+#include <stdint.h>
+
+#include "config.h"
+#include "reactor.h"
+
+// ============================================================================
+// DATA STRUCTURES
+// ============================================================================
+
+/**
+ * @brief Real-time settings state and latency probe
+ */
+typedef struct {
+    Reactor *reactor;                   /// Loop running the probe
+    int probe_fd;                       /// Probe timerfd, -1 if none
+    uint64_t probe_interval_us;         /// Probe period
+    uint64_t probe_deadline_us;         /// Monotonic time of the last expiration
+    uint64_t latency_max_us;            /// Worst wake-up latency seen
+    int memory_locked;                  /// mlockall() succeeded
+    int priority;                       /// Applied SCHED_FIFO priority, 0 if none
+} Realtime;
+
+// ============================================================================
+// LIFECYCLE
+// ============================================================================
+
+/**
+ * @brief Apply the configured options to the calling thread and the process
+ * @param realtime Pointer to state to initialize
+ * @param reactor Event loop whose thread is the calling thread
+ * @return 0 on success (options that could not be applied are logged),
+ *         negative if the latency probe could not be started
+ *
+ * Threads created afterwards inherit the reactor's policy and affinity
+ * unless they ask for something else.
+ */
+int realtime_init(Realtime *realtime, Reactor *reactor);
+
+/**
+ * @brief Stop the latency probe
+ * @param realtime Pointer to state
+ */
+void realtime_cleanup(Realtime *realtime);
+
+/**
+ * @brief Apply the interrupt thread options to the calling thread
+ *
+ * Registered with setDoorIsrThreadHook() before the driver is initialized.
+ */
+void realtime_isr_thread_setup(void);
+
+#endif // REALTIME_H
@@ -0,0 +1,216 @@
+/**
+ * @file reminder.c
+ * @brief Implementation of the door-close reminder policy
+ *
+ * The policy is a small state machine re-evaluated on every input: room
+ * occupancy changes, door state changes, send results and retry timer
+ * expiries.
+ */
+
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <string.h>
+
+#include "reminder.h"
+#include "runtime_config.h"
+#include "logger.h"
+#include "metrics.h"
+#include "trace.h"
+#include "alloc_stats.h"
+
+// ============================================================================
+// STATIC VARIABLES
+// ============================================================================
+
+static Metric reminder_attempts = METRIC_COUNTER_INIT("reminder_attempts_total",
+    "Door-close reminder send attempts");
+static Metric reminder_delivered = METRIC_COUNTER_INIT("reminder_delivered_total",
+    "Door-close reminders accepted by FCM");
+static Metric reminder_abandoned = METRIC_COUNTER_INIT("reminder_abandoned_total",
+    "Empty-room episodes whose reminder failed on every attempt");
+
+static Metric *const reminder_metrics[] = {
+    &reminder_attempts, &reminder_delivered, &reminder_abandoned
+};
+
+// ============================================================================
+// INTERNAL HELPER FUNCTIONS
+// ============================================================================
+
+static void evaluate(ReminderPolicy *policy);
+
+/**
+ * @brief Cancel the pending retry timer, if any
+ */
+static void cancel_retry(ReminderPolicy *policy) {
+    if (policy->retry_timer > 0) {
+        reactor_cancel_timer(policy->reactor, policy->retry_timer);
+        policy->retry_timer = 0;
+    }
+}
+
+/**
+ * @brief Retry timer handler
+ */
+static void retry_expired(void *userdata) {
+    ReminderPolicy *policy = (ReminderPolicy*)userdata;
+
+    policy->retry_timer = 0;
+    evaluate(policy);
+}
+
+/**
+ * @brief Schedule another attempt or give up on the episode
+ */
+static void schedule_retry(ReminderPolicy *policy) {
+    const RuntimeConfig *config = runtime_config_get();
+    
+    if (policy->attempts >= config->reminder_max_attempts) {
+        LOG_ERROR("Door close reminder failed %d times - giving up", policy->attempts);
+        METRICS_INC(&reminder_abandoned);
+        policy->episode_done = 1;
+        return;
+    }
+
+    int id = reactor_add_timer(policy->reactor, config->reminder_retry_delay * 1000ULL, 0,
+                               retry_expired, policy);
+    if (id < 0) {
+        LOG_ERROR("Unable to schedule reminder retry (error: %d)", id);
+        policy->episode_done = 1;
+        return;
+    }
+
+    policy->retry_timer = id;
+    LOG_INFO("Retrying door close reminder in %ds", config->reminder_retry_delay);
+}
+
+/**
+ * @brief Notifier completion callback
+ */
+static void send_completed(int result, void *userdata) {
+    ReminderPolicy *policy = (ReminderPolicy*)userdata;
+
+    policy->in_flight = 0;
+    log_notification_event(result == 0, result, policy->token);
+
+    if (result == 0) {
+        METRICS_INC(&reminder_delivered);
+        policy->episode_done = 1;
+        return;
+    }
+
+    // Someone came back while the request was in flight
+    if (!policy->room_empty) {
+        return;
+    }
+
+    schedule_retry(policy);
+}
+
+/**
+ * @brief Send a reminder if all conditions are met
+ */
+static void evaluate(ReminderPolicy *policy) {
+    ALLOC_SCOPE(ALLOC_SUBSYSTEM_REMINDER);
+    
+    if (!policy->room_empty || policy->episode_done ||
+        policy->in_flight || policy->retry_timer > 0) {
+        return;
+    }
+
+    // Check if we have a valid FCM token
+    if (policy->token[0] == '\0') {
+        LOG_WARN_RATELIMITED("No FCM token available for notification");
+        return;
+    }
+
+    // Check door state - only send if unlocked
+    if (policy->door_state != UNLOCKED) {
+        if (policy->door_state == LOCKED) {
+            LOG_INFO_RATELIMITED("Door already locked - no reminder needed");
+        } else {
+            LOG_WARN_RATELIMITED("Door state unknown - skipping notification");
+        }
+        return;
+    }
+
+    // All conditions met - send notification
+    LOG_INFO("Sending door close reminder - all devices gone, door unlocked");
+    trace_instant("reminder", "send");
+    policy->attempts++;
+    METRICS_INC(&reminder_attempts);
+
+    int result = notifier_send_door_reminder(policy->notifier, policy->token,
+                                             send_completed, policy);
+    if (result != SUCCESS) {
+        log_notification_event(0, result, policy->token);
+        schedule_retry(policy);
+        return;
+    }
+
+    policy->in_flight = 1;
+}
+
+// ============================================================================
+// PUBLIC FUNCTIONS
+// ============================================================================
+
+int reminder_policy_init(ReminderPolicy *policy, Reactor *reactor, Notifier *notifier,
+                         DoorState door_state) {
+    if (!policy || !reactor || !notifier) {
+        return ERROR_INVALID_PARAM;
+    }
+
+    memset(policy, 0, sizeof(ReminderPolicy));
+    policy->reactor = reactor;
+    policy->notifier = notifier;
+    policy->door_state = door_state;
+
+    metrics_register_all(reminder_metrics, sizeof(reminder_metrics) / sizeof(reminder_metrics[0]));
+
+    return SUCCESS;
+}
+
+void reminder_policy_cleanup(ReminderPolicy *policy) {
+    if (policy) {
+        cancel_retry(policy);
+    }
+}
+
+void reminder_policy_room_empty(ReminderPolicy *policy, const char *token) {
+    if (!policy) {
+        return;
+    }
+
+    policy->room_empty = 1;
+    policy->episode_done = 0;
+    policy->attempts = 0;
+    cancel_retry(policy);
+    snprintf(policy->token, sizeof(policy->token), "%s", token ? token : "");
+
+    evaluate(policy);
+}
+
+void reminder_policy_room_occupied(ReminderPolicy *policy) {
+    if (!policy) {
+        return;
+    }
+
+    policy->room_empty = 0;
+    cancel_retry(policy);
+}
+
+void reminder_policy_door_changed(ReminderPolicy *policy, DoorState state) {
+    if (!policy || policy->door_state == state) {
+        return;
+    }
+
+    policy->door_state = state;
+
+    // Locking the door resolves the episode's pending retries
+    if (state == LOCKED) {
+        cancel_retry(policy);
+    }
+
+    evaluate(policy);
+}
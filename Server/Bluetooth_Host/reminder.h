@@ -0,0 +1,97 @@
+/**
+ * @file reminder.h
+ * @brief Door-close reminder policy
+ *
+ * This module decides when a door-close reminder is sent. It combines the
+ * room occupancy reported by the device manager with the door state from
+ * the GPIO driver and hands reminders to the notifier.
+ *
+ * A reminder is sent when:
+ * 1. All BLE devices have disconnected (no one present)
+ * 2. The door sensor indicates UNLOCKED state
+ * 3. A valid FCM token is available from the last disconnected device
+ *
+ * At most one reminder is delivered per empty-room episode. Failed sends
+ * are retried after reminder_retry_delay seconds, up to
+ * reminder_max_attempts times (see runtime_config.h). If the door is unlocked later while the
+ * room is still empty, the reminder is sent at that point.
+ *
+ * Threading:
+ * All functions must be called from the reactor thread.
+ */
+
+#ifndef REMINDER_H
+#define REMINDER_H
+
+#include "config.h"
+#include "reactor.h"
+#include "notifier.h"
+#include "DoorStateDriver.h"
+
+// ============================================================================
+// DATA STRUCTURES
+// ============================================================================
+
+/**
+ * @brief Reminder policy state
+ */
+typedef struct {
+    Reactor *reactor;                   /// Loop used for retry timers
+    Notifier *notifier;                 /// Sender of the reminders
+    DoorState door_state;               /// Last known door state
+    int room_empty;                     /// All devices have left
+    int episode_done;                   /// Reminder delivered or abandoned for this episode
+    int in_flight;                      /// A reminder is being sent
+    int attempts;                       /// Send attempts in this episode
+    int retry_timer;                    /// Pending retry timer, 0 if none
+    char token[TOKEN_SIZE];             /// FCM token of the last device that left
+} ReminderPolicy;
+
+// ============================================================================
+// LIFECYCLE
+// ============================================================================
+
+/**
+ * @brief Initialize the reminder policy
+ * @param policy Pointer to policy to initialize
+ * @param reactor Loop used for retry timers
+ * @param notifier Notifier used to send reminders
+ * @param door_state Door state at startup
+ * @return 0 on success, negative on error
+ */
+int reminder_policy_init(ReminderPolicy *policy, Reactor *reactor, Notifier *notifier,
+                         DoorState door_state);
+
+/**
+ * @brief Cancel a pending retry
+ * @param policy Pointer to policy
+ */
+void reminder_policy_cleanup(ReminderPolicy *policy);
+
+// ============================================================================
+// INPUTS
+// ============================================================================
+
+/**
+ * @brief Report that the last device has left the room
+ * @param policy Pointer to policy
+ * @param token FCM token of the last device (can be empty)
+ */
+void reminder_policy_room_empty(ReminderPolicy *policy, const char *token);
+
+/**
+ * @brief Report that a device has entered the room
+ * @param policy Pointer to policy
+ *
+ * Ends the current episode; a reminder already in flight is not recalled.
+ */
+void reminder_policy_room_occupied(ReminderPolicy *policy);
+
+/**
+ * @brief Report a door state change
+ * @param policy Pointer to policy
+ * @param state New door state
+ */
+void reminder_policy_door_changed(ReminderPolicy *policy, DoorState state);
+
+#endif // REMINDER_H
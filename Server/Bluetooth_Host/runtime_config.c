@@ -0,0 +1,453 @@
+/**
+ * @file runtime_config.c
+ * @brief Implementation of the runtime configuration file
+ *
+ * Settings are described by a table of key, type, field offset and
+ * limits; the parser fills a private copy of the defaults from it and
+ * the copy is published only after every line parsed and validated.
+ */
+
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <stddef.h>
+#include <errno.h>
+#include <ctype.h>
+
+#include "runtime_config.h"
+#include "logger.h"
+
+// ============================================================================
+// SETTINGS TABLE
+// ============================================================================
+
+/**
+ * @brief Value type of a setting
+ */
+typedef enum {
+    SETTING_INT,
+    SETTING_BOOL,
+    SETTING_STRING,
+    SETTING_LOG_LEVEL
+} SettingType;
+
+/**
+ * @brief Description of one configuration key
+ */
+typedef struct {
+    const char *key;                    /// Name in the file
+    SettingType type;                   /// Value type
+    size_t offset;                      /// Field offset in RuntimeConfig
+    size_t size;                        /// Field size (strings include the NUL)
+    long min;                           /// Smallest accepted integer
+    long max;                           /// Largest accepted integer
+    int live;                           /// Applied on reload
+} Setting;
+
+#define INT_SETTING(name, min, max, live) \
+    { #name, SETTING_INT, offsetof(RuntimeConfig, name), sizeof(int), (min), (max), (live) }
+#define STRING_SETTING(name, live) \
+    { #name, SETTING_STRING, offsetof(RuntimeConfig, name), \
+      sizeof(((RuntimeConfig*)0)->name), 0, 0, (live) }
+
+static const Setting settings[] = {
+    INT_SETTING(ble_psm, BLE_PSM_MIN, BLE_PSM_MAX, 0),
+    INT_SETTING(heartbeat_check_interval, 1, 600, 0),
+    STRING_SETTING(service_account_file, 0),
+    STRING_SETTING(project_id, 0),
+    STRING_SETTING(metrics_listen_address, 0),
+    STRING_SETTING(control_socket_path, 0),
+    STRING_SETTING(status_shm_path, 0),
+    STRING_SETTING(state_file, 0),
+    { "notifier_warm_up", SETTING_BOOL, offsetof(RuntimeConfig, notifier_warm_up), sizeof(int), 0, 1, 0 },
+    INT_SETTING(rt_priority, 0, 99, 0),
+    INT_SETTING(rt_isr_priority, 0, 99, 0),
+    STRING_SETTING(cpu_affinity, 0),
+    STRING_SETTING(isr_cpu_affinity, 0),
+    { "lock_memory", SETTING_BOOL, offsetof(RuntimeConfig, lock_memory), sizeof(int), 0, 1, 0 },
+    INT_SETTING(prefault_heap_kb, 0, 65536, 0),
+
+    INT_SETTING(max_devices, 1, MAX_DEVICES, 1),
+    INT_SETTING(heartbeat_timeout, 5, 3600, 1),
+    INT_SETTING(min_token_length, 1, TOKEN_SIZE - 1, 1),
+    INT_SETTING(notifier_request_timeout, 1, 300, 1),
+    INT_SETTING(notifier_idle_release, 0, 86400, 1),
+    INT_SETTING(reminder_retry_delay, 1, 3600, 1),
+    INT_SETTING(reminder_max_attempts, 1, 20, 1),
+    { "log_level", SETTING_LOG_LEVEL, offsetof(RuntimeConfig, log_level), sizeof(int), 0, 0, 1 },
+    INT_SETTING(log_ratelimit_interval, 1, 3600, 1),
+    INT_SETTING(log_ratelimit_burst, 1, 1000, 1),
+    { "trace_enabled", SETTING_BOOL, offsetof(RuntimeConfig, trace_enabled), sizeof(int), 0, 1, 1 },
+    INT_SETTING(profiler_frequency, 1, PROFILER_MAX_FREQUENCY_HZ, 1),
+    INT_SETTING(profiler_duration, 1, PROFILER_MAX_DURATION_S, 1),
+    STRING_SETTING(profiler_output, 1),
+    STRING_SETTING(notification_title, 1),
+    STRING_SETTING(notification_body, 1),
+};
+
+#define SETTING_COUNT ((int)(sizeof(settings) / sizeof(settings[0])))
+
+// ============================================================================
+// STATIC VARIABLES
+// ============================================================================
+
+/// Compile-time defaults from config.h, published until a file is loaded
+static RuntimeConfig default_config = {
+    .ble_psm = BLE_PSM,
+    .heartbeat_check_interval = HEARTBEAT_CHECK_INTERVAL,
+    .service_account_file = FIREBASE_SERVICE_ACCOUNT_PATH,
+    .project_id = FIREBASE_PROJECT_ID,
+    .metrics_listen_address = METRICS_LISTEN_ADDRESS,
+    .control_socket_path = CONTROL_SOCKET_PATH,
+    .status_shm_path = STATUS_SHM_PATH,
+    .state_file = STATE_FILE_PATH,
+    .notifier_warm_up = NOTIFIER_WARM_UP_DEFAULT,
+    .rt_priority = RT_PRIORITY_DEFAULT,
+    .rt_isr_priority = RT_ISR_PRIORITY_DEFAULT,
+    .cpu_affinity = "",
+    .isr_cpu_affinity = "",
+    .lock_memory = RT_LOCK_MEMORY_DEFAULT,
+    .prefault_heap_kb = RT_PREFAULT_HEAP_KB,
+    .max_devices = MAX_DEVICES,
+    .heartbeat_timeout = HEARTBEAT_TIMEOUT,
+    .min_token_length = MIN_FCM_TOKEN_LENGTH,
+    .notifier_request_timeout = NOTIFIER_REQUEST_TIMEOUT,
+    .notifier_idle_release = NOTIFIER_IDLE_RELEASE,
+    .reminder_retry_delay = REMINDER_RETRY_DELAY,
+    .reminder_max_attempts = REMINDER_MAX_ATTEMPTS,
+    .log_level = LOG_LEVEL_INFO,
+    .log_ratelimit_interval = LOG_RATELIMIT_INTERVAL,
+    .log_ratelimit_burst = LOG_RATELIMIT_BURST,
+    .trace_enabled = TRACE_ENABLED_DEFAULT,
+    .profiler_frequency = PROFILER_FREQUENCY_HZ,
+    .profiler_duration = PROFILER_DURATION_S,
+    .profiler_output = PROFILER_OUTPUT_PATH,
+    .notification_title = FCM_NOTIFICATION_TITLE,
+    .notification_body = FCM_NOTIFICATION_BODY,
+    .generation = 0,
+    .retired_next = NULL
+};
+
+static RuntimeConfig *current_config = &default_config;
+static RuntimeConfig *retired_configs = NULL;
+static char config_path[256] = "";
+
+static const char *const log_level_names[] = { "error", "warn", "info", "debug" };
+
+// ============================================================================
+// INTERNAL HELPER FUNCTIONS
+// ============================================================================
+
+/**
+ * @brief Strip leading and trailing whitespace in place
+ */
+static char* trim(char *text) {
+    while (isspace((unsigned char)*text)) {
+        text++;
+    }
+
+    char *end = text + strlen(text);
+    while (end > text && isspace((unsigned char)end[-1])) {
+        end--;
+    }
+    *end = '\0';
+
+    return text;
+}
+
+/**
+ * @brief Find a setting by key
+ */
+static const Setting* find_setting(const char *key) {
+    for (int i = 0; i < SETTING_COUNT; i++) {
+        if (strcmp(settings[i].key, key) == 0) {
+            return &settings[i];
+        }
+    }
+    return NULL;
+}
+
+/**
+ * @brief Parse a value into its field
+ * @return NULL on success, or a description of the problem
+ */
+static const char* parse_value(const Setting *setting, const char *value, RuntimeConfig *config) {
+    char *field = (char*)config + setting->offset;
+
+    switch (setting->type) {
+        case SETTING_INT: {
+            char *end = NULL;
+            errno = 0;
+            long number = strtol(value, &end, 0);
+            if (errno != 0 || end == value || *end != '\0') {
+                return "not an integer";
+            }
+            if (number < setting->min || number > setting->max) {
+                return "out of range";
+            }
+            *(int*)field = (int)number;
+            return NULL;
+        }
+
+        case SETTING_BOOL:
+            if (strcasecmp(value, "true") == 0 || strcasecmp(value, "yes") == 0 ||
+                strcasecmp(value, "on") == 0 || strcmp(value, "1") == 0) {
+                *(int*)field = 1;
+                return NULL;
+            }
+            if (strcasecmp(value, "false") == 0 || strcasecmp(value, "no") == 0 ||
+                strcasecmp(value, "off") == 0 || strcmp(value, "0") == 0) {
+                *(int*)field = 0;
+                return NULL;
+            }
+            return "not a boolean";
+
+        case SETTING_LOG_LEVEL:
+            for (int level = LOG_LEVEL_ERROR; level <= LOG_LEVEL_DEBUG; level++) {
+                if (strcasecmp(value, log_level_names[level]) == 0) {
+                    *(int*)field = level;
+                    return NULL;
+                }
+            }
+            return "not one of error, warn, info, debug";
+
+        case SETTING_STRING: {
+            size_t length = strlen(value);
+            if (length >= 2 && value[0] == '"' && value[length - 1] == '"') {
+                value++;
+                length -= 2;
+            }
+            if (length == 0) {
+                return "empty";
+            }
+            if (length >= setting->size) {
+                return "too long";
+            }
+            // Clear the whole field so restart-only checks can compare bytes
+            memset(field, 0, setting->size);
+            memcpy(field, value, length);
+            return NULL;
+        }
+    }
+
+    return "unsupported type";
+}
+
+/**
+ * @brief Checks that involve more than one setting
+ * @return NULL if consistent, or a description of the problem
+ */
+static const char* validate(const RuntimeConfig *config) {
+    if (config->heartbeat_check_interval >= config->heartbeat_timeout) {
+        return "heartbeat_check_interval must be shorter than heartbeat_timeout";
+    }
+    if (config->ble_psm % 2 == 0) {
+        return "ble_psm must be odd";
+    }
+    return NULL;
+}
+
+/**
+ * @brief Parse a configuration file on top of the defaults
+ * @param path File to read
+ * @param config Output, initialized with the defaults
+ * @return 0 on success, ERROR_CONFIG_FILE on any error
+ */
+static int parse_file(const char *path, RuntimeConfig *config) {
+    FILE *file = fopen(path, "r");
+    if (!file) {
+        LOG_ERROR("Config: cannot open %s: %s", path, strerror(errno));
+        return ERROR_CONFIG_FILE;
+    }
+
+    char line[512];
+    int line_number = 0;
+    int result = SUCCESS;
+
+    while (fgets(line, sizeof(line), file)) {
+        line_number++;
+
+        if (!strchr(line, '\n') && !feof(file)) {
+            LOG_ERROR("Config %s:%d: line too long", path, line_number);
+            result = ERROR_CONFIG_FILE;
+            break;
+        }
+
+        char *key, *value;
+        int fields = runtime_config_split_line(line, &key, &value);
+        if (fields == 0) {
+            continue;
+        }
+        if (fields < 0) {
+            LOG_ERROR("Config %s:%d: expected key = value", path, line_number);
+            result = ERROR_CONFIG_FILE;
+            break;
+        }
+
+        const Setting *setting = find_setting(key);
+        if (!setting) {
+            LOG_ERROR("Config %s:%d: unknown key '%s'", path, line_number, key);
+            result = ERROR_CONFIG_FILE;
+            break;
+        }
+
+        const char *problem = parse_value(setting, value, config);
+        if (problem) {
+            LOG_ERROR("Config %s:%d: %s: %s", path, line_number, key, problem);
+            result = ERROR_CONFIG_FILE;
+            break;
+        }
+    }
+
+    fclose(file);
+
+    if (result == SUCCESS) {
+        const char *problem = validate(config);
+        if (problem) {
+            LOG_ERROR("Config %s: %s", path, problem);
+            result = ERROR_CONFIG_FILE;
+        }
+    }
+
+    return result;
+}
+
+/**
+ * @brief Keep the running value of restart-only settings
+ */
+static void keep_restart_only(RuntimeConfig *next, const RuntimeConfig *running) {
+    for (int i = 0; i < SETTING_COUNT; i++) {
+        const Setting *setting = &settings[i];
+        if (setting->live) {
+            continue;
+        }
+
+        char *next_field = (char*)next + setting->offset;
+        const char *running_field = (const char*)running + setting->offset;
+        if (memcmp(next_field, running_field, setting->size) != 0) {
+            LOG_WARN("Config: %s changed - restart required to apply", setting->key);
+            memcpy(next_field, running_field, setting->size);
+        }
+    }
+}
+
+/**
+ * @brief Make a configuration current and retire the previous one
+ */
+static void publish(RuntimeConfig *config) {
+    RuntimeConfig *previous = __atomic_exchange_n(&current_config, config, __ATOMIC_ACQ_REL);
+
+    if (previous != &default_config) {
+        previous->retired_next = retired_configs;
+        retired_configs = previous;
+    }
+}
+
+/**
+ * @brief Load the file into a new configuration
+ * @param running Configuration in effect, or NULL at startup
+ */
+static int load(const RuntimeConfig *running) {
+    RuntimeConfig *config = malloc(sizeof(RuntimeConfig));
+    if (!config) {
+        return ERROR_MEMORY;
+    }
+
+    memcpy(config, &default_config, sizeof(RuntimeConfig));
+
+    int result = parse_file(config_path, config);
+    if (result != SUCCESS) {
+        free(config);
+        return result;
+    }
+
+    if (running) {
+        keep_restart_only(config, running);
+        config->generation = running->generation + 1;
+    } else {
+        config->generation = 1;
+    }
+    config->retired_next = NULL;
+
+    publish(config);
+    LOG_INFO("Config: loaded %s (generation %u)", config_path, config->generation);
+    return SUCCESS;
+}
+
+// ============================================================================
+// PUBLIC FUNCTIONS
+// ============================================================================
+
+int runtime_config_init(const char *path, int required) {
+    if (!path || path[0] == '\0' || strlen(path) >= sizeof(config_path)) {
+        return ERROR_INVALID_PARAM;
+    }
+
+    snprintf(config_path, sizeof(config_path), "%s", path);
+
+    FILE *probe = fopen(path, "r");
+    if (!probe && errno == ENOENT && !required) {
+        LOG_INFO("Config: %s not found - using built-in defaults", path);
+        return SUCCESS;
+    }
+    if (probe) {
+        fclose(probe);
+    }
+
+    return load(NULL);
+}
+
+int runtime_config_reload(void) {
+    if (config_path[0] == '\0') {
+        return ERROR_CONFIG_FILE;
+    }
+
+    LOG_INFO("Config: reloading %s", config_path);
+
+    int result = load(runtime_config_get());
+    if (result != SUCCESS) {
+        LOG_ERROR("Config: reload failed - keeping the current configuration");
+    }
+    return result;
+}
+
+void runtime_config_cleanup(void) {
+    publish(&default_config);
+
+    while (retired_configs) {
+        RuntimeConfig *next = retired_configs->retired_next;
+        free(retired_configs);
+        retired_configs = next;
+    }
+}
+
+const RuntimeConfig* runtime_config_get(void) {
+    return __atomic_load_n(&current_config, __ATOMIC_ACQUIRE);
+}
+
+const char* runtime_config_path(void) {
+    return config_path;
+}
+
+// ============================================================================
+// PARSING
+// ============================================================================
+
+int runtime_config_split_line(char *line, char **key, char **value) {
+    char *text = trim(line);
+    if (text[0] == '\0' || text[0] == '#') {
+        return 0;
+    }
+
+    char *equals = strchr(text, '=');
+    if (!equals) {
+        return -1;
+    }
+
+    *equals = '\0';
+    *key = trim(text);
+    *value = trim(equals + 1);
+    return 1;
+}
@@ -0,0 +1,146 @@
+/**
+ * @file runtime_config.h
+ * @brief Runtime configuration file with hot reload
+ *
+ * The values in config.h are compile-time defaults. A key = value file
+ * read at startup overrides them, and SIGHUP re-reads it without
+ * dropping connections.
+ *
+ * File format:
+ * - One "key = value" per line; blank lines and lines starting with '#'
+ *   are ignored
+ * - Strings may be wrapped in double quotes to keep surrounding spaces
+ * - Integers accept decimal or 0x-prefixed hex
+ * - Booleans accept true/false, yes/no, on/off, 1/0
+ * - Unknown keys and out-of-range values reject the whole file
+ *
+ * Every load builds a complete, validated RuntimeConfig and publishes it
+ * with an atomic pointer swap, so readers see either the old or the new
+ * configuration, never a mix. A published configuration is immutable and
+ * stays valid until runtime_config_cleanup(): replaced versions are
+ * retired, not freed, because a reader on another thread may still hold
+ * them. Reloads are operator actions, so the retired list stays short.
+ *
+ * Settings marked restart-only (sockets, PSM, credentials) keep their
+ * running value on reload; a warning names any that changed.
+ */
+
+#ifndef RUNTIME_CONFIG_H
+#define RUNTIME_CONFIG_H
+
+#include "config.h"
+
+// ============================================================================
+// DATA STRUCTURES
+// ============================================================================
+
+/**
+ * @brief Effective configuration
+ */
+typedef struct RuntimeConfig {
+    // Restart-only
+    int ble_psm;                        /// L2CAP PSM of the server socket
+    int heartbeat_check_interval;       /// Seconds between heartbeat sweeps
+    char service_account_file[256];     /// Firebase service account JSON
+    char project_id[128];               /// Firebase project
+    char metrics_listen_address[108];   /// Prometheus endpoint address
+    char control_socket_path[108];      /// Control socket path
+    char status_shm_path[256];          /// Shared-memory status segment, empty = disabled
+    char state_file[256];               /// Persistent state file
+    int notifier_warm_up;               /// Load the HTTP stack and a token at startup
+    int rt_priority;                    /// Reactor SCHED_FIFO priority, 0 = normal
+    int rt_isr_priority;                /// Interrupt thread SCHED_FIFO priority, 0 = unchanged
+    char cpu_affinity[32];              /// Reactor CPU list, empty = unpinned
+    char isr_cpu_affinity[32];          /// Interrupt thread CPU list, empty = unpinned
+    int lock_memory;                    /// mlockall() and pre-fault reserves
+    int prefault_heap_kb;               /// Heap reserve pre-faulted when locking memory
+
+    // Applied on reload
+    int max_devices;                    /// Connection limit (at most MAX_DEVICES)
+    int heartbeat_timeout;              /// Seconds without data before a device expires
+    int min_token_length;               /// Shortest FCM token accepted
+    int notifier_request_timeout;       /// Seconds allowed per HTTP request
+    int notifier_idle_release;          /// Idle seconds before the HTTP stack is released, 0 = never
+    int reminder_retry_delay;           /// Seconds between reminder attempts
+    int reminder_max_attempts;          /// Attempts per empty-room episode
+    int log_level;                      /// LogLevel
+    int log_ratelimit_interval;         /// Rate limiting window in seconds
+    int log_ratelimit_burst;            /// Messages per window and call site
+    int trace_enabled;                  /// Record spans
+    int profiler_frequency;             /// Default profiler samples per CPU second
+    int profiler_duration;              /// Default profile length in seconds
+    char profiler_output[256];          /// Folded-stack output file
+    char notification_title[128];       /// Reminder title
+    char notification_body[256];        /// Reminder text
+
+    unsigned int generation;            /// 0 for defaults, incremented by each load
+    struct RuntimeConfig *retired_next; /// Retired list link (internal)
+} RuntimeConfig;
+
+// ============================================================================
+// LIFECYCLE
+// ============================================================================
+
+/**
+ * @brief Load the configuration file and publish the result
+ * @param path Configuration file path
+ * @param required Fail if the file does not exist (otherwise defaults are used)
+ * @return 0 on success, ERROR_CONFIG_FILE if the file is missing or invalid,
+ *         ERROR_MEMORY on allocation failure
+ *
+ * On failure the built-in defaults are published, so runtime_config_get()
+ * is always usable.
+ */
+int runtime_config_init(const char *path, int required);
+
+/**
+ * @brief Re-read the configuration file
+ * @return 0 if a new configuration was published, negative on error
+ *
+ * On error the current configuration stays in effect.
+ */
+int runtime_config_reload(void);
+
+/**
+ * @brief Free the current and all retired configurations
+ *
+ * Must only be called once no other thread reads the configuration.
+ */
+void runtime_config_cleanup(void);
+
+// ============================================================================
+// ACCESS
+// ============================================================================
+
+/**
+ * @brief Get the current configuration
+ * @return Immutable configuration, never NULL
+ *
+ * Read the pointer once per operation so related settings come from
+ * the same version. Safe from any thread.
+ */
+const RuntimeConfig* runtime_config_get(void);
+
+/**
+ * @brief Get the configuration file path
+ * @return Path given to runtime_config_init(), or an empty string
+ */
+const char* runtime_config_path(void);
+
+// ============================================================================
+// PARSING
+// ============================================================================
+
+/**
+ * @brief Split one "key = value" line in place
+ * @param line Line as read, modified in place
+ * @param key Set to the trimmed key
+ * @param value Set to the trimmed value
+ * @return 1 for a key/value pair, 0 for a blank or comment line,
+ *         -1 if the line has no '='
+ *
+ * The syntax shared by the configuration file and the state file.
+ */
+int runtime_config_split_line(char *line, char **key, char **value);
+
+#endif // RUNTIME_CONFIG_H
@@ -0,0 +1,828 @@
+/**
+ * @file simulation.c
+ * @brief Implementation of the scenario runner
+ *
+ * A single one-shot reactor timer is armed for the next event; when it
+ * fires, every event that is due runs and the timer is re-armed. Device
+ * sockets are watched so a connection the daemon closes (heartbeat
+ * timeout, capacity) is noticed and logged.
+ *
+ * A bench drives its iterations with the same kind of one-shot timer and
+ * reads the stage boundaries from the trace observer: the last departure
+ * and the stand-in's receipt are traced here and in the stand-in, the
+ * stages in between by the daemon's own spans.
+ */
+
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include <stddef.h>
+#include <ctype.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+
+#include "simulation.h"
+#include "bluetooth_server.h"
+#include "DoorStateDriver.h"
+#include "runtime_config.h"
+#include "logger.h"
+#include "metrics.h"
+#include "timesource.h"
+#include "trace.h"
+
+// ============================================================================
+// STATIC VARIABLES
+// ============================================================================
+
+static Metric scenario_events = METRIC_COUNTER_INIT("sim_events_total",
+    "Scenario events played by the simulation");
+static Metric scenario_errors = METRIC_COUNTER_INIT("sim_event_errors_total",
+    "Scenario events that could not be played");
+static Metric bench_latency = METRIC_HISTOGRAM_INIT("sim_bench_latency_us",
+    "Bench: last departure to the stand-in receiving the reminder in microseconds");
+
+static Metric *const simulation_metrics[] = {
+    &scenario_events, &scenario_errors, &bench_latency
+};
+
+/// Stage names in the bench report
+static const char *const stage_names[SIMULATION_STAGE_COUNT] = {
+    "disconnect", "policy", "notifier", "http", "total"
+};
+
+// ============================================================================
+// SCENARIO PARSING
+// ============================================================================
+
+/**
+ * @brief Parse a time offset such as "250ms", "5s", "1.5s" or "2m"
+ * @return 0 on success, -1 if malformed
+ */
+static int parse_offset(const char *text, uint64_t *offset_ms) {
+    char *unit;
+    double value = strtod(text, &unit);
+
+    if (unit == text || value < 0) {
+        return -1;
+    }
+
+    double scale;
+    if (strcmp(unit, "ms") == 0) {
+        scale = 1;
+    } else if (strcmp(unit, "s") == 0) {
+        scale = 1000;
+    } else if (strcmp(unit, "m") == 0) {
+        scale = 60000;
+    } else {
+        return -1;
+    }
+
+    *offset_ms = (uint64_t)(value * scale + 0.5);
+    return 0;
+}
+
+/**
+ * @brief Find or add a device by name
+ * @return Device index, -1 if the table is full or the name too long
+ */
+static int device_index(Simulation *simulation, const char *name) {
+    for (int i = 0; i < simulation->device_count; i++) {
+        if (strcmp(simulation->devices[i].name, name) == 0) {
+            return i;
+        }
+    }
+
+    if (simulation->device_count >= SIMULATION_MAX_DEVICES ||
+        strlen(name) >= sizeof(simulation->devices[0].name)) {
+        return -1;
+    }
+
+    int index = simulation->device_count++;
+    SimulationDevice *device = &simulation->devices[index];
+    device->simulation = simulation;
+    device->fd = -1;
+    snprintf(device->name, sizeof(device->name), "%s", name);
+
+    // A name that is a MAC address is used as is
+    if (bachk(name) == 0) {
+        snprintf(device->mac, sizeof(device->mac), "%s", name);
+    } else {
+        snprintf(device->mac, sizeof(device->mac), "02:53:49:4D:00:%02X", index + 1);
+    }
+    return index;
+}
+
+/**
+ * @brief Parse one non-empty scenario line into an event
+ * @return NULL on success, otherwise a description of the problem
+ */
+static const char* parse_event(Simulation *simulation, char *line, SimulationEvent *event) {
+    char *save = NULL;
+    char *time_text = strtok_r(line, " \t", &save);
+    char *action = strtok_r(NULL, " \t", &save);
+    char *argument = strtok_r(NULL, " \t", &save);
+
+    if (!action) {
+        return "missing action";
+    }
+    if (parse_offset(time_text, &event->at_ms) != 0) {
+        return "invalid time (expected e.g. 250ms, 5s or 2m)";
+    }
+
+    event->device = -1;
+    if (strcmp(action, "door") == 0) {
+        event->action = SIMULATION_DOOR;
+        if (argument && strcmp(argument, "locked") == 0) {
+            event->value = INT_EDGE_FALLING;
+        } else if (argument && strcmp(argument, "unlocked") == 0) {
+            event->value = INT_EDGE_RISING;
+        } else {
+            return "door needs \"locked\" or \"unlocked\"";
+        }
+        return NULL;
+    }
+
+    if (strcmp(action, "end") == 0) {
+        event->action = SIMULATION_END;
+        return NULL;
+    }
+
+    if (strcmp(action, "bench") == 0) {
+        char *iterations_text = strtok_r(NULL, " \t", &save);
+        char *devices_end = NULL;
+        char *iterations_end = NULL;
+        if (!argument || !iterations_text) {
+            return "bench needs \"<devices> <iterations>\"";
+        }
+        long devices = strtol(argument, &devices_end, 10);
+        long iterations = strtol(iterations_text, &iterations_end, 10);
+        if (*devices_end != '\0' || devices < 1 || devices > MAX_DEVICES ||
+            *iterations_end != '\0' || iterations < 1 ||
+            iterations > SIMULATION_BENCH_MAX_ITERATIONS) {
+            return "bench devices or iterations out of range";
+        }
+
+        // Reserve the device names now so a full table is reported here
+        for (int i = 0; i < devices; i++) {
+            char name[24];
+            snprintf(name, sizeof(name), "bench-%d", i + 1);
+            if (device_index(simulation, name) < 0) {
+                return "too many devices or device name too long";
+            }
+        }
+
+        event->action = SIMULATION_BENCH;
+        event->devices = (int)devices;
+        event->value = (int)iterations;
+        return NULL;
+    }
+
+    if (strcmp(action, "fcm") == 0) {
+        char *value_text = strtok_r(NULL, " \t", &save);
+        char *end = NULL;
+        long value = value_text ? strtol(value_text, &end, 10) : -1;
+        if (!value_text || *end != '\0' || value < 0) {
+            return "fcm needs \"latency <ms>\" or \"status <code>\"";
+        }
+        if (argument && strcmp(argument, "latency") == 0 && value <= 600000) {
+            event->action = SIMULATION_FCM_LATENCY;
+        } else if (argument && strcmp(argument, "status") == 0 && value >= 200 && value <= 599) {
+            event->action = SIMULATION_FCM_STATUS;
+        } else {
+            return "fcm needs \"latency <ms>\" or \"status <code>\"";
+        }
+        event->value = (int)value;
+        return NULL;
+    }
+
+    if (strcmp(action, "arrive") == 0) {
+        event->action = SIMULATION_ARRIVE;
+    } else if (strcmp(action, "heartbeat") == 0) {
+        event->action = SIMULATION_HEARTBEAT;
+    } else if (strcmp(action, "send") == 0) {
+        event->action = SIMULATION_SEND;
+    } else if (strcmp(action, "depart") == 0) {
+        event->action = SIMULATION_DEPART;
+    } else {
+        return "unknown action";
+    }
+
+    if (!argument) {
+        return "missing device name";
+    }
+    event->device = device_index(simulation, argument);
+    if (event->device < 0) {
+        return "too many devices or device name too long";
+    }
+
+    // The rest of the line: optional token for arrive, text for send
+    char *rest = save ? save + strspn(save, " \t") : NULL;
+    if (event->action == SIMULATION_SEND) {
+        if (!rest || *rest == '\0') {
+            return "send needs text";
+        }
+        event->text = strdup(rest);
+    } else if (event->action == SIMULATION_ARRIVE && rest && *rest != '\0') {
+        if (strlen(rest) >= TOKEN_SIZE || strpbrk(rest, " \t\"\\")) {
+            return "invalid token";
+        }
+        event->text = strdup(rest);
+    } else {
+        return NULL;
+    }
+
+    return event->text ? NULL : "out of memory";
+}
+
+// ============================================================================
+// DEVICE CONNECTIONS
+// ============================================================================
+
+/**
+ * @brief Close a device connection
+ */
+static void disconnect_device(SimulationDevice *device) {
+    if (device->fd < 0) {
+        return;
+    }
+    reactor_remove_fd(device->simulation->reactor, device->fd);
+    close(device->fd);
+    device->fd = -1;
+}
+
+/**
+ * @brief Reactor handler for a device socket: acknowledgements or close
+ */
+static void device_socket_event(int fd, uint32_t events, void *userdata) {
+    SimulationDevice *device = (SimulationDevice*)userdata;
+    char buffer[256];
+    (void)events;
+
+    // The server only writes acknowledgements; anything else is the end
+    ssize_t n = recv(fd, buffer, sizeof(buffer), 0);
+    if (n > 0 || (n < 0 && (errno == EAGAIN || errno == EINTR))) {
+        return;
+    }
+
+    LOG_INFO("Simulation: daemon closed the connection of %s", device->name);
+    disconnect_device(device);
+}
+
+/**
+ * @brief Send one message on a device connection
+ * @return 0 on success, negative on error
+ */
+static int device_send(SimulationDevice *device, const char *message) {
+    if (device->fd < 0) {
+        LOG_WARN("Simulation: %s is not connected", device->name);
+        return ERROR_INVALID_PARAM;
+    }
+
+    if (send(device->fd, message, strlen(message), MSG_NOSIGNAL) < 0) {
+        LOG_WARN("Simulation: send from %s failed: %s", device->name, strerror(errno));
+        disconnect_device(device);
+        return ERROR_NETWORK;
+    }
+    return SUCCESS;
+}
+
+/**
+ * @brief Connect a device to the loopback socket and send its token
+ * @return 0 on success, negative on error
+ */
+static int connect_device(Simulation *simulation, SimulationDevice *device, const char *token) {
+    struct sockaddr_un local = {0};
+    struct sockaddr_un server = {0};
+    char generated[TOKEN_SIZE];
+    char message[TOKEN_SIZE + 32];
+
+    if (device->fd >= 0) {
+        LOG_WARN("Simulation: %s is already connected", device->name);
+        return ERROR_INVALID_PARAM;
+    }
+
+    int fd = socket(AF_UNIX, SOCK_SEQPACKET | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+    if (fd < 0) {
+        LOG_WARN("Simulation: socket failed: %s", strerror(errno));
+        return ERROR_NETWORK;
+    }
+
+    // The abstract name tells the server which MAC address this is
+    local.sun_family = AF_UNIX;
+    int name_len = snprintf(local.sun_path + 1, sizeof(local.sun_path) - 1, "%s%d/%s",
+                            BT_LOOPBACK_CLIENT_PREFIX, (int)getpid(), device->mac);
+    socklen_t local_len = (socklen_t)(offsetof(struct sockaddr_un, sun_path) + 1 + (size_t)name_len);
+
+    server.sun_family = AF_UNIX;
+    snprintf(server.sun_path, sizeof(server.sun_path), "%s", simulation->socket_path);
+
+    if (bind(fd, (struct sockaddr*)&local, local_len) < 0 ||
+        connect(fd, (struct sockaddr*)&server, sizeof(server)) < 0) {
+        LOG_WARN("Simulation: %s cannot connect: %s", device->name, strerror(errno));
+        close(fd);
+        return ERROR_NETWORK;
+    }
+
+    if (reactor_add_fd(simulation->reactor, fd, REACTOR_READ, device_socket_event, device) != SUCCESS) {
+        close(fd);
+        return ERROR_GENERIC;
+    }
+    device->fd = fd;
+
+    if (!token) {
+        // Long enough to pass validation, recognisable in logs
+        int length = runtime_config_get()->min_token_length + 16;
+        if (length > TOKEN_SIZE - 1) {
+            length = TOKEN_SIZE - 1;
+        }
+        int prefix = snprintf(generated, sizeof(generated), "sim-%s-", device->name);
+        for (int i = prefix; i < length; i++) {
+            generated[i] = 'x';
+        }
+        generated[length > prefix ? length : prefix] = '\0';
+        token = generated;
+    }
+
+    snprintf(message, sizeof(message), "{\"fcm_token\": \"%s\"}", token);
+    return device_send(device, message);
+}
+
+// ============================================================================
+// BENCH
+// ============================================================================
+
+static void schedule_next(Simulation *simulation);
+static void bench_step(void *userdata);
+
+/**
+ * @brief Arm the timer for the next bench step
+ */
+static void bench_arm(Simulation *simulation, SimulationBenchStep step, uint64_t delay_ms) {
+    SimulationBench *bench = &simulation->bench;
+
+    bench->step = step;
+    bench->timer_id = reactor_add_timer(simulation->reactor, delay_ms, 0, bench_step, simulation);
+    if (bench->timer_id < 0) {
+        // Nothing would ever run again; give up on the iteration
+        LOG_ERROR("Simulation: cannot schedule the bench, iteration %d lost", bench->iteration);
+        bench->timer_id = 0;
+    }
+}
+
+/**
+ * @brief qsort comparator for stage durations
+ */
+static int compare_durations(const void *a, const void *b) {
+    uint64_t x = *(const uint64_t*)a;
+    uint64_t y = *(const uint64_t*)b;
+    return (x > y) - (x < y);
+}
+
+/**
+ * @brief Nearest-rank percentile of sorted durations
+ */
+static uint64_t percentile(const uint64_t *sorted, int count, int percent) {
+    int rank = (int)(((int64_t)count * percent + 99) / 100);
+    return sorted[rank > 0 ? rank - 1 : 0];
+}
+
+/**
+ * @brief Log the percentiles, release the bench and resume the scenario
+ */
+static void bench_finish(Simulation *simulation) {
+    SimulationBench *bench = &simulation->bench;
+
+    trace_set_observer(NULL, NULL);
+    if (!bench->trace_was_enabled) {
+        trace_set_enabled(0);
+    }
+
+    LOG_INFO("Simulation: bench of %d devices finished: %d iterations, %d without a send",
+             bench->device_count, bench->iterations, bench->timeouts);
+
+    uint64_t *sorted = bench->sample_count > 0 ?
+        malloc((size_t)bench->sample_count * sizeof(uint64_t)) : NULL;
+    if (sorted) {
+        for (int stage = 0; stage < SIMULATION_STAGE_COUNT; stage++) {
+            for (int i = 0; i < bench->sample_count; i++) {
+                sorted[i] = bench->samples[i * SIMULATION_STAGE_COUNT + stage];
+            }
+            qsort(sorted, (size_t)bench->sample_count, sizeof(uint64_t), compare_durations);
+            uint64_t p50 = percentile(sorted, bench->sample_count, 50);
+            uint64_t p99 = percentile(sorted, bench->sample_count, 99);
+            LOG_INFO("Simulation: bench %-10s p50 %7llu us  p99 %7llu us  max %7llu us",
+                     stage_names[stage], (unsigned long long)p50, (unsigned long long)p99,
+                     (unsigned long long)sorted[bench->sample_count - 1]);
+        }
+        free(sorted);
+    }
+
+    // The scenario clock stood still while the bench ran
+    simulation->start_ms += reactor_now_ms() - bench->started_ms;
+
+    free(bench->samples);
+    memset(bench, 0, sizeof(SimulationBench));
+    schedule_next(simulation);
+}
+
+/**
+ * @brief Move to the next iteration, or finish
+ */
+static void bench_next_iteration(Simulation *simulation) {
+    SimulationBench *bench = &simulation->bench;
+
+    bench->waiting = 0;
+    if (++bench->iteration >= bench->iterations) {
+        bench_finish(simulation);
+        return;
+    }
+    bench_arm(simulation, SIMULATION_BENCH_ARRIVE, SIMULATION_BENCH_SETTLE_MS);
+}
+
+/**
+ * @brief Store the stage durations of a completed iteration
+ */
+static void bench_record(Simulation *simulation, uint64_t http_start_us) {
+    SimulationBench *bench = &simulation->bench;
+    uint64_t *sample = &bench->samples[bench->sample_count++ * SIMULATION_STAGE_COUNT];
+
+    // A stage whose boundary was not seen counts as zero rather than wrapping
+    uint64_t marks[] = {
+        bench->depart_us, bench->empty_us, bench->reminder_us, http_start_us, bench->received_us
+    };
+    for (int i = 1; i < 5; i++) {
+        if (marks[i] < marks[i - 1]) {
+            marks[i] = marks[i - 1];
+        }
+    }
+
+    sample[SIMULATION_STAGE_DISCONNECT] = marks[1] - marks[0];
+    sample[SIMULATION_STAGE_POLICY] = marks[2] - marks[1];
+    sample[SIMULATION_STAGE_NOTIFIER] = marks[3] - marks[2];
+    sample[SIMULATION_STAGE_HTTP] = marks[4] - marks[3];
+    sample[SIMULATION_STAGE_TOTAL] = marks[4] - marks[0];
+    metrics_histogram_observe(&bench_latency, sample[SIMULATION_STAGE_TOTAL]);
+}
+
+/**
+ * @brief Trace observer: pick the stage boundaries out of the daemon's spans
+ *
+ * Called on every thread that records spans; the names checked first are
+ * only recorded on the reactor thread, which owns the bench.
+ */
+static void bench_observe(const char *category, const char *name,
+                          uint64_t start_us, uint64_t end_us, void *userdata) {
+    Simulation *simulation = (Simulation*)userdata;
+    SimulationBench *bench = &simulation->bench;
+    (void)end_us;
+
+    if (strcmp(category, "simulation") == 0 && strcmp(name, "last_depart") == 0) {
+        bench->depart_us = start_us;
+    } else if (strcmp(category, "device_manager") == 0 && strcmp(name, "room_empty") == 0) {
+        if (bench->waiting && bench->empty_us == 0) {
+            bench->empty_us = start_us;
+        }
+    } else if (strcmp(category, "reminder") == 0 && strcmp(name, "send") == 0) {
+        if (bench->waiting && bench->reminder_us == 0) {
+            bench->reminder_us = start_us;
+        }
+    } else if (strcmp(category, "fcm_standin") == 0 && strcmp(name, "send_received") == 0) {
+        if (bench->waiting && bench->received_us == 0) {
+            bench->received_us = start_us;
+        }
+    } else if (strcmp(category, "notification") == 0 && strcmp(name, "fcm_http") == 0) {
+        // The transfer span closes after the stand-in answered: iteration done
+        if (bench->waiting && bench->received_us != 0 && start_us >= bench->depart_us) {
+            reactor_cancel_timer(simulation->reactor, bench->timer_id);
+            bench->timer_id = 0;
+            bench_record(simulation, start_us);
+            bench_next_iteration(simulation);
+        }
+    }
+}
+
+/**
+ * @brief Bench timer handler: run the next step of the iteration
+ */
+static void bench_step(void *userdata) {
+    Simulation *simulation = (Simulation*)userdata;
+    SimulationBench *bench = &simulation->bench;
+
+    bench->timer_id = 0;
+
+    switch (bench->step) {
+        case SIMULATION_BENCH_ARRIVE:
+            simulateDoorEdge(INT_EDGE_FALLING);
+            for (int i = 0; i < bench->device_count; i++) {
+                connect_device(simulation, &simulation->devices[bench->devices[i]], NULL);
+            }
+            bench_arm(simulation, SIMULATION_BENCH_UNLOCK, SIMULATION_BENCH_SETTLE_MS);
+            break;
+        case SIMULATION_BENCH_UNLOCK:
+            simulateDoorEdge(INT_EDGE_RISING);
+            bench_arm(simulation, SIMULATION_BENCH_DEPART, SIMULATION_BENCH_SETTLE_MS);
+            break;
+        case SIMULATION_BENCH_DEPART:
+            bench->depart_us = bench->empty_us = bench->reminder_us = bench->received_us = 0;
+            for (int i = 0; i < bench->device_count; i++) {
+                disconnect_device(&simulation->devices[bench->devices[i]]);
+            }
+            bench->waiting = 1;
+            trace_instant("simulation", "last_depart");
+            bench_arm(simulation, SIMULATION_BENCH_WAIT, SIMULATION_BENCH_TIMEOUT_MS);
+            break;
+        case SIMULATION_BENCH_WAIT:
+            LOG_WARN("Simulation: bench iteration %d: no send within %d ms",
+                     bench->iteration + 1, SIMULATION_BENCH_TIMEOUT_MS);
+            bench->timeouts++;
+            bench_next_iteration(simulation);
+            break;
+    }
+}
+
+/**
+ * @brief Start a bench event
+ * @return 0 on success, negative if it cannot run
+ */
+static int bench_start(Simulation *simulation, const SimulationEvent *event) {
+    SimulationBench *bench = &simulation->bench;
+
+    if (event->devices > runtime_config_get()->max_devices) {
+        LOG_WARN("Simulation: bench of %d devices exceeds max_devices (%d)",
+                 event->devices, runtime_config_get()->max_devices);
+        return ERROR_INVALID_PARAM;
+    }
+
+    memset(bench, 0, sizeof(SimulationBench));
+    bench->samples = calloc((size_t)event->value * SIMULATION_STAGE_COUNT, sizeof(uint64_t));
+    if (!bench->samples) {
+        return ERROR_MEMORY;
+    }
+
+    for (int i = 0; i < event->devices; i++) {
+        char name[24];
+        snprintf(name, sizeof(name), "bench-%d", i + 1);
+        bench->devices[i] = device_index(simulation, name);
+    }
+    bench->device_count = event->devices;
+    bench->iterations = event->value;
+    bench->started_ms = reactor_now_ms();
+    bench->active = 1;
+
+    // The stage boundaries come from spans, so tracing must be on
+    bench->trace_was_enabled = trace_is_enabled();
+    if (!bench->trace_was_enabled) {
+        trace_set_enabled(1);
+    }
+    trace_set_observer(bench_observe, simulation);
+
+    LOG_INFO("Simulation: bench of %d devices, %d iterations", bench->device_count, bench->iterations);
+    bench_arm(simulation, SIMULATION_BENCH_ARRIVE, 0);
+    return SUCCESS;
+}
+
+// ============================================================================
+// SCENARIO EXECUTION
+// ============================================================================
+
+static void run_due_events(void *userdata);
+
+/**
+ * @brief Log the outcome, dump metrics and stop the daemon
+ */
+static void finish(Simulation *simulation) {
+    uint64_t elapsed = reactor_now_ms() - simulation->start_ms;
+
+    LOG_INFO("Simulation: scenario finished after %llu ms: %d events, "
+             "stand-in issued %llu tokens, accepted %llu and rejected %llu messages",
+             (unsigned long long)elapsed, simulation->next_event,
+             (unsigned long long)simulation->standin->tokens_issued,
+             (unsigned long long)simulation->standin->messages_accepted,
+             (unsigned long long)simulation->standin->messages_rejected);
+    if (timesource_is_virtual()) {
+        LOG_INFO("Simulation: virtual clock finished %llu ms ahead of real time",
+                 (unsigned long long)timesource_ahead_ms());
+    }
+    metrics_dump();
+    reactor_stop(simulation->reactor);
+}
+
+/**
+ * @brief Play one event
+ * @return 0 on success, negative if the event could not be played
+ */
+static int run_event(Simulation *simulation, const SimulationEvent *event) {
+    SimulationDevice *device = event->device >= 0 ? &simulation->devices[event->device] : NULL;
+
+    switch (event->action) {
+        case SIMULATION_DOOR:
+            LOG_DEBUG("Simulation: door %s",
+                      event->value == INT_EDGE_RISING ? "unlocked" : "locked");
+            return simulateDoorEdge(event->value) == 0 ? SUCCESS : ERROR_GENERIC;
+        case SIMULATION_ARRIVE:
+            LOG_DEBUG("Simulation: %s (%s) arrives", device->name, device->mac);
+            return connect_device(simulation, device, event->text);
+        case SIMULATION_HEARTBEAT:
+            return device_send(device, "{}");
+        case SIMULATION_SEND:
+            return device_send(device, event->text);
+        case SIMULATION_DEPART:
+            LOG_DEBUG("Simulation: %s departs", device->name);
+            if (device->fd < 0) {
+                LOG_WARN("Simulation: %s is not connected", device->name);
+                return ERROR_INVALID_PARAM;
+            }
+            disconnect_device(device);
+            return SUCCESS;
+        case SIMULATION_FCM_LATENCY:
+            fcm_standin_set_latency(simulation->standin, event->value);
+            return SUCCESS;
+        case SIMULATION_FCM_STATUS:
+            fcm_standin_set_status(simulation->standin, event->value);
+            return SUCCESS;
+        case SIMULATION_BENCH:
+            return bench_start(simulation, event);
+        case SIMULATION_END:
+            return SUCCESS;
+    }
+    return ERROR_INVALID_PARAM;
+}
+
+/**
+ * @brief Arm the timer for the next event
+ */
+static void schedule_next(Simulation *simulation) {
+    if (simulation->next_event >= simulation->event_count) {
+        LOG_INFO("Simulation: last event played, daemon keeps running");
+        return;
+    }
+
+    uint64_t due = simulation->start_ms + simulation->events[simulation->next_event].at_ms;
+    uint64_t now = reactor_now_ms();
+    int timer_id = reactor_add_timer(simulation->reactor, due > now ? due - now : 0, 0,
+                                     run_due_events, simulation);
+    if (timer_id < 0) {
+        LOG_ERROR("Simulation: cannot schedule the next event, scenario stopped");
+        return;
+    }
+    simulation->timer_id = timer_id;
+}
+
+/**
+ * @brief Timer handler: play every event that is due
+ */
+static void run_due_events(void *userdata) {
+    Simulation *simulation = (Simulation*)userdata;
+
+    // One-shot timers are released before their handler runs
+    simulation->timer_id = 0;
+
+    uint64_t elapsed = reactor_now_ms() - simulation->start_ms;
+    while (simulation->next_event < simulation->event_count &&
+           simulation->events[simulation->next_event].at_ms <= elapsed) {
+        const SimulationEvent *event = &simulation->events[simulation->next_event++];
+
+        METRICS_INC(&scenario_events);
+        if (event->action == SIMULATION_END) {
+            finish(simulation);
+            return;
+        }
+        if (run_event(simulation, event) != SUCCESS) {
+            LOG_WARN("Simulation: event on line %d could not be played", event->line);
+            METRICS_INC(&scenario_errors);
+        }
+        if (simulation->bench.active) {
+            return; // bench_finish() schedules the rest of the scenario
+        }
+    }
+
+    schedule_next(simulation);
+}
+
+// ============================================================================
+// PUBLIC API
+// ============================================================================
+
+int simulation_load(Simulation *simulation, const char *path) {
+    if (!simulation || !path) {
+        return ERROR_INVALID_PARAM;
+    }
+
+    memset(simulation, 0, sizeof(Simulation));
+
+    FILE *file = fopen(path, "r");
+    if (!file) {
+        LOG_ERROR("Simulation: cannot open scenario %s: %s", path, strerror(errno));
+        return ERROR_CONFIG_FILE;
+    }
+
+    char line[TOKEN_SIZE + 128];
+    int line_number = 0;
+    const char *problem = NULL;
+    while (!problem && fgets(line, sizeof(line), file)) {
+        line_number++;
+        line[strcspn(line, "#\r\n")] = '\0';
+
+        char *start = line + strspn(line, " \t");
+        size_t length = strlen(start);
+        while (length > 0 && isspace((unsigned char)start[length - 1])) {
+            start[--length] = '\0';
+        }
+        if (length == 0) {
+            continue;
+        }
+
+        if (simulation->event_count >= SIMULATION_MAX_EVENTS) {
+            problem = "too many events";
+            break;
+        }
+        if (!simulation->events) {
+            simulation->events = calloc(SIMULATION_MAX_EVENTS, sizeof(SimulationEvent));
+            if (!simulation->events) {
+                problem = "out of memory";
+                break;
+            }
+        }
+
+        SimulationEvent *event = &simulation->events[simulation->event_count];
+        event->line = line_number;
+        problem = parse_event(simulation, start, event);
+        if (!problem && simulation->event_count > 0 &&
+            event->at_ms < simulation->events[simulation->event_count - 1].at_ms) {
+            problem = "events must be in time order";
+        }
+        if (!problem) {
+            simulation->event_count++;
+        } else {
+            free(event->text);
+            event->text = NULL;
+        }
+    }
+    fclose(file);
+
+    if (problem) {
+        LOG_ERROR("Simulation: %s:%d: %s", path, line_number, problem);
+        simulation_cleanup(simulation);
+        return ERROR_CONFIG_FILE;
+    }
+
+    LOG_INFO("Simulation: loaded %d events for %d devices from %s",
+             simulation->event_count, simulation->device_count, path);
+    for (int i = 0; i < simulation->device_count; i++) {
+        LOG_DEBUG("Simulation: device %s is %s", simulation->devices[i].name,
+                  simulation->devices[i].mac);
+    }
+    return SUCCESS;
+}
+
+int simulation_start(Simulation *simulation, Reactor *reactor, const char *socket_path,
+                     FcmStandin *standin) {
+    if (!simulation || !reactor || !socket_path || !standin ||
+        strlen(socket_path) >= sizeof(simulation->socket_path)) {
+        return ERROR_INVALID_PARAM;
+    }
+
+    metrics_register_all(simulation_metrics, sizeof(simulation_metrics) / sizeof(simulation_metrics[0]));
+
+    simulation->reactor = reactor;
+    simulation->standin = standin;
+    snprintf(simulation->socket_path, sizeof(simulation->socket_path), "%s", socket_path);
+    simulation->start_ms = reactor_now_ms();
+
+    LOG_INFO("Simulation: scenario started");
+    schedule_next(simulation);
+    return SUCCESS;
+}
+
+void simulation_cleanup(Simulation *simulation) {
+    if (!simulation) {
+        return;
+    }
+
+    if (simulation->bench.active) {
+        trace_set_observer(NULL, NULL);
+        if (simulation->bench.timer_id > 0) {
+            reactor_cancel_timer(simulation->reactor, simulation->bench.timer_id);
+        }
+        free(simulation->bench.samples);
+    }
+
+    if (simulation->reactor) {
+        if (simulation->timer_id > 0) {
+            reactor_cancel_timer(simulation->reactor, simulation->timer_id);
+            simulation->timer_id = 0;
+        }
+        for (int i = 0; i < simulation->device_count; i++) {
+            disconnect_device(&simulation->devices[i]);
+        }
+    }
+
+    for (int i = 0; i < simulation->event_count; i++) {
+        free(simulation->events[i].text);
+    }
+    free(simulation->events);
+    memset(simulation, 0, sizeof(Simulation));
+}
@@ -0,0 +1,184 @@
+/**
+ * @file simulation.h
+ * @brief Scenario runner for the --simulate mode
+ *
+ * In simulation the daemon runs its production logic against stand-ins:
+ * the Bluetooth server listens on a Unix socket (loopback transport), the
+ * door driver takes scripted edges, and the notifier talks to the local
+ * FCM stand-in. This module plays a scenario file against them from the
+ * daemon's own event loop, so metrics and logs are the production ones.
+ *
+ * Scenario file, one event per line, '#' starts a comment:
+ *
+ *     <time> door locked|unlocked
+ *     <time> arrive <device> [token]   connect and send the FCM token
+ *     <time> heartbeat <device>        send an empty message
+ *     <time> send <device> <text...>   send raw text (e.g. invalid JSON)
+ *     <time> depart <device>           close the connection
+ *     <time> fcm latency <ms>          delay stand-in send responses
+ *     <time> fcm status <code>         stand-in send status (200 accepts)
+ *     <time> bench <devices> <n>       time the reminder path n times
+ *     <time> end                       dump metrics and shut down
+ *
+ * Times are offsets from the start of the scenario with a unit: 250ms,
+ * 5s, 1.5s or 2m. Events must be in time order. A device is any name; it
+ * is given a locally administered MAC address unless the name already is
+ * one. Without "end" the daemon keeps running after the last event.
+ * With --virtual-clock the offsets are virtual time (see timesource.h).
+ *
+ * A bench event repeats one episode: door locked, devices bench-1 to
+ * bench-<devices> arrive, door unlocked, all depart at once. Each time it
+ * measures from the last departure to the stand-in receiving the send,
+ * split into stages by the spans the daemon already traces, and logs the
+ * p50/p99 of every stage at the end. The scenario clock stops while it
+ * runs, and the room must otherwise be empty.
+ *
+ * Threading:
+ * simulation_load() may run anywhere; the other functions must be called
+ * from the reactor thread.
+ */
+
+#ifndef SIMULATION_H
+#define SIMULATION_H
+
+#include <stdint.h>
+
+#include "config.h"
+#include "reactor.h"
+#include "fcm_standin.h"
+
+// ============================================================================
+// DATA STRUCTURES
+// ============================================================================
+
+/**
+ * @brief Scenario actions
+ */
+typedef enum {
+    SIMULATION_DOOR = 0,                /// Queue a door edge
+    SIMULATION_ARRIVE,                  /// Connect a device and send its token
+    SIMULATION_HEARTBEAT,               /// Send an empty message
+    SIMULATION_SEND,                    /// Send raw text
+    SIMULATION_DEPART,                  /// Close a device connection
+    SIMULATION_FCM_LATENCY,             /// Set the stand-in latency
+    SIMULATION_FCM_STATUS,              /// Set the stand-in send status
+    SIMULATION_BENCH,                   /// Time the reminder path repeatedly
+    SIMULATION_END                      /// Stop the daemon
+} SimulationAction;
+
+/**
+ * @brief Stages of the reminder path timed by a bench
+ */
+typedef enum {
+    SIMULATION_STAGE_DISCONNECT = 0,    /// Last departure to room empty
+    SIMULATION_STAGE_POLICY,            /// Room empty to reminder issued
+    SIMULATION_STAGE_NOTIFIER,          /// Reminder issued to HTTP request started
+    SIMULATION_STAGE_HTTP,              /// HTTP request started to stand-in received it
+    SIMULATION_STAGE_TOTAL,             /// Last departure to stand-in received it
+    SIMULATION_STAGE_COUNT
+} SimulationStage;
+
+/**
+ * @brief Steps of one bench iteration
+ */
+typedef enum {
+    SIMULATION_BENCH_ARRIVE = 0,        /// Lock the door, connect the devices
+    SIMULATION_BENCH_UNLOCK,            /// Unlock the door
+    SIMULATION_BENCH_DEPART,            /// Disconnect every device
+    SIMULATION_BENCH_WAIT               /// Wait for the send (the timer is the timeout)
+} SimulationBenchStep;
+
+/**
+ * @brief Scenario event
+ */
+typedef struct {
+    uint64_t at_ms;                     /// Offset from the scenario start
+    SimulationAction action;            /// What to do
+    int device;                         /// Device index, -1 if none
+    int value;                          /// Door edge, latency, status or bench iterations
+    int devices;                        /// Devices taking part in a bench
+    char *text;                         /// Token or raw text, NULL if none
+    int line;                           /// Scenario line for log messages
+} SimulationEvent;
+
+/**
+ * @brief Simulated device
+ */
+typedef struct {
+    struct Simulation *simulation;      /// Owning simulation
+    char name[32];                      /// Name used in the scenario
+    char mac[18];                       /// Address announced to the server
+    int fd;                             /// Connected socket, -1 while away
+} SimulationDevice;
+
+/**
+ * @brief Bench in progress
+ */
+typedef struct {
+    int active;                         /// Non-zero while a bench event runs
+    int devices[SIMULATION_MAX_DEVICES]; /// Indices of the devices taking part
+    int device_count;                   /// Number of devices taking part
+    int iterations;                     /// Iterations requested
+    int iteration;                      /// Current iteration
+    int timeouts;                       /// Iterations whose send never arrived
+    SimulationBenchStep step;           /// Next step of the current iteration
+    int timer_id;                       /// Timer for the next step, 0 if none
+    int waiting;                        /// Set between the departure and the send
+    int trace_was_enabled;              /// Tracing state to restore afterwards
+    uint64_t started_ms;                /// Reactor time the bench started
+    uint64_t depart_us;                 /// Trace time of the last departure
+    uint64_t empty_us;                  /// Trace time the room became empty
+    uint64_t reminder_us;               /// Trace time the reminder was issued
+    uint64_t received_us;               /// Trace time the stand-in received the send
+    uint64_t *samples;                  /// SIMULATION_STAGE_COUNT durations per finished iteration
+    int sample_count;                   /// Finished iterations in samples
+} SimulationBench;
+
+/**
+ * @brief Simulation state
+ */
+typedef struct Simulation {
+    Reactor *reactor;                   /// Loop running the scenario, NULL before start
+    FcmStandin *standin;                /// Stand-in receiving the notifications
+    char socket_path[108];              /// Loopback socket of the Bluetooth server
+    SimulationEvent *events;            /// Parsed scenario
+    int event_count;                    /// Number of events
+    int next_event;                     /// First event not run yet
+    SimulationDevice devices[SIMULATION_MAX_DEVICES]; /// Devices named by the scenario
+    int device_count;                   /// Number of devices
+    int timer_id;                       /// Timer for the next event, 0 if none
+    uint64_t start_ms;                  /// Reactor time the scenario started
+    SimulationBench bench;              /// Bench event in progress
+} Simulation;
+
+// ============================================================================
+// PUBLIC API
+// ============================================================================
+
+/**
+ * @brief Parse a scenario file
+ * @param simulation Pointer to simulation to initialize
+ * @param path Scenario file
+ * @return 0 on success, ERROR_CONFIG_FILE if the file is unreadable or
+ *         invalid (the offending line is logged)
+ */
+int simulation_load(Simulation *simulation, const char *path);
+
+/**
+ * @brief Start playing the scenario
+ * @param simulation Loaded simulation
+ * @param reactor Daemon event loop
+ * @param socket_path Loopback socket of the Bluetooth server
+ * @param standin FCM stand-in the notifier sends to
+ * @return 0 on success, negative on error
+ */
+int simulation_start(Simulation *simulation, Reactor *reactor, const char *socket_path,
+                     FcmStandin *standin);
+
+/**
+ * @brief Disconnect the simulated devices and free the scenario
+ * @param simulation Pointer to simulation
+ */
+void simulation_cleanup(Simulation *simulation);
+
+#endif // SIMULATION_H
@@ -0,0 +1,304 @@
+/**
+ * @file startup.c
+ * @brief Implementation of the startup orchestrator
+ *
+ * One mutex and condition variable protect the step table. The caller and
+ * the workers each loop: pick a pending step of their kind whose
+ * dependencies are done, run it unlocked, publish the result and wake
+ * everyone. The caller returns once no step is pending or running.
+ */
+
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <string.h>
+#include <pthread.h>
+#include <time.h>
+
+#include "startup.h"
+#include "logger.h"
+#include "metrics.h"
+#include "trace.h"
+#include "timesource.h"
+
+// ============================================================================
+// DATA STRUCTURES
+// ============================================================================
+
+/**
+ * @brief Shared state of one startup_run() call
+ */
+typedef struct {
+    StartupStep *steps;                 /// Step table
+    int count;                          /// Number of steps
+    int failure;                        /// First failed result, 0 if none
+    int running;                        /// Steps currently executing
+    pthread_mutex_t mutex;              /// Protects everything above and the step states
+    pthread_cond_t changed;             /// Signalled whenever a step finishes
+} StartupPlan;
+
+/**
+ * @brief Worker thread argument
+ */
+typedef struct {
+    StartupPlan *plan;                  /// Shared plan
+    int index;                          /// Worker number for the thread name
+} StartupWorker;
+
+// ============================================================================
+// STATIC VARIABLES
+// ============================================================================
+
+static Metric startup_duration = METRIC_GAUGE_INIT("startup_duration_ms",
+    "Time spent in the startup orchestrator in milliseconds");
+static Metric startup_serial = METRIC_GAUGE_INIT("startup_serial_ms",
+    "Sum of startup step durations (the serial equivalent) in milliseconds");
+static Metric time_to_accept = METRIC_GAUGE_INIT("startup_time_to_accept_ms",
+    "Time from process start until Bluetooth connections are accepted in milliseconds");
+
+static Metric *const startup_metrics[] = {
+    &startup_duration, &startup_serial, &time_to_accept
+};
+
+/// Monotonic time recorded by startup_mark_origin()
+static uint64_t origin_us = 0;
+
+// ============================================================================
+// INTERNAL HELPER FUNCTIONS
+// ============================================================================
+
+/**
+ * @brief Skip pending steps that can no longer run (mutex held)
+ *
+ * After a failure nothing new starts; otherwise a step is skipped when
+ * one of its dependencies failed or was skipped.
+ */
+static void skip_blocked_steps(StartupPlan *plan) {
+    int changed = 1;
+
+    while (changed) {
+        changed = 0;
+        for (int i = 0; i < plan->count; i++) {
+            StartupStep *step = &plan->steps[i];
+            if (step->state != STARTUP_PENDING) {
+                continue;
+            }
+
+            int blocked = (plan->failure != 0);
+            for (int dep = 0; dep < plan->count && !blocked; dep++) {
+                if ((step->depends_on & STARTUP_DEP(dep)) &&
+                    (plan->steps[dep].state == STARTUP_FAILED ||
+                     plan->steps[dep].state == STARTUP_SKIPPED)) {
+                    blocked = 1;
+                }
+            }
+
+            if (blocked) {
+                step->state = STARTUP_SKIPPED;
+                changed = 1;
+            }
+        }
+    }
+}
+
+/**
+ * @brief Find a runnable step for the caller or a worker (mutex held)
+ * @return Step index, or -1 if none is ready
+ */
+static int next_ready_step(StartupPlan *plan, int on_worker) {
+    for (int i = 0; i < plan->count; i++) {
+        StartupStep *step = &plan->steps[i];
+        if (step->state != STARTUP_PENDING || (step->on_worker != 0) != (on_worker != 0)) {
+            continue;
+        }
+
+        int ready = 1;
+        for (int dep = 0; dep < plan->count; dep++) {
+            if ((step->depends_on & STARTUP_DEP(dep)) && plan->steps[dep].state != STARTUP_DONE) {
+                ready = 0;
+                break;
+            }
+        }
+        if (ready) {
+            return i;
+        }
+    }
+    return -1;
+}
+
+/**
+ * @brief Check whether steps of a kind are still pending (mutex held)
+ */
+static int has_pending(const StartupPlan *plan, int on_worker) {
+    for (int i = 0; i < plan->count; i++) {
+        const StartupStep *step = &plan->steps[i];
+        if (step->state == STARTUP_PENDING &&
+            (on_worker < 0 || (step->on_worker != 0) == (on_worker != 0))) {
+            return 1;
+        }
+    }
+    return 0;
+}
+
+/**
+ * @brief Run one step with the mutex released, then publish its result
+ */
+static void execute_step(StartupPlan *plan, int index) {
+    StartupStep *step = &plan->steps[index];
+
+    step->state = STARTUP_RUNNING;
+    plan->running++;
+    pthread_mutex_unlock(&plan->mutex);
+
+    uint64_t span = trace_begin();
+    uint64_t start = timesource_real_us();
+    int result = step->run(step->userdata);
+    uint64_t duration = timesource_real_us() - start;
+    trace_end("startup", step->name, span);
+
+    LOG_INFO("Startup: %s %s in %llu ms%s", step->name,
+             result == 0 ? "done" : "FAILED",
+             (unsigned long long)(duration / 1000),
+             step->on_worker ? " (worker)" : "");
+
+    pthread_mutex_lock(&plan->mutex);
+    step->result = result;
+    step->duration_us = duration;
+    step->state = (result == 0) ? STARTUP_DONE : STARTUP_FAILED;
+    if (result != 0 && plan->failure == 0) {
+        plan->failure = result;
+    }
+    plan->running--;
+    skip_blocked_steps(plan);
+    pthread_cond_broadcast(&plan->changed);
+}
+
+/**
+ * @brief Worker thread: run worker steps until none is left
+ */
+static void* worker_main(void *arg) {
+    StartupWorker *worker = (StartupWorker*)arg;
+    StartupPlan *plan = worker->plan;
+    char name[16];
+
+    snprintf(name, sizeof(name), "startup-%d", worker->index);
+    trace_set_thread_name(name);
+
+    pthread_mutex_lock(&plan->mutex);
+    while (has_pending(plan, 1)) {
+        int index = next_ready_step(plan, 1);
+        if (index < 0) {
+            pthread_cond_wait(&plan->changed, &plan->mutex);
+            continue;
+        }
+        execute_step(plan, index);
+    }
+    pthread_mutex_unlock(&plan->mutex);
+
+    return NULL;
+}
+
+// ============================================================================
+// PUBLIC API
+// ============================================================================
+
+void startup_mark_origin(void) {
+    origin_us = timesource_real_us();
+}
+
+int startup_run(StartupStep *steps, int count, int workers) {
+    if (!steps || count <= 0 || count > STARTUP_MAX_STEPS || workers < 1) {
+        return ERROR_INVALID_PARAM;
+    }
+
+    metrics_register_all(startup_metrics, sizeof(startup_metrics) / sizeof(startup_metrics[0]));
+
+    StartupPlan plan = { .steps = steps, .count = count };
+    pthread_mutex_init(&plan.mutex, NULL);
+    pthread_cond_init(&plan.changed, NULL);
+
+    for (int i = 0; i < count; i++) {
+        steps[i].state = STARTUP_PENDING;
+        steps[i].result = 0;
+        steps[i].duration_us = 0;
+    }
+
+    uint64_t start = timesource_real_us();
+
+    // Workers only exist while there is worker work
+    pthread_t threads[STARTUP_MAX_STEPS];
+    StartupWorker worker_args[STARTUP_MAX_STEPS];
+    int started = 0;
+    int worker_steps = 0;
+    for (int i = 0; i < count; i++) {
+        worker_steps += steps[i].on_worker ? 1 : 0;
+    }
+    for (int i = 0; i < workers && i < worker_steps; i++) {
+        worker_args[i].plan = &plan;
+        worker_args[i].index = i;
+        if (pthread_create(&threads[i], NULL, worker_main, &worker_args[i]) != 0) {
+            LOG_WARN("Startup: could not create worker %d, continuing with %d", i, started);
+            break;
+        }
+        started++;
+    }
+
+    pthread_mutex_lock(&plan.mutex);
+    if (started == 0) {
+        // No worker could be created: run worker steps on this thread
+        for (int i = 0; i < count; i++) {
+            steps[i].on_worker = 0;
+        }
+    }
+    while (has_pending(&plan, -1) || plan.running > 0) {
+        int index = next_ready_step(&plan, 0);
+        if (index >= 0) {
+            execute_step(&plan, index);
+            continue;
+        }
+
+        if (plan.running == 0 && next_ready_step(&plan, 1) < 0) {
+            // Pending steps whose dependencies can never be met
+            LOG_ERROR("Startup: unsatisfiable step dependencies");
+            if (plan.failure == 0) {
+                plan.failure = ERROR_INVALID_PARAM;
+            }
+            skip_blocked_steps(&plan);
+            pthread_cond_broadcast(&plan.changed);
+            continue;
+        }
+
+        pthread_cond_wait(&plan.changed, &plan.mutex);
+    }
+    int failure = plan.failure;
+    pthread_mutex_unlock(&plan.mutex);
+
+    for (int i = 0; i < started; i++) {
+        pthread_join(threads[i], NULL);
+    }
+    pthread_cond_destroy(&plan.changed);
+    pthread_mutex_destroy(&plan.mutex);
+
+    uint64_t elapsed = timesource_real_us() - start;
+    uint64_t serial = 0;
+    for (int i = 0; i < count; i++) {
+        serial += steps[i].duration_us;
+        if (steps[i].state == STARTUP_SKIPPED) {
+            LOG_WARN("Startup: %s skipped", steps[i].name);
+        }
+    }
+
+    metrics_gauge_set(&startup_duration, (int64_t)(elapsed / 1000));
+    metrics_gauge_set(&startup_serial, (int64_t)(serial / 1000));
+    LOG_INFO("Startup: %s in %llu ms (%llu ms of steps)",
+             failure == 0 ? "complete" : "aborted",
+             (unsigned long long)(elapsed / 1000), (unsigned long long)(serial / 1000));
+
+    return failure;
+}
+
+void startup_mark_accepting(void) {
+    uint64_t origin = origin_us ? origin_us : timesource_real_us();
+    metrics_gauge_set(&time_to_accept, (int64_t)((timesource_real_us() - origin) / 1000));
+    LOG_INFO("Startup: accepting Bluetooth connections %llu ms after launch",
+             (unsigned long long)((timesource_real_us() - origin) / 1000));
+}
@@ -0,0 +1,100 @@
+/**
+ * @file startup.h
+ * @brief Startup orchestrator running independent init steps concurrently
+ *
+ * Startup is described as a table of steps with dependency edges. Steps
+ * whose dependencies have succeeded run as soon as possible: steps marked
+ * for a worker run on a small pool of startup threads, the others run on
+ * the calling thread, which is the reactor thread. Slow, self-contained
+ * work such as GPIO setup, binding the L2CAP socket, signing the OAuth
+ * request and reading the state file therefore overlaps instead of
+ * adding up.
+ *
+ * A step that fails stops new steps from starting; steps that depend on
+ * it are skipped, running steps finish, and startup_run() returns the
+ * first failure. Every step is logged with its duration and recorded as
+ * a trace span in the "startup" category.
+ *
+ * Worker steps must not touch the reactor or anything another step may
+ * use at the same time; dependency edges are the only synchronization.
+ */
+
+#ifndef STARTUP_H
+#define STARTUP_H
+
+#include <stdint.h>
+
+#include "config.h"
+
+/// Maximum steps in one startup plan
+#define STARTUP_MAX_STEPS 32
+
+/// Dependency mask bit for the step at the given index
+#define STARTUP_DEP(index) (1u << (index))
+
+// ============================================================================
+// DATA STRUCTURES
+// ============================================================================
+
+/**
+ * @brief Step function
+ * @param userdata Pointer given in the step
+ * @return 0 on success, negative error code to abort startup
+ */
+typedef int (*StartupStepFunc)(void *userdata);
+
+/**
+ * @brief Step progress
+ */
+typedef enum {
+    STARTUP_PENDING = 0,                /// Waiting for dependencies
+    STARTUP_RUNNING,                    /// Executing
+    STARTUP_DONE,                       /// Succeeded
+    STARTUP_FAILED,                     /// Returned an error
+    STARTUP_SKIPPED                     /// Not run because startup failed
+} StartupStepState;
+
+/**
+ * @brief Startup step
+ */
+typedef struct {
+    const char *name;                   /// Phase name for logs and traces (string literal)
+    StartupStepFunc run;                /// Step function
+    void *userdata;                     /// Step function argument
+    uint32_t depends_on;                /// STARTUP_DEP() mask of steps that must succeed first
+    int on_worker;                      /// Run on a worker thread instead of the caller
+
+    StartupStepState state;             /// Progress (set by startup_run)
+    int result;                         /// Return value of run
+    uint64_t duration_us;               /// Execution time
+} StartupStep;
+
+// ============================================================================
+// PUBLIC API
+// ============================================================================
+
+/**
+ * @brief Record the process start time
+ *
+ * Call first thing in main(); startup metrics are measured from here.
+ */
+void startup_mark_origin(void);
+
+/**
+ * @brief Run a startup plan
+ * @param steps Step table; dependencies refer to indices in this table
+ * @param count Number of steps (at most STARTUP_MAX_STEPS)
+ * @param workers Worker threads for on_worker steps (at least 1)
+ * @return 0 if every step succeeded, otherwise the result of the first
+ *         failed step (ERROR_INVALID_PARAM for an unsatisfiable plan)
+ */
+int startup_run(StartupStep *steps, int count, int workers);
+
+/**
+ * @brief Record that the daemon now accepts Bluetooth connections
+ *
+ * Sets the startup_time_to_accept_ms gauge relative to the origin.
+ */
+void startup_mark_accepting(void);
+
+#endif // STARTUP_H
@@ -0,0 +1,139 @@
+/**
+ * @file state_file.c
+ * @brief Implementation of the persistent state file
+ */
+
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/stat.h>
+
+#include "state_file.h"
+#include "logger.h"
+#include "runtime_config.h"
+#include "timesource.h"
+
+/// Format version written to the file
+#define STATE_FILE_VERSION 1
+
+// ============================================================================
+// INTERNAL HELPER FUNCTIONS
+// ============================================================================
+
+/**
+ * @brief Create the directory holding the state file if it is missing
+ */
+static void ensure_directory(const char *path) {
+    char directory[256];
+    snprintf(directory, sizeof(directory), "%s", path);
+
+    char *slash = strrchr(directory, '/');
+    if (!slash || slash == directory) {
+        return;
+    }
+    *slash = '\0';
+
+    if (mkdir(directory, 0700) != 0 && errno != EEXIST) {
+        LOG_WARN("State: cannot create %s: %s", directory, strerror(errno));
+    }
+}
+
+// ============================================================================
+// PUBLIC API
+// ============================================================================
+
+int state_file_load(const char *path, PersistentState *state) {
+    if (!path || !state) {
+        return ERROR_INVALID_PARAM;
+    }
+
+    memset(state, 0, sizeof(PersistentState));
+
+    FILE *file = fopen(path, "r");
+    if (!file) {
+        if (errno != ENOENT) {
+            LOG_WARN("State: cannot open %s: %s", path, strerror(errno));
+        }
+        return ERROR_CONFIG_FILE;
+    }
+
+    char line[TOKEN_SIZE + 64];
+    while (fgets(line, sizeof(line), file)) {
+        char *key, *value;
+        if (runtime_config_split_line(line, &key, &value) <= 0) {
+            continue;
+        }
+
+        if (strcmp(key, "last_token") == 0) {
+            snprintf(state->last_token, sizeof(state->last_token), "%s", value);
+        } else if (strcmp(key, "saved_at") == 0) {
+            state->saved_at = strtoll(value, NULL, 10);
+        }
+    }
+
+    int failed = ferror(file);
+    fclose(file);
+
+    if (failed) {
+        LOG_WARN("State: error reading %s", path);
+        memset(state, 0, sizeof(PersistentState));
+        return ERROR_CONFIG_FILE;
+    }
+
+    return SUCCESS;
+}
+
+int state_file_save(const char *path, PersistentState *state) {
+    if (!path || !state) {
+        return ERROR_INVALID_PARAM;
+    }
+
+    char temp_path[256 + 8];
+    snprintf(temp_path, sizeof(temp_path), "%s.tmp", path);
+
+    ensure_directory(path);
+
+    int fd = open(temp_path, O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0600);
+    if (fd < 0) {
+        LOG_WARN("State: cannot write %s: %s", temp_path, strerror(errno));
+        return ERROR_CONFIG_FILE;
+    }
+
+    state->saved_at = (int64_t)timesource_wall();
+
+    char buffer[TOKEN_SIZE + 128];
+    int length = snprintf(buffer, sizeof(buffer),
+                          "# Door monitor state - rewritten by the daemon\n"
+                          "version = %d\n"
+                          "saved_at = %lld\n"
+                          "last_token = %s\n",
+                          STATE_FILE_VERSION,
+                          (long long)state->saved_at, state->last_token);
+
+    int result = SUCCESS;
+    if (length < 0 || (size_t)length >= sizeof(buffer) ||
+        write(fd, buffer, (size_t)length) != length || fsync(fd) != 0) {
+        LOG_WARN("State: failed to write %s: %s", temp_path, strerror(errno));
+        result = ERROR_CONFIG_FILE;
+    }
+
+    if (close(fd) != 0 && result == SUCCESS) {
+        result = ERROR_CONFIG_FILE;
+    }
+
+    if (result == SUCCESS && rename(temp_path, path) != 0) {
+        LOG_WARN("State: cannot replace %s: %s", path, strerror(errno));
+        result = ERROR_CONFIG_FILE;
+    }
+
+    if (result != SUCCESS) {
+        unlink(temp_path);
+    }
+
+    return result;
+}
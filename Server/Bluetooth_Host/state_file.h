@@ -0,0 +1,56 @@
+/**
+ * @file state_file.h
+ * @brief Persistent daemon state kept across restarts
+ *
+ * A small "key = value" file holding what the daemon would otherwise
+ * forget on restart: the FCM token of the last device that left, so a
+ * reminder or test-reminder right after a restart still has a recipient.
+ *
+ * The file is replaced atomically (write to a temporary file, fsync,
+ * rename) and created with owner-only permissions because it contains a
+ * device token. Unknown keys are ignored so older daemons can read files
+ * written by newer ones.
+ */
+
+#ifndef STATE_FILE_H
+#define STATE_FILE_H
+
+#include <stdint.h>
+
+#include "config.h"
+
+// ============================================================================
+// DATA STRUCTURES
+// ============================================================================
+
+/**
+ * @brief Persisted state
+ */
+typedef struct {
+    char last_token[TOKEN_SIZE];        /// FCM token of the last disconnected device
+    int64_t saved_at;                   /// Wall-clock time of the save (seconds)
+} PersistentState;
+
+// ============================================================================
+// FILE ACCESS
+// ============================================================================
+
+/**
+ * @brief Read the state file
+ * @param path State file path
+ * @param state Filled with the stored values (zeroed first)
+ * @return 0 on success, ERROR_CONFIG_FILE if the file is missing or unreadable
+ *
+ * Does not use the reactor; safe to call from a startup worker thread.
+ */
+int state_file_load(const char *path, PersistentState *state);
+
+/**
+ * @brief Replace the state file
+ * @param path State file path (its directory is created if missing)
+ * @param state Values to store; saved_at is set by this call
+ * @return 0 on success, negative on error
+ */
+int state_file_save(const char *path, PersistentState *state);
+
+#endif // STATE_FILE_H
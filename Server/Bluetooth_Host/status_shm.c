@@ -0,0 +1,249 @@
+/**
+ * @file status_shm.c
+ * @brief Implementation of the shared-memory status segment
+ *
+ * The segment is a regular file in tmpfs mapped with MAP_SHARED, so
+ * readers only need open() and mmap() and no -lrt. Values are gathered
+ * before the write window opens; inside it the reactor only copies them
+ * into the mapping, which keeps the odd-sequence phase a few hundred
+ * nanoseconds long.
+ */
+
+#define _GNU_SOURCE
+#include <stddef.h>
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+
+#include "status_shm.h"
+#include "health.h"
+#include "metrics.h"
+#include "logger.h"
+#include "timesource.h"
+#include "DoorStateDriver.h"
+
+// ============================================================================
+// PUBLISHED METRICS
+// ============================================================================
+
+/**
+ * @brief Counter copied into StatusShmCounters
+ */
+typedef struct {
+    const char *name;                   /// Registered metric name
+    size_t offset;                      /// Field in StatusShmCounters
+} PublishedCounter;
+
+static const PublishedCounter published_counters[] = {
+    { "dm_messages_processed_total", offsetof(StatusShmCounters, messages_processed) },
+    { "dm_devices_added_total", offsetof(StatusShmCounters, devices_added) },
+    { "dm_device_timeouts_total", offsetof(StatusShmCounters, device_timeouts) },
+    { "bt_connections_accepted_total", offsetof(StatusShmCounters, connections_accepted) },
+    { "notifier_sent_total", offsetof(StatusShmCounters, notifications_sent) },
+    { "notifier_failed_total", offsetof(StatusShmCounters, notifications_failed) },
+    { "reminder_delivered_total", offsetof(StatusShmCounters, reminders_delivered) },
+    { "reminder_abandoned_total", offsetof(StatusShmCounters, reminders_abandoned) },
+};
+
+#define PUBLISHED_COUNTER_COUNT \
+    ((int)(sizeof(published_counters) / sizeof(published_counters[0])))
+
+/// Gauge holding the number of connected devices
+#define DEVICES_GAUGE_NAME "dm_devices_connected"
+
+/// Resolved metrics; a subsystem that is not running yet is looked up again later
+static const Metric *counter_metrics[PUBLISHED_COUNTER_COUNT];
+static const Metric *devices_gauge = NULL;
+
+// ============================================================================
+// INTERNAL HELPER FUNCTIONS
+// ============================================================================
+
+/**
+ * @brief Find a registered metric by name
+ */
+static const Metric* find_metric(const char *name) {
+    for (const Metric *m = metrics_first(); m; m = __atomic_load_n(&m->next, __ATOMIC_ACQUIRE)) {
+        if (strcmp(m->name, name) == 0) {
+            return m;
+        }
+    }
+    return NULL;
+}
+
+/**
+ * @brief Read every published counter
+ */
+static void read_counters(StatusShmCounters *counters) {
+    memset(counters, 0, sizeof(*counters));
+    for (int i = 0; i < PUBLISHED_COUNTER_COUNT; i++) {
+        if (!counter_metrics[i]) {
+            counter_metrics[i] = find_metric(published_counters[i].name);
+        }
+        uint64_t value = metrics_counter_value(counter_metrics[i]);
+        memcpy((char*)counters + published_counters[i].offset, &value, sizeof(value));
+    }
+}
+
+/**
+ * @brief Read the room status, stamping changes against the published one
+ */
+static void read_room(const StatusShmRoom *published, StatusShmRoom *room, int64_t now) {
+    *room = *published;
+
+    if (!devices_gauge) {
+        devices_gauge = find_metric(DEVICES_GAUGE_NAME);
+    }
+    int64_t devices = metrics_gauge_value(devices_gauge);
+    room->devices = devices > 0 ? (uint32_t)devices : 0;
+    room->occupied = room->devices > 0;
+    room->door_state = (int32_t)getDoorState();
+
+    if (room->occupied != published->occupied) {
+        room->occupancy_changed = now;
+    }
+    if (room->door_state != published->door_state) {
+        room->door_changed = now;
+    }
+}
+
+/**
+ * @brief Reactor timer: refresh the counters and the health level
+ */
+static void refresh_timer(void *userdata) {
+    status_shm_publish((StatusShm*)userdata);
+}
+
+// ============================================================================
+// PUBLIC API
+// ============================================================================
+
+int status_shm_init(StatusShm *shm, Reactor *reactor,
+                    const struct HealthMonitor *health, const char *path) {
+    if (!shm || !reactor || !path) {
+        return ERROR_INVALID_PARAM;
+    }
+
+    memset(shm, 0, sizeof(StatusShm));
+    if (path[0] == '\0') {
+        LOG_INFO("Status segment disabled");
+        return 0;
+    }
+    if (strlen(path) >= sizeof(shm->path)) {
+        LOG_ERROR("Status segment path too long: %s", path);
+        return ERROR_INVALID_PARAM;
+    }
+
+    // Readable by local monitors; truncating first clears a previous run's data
+    int fd = open(path, O_RDWR | O_CREAT | O_NOFOLLOW | O_CLOEXEC, 0644);
+    if (fd < 0) {
+        LOG_WARN("Status segment: cannot open %s: %s", path, strerror(errno));
+        return ERROR_GENERIC;
+    }
+    if (ftruncate(fd, 0) != 0 || ftruncate(fd, sizeof(StatusShmSegment)) != 0) {
+        LOG_WARN("Status segment: cannot size %s: %s", path, strerror(errno));
+        close(fd);
+        unlink(path);
+        return ERROR_GENERIC;
+    }
+
+    StatusShmSegment *segment = mmap(NULL, sizeof(StatusShmSegment), PROT_READ | PROT_WRITE,
+                                     MAP_SHARED, fd, 0);
+    close(fd);
+    if (segment == MAP_FAILED) {
+        LOG_WARN("Status segment: cannot map %s: %s", path, strerror(errno));
+        unlink(path);
+        return ERROR_MEMORY;
+    }
+
+    snprintf(shm->path, sizeof(shm->path), "%s", path);
+    shm->reactor = reactor;
+    shm->health = health;
+    shm->segment = segment;
+
+    segment->version = STATUS_SHM_VERSION;
+    segment->size = sizeof(StatusShmSegment);
+    segment->pid = (int32_t)getpid();
+    segment->started = (int64_t)timesource_wall();
+    segment->health = -1;
+    segment->room_count = 1;
+    snprintf(segment->rooms[0].room_id, sizeof(segment->rooms[0].room_id), "%s", ROOM_ID);
+    segment->rooms[0].door_state = (int32_t)getDoorState();
+
+    // Date the current door state from the last edge the driver saw
+    int64_t last_edge_us = getDoorLastEventTime();
+    if (last_edge_us > 0) {
+        int64_t age_s = ((int64_t)timesource_now_us() - last_edge_us) / 1000000;
+        segment->rooms[0].door_changed = segment->started - age_s;
+    }
+    status_shm_publish(shm);
+    __atomic_store_n(&segment->magic, STATUS_SHM_MAGIC, __ATOMIC_RELEASE);
+
+    int timer_id = reactor_add_timer(reactor, STATUS_SHM_INTERVAL_MS, STATUS_SHM_INTERVAL_MS,
+                                     refresh_timer, shm);
+    if (timer_id < 0) {
+        LOG_WARN("Status segment: cannot schedule refresh timer");
+        status_shm_cleanup(shm);
+        return ERROR_GENERIC;
+    }
+    shm->timer_id = timer_id;
+
+    LOG_INFO("Status segment published at %s (%zu bytes, refreshed every %d ms)",
+             path, sizeof(StatusShmSegment), STATUS_SHM_INTERVAL_MS);
+    return 0;
+}
+
+void status_shm_cleanup(StatusShm *shm) {
+    if (!shm || !shm->segment) {
+        return;
+    }
+
+    if (shm->timer_id > 0) {
+        reactor_cancel_timer(shm->reactor, shm->timer_id);
+        shm->timer_id = 0;
+    }
+
+    // Readers that keep the old mapping see the daemon stopped
+    StatusShmSegment *segment = shm->segment;
+    uint64_t sequence = segment->sequence;
+    __atomic_store_n(&segment->sequence, sequence + 1, __ATOMIC_RELAXED);
+    __atomic_thread_fence(__ATOMIC_RELEASE);
+    segment->pid = 0;
+    __atomic_store_n(&segment->sequence, sequence + 2, __ATOMIC_RELEASE);
+
+    munmap(segment, sizeof(StatusShmSegment));
+    unlink(shm->path);
+    shm->segment = NULL;
+}
+
+void status_shm_publish(StatusShm *shm) {
+    if (!shm || !shm->segment) {
+        return;
+    }
+
+    StatusShmSegment *segment = shm->segment;
+    int64_t now = (int64_t)timesource_wall();
+
+    // Everything that may block or take a while happens before the write
+    StatusShmRoom room;
+    StatusShmCounters counters;
+    read_room(&segment->rooms[0], &room, now);
+    read_counters(&counters);
+    int32_t health = shm->health ? (int32_t)health_monitor_report(shm->health)->level : -1;
+
+    // Only the reactor writes, so the sequence can be read without ordering
+    uint64_t sequence = segment->sequence;
+    __atomic_store_n(&segment->sequence, sequence + 1, __ATOMIC_RELAXED);
+    __atomic_thread_fence(__ATOMIC_RELEASE);
+
+    segment->updated = now;
+    segment->updated_ms = timesource_now_ms();
+    segment->health = health;
+    segment->rooms[0] = room;
+    segment->counters = counters;
+
+    __atomic_store_n(&segment->sequence, sequence + 2, __ATOMIC_RELEASE);
+}
@@ -0,0 +1,175 @@
+/**
+ * @file status_shm.h
+ * @brief Room and door status published in a shared-memory segment
+ *
+ * Dashboards poll occupancy and door state far more often than the
+ * control socket or the metrics endpoint are meant to be scraped. The
+ * daemon therefore keeps a fixed-layout snapshot in a file under
+ * /dev/shm (setting status_shm_path) that local monitors map read-only:
+ * per-room occupancy and door state with the time of their last change,
+ * the health level and a few key counters.
+ *
+ * The reactor rewrites the segment on every door and occupancy change and
+ * every STATUS_SHM_INTERVAL_MS for the counters, under a sequence lock:
+ * the sequence is odd while a write is in progress and advances by two
+ * per update. Readers copy the segment and retry if the sequence changed
+ * underneath them (status_shm_read()), so they never make a syscall or
+ * take a lock, and the daemon never waits for a reader.
+ *
+ * The layout uses fixed-width fields only and is identified by
+ * STATUS_SHM_MAGIC and STATUS_SHM_VERSION; fields are only ever appended,
+ * and size tells a reader how much of the segment the daemon writes.
+ * On shutdown pid is cleared before the file is removed, so a reader that
+ * still has the old segment mapped sees that the daemon stopped.
+ *
+ * Threading:
+ * status_shm_init(), status_shm_publish() and status_shm_cleanup() run on
+ * the reactor thread. status_shm_read() may run in any process.
+ */
+
+#ifndef STATUS_SHM_H
+#define STATUS_SHM_H
+
+#include <stdint.h>
+#include <string.h>
+
+#include "config.h"
+#include "reactor.h"
+
+/// "DMST" in the first four bytes of the segment
+#define STATUS_SHM_MAGIC 0x54534D44u
+
+/// Layout version, incremented on incompatible changes
+#define STATUS_SHM_VERSION 1
+
+/// Copy attempts before status_shm_read() gives up on a busy writer
+#define STATUS_SHM_READ_ATTEMPTS 64
+
+// ============================================================================
+// SEGMENT LAYOUT
+// ============================================================================
+
+/**
+ * @brief Status of one room
+ */
+typedef struct {
+    char room_id[16];                   /// Room identifier (NUL-terminated)
+    uint32_t devices;                   /// Connected devices
+    uint32_t occupied;                  /// 1 if at least one device is connected
+    int32_t door_state;                 /// 0 locked, 1 unlocked, -1 sensor error
+    uint32_t reserved;                  /// Zero
+    int64_t occupancy_changed;          /// Wall-clock time occupied last changed (seconds), 0 if never
+    int64_t door_changed;               /// Wall-clock time door_state last changed (seconds), 0 if never
+} StatusShmRoom;
+
+/**
+ * @brief Totals since the daemon started
+ */
+typedef struct {
+    uint64_t messages_processed;        /// Device messages handled
+    uint64_t devices_added;             /// Devices registered
+    uint64_t device_timeouts;           /// Devices expired by the heartbeat sweep
+    uint64_t connections_accepted;      /// Bluetooth connections accepted
+    uint64_t notifications_sent;        /// FCM messages delivered
+    uint64_t notifications_failed;      /// FCM messages that failed
+    uint64_t reminders_delivered;       /// Reminders that reached a device
+    uint64_t reminders_abandoned;       /// Reminders given up after the last attempt
+} StatusShmCounters;
+
+/**
+ * @brief The shared segment
+ */
+typedef struct {
+    uint32_t magic;                     /// STATUS_SHM_MAGIC once the segment is valid
+    uint32_t version;                   /// STATUS_SHM_VERSION
+    uint32_t size;                      /// sizeof(StatusShmSegment) of the writer
+    int32_t pid;                        /// Daemon pid, 0 after shutdown
+    uint64_t sequence;                  /// Sequence lock; odd while the daemon writes
+    int64_t started;                    /// Wall-clock time the daemon started (seconds)
+    int64_t updated;                    /// Wall-clock time of the last update (seconds)
+    uint64_t updated_ms;                /// Monotonic time of the last update (milliseconds)
+    int32_t health;                     /// HealthLevel: 0 ok, 1 degraded, 2 failed, -1 unknown
+    uint32_t room_count;                /// Valid entries in rooms
+    StatusShmRoom rooms[STATUS_SHM_MAX_ROOMS]; /// Per-room status
+    StatusShmCounters counters;         /// Key counters
+} StatusShmSegment;
+
+// ============================================================================
+// WRITER
+// ============================================================================
+
+// Declared in health.h, which readers do not need
+struct HealthMonitor;
+
+/**
+ * @brief Writer state
+ */
+typedef struct {
+    Reactor *reactor;                   /// Loop running the refresh timer
+    const struct HealthMonitor *health; /// Source of the health level, or NULL
+    StatusShmSegment *segment;          /// Mapped segment, NULL if disabled
+    char path[256];                     /// Segment file
+    int timer_id;                       /// Refresh timer, 0 if none
+} StatusShm;
+
+/**
+ * @brief Create the segment and start refreshing it
+ * @param shm Pointer to writer state
+ * @param reactor Event loop running the refresh timer
+ * @param health Health monitor to publish the level of, or NULL
+ * @param path Segment file; empty disables publishing
+ * @return 0 on success or when disabled, negative on error
+ *
+ * An existing file at path is reused and cleared. Device counts and
+ * counters are read from the metrics registry, so the segment can be
+ * refreshed without taking any subsystem's lock.
+ */
+int status_shm_init(StatusShm *shm, Reactor *reactor,
+                    const struct HealthMonitor *health, const char *path);
+
+/**
+ * @brief Stop refreshing, mark the segment stopped and remove the file
+ * @param shm Pointer to writer state
+ */
+void status_shm_cleanup(StatusShm *shm);
+
+/**
+ * @brief Rewrite the segment now
+ * @param shm Pointer to writer state
+ *
+ * Called on door and occupancy changes so readers see them without
+ * waiting for the next refresh. Does nothing when publishing is disabled.
+ */
+void status_shm_publish(StatusShm *shm);
+
+// ============================================================================
+// READER
+// ============================================================================
+
+/**
+ * @brief Take a consistent copy of a mapped segment
+ * @param segment Segment mapped by the reader
+ * @param snapshot Receives the copy
+ * @return 0 on success, -1 if the segment is not (yet) valid or the
+ *         writer kept it busy for STATUS_SHM_READ_ATTEMPTS copies
+ *
+ * Header-only, so a monitor needs this file and the headers it includes
+ * but none of the daemon's code.
+ */
+static inline int status_shm_read(const StatusShmSegment *segment, StatusShmSegment *snapshot) {
+    for (int attempt = 0; attempt < STATUS_SHM_READ_ATTEMPTS; attempt++) {
+        uint64_t before = __atomic_load_n(&segment->sequence, __ATOMIC_ACQUIRE);
+        if (before & 1) {
+            continue;
+        }
+        memcpy(snapshot, (const void*)segment, sizeof(*snapshot));
+        __atomic_thread_fence(__ATOMIC_ACQUIRE);
+        if (__atomic_load_n(&segment->sequence, __ATOMIC_RELAXED) == before) {
+            return snapshot->magic == STATUS_SHM_MAGIC &&
+                   snapshot->version == STATUS_SHM_VERSION ? 0 : -1;
+        }
+    }
+    return -1;
+}
+
+#endif // STATUS_SHM_H
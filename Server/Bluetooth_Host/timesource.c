@@ -0,0 +1,116 @@
+/**
+ * @file timesource.c
+ * @brief Implementation of the real and virtual clocks
+ *
+ * The virtual clock is one atomic microsecond counter on the monotonic
+ * scale. The wall clock is derived from it by the offset between the two
+ * clocks at the moment the virtual clock was switched on.
+ */
+
+#define _GNU_SOURCE
+#include <time.h>
+
+#include "timesource.h"
+
+// ============================================================================
+// STATIC VARIABLES
+// ============================================================================
+
+/// Set once before other threads start, read-only afterwards
+static int virtual_clock = 0;
+
+/// Virtual monotonic time in microseconds (atomic)
+static uint64_t virtual_now_us = 0;
+
+/// Set by timesource_expect_io(), cleared by the reactor (atomic)
+static int expected_io = 0;
+
+/// Real monotonic and wall time when the virtual clock was switched on
+static uint64_t virtual_start_us = 0;
+static int64_t virtual_start_wall_us = 0;
+
+// ============================================================================
+// INTERNAL HELPER FUNCTIONS
+// ============================================================================
+
+/**
+ * @brief Read a system clock in microseconds
+ */
+static uint64_t read_clock_us(clockid_t clock) {
+    struct timespec ts;
+    clock_gettime(clock, &ts);
+    return (uint64_t)ts.tv_sec * 1000000ULL + (uint64_t)ts.tv_nsec / 1000ULL;
+}
+
+// ============================================================================
+// PUBLIC API
+// ============================================================================
+
+void timesource_use_virtual(void) {
+    if (virtual_clock) {
+        return;
+    }
+
+    virtual_start_us = read_clock_us(CLOCK_MONOTONIC);
+    virtual_start_wall_us = (int64_t)read_clock_us(CLOCK_REALTIME);
+    __atomic_store_n(&virtual_now_us, virtual_start_us, __ATOMIC_RELEASE);
+    virtual_clock = 1;
+}
+
+int timesource_is_virtual(void) {
+    return virtual_clock;
+}
+
+uint64_t timesource_now_us(void) {
+    if (virtual_clock) {
+        return __atomic_load_n(&virtual_now_us, __ATOMIC_ACQUIRE);
+    }
+    return read_clock_us(CLOCK_MONOTONIC);
+}
+
+uint64_t timesource_now_ms(void) {
+    return timesource_now_us() / 1000ULL;
+}
+
+uint64_t timesource_real_us(void) {
+    return read_clock_us(CLOCK_MONOTONIC);
+}
+
+time_t timesource_wall(void) {
+    if (virtual_clock) {
+        uint64_t elapsed = __atomic_load_n(&virtual_now_us, __ATOMIC_ACQUIRE) - virtual_start_us;
+        return (time_t)((virtual_start_wall_us + (int64_t)elapsed) / 1000000LL);
+    }
+    return time(NULL);
+}
+
+void timesource_advance_to_ms(uint64_t monotonic_ms) {
+    if (!virtual_clock) {
+        return;
+    }
+
+    uint64_t target = monotonic_ms * 1000ULL;
+    if (target > __atomic_load_n(&virtual_now_us, __ATOMIC_ACQUIRE)) {
+        __atomic_store_n(&virtual_now_us, target, __ATOMIC_RELEASE);
+    }
+}
+
+void timesource_expect_io(void) {
+    if (virtual_clock) {
+        __atomic_store_n(&expected_io, 1, __ATOMIC_RELEASE);
+    }
+}
+
+int timesource_take_expected_io(void) {
+    return __atomic_exchange_n(&expected_io, 0, __ATOMIC_ACQ_REL);
+}
+
+uint64_t timesource_ahead_ms(void) {
+    if (!virtual_clock) {
+        return 0;
+    }
+
+    uint64_t virtual_elapsed = __atomic_load_n(&virtual_now_us, __ATOMIC_ACQUIRE) - virtual_start_us;
+    uint64_t real_elapsed = read_clock_us(CLOCK_MONOTONIC) - virtual_start_us;
+    return virtual_elapsed > real_elapsed ? (virtual_elapsed - real_elapsed) / 1000ULL : 0;
+}
@@ -0,0 +1,104 @@
+/**
+ * @file timesource.h
+ * @brief Clock behind every timer, timeout and timestamp of the daemon
+ *
+ * Heartbeat expiry, the timeout sweep, reminder delays, OAuth token and JWT
+ * lifetimes, log timestamps and the reactor's timers all read time from
+ * here. Normally this is the system clock. With a virtual clock time stands
+ * still while the daemon works and, once the event loop is idle, jumps
+ * straight to the next timer deadline, so a day of a --simulate scenario
+ * plays in seconds with the same ordering as in real time.
+ *
+ * Work that finishes outside the loop thread (the simulated door thread,
+ * HTTP transfers) calls timesource_expect_io(); the loop then gives the
+ * answer up to VIRTUAL_CLOCK_IDLE_MS of real time to arrive before it
+ * jumps. Traffic from other processes is not waited for, so load tests
+ * such as door_monitor_loadgen belong on the real clock.
+ *
+ * Durations of code - trace spans, lock hold times, handler durations and
+ * scheduling latency - stay on the real clock (timesource_real_us()): they
+ * measure the CPU, not the schedule.
+ *
+ * Threading:
+ * timesource_use_virtual() must be called before any other thread starts.
+ * timesource_advance_to_ms() and timesource_take_expected_io() are called
+ * by the reactor thread only; the other functions may run on any thread.
+ */
+
+#ifndef TIMESOURCE_H
+#define TIMESOURCE_H
+
+#include <stdint.h>
+#include <time.h>
+
+// ============================================================================
+// PUBLIC API
+// ============================================================================
+
+/**
+ * @brief Switch to the virtual clock
+ *
+ * The virtual clock starts at the current real time and only moves when
+ * timesource_advance_to_ms() is called. There is no way back.
+ */
+void timesource_use_virtual(void);
+
+/**
+ * @brief Check whether the virtual clock is in use
+ * @return 1 if virtual, 0 if real
+ */
+int timesource_is_virtual(void);
+
+/**
+ * @brief Read the monotonic clock
+ * @return Microseconds since an arbitrary epoch
+ */
+uint64_t timesource_now_us(void);
+
+/**
+ * @brief Read the monotonic clock
+ * @return Milliseconds since an arbitrary epoch
+ */
+uint64_t timesource_now_ms(void);
+
+/**
+ * @brief Read the real monotonic clock, whichever clock is in use
+ * @return Microseconds since an arbitrary epoch
+ */
+uint64_t timesource_real_us(void);
+
+/**
+ * @brief Read the wall clock (replaces time(NULL))
+ * @return Seconds since the Unix epoch
+ */
+time_t timesource_wall(void);
+
+/**
+ * @brief Move the virtual clock forward
+ * @param monotonic_ms Target time on the timesource_now_ms() scale;
+ *                     earlier times are ignored
+ *
+ * Does nothing with the real clock.
+ */
+void timesource_advance_to_ms(uint64_t monotonic_ms);
+
+/**
+ * @brief Announce an answer that will arrive as I/O from outside the loop
+ *
+ * Does nothing with the real clock.
+ */
+void timesource_expect_io(void);
+
+/**
+ * @brief Consume the announcement made by timesource_expect_io()
+ * @return 1 if the loop should wait for I/O before the clock jumps, 0 if not
+ */
+int timesource_take_expected_io(void);
+
+/**
+ * @brief Virtual time gained on real time
+ * @return Milliseconds the virtual clock is ahead, 0 with the real clock
+ */
+uint64_t timesource_ahead_ms(void);
+
+#endif // TIMESOURCE_H
@@ -0,0 +1,309 @@
+/**
+ * @file trace.c
+ * @brief Implementation of span tracing with Chrome/Perfetto export
+ *
+ * Every thread owns one ring buffer, allocated on its first span and
+ * linked into a global list. Writers publish each event by advancing the
+ * buffer head with a release store; the exporter copies the ring and then
+ * discards any slot the writer may have overwritten during the copy.
+ */
+
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <sys/syscall.h>
+
+#include "trace.h"
+#include "logger.h"
+#include "timesource.h"
+
+// ============================================================================
+// DATA STRUCTURES
+// ============================================================================
+
+/**
+ * @brief One recorded span (duration 0 marks an instant event)
+ */
+typedef struct {
+    const char *category;               /// Span category
+    const char *name;                   /// Span name
+    uint64_t start_us;                  /// Monotonic start time in microseconds
+    uint64_t duration_us;               /// Span duration in microseconds
+    int instant;                        /// Non-zero for instantaneous events
+} TraceEvent;
+
+/**
+ * @brief Per-thread ring buffer
+ */
+typedef struct TraceBuffer {
+    pid_t tid;                          /// Kernel thread id
+    char thread_name[16];               /// Thread name for trace metadata
+    uint64_t head;                      /// Total events written (slot = head % size)
+    TraceEvent events[TRACE_BUFFER_EVENTS]; /// Event ring
+    struct TraceBuffer *next;           /// Next registered buffer
+} TraceBuffer;
+
+// ============================================================================
+// STATIC VARIABLES
+// ============================================================================
+
+static int trace_enabled = TRACE_ENABLED_DEFAULT;
+static pthread_mutex_t registry_mutex = PTHREAD_MUTEX_INITIALIZER;
+static TraceBuffer *buffer_list = NULL;
+static __thread TraceBuffer *thread_buffer = NULL;
+
+/// Span observer and its argument (atomic, the data is stored first)
+static TraceObserver trace_observer = NULL;
+static void *trace_observer_data = NULL;
+
+// ============================================================================
+// INTERNAL HELPER FUNCTIONS
+// ============================================================================
+
+/**
+ * @brief Get (allocating on first use) the calling thread's buffer
+ * @return Thread buffer, or NULL if allocation failed
+ */
+static TraceBuffer* get_thread_buffer(void) {
+    if (thread_buffer) {
+        return thread_buffer;
+    }
+
+    TraceBuffer *buffer = calloc(1, sizeof(TraceBuffer));
+    if (!buffer) {
+        return NULL;
+    }
+
+    buffer->tid = (pid_t)syscall(SYS_gettid);
+    snprintf(buffer->thread_name, sizeof(buffer->thread_name), "thread-%d", (int)buffer->tid);
+
+    pthread_mutex_lock(&registry_mutex);
+    buffer->next = buffer_list;
+    buffer_list = buffer;
+    pthread_mutex_unlock(&registry_mutex);
+
+    thread_buffer = buffer;
+    return buffer;
+}
+
+/**
+ * @brief Append an event to the calling thread's ring
+ * @param category Event category
+ * @param name Event name
+ * @param start_us Start time in microseconds
+ * @param duration_us Duration in microseconds
+ * @param instant Non-zero for instantaneous events
+ */
+static void record_event(const char *category, const char *name,
+                         uint64_t start_us, uint64_t duration_us, int instant) {
+    TraceBuffer *buffer = get_thread_buffer();
+    if (!buffer) {
+        return;
+    }
+
+    uint64_t head = buffer->head;
+    TraceEvent *event = &buffer->events[head % TRACE_BUFFER_EVENTS];
+    event->category = category;
+    event->name = name;
+    event->start_us = start_us;
+    event->duration_us = duration_us;
+    event->instant = instant;
+
+    // Publish the event to the exporter
+    __atomic_store_n(&buffer->head, head + 1, __ATOMIC_RELEASE);
+
+    TraceObserver observer = __atomic_load_n(&trace_observer, __ATOMIC_ACQUIRE);
+    if (observer) {
+        observer(category, name, start_us, start_us + duration_us,
+                 __atomic_load_n(&trace_observer_data, __ATOMIC_RELAXED));
+    }
+}
+
+/**
+ * @brief Write one thread's events to the trace file
+ * @param file Output file
+ * @param buffer Thread buffer to export
+ * @param pid Process id for the events
+ * @param first Pointer to flag tracking whether a separator is needed
+ * @return Number of events written
+ */
+static int export_buffer(FILE *file, TraceBuffer *buffer, int pid, int *first) {
+    static TraceEvent snapshot[TRACE_BUFFER_EVENTS];
+
+    uint64_t head = __atomic_load_n(&buffer->head, __ATOMIC_ACQUIRE);
+    uint64_t begin = (head > TRACE_BUFFER_EVENTS) ? head - TRACE_BUFFER_EVENTS : 0;
+
+    for (uint64_t i = begin; i < head; i++) {
+        snapshot[i - begin] = buffer->events[i % TRACE_BUFFER_EVENTS];
+    }
+
+    // Slots the writer reached during the copy (including the one it may
+    // be writing right now) can be torn - skip them
+    uint64_t head_after = __atomic_load_n(&buffer->head, __ATOMIC_ACQUIRE);
+    uint64_t valid_from = begin;
+    if (head_after + 1 > TRACE_BUFFER_EVENTS && head_after + 1 - TRACE_BUFFER_EVENTS > valid_from) {
+        valid_from = head_after + 1 - TRACE_BUFFER_EVENTS;
+    }
+    if (valid_from > head) {
+        valid_from = head;
+    }
+
+    fprintf(file, "%s{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":%d,\"tid\":%d,"
+            "\"args\":{\"name\":\"%s\"}}",
+            *first ? "" : ",\n", pid, (int)buffer->tid, buffer->thread_name);
+    *first = 0;
+
+    int written = 0;
+    for (uint64_t i = valid_from; i < head; i++) {
+        const TraceEvent *event = &snapshot[i - begin];
+        if (event->instant) {
+            fprintf(file, ",\n{\"name\":\"%s\",\"cat\":\"%s\",\"ph\":\"i\",\"s\":\"t\","
+                    "\"ts\":%llu,\"pid\":%d,\"tid\":%d}",
+                    event->name, event->category, (unsigned long long)event->start_us,
+                    pid, (int)buffer->tid);
+        } else {
+            fprintf(file, ",\n{\"name\":\"%s\",\"cat\":\"%s\",\"ph\":\"X\","
+                    "\"ts\":%llu,\"dur\":%llu,\"pid\":%d,\"tid\":%d}",
+                    event->name, event->category, (unsigned long long)event->start_us,
+                    (unsigned long long)event->duration_us, pid, (int)buffer->tid);
+        }
+        written++;
+    }
+
+    return written;
+}
+
+// ============================================================================
+// CONTROL
+// ============================================================================
+
+void trace_set_enabled(int enabled) {
+    __atomic_store_n(&trace_enabled, enabled ? 1 : 0, __ATOMIC_RELAXED);
+    LOG_INFO("Span tracing %s", enabled ? "enabled" : "disabled");
+}
+
+int trace_is_enabled(void) {
+    return __atomic_load_n(&trace_enabled, __ATOMIC_RELAXED);
+}
+
+void trace_set_thread_name(const char *name) {
+    TraceBuffer *buffer = get_thread_buffer();
+    if (buffer && name) {
+        snprintf(buffer->thread_name, sizeof(buffer->thread_name), "%s", name);
+    }
+}
+
+int trace_get_thread_name(int tid, char *name, size_t size) {
+    int result = -1;
+
+    pthread_mutex_lock(&registry_mutex);
+    for (TraceBuffer *buffer = buffer_list; buffer; buffer = buffer->next) {
+        if (buffer->tid == (pid_t)tid) {
+            snprintf(name, size, "%s", buffer->thread_name);
+            result = 0;
+            break;
+        }
+    }
+    pthread_mutex_unlock(&registry_mutex);
+
+    return result;
+}
+
+void trace_set_observer(TraceObserver observer, void *userdata) {
+    __atomic_store_n(&trace_observer, NULL, __ATOMIC_RELEASE);
+    if (observer) {
+        __atomic_store_n(&trace_observer_data, userdata, __ATOMIC_RELAXED);
+        __atomic_store_n(&trace_observer, observer, __ATOMIC_RELEASE);
+    }
+}
+
+// ============================================================================
+// RECORDING
+// ============================================================================
+
+uint64_t trace_begin(void) {
+    if (!__atomic_load_n(&trace_enabled, __ATOMIC_RELAXED)) {
+        return 0;
+    }
+    return timesource_real_us();
+}
+
+void trace_end(const char *category, const char *name, uint64_t start) {
+    if (start == 0) {
+        return; // Span started while tracing was disabled
+    }
+
+    uint64_t end = timesource_real_us();
+    record_event(category, name, start, end - start, 0);
+}
+
+void trace_instant(const char *category, const char *name) {
+    if (!__atomic_load_n(&trace_enabled, __ATOMIC_RELAXED)) {
+        return;
+    }
+    record_event(category, name, timesource_real_us(), 0, 1);
+}
+
+// ============================================================================
+// EXPORT
+// ============================================================================
+
+int trace_export_chrome(const char *path) {
+    static pthread_mutex_t export_mutex = PTHREAD_MUTEX_INITIALIZER;
+
+    if (!path) {
+        return ERROR_INVALID_PARAM;
+    }
+
+    // Created exclusively with mode 0600, so a symlink planted at the
+    // temporary name is never followed; rename() replaces one at path
+    char temp_path[512];
+    snprintf(temp_path, sizeof(temp_path), "%s.XXXXXX", path);
+
+    // The export snapshot buffer is shared, so exports are serialized
+    pthread_mutex_lock(&export_mutex);
+
+    int fd = mkostemp(temp_path, O_CLOEXEC);
+    FILE *file = (fd >= 0) ? fdopen(fd, "w") : NULL;
+    if (!file) {
+        pthread_mutex_unlock(&export_mutex);
+        LOG_ERROR("Trace export: cannot open %s", temp_path);
+        if (fd >= 0) {
+            close(fd);
+            unlink(temp_path);
+        }
+        return ERROR_GENERIC;
+    }
+
+    pthread_mutex_lock(&registry_mutex);
+    TraceBuffer *buffers = buffer_list;
+    pthread_mutex_unlock(&registry_mutex);
+
+    int pid = (int)getpid();
+    int first = 1;
+    int total = 0;
+
+    fprintf(file, "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n");
+    for (TraceBuffer *buffer = buffers; buffer; buffer = buffer->next) {
+        total += export_buffer(file, buffer, pid, &first);
+    }
+    fprintf(file, "\n]}\n");
+
+    int failed = ferror(file);
+    if (fclose(file) != 0 || failed || rename(temp_path, path) != 0) {
+        pthread_mutex_unlock(&export_mutex);
+        LOG_ERROR("Trace export: failed to write %s", path);
+        unlink(temp_path);
+        return ERROR_GENERIC;
+    }
+
+    pthread_mutex_unlock(&export_mutex);
+
+    LOG_INFO("Trace exported: %d events to %s", total, path);
+    return total;
+}
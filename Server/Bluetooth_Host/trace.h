@@ -0,0 +1,135 @@
+/**
+ * @file trace.h
+ * @brief Lightweight span tracing with Chrome/Perfetto export
+ *
+ * This module records timed spans (accept, receive, parse, notification,
+ * door interrupt, ...) into per-thread ring buffers. It acts as a flight
+ * recorder: the most recent TRACE_BUFFER_EVENTS spans of every thread are
+ * kept and can be exported on demand as Chrome trace event JSON, which
+ * both chrome://tracing and ui.perfetto.dev open directly.
+ *
+ * Features:
+ * - Lock-free recording: each thread writes only its own ring buffer
+ * - No allocation after a thread's first span
+ * - Thread names exported as trace metadata
+ * - Export can run while other threads keep recording
+ *
+ * Usage:
+ *   uint64_t span = trace_begin();
+ *   ... work ...
+ *   trace_end("bluetooth", "accept", span);
+ */
+
+#ifndef TRACE_H
+#define TRACE_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "config.h"
+
+// ============================================================================
+// DATA STRUCTURES
+// ============================================================================
+
+/**
+ * @brief Callback seeing every recorded span and instant
+ * @param category Span category
+ * @param name Span name
+ * @param start_us Monotonic start time in microseconds
+ * @param end_us Monotonic end time (equal to start_us for instants)
+ * @param userdata Pointer given to trace_set_observer()
+ *
+ * Runs on the recording thread, so it must be quick and thread-safe.
+ */
+typedef void (*TraceObserver)(const char *category, const char *name,
+                              uint64_t start_us, uint64_t end_us, void *userdata);
+
+// ============================================================================
+// CONTROL
+// ============================================================================
+
+/**
+ * @brief Enable or disable span recording
+ * @param enabled Non-zero to record spans
+ *
+ * Recording is enabled by default (TRACE_ENABLED_DEFAULT). While disabled,
+ * trace_begin() returns 0 and no span is recorded.
+ */
+void trace_set_enabled(int enabled);
+
+/**
+ * @brief Check whether span recording is enabled
+ * @return 1 if enabled, 0 otherwise
+ */
+int trace_is_enabled(void);
+
+/**
+ * @brief Name the calling thread in exported traces
+ * @param name Thread name (truncated to 15 characters)
+ */
+void trace_set_thread_name(const char *name);
+
+/**
+ * @brief Look up the name a thread gave itself
+ * @param tid Kernel thread id
+ * @param name Receives the name
+ * @param size Size of name
+ * @return 0 if the thread has a trace buffer, -1 otherwise
+ */
+int trace_get_thread_name(int tid, char *name, size_t size);
+
+/**
+ * @brief Watch recorded spans as they happen
+ * @param observer Callback, or NULL to stop observing
+ * @param userdata Passed to the callback
+ *
+ * Used by the simulation to time stages of the reminder path. Only spans
+ * recorded while tracing is enabled are seen; one observer at a time.
+ */
+void trace_set_observer(TraceObserver observer, void *userdata);
+
+// ============================================================================
+// RECORDING
+// ============================================================================
+
+/**
+ * @brief Start a span
+ * @return Start timestamp in microseconds, or 0 if tracing is disabled
+ */
+uint64_t trace_begin(void);
+
+/**
+ * @brief Finish a span started with trace_begin()
+ * @param category Span category (static string)
+ * @param name Span name (static string)
+ * @param start Value returned by trace_begin()
+ *
+ * The strings are stored by pointer and must outlive the process, which
+ * string literals do.
+ */
+void trace_end(const char *category, const char *name, uint64_t start);
+
+/**
+ * @brief Record an instantaneous event
+ * @param category Event category (static string)
+ * @param name Event name (static string)
+ */
+void trace_instant(const char *category, const char *name);
+
+// ============================================================================
+// EXPORT
+// ============================================================================
+
+/**
+ * @brief Export all buffered spans as Chrome trace event JSON
+ * @param path Output file path
+ * @return Number of events written, negative on error
+ *
+ * The file is written to a temporary name and renamed into place, so
+ * readers never see a partial trace. Load it in ui.perfetto.dev or
+ * chrome://tracing.
+ */
+int trace_export_chrome(const char *path);
+
+#endif // TRACE_H
@@ -15,14 +15,59 @@
  * Debounce Handling:
  * - Hardware debounce: configurable microseconds via config.h
  * - Prevents multiple interrupts from mechanical switch bounce
+ * 
+ * Event Delivery:
+ * - wiringPi runs the ISR on its own thread
+ * - The ISR records the state and signals an eventfd, which the
+ *   main event loop watches to react to door changes
+ * 
+ * Simulation:
+ * - initSimulated() replaces wiringPi with a local thread that receives
+ *   scripted edges and runs the same ISR callback, so the rest of the
+ *   daemon cannot tell the difference
  */
 
+#include <pthread.h>
+#include <sys/eventfd.h>
+
 #include "config.h"
+#include "logger.h"
+#include "trace.h"
+#include "metrics.h"
+#include "timesource.h"
 #include "DoorStateDriver.h"
 
 /// Global variable to store current door state (volatile for ISR access)
 volatile DoorState boltState = ERROR;
 
+/// Event counter signalled by the ISR on every edge (-1 before init)
+static int doorEventFd = -1;
+
+/// timesource_now_us() time of the last edge (0 before the first)
+static int64_t lastEventUs = 0;
+
+/// Run once on the ISR thread before its first edge is handled (may be NULL)
+static void (*isrThreadHook)(void) = NULL;
+
+/// Pipe carrying scripted edges to the simulated ISR thread (-1 if unused)
+static int simEdgePipe[2] = { -1, -1 };
+
+/// Scripted edge as queued by simulateDoorEdge()
+typedef struct {
+    int edge;                     /// INT_EDGE_RISING or INT_EDGE_FALLING
+    long long int timeStamp_us;   /// CLOCK_MONOTONIC time the edge was queued
+} SimulatedEdge;
+
+/// Driver metrics (updated only from the ISR thread)
+static Metric door_interrupts = METRIC_COUNTER_INIT("door_interrupts_total",
+    "Door sensor interrupts handled");
+static Metric door_state_changes = METRIC_COUNTER_INIT("door_state_changes_total",
+    "Door state transitions");
+static Metric door_isr_errors = METRIC_COUNTER_INIT("door_isr_errors_total",
+    "Interrupts that left the door in the ERROR state");
+static Metric door_isr_latency = METRIC_HISTOGRAM_INIT("door_isr_latency_us",
+    "Delay from edge timestamp to ISR callback in microseconds");
+
 /**
  * @brief Set door state (private function)
  * @param state New door state to set
@@ -30,10 +75,29 @@ volatile DoorState boltState = ERROR;
  * This function is used internally to update the door state.
  * It's marked as static to prevent external access and ensure
  * state changes only occur through proper interrupt handling.
+ * Actual transitions are reported through the logger.
  */
 static void setDoorState(DoorState state)
 {
+    DoorState previous = boltState;
     boltState = state;
+    
+    if (previous != state)
+    {
+        log_door_state_change(previous, state);
+        METRICS_INC(&door_state_changes);
+    }
+}
+
+/**
+ * @brief Wake the event loop after an edge (private function)
+ */
+static void signalDoorEvent(void)
+{
+    uint64_t one = 1;
+    
+    if (doorEventFd >= 0 && write(doorEventFd, &one, sizeof(one)) != sizeof(one))
+        METRICS_INC(&door_isr_errors);
 }
 
 /**
@@ -54,18 +118,36 @@ void doorLockedOrUnlocked(struct WPIWfiStatus wfiStatus, void* userdata)
 {
     long long int timenow, diff;
     struct timespec curr;
+    static int thread_named = 0;
+    
+    // wiringPi runs every ISR callback on the same dedicated thread
+    if (!thread_named)
+    {
+        trace_set_thread_name("door_isr");
+        if (isrThreadHook)
+            isrThreadHook();
+        thread_named = 1;
+    }
+    uint64_t span = trace_begin();
+    METRICS_INC(&door_interrupts);
     
-    // Get current timestamp for potential future use
+    // Get current timestamp to measure interrupt delivery latency
     if (clock_gettime(CLOCK_MONOTONIC, &curr) == -1)
     {
-        printf("clock_gettime error: %s\n", strerror(errno));
+        LOG_ERROR("Door ISR: clock_gettime error: %s", strerror(errno));
+        METRICS_INC(&door_isr_errors);
         setDoorState(ERROR);
+        signalDoorEvent();
+        trace_end("driver", "door_isr", span);
         return;
     }
     
     // Convert to microseconds for comparison with wfiStatus.timeStamp_us
     timenow = curr.tv_sec * 1000000LL + curr.tv_nsec/1000L;
+    __atomic_store_n(&lastEventUs, (int64_t)timesource_now_us(), __ATOMIC_RELAXED);
     diff = timenow - wfiStatus.timeStamp_us;
+    if (diff >= 0)
+        metrics_histogram_observe(&door_isr_latency, (uint64_t)diff);
     
     // Update door state based on interrupt edge
     if (wfiStatus.edge == INT_EDGE_RISING)
@@ -73,7 +155,65 @@ void doorLockedOrUnlocked(struct WPIWfiStatus wfiStatus, void* userdata)
     else if (wfiStatus.edge == INT_EDGE_FALLING)
         setDoorState(LOCKED);
     else
+    {
+        METRICS_INC(&door_isr_errors);
         setDoorState(ERROR);
+    }
+    
+    signalDoorEvent();
+    trace_end("driver", "door_isr", span);
+}
+
+/**
+ * @brief Register metrics and create the event fd (private function)
+ * @return 0 on success, -5 if the event fd cannot be created
+ */
+static int prepareDoorEvents(void)
+{
+    Metric *driver_metrics[] = {
+        &door_interrupts, &door_state_changes, &door_isr_errors, &door_isr_latency
+    };
+    metrics_register_all(driver_metrics, sizeof(driver_metrics) / sizeof(driver_metrics[0]));
+    
+    // Create the event fd before the ISR can fire
+    if (doorEventFd < 0)
+    {
+        doorEventFd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+        if (doorEventFd < 0)
+        {
+            LOG_ERROR("Unable to create door event fd: %s", strerror(errno));
+            return -5;
+        }
+    }
+    
+    return 0;
+}
+
+/**
+ * @brief Simulated interrupt thread (private function)
+ * @param arg Unused
+ * 
+ * Plays the part of the wiringPi interrupt thread: every scripted edge is
+ * handed to doorLockedOrUnlocked() with the time it was queued, so the
+ * interrupt latency histogram measures the real hand-off delay.
+ */
+static void* simulatedIsrThread(void *arg)
+{
+    SimulatedEdge queued;
+    (void)arg;
+    
+    while (read(simEdgePipe[0], &queued, sizeof(queued)) == sizeof(queued))
+    {
+        struct WPIWfiStatus status = {
+            .statusOK = 1,
+            .pinBCM = DOOR_SENSOR_PIN,
+            .edge = queued.edge,
+            .timeStamp_us = queued.timeStamp_us
+        };
+        doorLockedOrUnlocked(status, NULL);
+    }
+    
+    return NULL;
 }
 
 /**
@@ -84,6 +224,7 @@ void doorLockedOrUnlocked(struct WPIWfiStatus wfiStatus, void* userdata)
  * @retval -2 ISR setup failed
  * @retval -3 Pin mode configuration failed
  * @retval -4 Pull control configuration failed
+ * @retval -5 Event fd creation failed
  * 
  * This function performs complete initialization of the door sensor:
  * 1. Initialize WiringPi library
@@ -96,31 +237,39 @@ void doorLockedOrUnlocked(struct WPIWfiStatus wfiStatus, void* userdata)
  */
 int init(void)
 {
+    int result = prepareDoorEvents();
+    if (result != 0)
+        return result;
+    
+#ifdef DOOR_MONITOR_NO_WIRINGPI
+    LOG_ERROR("Built without wiringPi: the door sensor is only available in simulation");
+    return -1;
+#else
     // Initialize WiringPi library
     if (wiringPiSetup() < 0)
     {
-        fprintf(stderr, "Unable to setup wiringPi: %s\n", strerror(errno));
+        LOG_ERROR("Unable to setup wiringPi: %s", strerror(errno));
         return -1;
     }
     
     // Setup interrupt service routine with hardware debounce
     if (wiringPiISR2(DOOR_SENSOR_PIN, INT_EDGE_BOTH, &doorLockedOrUnlocked, BOUNCE_TIME_US, NULL) < 0)
     {
-        fprintf(stderr, "Unable to setup ISR: %s\n", strerror(errno));
+        LOG_ERROR("Unable to setup ISR: %s", strerror(errno));
         return -2;
     }
     
     // Configure pin as input
     if (pinMode(DOOR_SENSOR_PIN, INPUT) < 0)
     {
-        fprintf(stderr, "Unable to set pin as input: %s\n", strerror(errno));
+        LOG_ERROR("Unable to set pin as input: %s", strerror(errno));
         return -3;
     }
     
     // Enable pull-down resistor (sensor pulls high when activated)
     if (pullUpDnControl(DOOR_SENSOR_PIN, DOWN) < 0)
     {
-        fprintf(stderr, "Unable to setup pull-down control: %s\n", strerror(errno));
+        LOG_ERROR("Unable to setup pull-down control: %s", strerror(errno));
         return -4;
     }
     
@@ -128,6 +277,83 @@ int init(void)
     setDoorState(ERROR);
     
     return 0;
+#endif
+}
+
+/**
+ * @brief Initialize the driver with a scripted door instead of GPIO
+ * @return 0 on success, negative value on error
+ * @retval -2 Simulated interrupt thread could not be started
+ * @retval -5 Event fd creation failed
+ * 
+ * Edges are queued with simulateDoorEdge() and handled on a dedicated
+ * thread by the same callback wiringPi would call, including the thread
+ * hook, metrics and logs. Use instead of init(), never both.
+ */
+int initSimulated(void)
+{
+    pthread_t thread;
+    int result = prepareDoorEvents();
+    if (result != 0)
+        return result;
+    
+    if (pipe(simEdgePipe) != 0)
+    {
+        LOG_ERROR("Unable to create simulated door pipe: %s", strerror(errno));
+        return -2;
+    }
+    
+    if (pthread_create(&thread, NULL, simulatedIsrThread, NULL) != 0)
+    {
+        LOG_ERROR("Unable to start simulated door interrupt thread");
+        close(simEdgePipe[0]);
+        close(simEdgePipe[1]);
+        simEdgePipe[0] = simEdgePipe[1] = -1;
+        return -2;
+    }
+    pthread_detach(thread);
+    
+    // Same starting point as the hardware: unknown until the first edge
+    setDoorState(ERROR);
+    
+    return 0;
+}
+
+/**
+ * @brief Queue a scripted door edge
+ * @param edge INT_EDGE_RISING (unlocked) or INT_EDGE_FALLING (locked)
+ * @return 0 on success, -1 if the driver is not simulated or the queue failed
+ */
+int simulateDoorEdge(int edge)
+{
+    SimulatedEdge queued;
+    struct timespec now;
+    
+    if (simEdgePipe[1] < 0)
+        return -1;
+    
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    queued.edge = edge;
+    queued.timeStamp_us = now.tv_sec * 1000000LL + now.tv_nsec / 1000L;
+    
+    // The edge comes back through the event fd; hold a virtual clock for it
+    timesource_expect_io();
+    
+    // Edges are smaller than PIPE_BUF, so each write is atomic
+    return write(simEdgePipe[1], &queued, sizeof(queued)) == sizeof(queued) ? 0 : -1;
+}
+
+/**
+ * @brief Register a function run once on the interrupt thread
+ * @param hook Called on the first interrupt, before the edge is handled
+ * 
+ * wiringPi creates the interrupt thread itself, so settings such as its
+ * scheduling priority or CPU affinity can only be applied from inside.
+ * Call before init().
+ */
+void setDoorIsrThreadHook(void (*hook)(void))
+{
+    isrThreadHook = hook;
 }
 
 /**
@@ -147,4 +373,39 @@ int init(void)
 DoorState getDoorState(void)
 {
     return boltState;
+}
+
+/**
+ * @brief Get the door event fd
+ * @return Event fd that becomes readable after door edges, -1 before init()
+ */
+int getDoorEventFd(void)
+{
+    return doorEventFd;
+}
+
+/**
+ * @brief Get the time of the last door edge
+ * @return timesource_now_us() time, 0 if no edge was seen yet
+ */
+int64_t getDoorLastEventTime(void)
+{
+    return __atomic_load_n(&lastEventUs, __ATOMIC_RELAXED);
+}
+
+/**
+ * @brief Consume pending door events
+ * @return Number of edges signalled since the previous call
+ * 
+ * Call from the event loop when the door event fd is readable, then
+ * read the resulting state with getDoorState().
+ */
+int consumeDoorEvents(void)
+{
+    uint64_t count = 0;
+    
+    if (doorEventFd < 0 || read(doorEventFd, &count, sizeof(count)) != sizeof(count))
+        return 0;
+    
+    return (int)count;
 }
\ No newline at end of file
@@ -17,12 +17,30 @@
  * 1. Call init() to initialize the GPIO driver
  * 2. Use getDoorState() to read current door state
  * 3. The state is updated automatically via interrupts
+ * 4. Watch getDoorEventFd() in an event loop to be woken on changes
+ * 
+ * For simulation, call initSimulated() instead of init() and feed edges
+ * with simulateDoorEdge(). Defining DOOR_MONITOR_NO_WIRINGPI builds the
+ * driver without wiringPi (for laptops); init() then always fails.
  */
 
 #ifndef DOORSTATEDRIVER_H
 #define DOORSTATEDRIVER_H
 
+#ifdef DOOR_MONITOR_NO_WIRINGPI
+/// wiringPi definitions the driver relies on, for builds without wiringPi
+#define INT_EDGE_FALLING 1
+#define INT_EDGE_RISING  2
+#define INT_EDGE_BOTH    3
+struct WPIWfiStatus {
+    int statusOK;
+    unsigned int pinBCM;
+    int edge;
+    long long int timeStamp_us;
+};
+#else
 #include <wiringPi.h>
+#endif
 #include <stdio.h>
 #include <string.h>
 #include <unistd.h>
@@ -53,6 +71,7 @@ typedef enum {
  * @retval -2 ISR setup failed
  * @retval -3 Pin mode configuration failed
  * @retval -4 Pull control configuration failed
+ * @retval -5 Event fd creation failed
  * 
  * This function performs complete initialization of the door sensor:
  * 1. Initialize WiringPi library
@@ -64,6 +83,34 @@ typedef enum {
  */
 int init(void);
 
+/**
+ * @brief Initialize the driver with a scripted door instead of GPIO
+ * @return 0 on success, negative value on error
+ * @retval -2 Simulated interrupt thread could not be started
+ * @retval -5 Event fd creation failed
+ * 
+ * Edges queued with simulateDoorEdge() go through doorLockedOrUnlocked()
+ * on a dedicated thread, exactly like hardware interrupts.
+ */
+int initSimulated(void);
+
+/**
+ * @brief Queue a scripted door edge
+ * @param edge INT_EDGE_RISING (unlocked) or INT_EDGE_FALLING (locked)
+ * @return 0 on success, -1 if the driver is not simulated or the queue failed
+ */
+int simulateDoorEdge(int edge);
+
+/**
+ * @brief Register a function run once on the interrupt thread
+ * @param hook Called on the first interrupt, before the edge is handled
+ * 
+ * wiringPi creates the interrupt thread internally; the hook is the only
+ * way to apply per-thread settings (priority, CPU affinity) to it.
+ * Call before init().
+ */
+void setDoorIsrThreadHook(void (*hook)(void));
+
 /**
  * @brief Get current door state
  * @return Current door state
@@ -78,6 +125,30 @@ int init(void);
  */
 DoorState getDoorState(void);
 
+/**
+ * @brief Get the door event fd
+ * @return Non-blocking eventfd, or -1 if init() hasn't been called
+ * 
+ * The fd becomes readable whenever the interrupt handler has processed
+ * an edge. It is owned by the driver and must not be closed.
+ */
+int getDoorEventFd(void);
+
+/**
+ * @brief Get the time of the last door edge
+ * @return timesource_now_us() time, 0 if no edge was seen yet
+ * 
+ * The door only produces interrupts when it moves, so an old timestamp
+ * is normal; callers use it to tell "no edge yet" from a sensor error.
+ */
+int64_t getDoorLastEventTime(void);
+
+/**
+ * @brief Consume pending door events
+ * @return Number of edges signalled since the previous call
+ */
+int consumeDoorEvents(void);
+
 /**
  * @brief Interrupt callback function for door state changes
  * @param wfiStatus WiringPi interrupt status structure containing edge info and timestamp
@@ -2,14 +2,34 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#ifndef DOOR_MONITOR_MINIMAL_HTTP
 #include <curl/curl.h>
-#include <json-c/json.h>
+#endif
 
 // Configuration and module imports
 #include "config.h"
+#include "logger.h"
+#include "trace.h"
+#include "metrics.h"
 #include "fcm_notification.h"
 #include "fcm_token.h"
 
+#ifndef DOOR_MONITOR_MINIMAL_HTTP
+
+// Registered on first use; the standalone door_reminder tool never reads them
+static Metric oauth_requests = METRIC_COUNTER_INIT("fcm_oauth_requests_total",
+    "OAuth access token requests");
+static Metric oauth_failures = METRIC_COUNTER_INIT("fcm_oauth_failures_total",
+    "OAuth access token requests that failed");
+static Metric notifications_sent = METRIC_COUNTER_INIT("fcm_notifications_sent_total",
+    "Notifications accepted by FCM");
+static Metric notifications_failed = METRIC_COUNTER_INIT("fcm_notifications_failed_total",
+    "Notifications that could not be delivered to FCM");
+static Metric http_errors = METRIC_COUNTER_INIT("fcm_http_errors_total",
+    "FCM send requests that failed at the transport level");
+static Metric http_duration = METRIC_HISTOGRAM_INIT("fcm_http_duration_us",
+    "FCM send request duration in microseconds");
+
 struct APIResponse {
     char *data;
     size_t size;
@@ -20,7 +40,7 @@ static size_t WriteCallback(void *contents, size_t size, size_t nmemb, struct AP
     size_t realsize = size * nmemb;
     char *ptr = realloc(response->data, response->size + realsize + 1);
     if (!ptr) {
-        printf("Error: insufficient memory (realloc failed)\n");
+        LOG_ERROR("FCM response: insufficient memory (realloc failed)");
         return 0;
     }
 
@@ -32,55 +52,123 @@ static size_t WriteCallback(void *contents, size_t size, size_t nmemb, struct AP
     return realsize;
 }
 
-static char* create_fcm_message_json(const char* app_token, const char* title, 
-                                   const char* body, const char* data_type) {
-    json_object *root = json_object_new_object();
-    json_object *message = json_object_new_object();
-    json_object *notification = json_object_new_object();
-
-    // Add destination for the message
-    json_object_object_add(message, "token", json_object_new_string(app_token));
-
-    // Add title and message text
-    json_object_object_add(notification, "title", json_object_new_string(title));
-    json_object_object_add(notification, "body", json_object_new_string(body));
-    json_object_object_add(message, "notification", notification);
-
-    // Add additional data
-    if (data_type && strlen(data_type) > 0) {
-        json_object *data = json_object_new_object();
-        json_object_object_add(data, "type", json_object_new_string(data_type));
-        json_object_object_add(message, "data", data);
+#endif // DOOR_MONITOR_MINIMAL_HTTP
+
+// Output position of format_fcm_message_json; counts past the end of the buffer
+struct JsonWriter {
+    char *buffer;
+    size_t size;
+    size_t length;
+};
+
+static void json_put(struct JsonWriter *writer, const char *text, size_t length) {
+    if (writer->length < writer->size) {
+        size_t room = writer->size - writer->length;
+        memcpy(writer->buffer + writer->length, text, length < room ? length : room);
+    }
+    writer->length += length;
+}
+
+static void json_put_raw(struct JsonWriter *writer, const char *text) {
+    json_put(writer, text, strlen(text));
+}
+
+// Writes a quoted JSON string, escaping quotes, backslashes and control characters
+static void json_put_string(struct JsonWriter *writer, const char *text) {
+    const char *run = text;
+    const char *p;
+
+    json_put(writer, "\"", 1);
+    for (p = text; *p; p++) {
+        unsigned char c = (unsigned char)*p;
+        if (c != '"' && c != '\\' && c >= 0x20) {
+            continue;
+        }
+
+        // Copy the characters before this one unchanged, then its escape
+        json_put(writer, run, (size_t)(p - run));
+        run = p + 1;
+
+        char escape[8];
+        switch (c) {
+            case '"':  json_put(writer, "\\\"", 2); break;
+            case '\\': json_put(writer, "\\\\", 2); break;
+            case '\n': json_put(writer, "\\n", 2); break;
+            case '\r': json_put(writer, "\\r", 2); break;
+            case '\t': json_put(writer, "\\t", 2); break;
+            default:
+                snprintf(escape, sizeof(escape), "\\u%04x", c);
+                json_put(writer, escape, 6);
+                break;
+        }
+    }
+    json_put(writer, run, (size_t)(p - run));
+    json_put(writer, "\"", 1);
+}
+
+int format_fcm_message_json(char* buffer, size_t buffer_size, const char* app_token,
+                            const char* title, const char* body, const char* data_type) {
+    struct JsonWriter writer = { buffer, buffer_size, 0 };
+
+    // Destination, title and message text
+    json_put_raw(&writer, "{\"message\":{\"token\":");
+    json_put_string(&writer, app_token);
+    json_put_raw(&writer, ",\"notification\":{\"title\":");
+    json_put_string(&writer, title);
+    json_put_raw(&writer, ",\"body\":");
+    json_put_string(&writer, body);
+    json_put_raw(&writer, "}");
+
+    // Additional data
+    if (data_type && data_type[0] != '\0') {
+        json_put_raw(&writer, ",\"data\":{\"type\":");
+        json_put_string(&writer, data_type);
+        json_put_raw(&writer, "}");
     }
+    json_put_raw(&writer, "}}");
 
-    // Add the message to the main JSON object
-    json_object_object_add(root, "message", message);
+    if (buffer_size > 0) {
+        buffer[writer.length < buffer_size ? writer.length : buffer_size - 1] = '\0';
+    }
+    return (int)writer.length;
+}
 
-    // Convert to JSON string
-    const char* json_string = json_object_to_json_string(root);
-    char* result = strdup(json_string);
+char* create_fcm_message_json(const char* app_token, const char* title, 
+                              const char* body, const char* data_type) {
+    int length = format_fcm_message_json(NULL, 0, app_token, title, body, data_type);
+    char* result = malloc((size_t)length + 1);
+    if (!result) {
+        return NULL;
+    }
 
-    // Free memory
-    json_object_put(root);
+    format_fcm_message_json(result, (size_t)length + 1, app_token, title, body, data_type);
     return result;
 }
 
+int build_fcm_url(char* url, size_t url_size, const char* project_id) {
+    int written = snprintf(url, url_size, FCM_API_URL_TEMPLATE, project_id);
+    return (written < 0 || (size_t)written >= url_size) ? -1 : 0;
+}
+
+#ifndef DOOR_MONITOR_MINIMAL_HTTP
+
 // Sends the notification to FCM
 int send_fcm_notification(const char* oauth_token, const char* app_token, 
                          const char* title, const char* body, 
                          const char* data_type, const char* project_id) {
     if (!oauth_token || !app_token || !title || !body || !project_id) {
-        printf("Error: missing required parameters\n");
+        LOG_ERROR("FCM send: missing required parameters");
         return -1;
     }
 
     char* message_json = create_fcm_message_json(app_token, title, body, data_type);
     if (!message_json) {
-        printf("Error: failed to create JSON message\n");
+        LOG_ERROR("FCM send: failed to create JSON message");
         return -1;
     }
 
-    printf("FCM message JSON: %s\n", message_json);
+    // The message embeds the recipient token, so only its size is logged
+    LOG_DEBUG("FCM message built (%zu bytes)", strlen(message_json));
 
     CURL *curl;
     CURLcode res;
@@ -88,7 +176,7 @@ int send_fcm_notification(const char* oauth_token, const char* app_token,
 
     curl = curl_easy_init();
     if (!curl) {
-        printf("Error: failed to initialize curl\n");
+        LOG_ERROR("FCM send: failed to initialize curl");
         free(message_json);
         return -1;
     }
@@ -103,8 +191,13 @@ int send_fcm_notification(const char* oauth_token, const char* app_token,
 
     // Build the FCM API URL
     char fcm_url[512];
-    snprintf(fcm_url, sizeof(fcm_url), 
-             "https://fcm.googleapis.com/v1/projects/%s/messages:send", project_id);
+    if (build_fcm_url(fcm_url, sizeof(fcm_url), project_id) < 0) {
+        LOG_ERROR("FCM send: project id too long");
+        curl_slist_free_all(headers);
+        curl_easy_cleanup(curl);
+        free(message_json);
+        return -1;
+    }
 
     // Configure curl options
     curl_easy_setopt(curl, CURLOPT_URL, fcm_url);
@@ -113,8 +206,15 @@ int send_fcm_notification(const char* oauth_token, const char* app_token,
     curl_easy_setopt(curl, CURLOPT_WRITEFUNCTION, WriteCallback);
     curl_easy_setopt(curl, CURLOPT_WRITEDATA, &response);
 
-    printf("Sending FCM notification...\n");
+    LOG_DEBUG("Sending FCM notification to project %s", project_id);
+    uint64_t span = trace_begin();
     res = curl_easy_perform(curl);
+    trace_end("notification", "fcm_http", span);
+
+    double total_time = 0;
+    if (curl_easy_getinfo(curl, CURLINFO_TOTAL_TIME, &total_time) == CURLE_OK) {
+        metrics_histogram_observe(&http_duration, (uint64_t)(total_time * 1000000.0));
+    }
 
     long response_code;
     curl_easy_getinfo(curl, CURLINFO_RESPONSE_CODE, &response_code);
@@ -125,40 +225,50 @@ int send_fcm_notification(const char* oauth_token, const char* app_token,
     free(message_json);
 
     if (res != CURLE_OK) {
-        printf("Curl error: %s\n", curl_easy_strerror(res));
+        LOG_ERROR("FCM send: curl error: %s", curl_easy_strerror(res));
+        METRICS_INC(&http_errors);
         if (response.data) free(response.data);
         return -1;
     }
 
-    printf("HTTP response code: %ld\n", response_code);
-    if (response.data) {
-        printf("Server response: %s\n", response.data);
-        free(response.data);
-    }
+    char preview[LOG_PREVIEW_LENGTH + 4];
+    log_preview(preview, sizeof(preview), response.data, response.size);
 
+    int result;
     if (response_code == 200) {
-        printf("Notification sent successfully\n");
-        return 0;
+        LOG_DEBUG("FCM response: HTTP %ld, %zu bytes: %s", response_code, response.size, preview);
+        result = 0;
     } else {
-        printf("Notification sending failed\n");
-        return -1;
+        LOG_WARN("FCM send failed: HTTP %ld, %zu bytes: %s", response_code, response.size, preview);
+        result = -1;
     }
+
+    free(response.data);
+    return result;
 }
 
 int send_door_close_reminder(const char* app_token, const char* service_account_file) {
     if (!app_token || !service_account_file) {
-        printf("Error: missing required arguments\n");
+        LOG_ERROR("Door close reminder: missing required arguments");
         return -1;
     }
 
-    printf("Obtaining OAuth token...\n");
+    uint64_t span = trace_begin();
+
+    LOG_DEBUG("Obtaining OAuth token...");
+    uint64_t oauth_span = trace_begin();
+    METRICS_INC(&oauth_requests);
     char* oauth_token = get_fcm_oauth_token(service_account_file);
+    trace_end("notification", "oauth", oauth_span);
     if (!oauth_token) {
-        printf("Failed to obtain OAuth token\n");
+        LOG_ERROR("Failed to obtain OAuth token");
+        METRICS_INC(&oauth_failures);
+        METRICS_INC(&notifications_failed);
+        trace_end("notification", "door_close_reminder", span);
         return -1;
     }
 
-    printf("OAuth token obtained successfully\n");
+    LOG_DEBUG("OAuth token obtained (%zu bytes)", strlen(oauth_token));
 
     int result = send_fcm_notification(
         oauth_token,
@@ -170,5 +280,9 @@ int send_door_close_reminder(const char* app_token, const char* service_account_
     );
 
     free(oauth_token);
+    METRICS_INC(result == 0 ? &notifications_sent : &notifications_failed);
+    trace_end("notification", "door_close_reminder", span);
     return result;
-}
\ No newline at end of file
+}
+
+#endif // DOOR_MONITOR_MINIMAL_HTTP
@@ -1,28 +1,74 @@
-#ifndef FCM_NOTIFICATION_H
-#define FCM_NOTIFICATION_H
-
-/**
- * Sends a Firebase Cloud Messaging (FCM) notification
- * 
- * @param oauth_token OAuth2 token for authentication
- * @param app_token Recipient application's token
- * @param title Notification title
- * @param body Notification message body
- * @param data_type Custom data type (can be NULL)
- * @param project_id Firebase project ID
- * @return 0 on success, -1 on failure
- */
-int send_fcm_notification(const char* oauth_token, const char* app_token, 
-                         const char* title, const char* body, 
-                         const char* data_type, const char* project_id);
-
-/**
- * Convenience function to send a door close reminder
- * 
- * @param app_token Recipient application's token
- * @param service_account_file Path to the service account JSON file
- * @return 0 on success, -1 on failure
- */
-int send_door_close_reminder(const char* app_token, const char* service_account_file);
-
-#endif // FCM_NOTIFICATION_H
+#ifndef FCM_NOTIFICATION_H
+#define FCM_NOTIFICATION_H
+
+#include <stddef.h>
+
+/**
+ * Sends a Firebase Cloud Messaging (FCM) notification
+ * 
+ * Blocking, over libcurl; not built with DOOR_MONITOR_MINIMAL_HTTP.
+ * 
+ * @param oauth_token OAuth2 token for authentication
+ * @param app_token Recipient application's token
+ * @param title Notification title
+ * @param body Notification message body
+ * @param data_type Custom data type (can be NULL)
+ * @param project_id Firebase project ID
+ * @return 0 on success, -1 on failure
+ */
+int send_fcm_notification(const char* oauth_token, const char* app_token, 
+                         const char* title, const char* body, 
+                         const char* data_type, const char* project_id);
+
+/**
+ * Convenience function to send a door close reminder
+ * 
+ * Blocking, over libcurl; not built with DOOR_MONITOR_MINIMAL_HTTP.
+ * 
+ * @param app_token Recipient application's token
+ * @param service_account_file Path to the service account JSON file
+ * @return 0 on success, -1 on failure
+ */
+int send_door_close_reminder(const char* app_token, const char* service_account_file);
+
+/**
+ * Builds the JSON body of an FCM v1 send request
+ * 
+ * @param app_token Recipient application's token
+ * @param title Notification title
+ * @param body Notification message body
+ * @param data_type Custom data type (can be NULL)
+ * @return JSON message (must be freed with free()), or NULL on failure
+ */
+char* create_fcm_message_json(const char* app_token, const char* title, 
+                              const char* body, const char* data_type);
+
+/**
+ * Writes the JSON body of an FCM v1 send request into a caller's buffer
+ * 
+ * Like snprintf(), the output is always terminated and the full length is
+ * returned even when it does not fit, so a result >= buffer_size means the
+ * body was truncated. Nothing is allocated.
+ * 
+ * @param buffer Output buffer (may be NULL if buffer_size is 0)
+ * @param buffer_size Size of the output buffer
+ * @param app_token Recipient application's token
+ * @param title Notification title
+ * @param body Notification message body
+ * @param data_type Custom data type (can be NULL)
+ * @return Length of the complete JSON body, excluding the terminator
+ */
+int format_fcm_message_json(char* buffer, size_t buffer_size, const char* app_token,
+                            const char* title, const char* body, const char* data_type);
+
+/**
+ * Builds the FCM v1 send URL of a project
+ * 
+ * @param url Output buffer
+ * @param url_size Size of the output buffer
+ * @param project_id Firebase project ID
+ * @return 0 on success, -1 if the buffer is too small
+ */
+int build_fcm_url(char* url, size_t url_size, const char* project_id);
+
+#endif // FCM_NOTIFICATION_H
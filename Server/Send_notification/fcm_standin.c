@@ -0,0 +1,444 @@
+/**
+ * @file fcm_standin.c
+ * @brief Implementation of the OAuth and FCM stand-in
+ *
+ * Each connection reads one request (head and Content-Length body), then
+ * the response is written, possibly after the configured latency, and the
+ * connection is closed. The notifier simply reconnects.
+ */
+
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <errno.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+
+#include "fcm_standin.h"
+#include "logger.h"
+#include "metrics.h"
+#include "trace.h"
+
+// ============================================================================
+// STATIC VARIABLES
+// ============================================================================
+
+static Metric standin_tokens = METRIC_COUNTER_INIT("sim_fcm_tokens_total",
+    "Access tokens issued by the FCM stand-in");
+static Metric standin_messages = METRIC_COUNTER_INIT("sim_fcm_messages_total",
+    "Messages accepted by the FCM stand-in");
+static Metric standin_rejected = METRIC_COUNTER_INIT("sim_fcm_rejected_total",
+    "Messages answered with an error status by the FCM stand-in");
+
+static Metric *const standin_metrics[] = {
+    &standin_tokens, &standin_messages, &standin_rejected
+};
+
+// ============================================================================
+// INTERNAL HELPER FUNCTIONS
+// ============================================================================
+
+/**
+ * @brief Reason phrase for the statuses a scenario is likely to use
+ */
+static const char* status_text(int status) {
+    switch (status) {
+        case 200: return "OK";
+        case 400: return "Bad Request";
+        case 401: return "Unauthorized";
+        case 403: return "Forbidden";
+        case 404: return "Not Found";
+        case 429: return "Too Many Requests";
+        case 500: return "Internal Server Error";
+        case 503: return "Service Unavailable";
+        default:  return "Error";
+    }
+}
+
+/**
+ * @brief Release a connection slot
+ */
+static void close_client(FcmStandinClient *client) {
+    FcmStandin *standin = client->standin;
+
+    if (client->timer_id > 0) {
+        reactor_cancel_timer(standin->reactor, client->timer_id);
+    }
+    reactor_remove_fd(standin->reactor, client->fd);
+    close(client->fd);
+    free(client->response);
+
+    memset(client, 0, sizeof(FcmStandinClient));
+    client->standin = standin;
+    client->fd = -1;
+}
+
+/**
+ * @brief Connection timeout handler
+ */
+static void client_timed_out(void *userdata) {
+    FcmStandinClient *client = (FcmStandinClient*)userdata;
+
+    // One-shot timers are released before their handler runs
+    client->timer_id = 0;
+    close_client(client);
+}
+
+/**
+ * @brief Prepare a JSON response
+ */
+static int set_response(FcmStandinClient *client, int status, const char *body) {
+    char *response = NULL;
+    int len = asprintf(&response,
+                       "HTTP/1.1 %d %s\r\n"
+                       "Content-Type: application/json; charset=UTF-8\r\n"
+                       "Content-Length: %zu\r\n"
+                       "Connection: close\r\n"
+                       "\r\n"
+                       "%s",
+                       status, status_text(status), strlen(body), body);
+    if (len < 0) {
+        return ERROR_MEMORY;
+    }
+
+    client->response = response;
+    client->response_len = (size_t)len;
+    client->response_sent = 0;
+    return SUCCESS;
+}
+
+/**
+ * @brief Choose the response for a complete request
+ */
+static int handle_request(FcmStandinClient *client) {
+    FcmStandin *standin = client->standin;
+    char method[8];
+    char path[256];
+    char body[160];
+
+    if (sscanf(client->request, "%7s %255s", method, path) != 2 || strcmp(method, "POST") != 0) {
+        return set_response(client, 400, "{\"error\":{\"code\":400,\"status\":\"INVALID_ARGUMENT\"}}");
+    }
+
+    if (strcmp(path, "/token") == 0) {
+        standin->tokens_issued++;
+        METRICS_INC(&standin_tokens);
+        snprintf(body, sizeof(body),
+                 "{\"access_token\":\"stand-in-%llu\",\"expires_in\":3600,\"token_type\":\"Bearer\"}",
+                 (unsigned long long)standin->tokens_issued);
+        return set_response(client, 200, body);
+    }
+
+    size_t path_len = strlen(path);
+    size_t suffix_len = strlen("/messages:send");
+    if (path_len < suffix_len || strcmp(path + path_len - suffix_len, "/messages:send") != 0) {
+        return set_response(client, 404, "{\"error\":{\"code\":404,\"status\":\"NOT_FOUND\"}}");
+    }
+
+    // End of the reminder path as timed by the simulation's bench
+    trace_instant("fcm_standin", "send_received");
+
+    if (standin->send_status == 200) {
+        standin->messages_accepted++;
+        METRICS_INC(&standin_messages);
+        snprintf(body, sizeof(body), "{\"name\":\"projects/simulation/messages/%llu\"}",
+                 (unsigned long long)standin->messages_accepted);
+    } else {
+        standin->messages_rejected++;
+        METRICS_INC(&standin_rejected);
+        snprintf(body, sizeof(body), "{\"error\":{\"code\":%d,\"message\":\"%s\"}}",
+                 standin->send_status, status_text(standin->send_status));
+    }
+    LOG_DEBUG("FCM stand-in: answering send with HTTP %d", standin->send_status);
+    return set_response(client, standin->send_status, body);
+}
+
+/**
+ * @brief Read the request head and body
+ * @return 1 when a response is ready, 0 to wait, negative to drop the connection
+ */
+static int read_request(FcmStandinClient *client) {
+    for (;;) {
+        size_t space = sizeof(client->request) - 1 - client->request_len;
+        if (space == 0) {
+            int result = set_response(client, 413, "{\"error\":{\"code\":413}}");
+            return result == SUCCESS ? 1 : result;
+        }
+
+        ssize_t n = recv(client->fd, client->request + client->request_len, space, 0);
+        if (n < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            if (errno == EAGAIN || errno == EWOULDBLOCK) {
+                return 0;
+            }
+            return ERROR_NETWORK;
+        }
+        if (n == 0) {
+            return ERROR_NETWORK;
+        }
+
+        client->request_len += (size_t)n;
+        client->request[client->request_len] = '\0';
+
+        if (client->request_expected == 0) {
+            char *head_end = strstr(client->request, "\r\n\r\n");
+            if (!head_end) {
+                continue;
+            }
+
+            const char *length = strcasestr(client->request, "\r\nContent-Length:");
+            size_t body_len = (length && length < head_end)
+                            ? strtoul(length + strlen("\r\nContent-Length:"), NULL, 10) : 0;
+            client->request_expected = (size_t)(head_end + 4 - client->request) + body_len;
+
+            // Larger bodies make curl wait for permission before sending them
+            if (strcasestr(client->request, "\r\nExpect: 100-continue") &&
+                send(client->fd, "HTTP/1.1 100 Continue\r\n\r\n", 25, MSG_NOSIGNAL) != 25) {
+                return ERROR_NETWORK;
+            }
+        }
+
+        if (client->request_len >= client->request_expected) {
+            int result = handle_request(client);
+            return result == SUCCESS ? 1 : result;
+        }
+    }
+}
+
+/**
+ * @brief Write as much of the response as the socket accepts
+ * @return 1 when the response is complete or the connection failed, 0 to wait
+ */
+static int flush_response(FcmStandinClient *client) {
+    while (client->response_sent < client->response_len) {
+        ssize_t n = send(client->fd, client->response + client->response_sent,
+                         client->response_len - client->response_sent, MSG_NOSIGNAL);
+        if (n < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            return (errno == EAGAIN || errno == EWOULDBLOCK) ? 0 : 1;
+        }
+        client->response_sent += (size_t)n;
+    }
+    return 1;
+}
+
+static void client_ready(int fd, uint32_t events, void *userdata);
+
+/**
+ * @brief Delay timer handler: start writing the held-back response
+ */
+static void response_due(void *userdata) {
+    FcmStandinClient *client = (FcmStandinClient*)userdata;
+    FcmStandin *standin = client->standin;
+
+    client->timer_id = 0;
+    if (reactor_add_fd(standin->reactor, client->fd, REACTOR_WRITE, client_ready, client) != SUCCESS) {
+        close_client(client);
+        return;
+    }
+
+    int timer_id = reactor_add_timer(standin->reactor, FCM_STANDIN_CLIENT_TIMEOUT * 1000ULL, 0,
+                                     client_timed_out, client);
+    client->timer_id = timer_id > 0 ? timer_id : 0;
+}
+
+/**
+ * @brief Hold a ready send response back for the configured latency
+ * @return 1 if the response is delayed, 0 to write it now
+ */
+static int delay_response(FcmStandinClient *client) {
+    FcmStandin *standin = client->standin;
+
+    if (standin->latency_ms <= 0 || strncmp(client->request, "POST /token", 11) == 0) {
+        return 0;
+    }
+
+    // The socket is unwatched meanwhile; a client that gave up is noticed
+    // when the response cannot be written
+    int timer_id = reactor_add_timer(standin->reactor, (uint64_t)standin->latency_ms, 0,
+                                     response_due, client);
+    if (timer_id <= 0) {
+        return 0;
+    }
+
+    if (client->timer_id > 0) {
+        reactor_cancel_timer(standin->reactor, client->timer_id);
+    }
+    client->timer_id = timer_id;
+    reactor_remove_fd(standin->reactor, client->fd);
+    return 1;
+}
+
+/**
+ * @brief Client socket handler
+ */
+static void client_ready(int fd, uint32_t events, void *userdata) {
+    FcmStandinClient *client = (FcmStandinClient*)userdata;
+    (void)fd;
+
+    if (!client->response) {
+        int result = (events & REACTOR_ERROR) ? ERROR_NETWORK : read_request(client);
+        if (result < 0) {
+            close_client(client);
+            return;
+        }
+        if (result == 0 || delay_response(client)) {
+            return;
+        }
+    }
+
+    if (flush_response(client)) {
+        close_client(client);
+        return;
+    }
+
+    if (reactor_modify_fd(client->standin->reactor, client->fd, REACTOR_WRITE) != SUCCESS) {
+        close_client(client);
+    }
+}
+
+/**
+ * @brief Listener handler: accept pending connections
+ */
+static void listener_ready(int fd, uint32_t events, void *userdata) {
+    FcmStandin *standin = (FcmStandin*)userdata;
+    (void)events;
+
+    for (;;) {
+        int client_fd = accept4(fd, NULL, NULL, SOCK_NONBLOCK | SOCK_CLOEXEC);
+        if (client_fd < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            if (errno != EAGAIN && errno != EWOULDBLOCK) {
+                LOG_WARN_RATELIMITED("FCM stand-in: accept failed: %s", strerror(errno));
+            }
+            return;
+        }
+
+        FcmStandinClient *client = NULL;
+        for (int i = 0; i < FCM_STANDIN_MAX_CLIENTS; i++) {
+            if (standin->clients[i].fd < 0) {
+                client = &standin->clients[i];
+                break;
+            }
+        }
+
+        if (!client) {
+            LOG_WARN_RATELIMITED("FCM stand-in: too many connections, dropping one");
+            close(client_fd);
+            continue;
+        }
+
+        if (reactor_add_fd(standin->reactor, client_fd, REACTOR_READ, client_ready, client) != SUCCESS) {
+            close(client_fd);
+            continue;
+        }
+        client->fd = client_fd;
+
+        int timer_id = reactor_add_timer(standin->reactor, FCM_STANDIN_CLIENT_TIMEOUT * 1000ULL, 0,
+                                         client_timed_out, client);
+        if (timer_id < 0) {
+            close_client(client);
+            continue;
+        }
+        client->timer_id = timer_id;
+    }
+}
+
+// ============================================================================
+// PUBLIC FUNCTIONS
+// ============================================================================
+
+int fcm_standin_init(FcmStandin *standin, Reactor *reactor) {
+    if (!standin || !reactor) {
+        return ERROR_INVALID_PARAM;
+    }
+
+    memset(standin, 0, sizeof(FcmStandin));
+    standin->reactor = reactor;
+    standin->listen_fd = -1;
+    standin->send_status = 200;
+    for (int i = 0; i < FCM_STANDIN_MAX_CLIENTS; i++) {
+        standin->clients[i].standin = standin;
+        standin->clients[i].fd = -1;
+    }
+
+    metrics_register_all(standin_metrics, sizeof(standin_metrics) / sizeof(standin_metrics[0]));
+
+    struct sockaddr_in addr;
+    socklen_t addr_len = sizeof(addr);
+    memset(&addr, 0, sizeof(addr));
+    addr.sin_family = AF_INET;
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+
+    int fd = socket(AF_INET, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+    if (fd < 0) {
+        LOG_ERROR("FCM stand-in: failed to create socket: %s", strerror(errno));
+        return ERROR_NETWORK;
+    }
+
+    // Port 0: the kernel picks a free port, read back with getsockname()
+    if (bind(fd, (struct sockaddr*)&addr, sizeof(addr)) < 0 ||
+        listen(fd, FCM_STANDIN_MAX_CLIENTS) < 0 ||
+        getsockname(fd, (struct sockaddr*)&addr, &addr_len) < 0) {
+        LOG_ERROR("FCM stand-in: failed to listen: %s", strerror(errno));
+        close(fd);
+        return ERROR_NETWORK;
+    }
+
+    int result = reactor_add_fd(reactor, fd, REACTOR_READ, listener_ready, standin);
+    if (result != SUCCESS) {
+        close(fd);
+        return result;
+    }
+
+    standin->listen_fd = fd;
+    snprintf(standin->token_url, sizeof(standin->token_url),
+             "http://127.0.0.1:%u/token", ntohs(addr.sin_port));
+    snprintf(standin->send_url, sizeof(standin->send_url),
+             "http://127.0.0.1:%u/v1/projects/simulation/messages:send", ntohs(addr.sin_port));
+
+    LOG_INFO("FCM stand-in listening on 127.0.0.1:%u", ntohs(addr.sin_port));
+    return SUCCESS;
+}
+
+void fcm_standin_cleanup(FcmStandin *standin) {
+    if (!standin || !standin->reactor) {
+        return;
+    }
+
+    for (int i = 0; i < FCM_STANDIN_MAX_CLIENTS; i++) {
+        // Delayed clients are not watched; removing them again is harmless
+        if (standin->clients[i].fd >= 0) {
+            close_client(&standin->clients[i]);
+        }
+    }
+
+    if (standin->listen_fd >= 0) {
+        reactor_remove_fd(standin->reactor, standin->listen_fd);
+        close(standin->listen_fd);
+        standin->listen_fd = -1;
+    }
+
+    standin->reactor = NULL;
+}
+
+void fcm_standin_set_latency(FcmStandin *standin, int latency_ms) {
+    if (standin) {
+        standin->latency_ms = latency_ms > 0 ? latency_ms : 0;
+    }
+}
+
+void fcm_standin_set_status(FcmStandin *standin, int status) {
+    if (standin && status >= 200 && status <= 599) {
+        standin->send_status = status;
+    }
+}
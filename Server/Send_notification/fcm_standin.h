@@ -0,0 +1,102 @@
+/**
+ * @file fcm_standin.h
+ * @brief Local stand-in for the Google OAuth and FCM endpoints
+ *
+ * The simulation points the notifier at this server instead of Google, so
+ * reminders travel the production path (HTTP on the reactor, token
+ * caching, retries) without credentials or network access. The server
+ * listens on an ephemeral 127.0.0.1 port served by the same reactor.
+ *
+ * Endpoints:
+ * - POST /token: issues an access token valid for an hour
+ * - POST .../messages:send: answers with the configured status after the
+ *   configured latency (200 accepts the message)
+ * - anything else: 404
+ *
+ * Threading:
+ * All functions must be called from the reactor thread.
+ */
+
+#ifndef FCM_STANDIN_H
+#define FCM_STANDIN_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "config.h"
+#include "reactor.h"
+
+// ============================================================================
+// DATA STRUCTURES
+// ============================================================================
+
+/**
+ * @brief Stand-in connection
+ */
+typedef struct {
+    struct FcmStandin *standin;         /// Owning server
+    int fd;                             /// Client socket, -1 if the slot is free
+    int timer_id;                       /// Timeout or response delay timer, 0 if none
+    char request[4096];                 /// Request received so far
+    size_t request_len;                 /// Bytes in request
+    size_t request_expected;            /// Head plus body length once the head is in, 0 before
+    char *response;                     /// Response being written, NULL while reading
+    size_t response_len;                /// Total response bytes
+    size_t response_sent;               /// Response bytes already written
+} FcmStandinClient;
+
+/**
+ * @brief Stand-in server state
+ */
+typedef struct FcmStandin {
+    Reactor *reactor;                   /// Loop serving the endpoints
+    int listen_fd;                      /// Listening socket, -1 if not listening
+    char token_url[64];                 /// URL to give notifier_set_endpoints()
+    char send_url[96];                  /// URL to give notifier_set_endpoints()
+    int latency_ms;                     /// Delay before each send response
+    int send_status;                    /// HTTP status of send responses
+    uint64_t tokens_issued;             /// Access tokens handed out
+    uint64_t messages_accepted;         /// Sends answered with 200
+    uint64_t messages_rejected;         /// Sends answered with an error status
+    FcmStandinClient clients[FCM_STANDIN_MAX_CLIENTS]; /// Connection slots
+} FcmStandin;
+
+// ============================================================================
+// LIFECYCLE
+// ============================================================================
+
+/**
+ * @brief Start the stand-in on an ephemeral loopback port
+ * @param standin Pointer to server to initialize
+ * @param reactor Loop serving the endpoints
+ * @return 0 on success, negative on error
+ *
+ * Sends are accepted immediately until told otherwise.
+ */
+int fcm_standin_init(FcmStandin *standin, Reactor *reactor);
+
+/**
+ * @brief Close the listener and all connections
+ * @param standin Pointer to server
+ */
+void fcm_standin_cleanup(FcmStandin *standin);
+
+// ============================================================================
+// BEHAVIOUR
+// ============================================================================
+
+/**
+ * @brief Delay every following send response
+ * @param standin Pointer to server
+ * @param latency_ms Delay in milliseconds (0 answers at once)
+ */
+void fcm_standin_set_latency(FcmStandin *standin, int latency_ms);
+
+/**
+ * @brief Answer following sends with an HTTP status
+ * @param standin Pointer to server
+ * @param status 200 to accept, or an error status such as 401, 500 or 503
+ */
+void fcm_standin_set_status(FcmStandin *standin, int status);
+
+#endif // FCM_STANDIN_H
@@ -3,7 +3,9 @@
 #include <stdlib.h>
 #include <string.h>
 #include <time.h>
+#ifndef DOOR_MONITOR_MINIMAL_HTTP
 #include <curl/curl.h>
+#endif
 #include <json-c/json.h>
 #include <openssl/pem.h>
 #include <openssl/rsa.h>
@@ -15,24 +17,41 @@
 
 // Configuration and module imports
 #include "config.h"
+#include "logger.h"
+#include "trace.h"
+#include "timesource.h"
 #include "fcm_token.h"
+#include "alloc_stats.h"
+
+#ifndef DOOR_MONITOR_MINIMAL_HTTP
 
 // Structure to store HTTP response
 struct APIResponse {
     char *data;
     size_t size;
+    size_t capacity;
 };
 
-// Callback to receive HTTP response data
+// Callback to receive HTTP response data; the buffer grows geometrically
 static size_t WriteCallback(void *contents, size_t size, size_t nmemb, struct APIResponse *response) {
     size_t realsize = size * nmemb;
-    char *ptr = realloc(response->data, response->size + realsize + 1);
-    if (!ptr) {
-        printf("Error: insufficient memory (realloc)\n");
-        return 0;
+    size_t needed = response->size + realsize + 1;
+
+    if (needed > response->capacity) {
+        size_t capacity = response->capacity ? response->capacity : 1024;
+        while (capacity < needed) {
+            capacity *= 2;
+        }
+
+        char *ptr = realloc(response->data, capacity);
+        if (!ptr) {
+            LOG_ERROR("OAuth response: insufficient memory (realloc)");
+            return 0;
+        }
+        response->data = ptr;
+        response->capacity = capacity;
     }
 
-    response->data = ptr;
     memcpy(&(response->data[response->size]), contents, realsize);
     response->size += realsize;
     response->data[response->size] = 0;
@@ -40,92 +59,88 @@ static size_t WriteCallback(void *contents, size_t size, size_t nmemb, struct AP
     return realsize;
 }
 
-static char* base64_url_encode(const unsigned char* input, int length) {
-    BIO *bio, *b64;
-    BUF_MEM *bufferPtr;
+#endif // DOOR_MONITOR_MINIMAL_HTTP
 
-    b64 = BIO_new(BIO_f_base64());
-    bio = BIO_new(BIO_s_mem());
-    bio = BIO_push(b64, bio);
+// Output size of base64_url_encode for length input bytes, terminator included
+#define BASE64_ENCODED_SIZE(length) ((((length) + 2) / 3) * 4 + 1)
 
-    BIO_set_flags(bio, BIO_FLAGS_BASE64_NO_NL);
-    BIO_write(bio, input, length);
-    BIO_flush(bio);
-    BIO_get_mem_ptr(bio, &bufferPtr);
+// Largest signature sign_jwt handles (RSA-4096)
+#define JWT_MAX_SIGNATURE_BYTES 512
 
-    char *encoded = malloc(bufferPtr->length + 1);
-    memcpy(encoded, bufferPtr->data, bufferPtr->length);
-    encoded[bufferPtr->length] = '\0';
+// Encodes into output (at least BASE64_ENCODED_SIZE(length) bytes);
+// returns the encoded length, or -1 if output is too small
+static int base64_url_encode(const unsigned char* input, int length, char* output, size_t output_size) {
+    if (length < 0 || output_size < (size_t)BASE64_ENCODED_SIZE(length)) {
+        return -1;
+    }
 
-    BIO_free_all(bio);
+    int encoded_length = EVP_EncodeBlock((unsigned char*)output, input, length);
 
     // Convert to Base64 URL-safe (replace + with -, / with _, remove =)
-    size_t len = strlen(encoded);
-    for (size_t i = 0; i < len; i++) {
-        if (encoded[i] == '+') encoded[i] = '-';
-        else if (encoded[i] == '/') encoded[i] = '_';
-        else if (encoded[i] == '=') {
-            encoded[i] = '\0';
-            break;
+    for (int i = 0; i < encoded_length; i++) {
+        if (output[i] == '+') output[i] = '-';
+        else if (output[i] == '/') output[i] = '_';
+        else if (output[i] == '=') {
+            output[i] = '\0';
+            return i;
         }
     }
 
-    return encoded;
+    return encoded_length;
 }
 
-// Function to sign with RSA SHA256
-static char* sign_jwt(const char* message, EVP_PKEY* private_key) {
+// Signs with RSA SHA256 and writes the base64url signature into signature;
+// returns its length, or -1 on error
+static int sign_jwt(const char* message, EVP_PKEY* private_key, char* signature, size_t signature_size) {
     EVP_MD_CTX *mdctx = EVP_MD_CTX_new();
-    if (!mdctx) return NULL;
+    if (!mdctx) return -1;
 
     if (EVP_DigestSignInit(mdctx, NULL, EVP_sha256(), NULL, private_key) <= 0) {
         EVP_MD_CTX_free(mdctx);
-        return NULL;
+        return -1;
     }
 
     if (EVP_DigestSignUpdate(mdctx, message, strlen(message)) <= 0) {
         EVP_MD_CTX_free(mdctx);
-        return NULL;
+        return -1;
     }
 
+    unsigned char sig[JWT_MAX_SIGNATURE_BYTES];
     size_t sig_len;
-    if (EVP_DigestSignFinal(mdctx, NULL, &sig_len) <= 0) {
+    if (EVP_DigestSignFinal(mdctx, NULL, &sig_len) <= 0 || sig_len > sizeof(sig) ||
+        EVP_DigestSignFinal(mdctx, sig, &sig_len) <= 0) {
         EVP_MD_CTX_free(mdctx);
-        return NULL;
-    }
-
-    unsigned char *sig = malloc(sig_len);
-    if (EVP_DigestSignFinal(mdctx, sig, &sig_len) <= 0) {
-        EVP_MD_CTX_free(mdctx);
-        free(sig);
-        return NULL;
+        return -1;
     }
 
     EVP_MD_CTX_free(mdctx);
 
-    char* signature = base64_url_encode(sig, sig_len);
-    free(sig);
-
-    return signature;
+    return base64_url_encode(sig, (int)sig_len, signature, signature_size);
 }
 
 static char* create_jwt(const char* client_email, const char* private_key_str) {
     if (!client_email || !private_key_str) {
-        printf("Error: NULL parameters\n");
+        LOG_ERROR("JWT creation: NULL parameters");
         return NULL;
     }
 
+    // The JWT is assembled in place: header.payload, then .signature
+    char jwt[MAX_JWT_SIZE];
+    size_t jwt_len = 0;
+
     // JWT header using config constants
     char header[256];
     snprintf(header, sizeof(header), "{\"alg\":\"%s\",\"typ\":\"%s\"}", JWT_ALGORITHM, JWT_TOKEN_TYPE);
-    char* header_encoded = base64_url_encode((const unsigned char*)header, strlen(header));
-    if (!header_encoded) {
-        printf("Error: header encoding\n");
+    int encoded = base64_url_encode((const unsigned char*)header, strlen(header), jwt, sizeof(jwt));
+    if (encoded < 0) {
+        LOG_ERROR("JWT creation: header encoding failed");
         return NULL;
     }
+    jwt_len = (size_t)encoded;
+    jwt[jwt_len++] = '.';
 
     // JWT payload using config constants
-    time_t now = time(NULL);
+    time_t now = timesource_wall();
     time_t exp = now + JWT_EXPIRATION_TIME;
 
     char payload[1024];
@@ -139,33 +154,20 @@ static char* create_jwt(const char* client_email, const char* private_key_str) {
         "}",
         client_email, OAUTH_SCOPE, OAUTH_TOKEN_URL, exp, now);
 
-    char* payload_encoded = base64_url_encode((const unsigned char*)payload, strlen(payload));
-    if (!payload_encoded) {
-        printf("Error: payload encoding\n");
-        free(header_encoded);
-        return NULL;
-    }
-
-    // Message to sign (header.payload)
-    size_t message_len = strlen(header_encoded) + strlen(payload_encoded) + 2;
-    char* message = malloc(message_len);
-    if (!message) {
-        printf("Error: message memory allocation\n");
-        free(header_encoded);
-        free(payload_encoded);
+    encoded = base64_url_encode((const unsigned char*)payload, strlen(payload),
+                                jwt + jwt_len, sizeof(jwt) - jwt_len);
+    if (encoded < 0) {
+        LOG_ERROR("JWT creation: payload encoding failed");
         return NULL;
     }
-    snprintf(message, message_len, "%s.%s", header_encoded, payload_encoded);
+    jwt_len += (size_t)encoded;
 
-    printf("Debug: Loading private key...\n");
+    LOG_DEBUG("Loading service account private key...");
 
     // Load private key
     BIO *bio = BIO_new_mem_buf(private_key_str, -1);
     if (!bio) {
-        printf("Error: BIO creation\n");
-        free(header_encoded);
-        free(payload_encoded);
-        free(message);
+        LOG_ERROR("JWT creation: BIO creation failed");
         return NULL;
     }
 
@@ -173,54 +175,38 @@ static char* create_jwt(const char* client_email, const char* private_key_str) {
     BIO_free(bio);
 
     if (!private_key) {
-        printf("Error: failed to load private key\n");
         unsigned long err = ERR_get_error();
         char err_buf[256];
         ERR_error_string_n(err, err_buf, sizeof(err_buf));
-        printf("OpenSSL error detail: %s\n", err_buf);
-        free(header_encoded);
-        free(payload_encoded);
-        free(message);
+        LOG_ERROR("JWT creation: failed to load private key (%s)", err_buf);
         return NULL;
     }
 
-    printf("Debug: Private key loaded, signing...\n");
+    LOG_DEBUG("Private key loaded, signing JWT...");
 
-    // Sign the message
-    char* signature = sign_jwt(message, private_key);
+    // Sign the message (header.payload) and append the signature
+    char signature[BASE64_ENCODED_SIZE(JWT_MAX_SIGNATURE_BYTES)];
+    int signature_len = sign_jwt(jwt, private_key, signature, sizeof(signature));
     EVP_PKEY_free(private_key);
 
-    if (!signature) {
-        printf("Error: failed to sign JWT\n");
-        free(header_encoded);
-        free(payload_encoded);
-        free(message);
+    if (signature_len < 0) {
+        LOG_ERROR("JWT creation: signing failed");
         return NULL;
     }
-
-    // Assemble final JWT
-    size_t jwt_len = strlen(message) + strlen(signature) + 2;
-    char* jwt = malloc(jwt_len);
-    if (!jwt) {
-        printf("Error: JWT allocation\n");
-        free(header_encoded);
-        free(payload_encoded);
-        free(message);
-        free(signature);
+    if (jwt_len + 1 + (size_t)signature_len >= sizeof(jwt)) {
+        LOG_ERROR("JWT creation: JWT exceeds %d bytes", MAX_JWT_SIZE);
         return NULL;
     }
-    snprintf(jwt, jwt_len, "%s.%s", message, signature);
 
-    free(header_encoded);
-    free(payload_encoded);
-    free(message);
-    free(signature);
+    jwt[jwt_len++] = '.';
+    memcpy(jwt + jwt_len, signature, (size_t)signature_len + 1);
 
-    return jwt;
+    return strdup(jwt);
 }
 
-// Function to extract access token from JSON response
-static char* extract_access_token(const char* json_response) {
+// Extracts the access token (and its lifetime) from a JSON response
+char* parse_oauth_response(const char* json_response, long* expires_in) {
+    ALLOC_SCOPE(ALLOC_SUBSYSTEM_OAUTH);
     json_object *root = json_tokener_parse(json_response);
     if (!root) return NULL;
     
@@ -233,17 +219,23 @@ static char* extract_access_token(const char* json_response) {
     const char* token = json_object_get_string(access_token_obj);
     char* result = strdup(token);
     
+    if (expires_in) {
+        json_object *expires_obj;
+        *expires_in = json_object_object_get_ex(root, "expires_in", &expires_obj)
+            ? (long)json_object_get_int64(expires_obj) : JWT_EXPIRATION_TIME;
+    }
+    
     json_object_put(root);
     return result;
 }
 
-// Main function to obtain OAuth2 token
-char* get_fcm_oauth_token(const char* service_account_file) {
+// Builds the form body of the JWT-bearer token request
+char* build_oauth_request_body(const char* service_account_file) {
+    ALLOC_SCOPE(ALLOC_SUBSYSTEM_OAUTH);
     // Check that the service account file exists
     FILE *test_file = fopen(service_account_file, "r");
     if (!test_file) {
-        printf("Error: file %s not found\n", service_account_file);
-        printf("Make sure the service account JSON file is present.\n");
+        LOG_ERROR("Service account file %s not found", service_account_file);
         return NULL;
     }
     fclose(test_file);
@@ -251,7 +243,7 @@ char* get_fcm_oauth_token(const char* service_account_file) {
     // Read the service account JSON file
     FILE *file = fopen(service_account_file, "r");
     if (!file) {
-        printf("Error: unable to open file %s\n", service_account_file);
+        LOG_ERROR("Unable to open service account file %s", service_account_file);
         return NULL;
     }
     
@@ -269,7 +261,7 @@ char* get_fcm_oauth_token(const char* service_account_file) {
     free(json_content);
     
     if (!root) {
-        printf("Error: invalid JSON\n");
+        LOG_ERROR("Service account file: invalid JSON");
         return NULL;
     }
     
@@ -277,7 +269,7 @@ char* get_fcm_oauth_token(const char* service_account_file) {
     json_object *client_email_obj, *private_key_obj;
     if (!json_object_object_get_ex(root, "client_email", &client_email_obj) ||
         !json_object_object_get_ex(root, "private_key", &private_key_obj)) {
-        printf("Error: missing fields in JSON\n");
+        LOG_ERROR("Service account file: missing client_email or private_key");
         json_object_put(root);
         return NULL;
     }
@@ -286,11 +278,36 @@ char* get_fcm_oauth_token(const char* service_account_file) {
     const char* private_key = json_object_get_string(private_key_obj);
     
     // Create the JWT
+    uint64_t span = trace_begin();
     char* jwt = create_jwt(client_email, private_key);
+    trace_end("notification", "jwt_sign", span);
     json_object_put(root);
     
     if (!jwt) {
-        printf("Error: unable to create JWT\n");
+        LOG_ERROR("OAuth: unable to create JWT");
+        return NULL;
+    }
+    
+    // Prepare POST data
+    size_t post_size = strlen(jwt) + 100;
+    char* post_data = malloc(post_size);
+    if (post_data) {
+        snprintf(post_data, post_size,
+            "grant_type=urn:ietf:params:oauth:grant-type:jwt-bearer&assertion=%s", jwt);
+    } else {
+        LOG_ERROR("OAuth: request body allocation failed");
+    }
+    free(jwt);
+    
+    return post_data;
+}
+
+#ifndef DOOR_MONITOR_MINIMAL_HTTP
+
+// Main function to obtain OAuth2 token
+char* get_fcm_oauth_token(const char* service_account_file) {
+    char* post_data = build_oauth_request_body(service_account_file);
+    if (!post_data) {
         return NULL;
     }
     
@@ -301,16 +318,11 @@ char* get_fcm_oauth_token(const char* service_account_file) {
     
     curl = curl_easy_init();
     if (!curl) {
-        printf("Error: unable to initialize CURL\n");
-        free(jwt);
+        LOG_ERROR("OAuth: unable to initialize curl");
+        free(post_data);
         return NULL;
     }
     
-    // Prepare POST data
-    char post_data[MAX_JWT_SIZE + 200];
-    snprintf(post_data, sizeof(post_data),
-        "grant_type=urn:ietf:params:oauth:grant-type:jwt-bearer&assertion=%s", jwt);
-    
     // Configure CURL using config constants
     curl_easy_setopt(curl, CURLOPT_URL, OAUTH_TOKEN_URL);
     curl_easy_setopt(curl, CURLOPT_POSTFIELDS, post_data);
@@ -322,20 +334,30 @@ char* get_fcm_oauth_token(const char* service_account_file) {
     curl_easy_setopt(curl, CURLOPT_HTTPHEADER, headers);
     
     // Execute the request
+    uint64_t span = trace_begin();
     res = curl_easy_perform(curl);
+    trace_end("notification", "oauth_http", span);
     curl_slist_free_all(headers);
     curl_easy_cleanup(curl);
-    free(jwt);
+    free(post_data);
     
     if (res != CURLE_OK) {
-        printf("CURL error: %s\n", curl_easy_strerror(res));
+        LOG_ERROR("OAuth: curl error: %s", curl_easy_strerror(res));
         if (response.data) free(response.data);
         return NULL;
     }
     
     // Extract the access token
-    char* access_token = extract_access_token(response.data);
+    char* access_token = response.data ? parse_oauth_response(response.data, NULL) : NULL;
+    if (!access_token) {
+        // Error responses carry no secret, so a short preview is safe to log
+        char preview[LOG_PREVIEW_LENGTH + 4];
+        log_preview(preview, sizeof(preview), response.data, response.size);
+        LOG_ERROR("OAuth: no access token in response (%zu bytes): %s", response.size, preview);
+    }
     free(response.data);
     
     return access_token;
-}
\ No newline at end of file
+}
+
+#endif // DOOR_MONITOR_MINIMAL_HTTP
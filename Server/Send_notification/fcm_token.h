@@ -4,9 +4,32 @@
 /**
  * Retrieves an OAuth2 token for Firebase Cloud Messaging
  * 
+ * Blocking, over libcurl; not built with DOOR_MONITOR_MINIMAL_HTTP.
+ * 
  * @param service_account_file Path to the service account JSON file
  * @return OAuth2 token (must be freed with free()), or NULL on failure
  */
 char* get_fcm_oauth_token(const char* service_account_file);
 
+/**
+ * Builds the form body of a JWT-bearer token request
+ * 
+ * Reads the service account file and signs a fresh JWT, so callers that
+ * perform the HTTP exchange themselves only need to POST the result to
+ * OAUTH_TOKEN_URL.
+ * 
+ * @param service_account_file Path to the service account JSON file
+ * @return Request body (must be freed with free()), or NULL on failure
+ */
+char* build_oauth_request_body(const char* service_account_file);
+
+/**
+ * Extracts the access token from an OAuth2 token response
+ * 
+ * @param json_response Response body returned by OAUTH_TOKEN_URL
+ * @param expires_in Receives the token lifetime in seconds (can be NULL)
+ * @return OAuth2 token (must be freed with free()), or NULL on failure
+ */
+char* parse_oauth_response(const char* json_response, long* expires_in);
+
 #endif // FCM_TOKEN_H
@@ -0,0 +1,1089 @@
+/**
+ * @file http_client.c
+ * @brief Implementation of the minimal HTTP/1.1 client
+ *
+ * A request moves through RESOLVING, CONNECTING, HANDSHAKE (https only),
+ * SENDING and RECEIVING. One socket handler drives the last four: each
+ * step runs until the socket would block, and the reactor is then asked
+ * for the direction that step, or OpenSSL underneath it, waits for. The
+ * response is kept in one buffer; once its head is complete it is parsed,
+ * and after every read the body is checked for completeness, so a request
+ * finishes without waiting for the server to close the connection.
+ */
+
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <ctype.h>
+#include <unistd.h>
+#include <errno.h>
+#include <time.h>
+#include <pthread.h>
+#include <sched.h>
+#include <netdb.h>
+#include <sys/socket.h>
+#include <sys/eventfd.h>
+#include <arpa/inet.h>
+#include <openssl/err.h>
+#include <openssl/x509v3.h>
+
+#include "http_client.h"
+#include "logger.h"
+#include "timesource.h"
+#include "alloc_stats.h"
+
+/// First allocation of a response buffer (doubled as needed)
+#define RESPONSE_INITIAL_SIZE 1024
+
+/// Largest response buffer: head, body and chunk framing
+#define RESPONSE_MAX_SIZE (HTTP_CLIENT_MAX_HEAD_SIZE + MAX_HTTP_RESPONSE_SIZE + 1024)
+
+// ============================================================================
+// DATA STRUCTURES
+// ============================================================================
+
+/**
+ * @brief Progress of a request
+ */
+typedef enum {
+    HTTP_RESOLVING,                     /// Waiting for the host lookup
+    HTTP_CONNECTING,                    /// TCP connect in progress
+    HTTP_HANDSHAKE,                     /// TLS handshake in progress
+    HTTP_SENDING,                       /// Writing the request
+    HTTP_RECEIVING,                     /// Reading the response
+    HTTP_FINISHED                       /// Callback running, released afterwards
+} HttpState;
+
+/// Lookup states, exchanged atomically by the reactor and the resolver thread
+#define LOOKUP_RUNNING 0
+#define LOOKUP_DONE 1
+#define LOOKUP_ABANDONED 2
+
+/**
+ * @brief Host lookup, shared with the resolver thread
+ *
+ * Whichever comes second, the resolver finishing or the request giving up
+ * on it, releases the lookup.
+ */
+typedef struct {
+    int state;                          /// LOOKUP_* (atomic)
+    int event_fd;                       /// Signalled when the answer is in
+    int error;                          /// getaddrinfo() result
+    struct addrinfo *addresses;         /// Answer, NULL on error
+    char host[256];                     /// Host to look up
+    char port[8];                       /// Port to look up
+} HttpLookup;
+
+/**
+ * @brief Request in flight
+ */
+struct HttpRequest {
+    HttpClient *client;                 /// Owning client
+    HttpRequest *next;                  /// Next request of the client
+    HttpState state;                    /// Progress
+    HttpCallback callback;              /// Completion callback
+    void *userdata;                     /// Callback argument
+    HttpLookup *lookup;                 /// Lookup in progress, NULL once answered
+    struct addrinfo *addresses;         /// Addresses of the host
+    struct addrinfo *address;           /// Next address to try
+    int fd;                             /// Connection, -1 if none
+    uint32_t events;                    /// Events watched on fd
+    int timer_id;                       /// Request timeout, 0 if none
+    int tls;                            /// Connection uses TLS
+    SSL *ssl;                           /// TLS session, NULL if none
+    uint64_t start_us;                  /// Time the request was started
+    char host[256];                     /// Host name or address, without brackets
+    char *out;                          /// Request head and body
+    size_t out_size;                    /// Bytes in out
+    size_t out_sent;                    /// Bytes of out already sent
+    char *in;                           /// Response received so far, NUL terminated
+    size_t in_size;                     /// Bytes in in
+    size_t in_capacity;                 /// Bytes allocated for in
+    size_t head_size;                   /// Bytes of response head, 0 until complete
+    long status;                        /// Status code, 0 until the head is parsed
+    long long content_length;           /// Announced body length, -1 if none
+    int chunked;                        /// Body uses chunked transfer encoding
+    const char *body;                   /// Body of the complete response
+    size_t body_size;                   /// Bytes in body
+    char error[384];                    /// Description of a failure, host included
+};
+
+// ============================================================================
+// INTERNAL HELPER FUNCTIONS
+// ============================================================================
+
+static void connection_event(int fd, uint32_t events, void *userdata);
+
+/**
+ * @brief Split a URL into scheme, host, port, authority and path
+ * @return 0 on success, ERROR_INVALID_PARAM if the URL is not supported
+ */
+static int parse_url(const char *url, int *tls, char *host, size_t host_size, char *port,
+                     size_t port_size, const char **authority, size_t *authority_length,
+                     const char **path) {
+    const char *rest;
+
+    if (strncmp(url, "https://", 8) == 0) {
+        *tls = 1;
+        rest = url + 8;
+    } else if (strncmp(url, "http://", 7) == 0) {
+        *tls = 0;
+        rest = url + 7;
+    } else {
+        return ERROR_INVALID_PARAM;
+    }
+    *authority = rest;
+
+    // An IPv6 address is bracketed so its colons are not taken for the port
+    const char *host_start = rest;
+    const char *host_end;
+    if (*rest == '[') {
+        host_start = rest + 1;
+        host_end = strchr(host_start, ']');
+        if (!host_end) {
+            return ERROR_INVALID_PARAM;
+        }
+        rest = host_end + 1;
+    } else {
+        host_end = rest + strcspn(rest, ":/");
+        rest = host_end;
+    }
+
+    size_t host_length = (size_t)(host_end - host_start);
+    if (host_length == 0 || host_length >= host_size) {
+        return ERROR_INVALID_PARAM;
+    }
+    memcpy(host, host_start, host_length);
+    host[host_length] = '\0';
+
+    if (*rest == ':') {
+        size_t port_length = strspn(rest + 1, "0123456789");
+        if (port_length == 0 || port_length >= port_size) {
+            return ERROR_INVALID_PARAM;
+        }
+        memcpy(port, rest + 1, port_length);
+        port[port_length] = '\0';
+        rest += 1 + port_length;
+    } else {
+        snprintf(port, port_size, "%s", *tls ? "443" : "80");
+    }
+
+    if (*rest != '/' && *rest != '\0') {
+        return ERROR_INVALID_PARAM;
+    }
+    *authority_length = (size_t)(rest - *authority);
+    *path = (*rest == '/') ? rest : "/";
+    return SUCCESS;
+}
+
+/**
+ * @brief Write the request head and body into one buffer
+ * @return 0 on success, ERROR_MEMORY on error
+ */
+static int build_request(HttpRequest *request, const char *path, const char *authority,
+                         size_t authority_length, const char *content_type,
+                         const char *bearer_token, const char *body) {
+    static const char format[] =
+        "POST %s HTTP/1.1\r\n"
+        "Host: %.*s\r\n"
+        "Content-Type: %s\r\n"
+        "%s%s%s"
+        "Content-Length: %zu\r\n"
+        "Connection: close\r\n"
+        "\r\n";
+    size_t body_length = strlen(body);
+
+    // The token goes straight into the request, not through a header buffer
+    int head_length = snprintf(NULL, 0, format, path, (int)authority_length, authority,
+                               content_type, bearer_token ? "Authorization: Bearer " : "",
+                               bearer_token ? bearer_token : "", bearer_token ? "\r\n" : "",
+                               body_length);
+    if (head_length < 0) {
+        return ERROR_MEMORY;
+    }
+
+    request->out = malloc((size_t)head_length + body_length + 1);
+    if (!request->out) {
+        return ERROR_MEMORY;
+    }
+    snprintf(request->out, (size_t)head_length + 1, format, path, (int)authority_length,
+             authority, content_type, bearer_token ? "Authorization: Bearer " : "",
+             bearer_token ? bearer_token : "", bearer_token ? "\r\n" : "", body_length);
+    memcpy(request->out + head_length, body, body_length + 1);
+    request->out_size = (size_t)head_length + body_length;
+    return SUCCESS;
+}
+
+// ============================================================================
+// HOST LOOKUP
+// ============================================================================
+
+/**
+ * @brief Release a lookup and its answer
+ */
+static void lookup_free(HttpLookup *lookup) {
+    if (lookup->addresses) {
+        freeaddrinfo(lookup->addresses);
+    }
+    close(lookup->event_fd);
+    free(lookup);
+}
+
+/**
+ * @brief Resolver thread: look the host up and signal the reactor
+ */
+static void* lookup_thread(void *arg) {
+    ALLOC_SCOPE(ALLOC_SUBSYSTEM_NOTIFIER);
+    HttpLookup *lookup = (HttpLookup*)arg;
+    struct addrinfo hints;
+
+    memset(&hints, 0, sizeof(hints));
+    hints.ai_family = AF_UNSPEC;
+    hints.ai_socktype = SOCK_STREAM;
+    hints.ai_flags = AI_ADDRCONFIG;
+    lookup->error = getaddrinfo(lookup->host, lookup->port, &hints, &lookup->addresses);
+
+    // Signal first: once the state is published the reactor may free the lookup
+    uint64_t one = 1;
+    if (write(lookup->event_fd, &one, sizeof(one)) != sizeof(one)) {
+        lookup->error = EAI_SYSTEM;
+    }
+    if (__atomic_exchange_n(&lookup->state, LOOKUP_DONE, __ATOMIC_ACQ_REL) == LOOKUP_ABANDONED) {
+        lookup_free(lookup);
+    }
+    return NULL;
+}
+
+/**
+ * @brief Start looking up a host
+ *
+ * Numeric addresses are converted on the spot; names go to a detached
+ * resolver thread. Either way the answer is picked up by lookup_ready().
+ *
+ * @return 0 on success, negative on error
+ */
+static int lookup_start(HttpLookup *lookup) {
+    struct addrinfo hints;
+
+    memset(&hints, 0, sizeof(hints));
+    hints.ai_family = AF_UNSPEC;
+    hints.ai_socktype = SOCK_STREAM;
+    hints.ai_flags = AI_NUMERICHOST | AI_NUMERICSERV;
+    if (getaddrinfo(lookup->host, lookup->port, &hints, &lookup->addresses) == 0) {
+        uint64_t one = 1;
+        lookup->state = LOOKUP_DONE;
+        return write(lookup->event_fd, &one, sizeof(one)) == sizeof(one) ? SUCCESS : ERROR_GENERIC;
+    }
+
+    // Normal scheduling even when the reactor runs SCHED_FIFO: a slow DNS
+    // server must not hold a real-time priority
+    pthread_t thread;
+    pthread_attr_t thread_attr;
+    struct sched_param param = { .sched_priority = 0 };
+    pthread_attr_init(&thread_attr);
+    pthread_attr_setdetachstate(&thread_attr, PTHREAD_CREATE_DETACHED);
+    pthread_attr_setinheritsched(&thread_attr, PTHREAD_EXPLICIT_SCHED);
+    pthread_attr_setschedpolicy(&thread_attr, SCHED_OTHER);
+    pthread_attr_setschedparam(&thread_attr, &param);
+    int result = pthread_create(&thread, &thread_attr, lookup_thread, lookup);
+    pthread_attr_destroy(&thread_attr);
+
+    return result == 0 ? SUCCESS : ERROR_GENERIC;
+}
+
+/**
+ * @brief Give up on a lookup that may still be running
+ */
+static void lookup_abandon(Reactor *reactor, HttpLookup *lookup) {
+    reactor_remove_fd(reactor, lookup->event_fd);
+
+    // A resolver that finishes after this releases the lookup itself
+    if (__atomic_exchange_n(&lookup->state, LOOKUP_ABANDONED, __ATOMIC_ACQ_REL) == LOOKUP_DONE) {
+        lookup_free(lookup);
+    }
+}
+
+// ============================================================================
+// REQUEST LIFECYCLE
+// ============================================================================
+
+/**
+ * @brief Stop watching and close the connection
+ */
+static void close_connection(HttpRequest *request) {
+    if (request->ssl) {
+        SSL_free(request->ssl);
+        request->ssl = NULL;
+    }
+    if (request->fd >= 0) {
+        reactor_remove_fd(request->client->reactor, request->fd);
+        close(request->fd);
+        request->fd = -1;
+        request->events = 0;
+    }
+}
+
+/**
+ * @brief Stop everything a request has running
+ */
+static void release_request(HttpRequest *request) {
+    Reactor *reactor = request->client->reactor;
+
+    if (request->timer_id > 0) {
+        reactor_cancel_timer(reactor, request->timer_id);
+        request->timer_id = 0;
+    }
+    if (request->lookup) {
+        lookup_abandon(reactor, request->lookup);
+        request->lookup = NULL;
+    }
+    close_connection(request);
+    if (request->addresses) {
+        freeaddrinfo(request->addresses);
+        request->addresses = NULL;
+    }
+}
+
+/**
+ * @brief Free a released request
+ */
+static void free_request(HttpRequest *request) {
+    free(request->out);
+    free(request->in);
+    free(request);
+}
+
+/**
+ * @brief Remove a request from its client's list
+ */
+static void unlink_request(HttpRequest *request) {
+    HttpRequest **link = &request->client->requests;
+
+    while (*link && *link != request) {
+        link = &(*link)->next;
+    }
+    if (*link) {
+        *link = request->next;
+    }
+}
+
+/**
+ * @brief End a request and report its outcome
+ * @param error NULL on success, otherwise what failed
+ * @return 0, the request no longer exists
+ */
+static int finish(HttpRequest *request, const char *error) {
+    HttpResult result = {
+        .request = request,
+        .error = error,
+        .status = request->status,
+        .body = (!error && request->body) ? request->body : "",
+        .body_size = (!error && request->body) ? request->body_size : 0,
+        .duration_us = timesource_real_us() - request->start_us,
+    };
+
+    release_request(request);
+    unlink_request(request);
+
+    // Cancelling from the callback is a no-op; the request is freed here
+    request->state = HTTP_FINISHED;
+    request->callback(&result, request->userdata);
+    free_request(request);
+    return 0;
+}
+
+/**
+ * @brief End a request with the failure described in request->error
+ * @return 0, the request no longer exists
+ */
+static int fail(HttpRequest *request) {
+    return finish(request, request->error);
+}
+
+/**
+ * @brief Request timeout
+ */
+static void request_timeout(void *userdata) {
+    ALLOC_SCOPE(ALLOC_SUBSYSTEM_NOTIFIER);
+    HttpRequest *request = (HttpRequest*)userdata;
+
+    request->timer_id = 0;
+    snprintf(request->error, sizeof(request->error), "request to %s timed out", request->host);
+    fail(request);
+}
+
+// ============================================================================
+// CONNECTION
+// ============================================================================
+
+/**
+ * @brief Connect to the next address of the host
+ * @return 1 if a connection is in progress, 0 if the request failed
+ */
+static int connect_next(HttpRequest *request) {
+    while (request->address) {
+        struct addrinfo *address = request->address;
+        request->address = address->ai_next;
+
+        int fd = socket(address->ai_family, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+        if (fd < 0) {
+            snprintf(request->error, sizeof(request->error), "socket failed: %s", strerror(errno));
+            continue;
+        }
+
+        if (connect(fd, address->ai_addr, address->ai_addrlen) < 0 && errno != EINPROGRESS) {
+            snprintf(request->error, sizeof(request->error), "connect to %s failed: %s",
+                     request->host, strerror(errno));
+            close(fd);
+            continue;
+        }
+
+        if (reactor_add_fd(request->client->reactor, fd, REACTOR_WRITE,
+                           connection_event, request) != SUCCESS) {
+            snprintf(request->error, sizeof(request->error), "unable to watch connection");
+            close(fd);
+            return fail(request);
+        }
+
+        request->fd = fd;
+        request->events = REACTOR_WRITE;
+        request->state = HTTP_CONNECTING;
+        return 1;
+    }
+
+    if (request->error[0] == '\0') {
+        snprintf(request->error, sizeof(request->error), "no address for %s", request->host);
+    }
+    return fail(request);
+}
+
+/**
+ * @brief Set up the TLS session on a connected socket
+ * @return 0 on success, ERROR_NETWORK on error
+ */
+static int start_tls(HttpRequest *request) {
+    unsigned char address[sizeof(struct in6_addr)];
+    int ok;
+
+    request->ssl = SSL_new(request->client->tls);
+    if (!request->ssl) {
+        return ERROR_NETWORK;
+    }
+
+    // Names are sent as SNI and matched against the certificate; addresses
+    // are matched against its IP entries
+    if (inet_pton(AF_INET, request->host, address) == 1 ||
+        inet_pton(AF_INET6, request->host, address) == 1) {
+        ok = X509_VERIFY_PARAM_set1_ip_asc(SSL_get0_param(request->ssl), request->host);
+    } else {
+        ok = SSL_set_tlsext_host_name(request->ssl, request->host) == 1 &&
+             SSL_set1_host(request->ssl, request->host) == 1;
+    }
+
+    if (!ok || SSL_set_fd(request->ssl, request->fd) != 1) {
+        return ERROR_NETWORK;
+    }
+    SSL_set_connect_state(request->ssl);
+    return SUCCESS;
+}
+
+/**
+ * @brief Interpret a failed OpenSSL call
+ * @return -1 if it has to wait for want, 0 at the end of the connection,
+ *         -2 on error (described in request->error)
+ */
+static int tls_status(HttpRequest *request, int result, const char *operation, uint32_t *want) {
+    int saved_errno = errno;
+
+    switch (SSL_get_error(request->ssl, result)) {
+    case SSL_ERROR_WANT_READ:
+        *want = REACTOR_READ;
+        return -1;
+    case SSL_ERROR_WANT_WRITE:
+        *want = REACTOR_WRITE;
+        return -1;
+    case SSL_ERROR_ZERO_RETURN:
+        return 0;
+    case SSL_ERROR_SYSCALL:
+        // Closed without close_notify; the parser checks the framing
+        if (ERR_peek_error() == 0 && (result == 0 || saved_errno == 0)) {
+            return 0;
+        }
+        snprintf(request->error, sizeof(request->error), "%s failed: %s", operation,
+                 strerror(saved_errno));
+        return -2;
+    default:
+        break;
+    }
+
+    long verify = SSL_get_verify_result(request->ssl);
+    if (verify != X509_V_OK) {
+        snprintf(request->error, sizeof(request->error), "certificate of %s rejected: %s",
+                 request->host, X509_verify_cert_error_string(verify));
+    } else {
+        const char *reason = ERR_reason_error_string(ERR_peek_error());
+        snprintf(request->error, sizeof(request->error), "%s failed: %s", operation,
+                 reason ? reason : "protocol error");
+    }
+    return -2;
+}
+
+/**
+ * @brief Send or receive on the connection, through TLS if it has any
+ * @return Bytes transferred, 0 at the end of the connection, -1 if it has
+ *         to wait for want, -2 on error (described in request->error)
+ */
+static ssize_t connection_io(HttpRequest *request, int writing, void *data, size_t size,
+                             uint32_t *want) {
+    if (request->ssl) {
+        ERR_clear_error();
+        int result = writing ? SSL_write(request->ssl, data, (int)size)
+                             : SSL_read(request->ssl, data, (int)size);
+        if (result > 0) {
+            return result;
+        }
+        return tls_status(request, result, writing ? "TLS write" : "TLS read", want);
+    }
+
+    ssize_t result = writing ? send(request->fd, data, size, MSG_NOSIGNAL)
+                             : recv(request->fd, data, size, 0);
+    if (result >= 0) {
+        return result;
+    }
+    if (errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR) {
+        *want = writing ? REACTOR_WRITE : REACTOR_READ;
+        return -1;
+    }
+    snprintf(request->error, sizeof(request->error), "%s failed: %s",
+             writing ? "send" : "receive", strerror(errno));
+    return -2;
+}
+
+// ============================================================================
+// RESPONSE PARSING
+// ============================================================================
+
+/**
+ * @brief Walk a chunked body, optionally decoding it in place
+ * @return 1 once the last chunk has arrived, 0 if more data is needed,
+ *         -1 if the body is malformed or too large
+ */
+static int walk_chunks(HttpRequest *request, int decode) {
+    char *body = request->in + request->head_size;
+    size_t size = request->in_size - request->head_size;
+    size_t position = 0;
+    size_t decoded = 0;
+
+    for (;;) {
+        char *line_end = memmem(body + position, size - position, "\r\n", 2);
+        if (!line_end) {
+            return 0;
+        }
+
+        char *digits_end;
+        unsigned long long chunk = strtoull(body + position, &digits_end, 16);
+        if (!isxdigit((unsigned char)body[position]) ||
+            (digits_end != line_end && *digits_end != ';' && *digits_end != ' ')) {
+            snprintf(request->error, sizeof(request->error), "malformed chunked response");
+            return -1;
+        }
+        if (chunk > MAX_HTTP_RESPONSE_SIZE || decoded + chunk > MAX_HTTP_RESPONSE_SIZE) {
+            snprintf(request->error, sizeof(request->error), "response exceeds %d bytes",
+                     MAX_HTTP_RESPONSE_SIZE);
+            return -1;
+        }
+
+        size_t data = (size_t)(line_end + 2 - body);
+        if (chunk == 0) {
+            // Optional trailer lines, then the empty line ending the body
+            if (!memmem(body + data - 2, size - (data - 2), "\r\n\r\n", 4)) {
+                return 0;
+            }
+            if (decode) {
+                body[decoded] = '\0';
+                request->body = body;
+                request->body_size = decoded;
+            }
+            return 1;
+        }
+
+        if (size < data + chunk + 2) {
+            return 0;
+        }
+        if (body[data + chunk] != '\r' || body[data + chunk + 1] != '\n') {
+            snprintf(request->error, sizeof(request->error), "malformed chunked response");
+            return -1;
+        }
+        if (decode) {
+            memmove(body + decoded, body + data, chunk);
+        }
+        decoded += chunk;
+        position = data + chunk + 2;
+    }
+}
+
+/**
+ * @brief Parse the status line and the framing headers
+ * @return 0 on success, -1 if the head is malformed
+ */
+static int parse_head(HttpRequest *request) {
+    const char *line = request->in;
+    const char *head_end = request->in + request->head_size;
+
+    if (sscanf(line, "HTTP/%*d.%*d %3ld", &request->status) != 1 ||
+        request->status < 100 || request->status > 599) {
+        snprintf(request->error, sizeof(request->error), "malformed response from %s",
+                 request->host);
+        request->status = 0;
+        return -1;
+    }
+
+    request->content_length = -1;
+    request->chunked = 0;
+    while ((line = memmem(line, (size_t)(head_end - line), "\r\n", 2)) != NULL) {
+        line += 2;
+        if (strncasecmp(line, "Content-Length:", 15) == 0) {
+            request->content_length = strtoll(line + 15, NULL, 10);
+        } else if (strncasecmp(line, "Transfer-Encoding:", 18) == 0) {
+            const char *value = line + 18;
+            value += strspn(value, " \t");
+            request->chunked = strncasecmp(value, "chunked", 7) == 0;
+        }
+    }
+    return SUCCESS;
+}
+
+/**
+ * @brief Check whether the whole response has arrived
+ * @return 1 if complete (body set), 0 if more data is needed, -1 on error
+ */
+static int check_response(HttpRequest *request) {
+    while (request->head_size == 0) {
+        char *end = strstr(request->in, "\r\n\r\n");
+        if (!end) {
+            if (request->in_size > HTTP_CLIENT_MAX_HEAD_SIZE) {
+                snprintf(request->error, sizeof(request->error), "response head exceeds %d bytes",
+                         HTTP_CLIENT_MAX_HEAD_SIZE);
+                return -1;
+            }
+            return 0;
+        }
+
+        request->head_size = (size_t)(end + 4 - request->in);
+        if (parse_head(request) != SUCCESS) {
+            return -1;
+        }
+
+        // An interim response (100 Continue) is followed by the real one
+        if (request->status < 200) {
+            request->in_size -= request->head_size;
+            memmove(request->in, request->in + request->head_size, request->in_size + 1);
+            request->head_size = 0;
+            request->status = 0;
+        }
+    }
+
+    char *body = request->in + request->head_size;
+    size_t received = request->in_size - request->head_size;
+
+    if (request->status == 204 || request->status == 304) {
+        request->body = body;
+        request->body_size = 0;
+        return 1;
+    }
+    if (request->chunked) {
+        int complete = walk_chunks(request, 0);
+        return complete > 0 ? walk_chunks(request, 1) : complete;
+    }
+    if (request->content_length > MAX_HTTP_RESPONSE_SIZE ||
+        (request->content_length < 0 && received > MAX_HTTP_RESPONSE_SIZE)) {
+        snprintf(request->error, sizeof(request->error), "response exceeds %d bytes",
+                 MAX_HTTP_RESPONSE_SIZE);
+        return -1;
+    }
+    if (request->content_length >= 0 && received >= (size_t)request->content_length) {
+        body[request->content_length] = '\0';
+        request->body = body;
+        request->body_size = (size_t)request->content_length;
+        return 1;
+    }
+    return 0;
+}
+
+/**
+ * @brief Handle the end of the connection while receiving
+ * @return 0, the request no longer exists
+ */
+static int complete_at_eof(HttpRequest *request) {
+    if (request->head_size == 0) {
+        snprintf(request->error, sizeof(request->error), "connection to %s closed %s",
+                 request->host, request->in_size ? "inside the response head" : "without a response");
+        return fail(request);
+    }
+    if (request->chunked || request->content_length >= 0) {
+        snprintf(request->error, sizeof(request->error), "connection to %s closed inside the body",
+                 request->host);
+        return fail(request);
+    }
+
+    // Without framing the body ends with the connection
+    request->body = request->in + request->head_size;
+    request->body_size = request->in_size - request->head_size;
+    return finish(request, NULL);
+}
+
+/**
+ * @brief Make room for the next read
+ * @return 0 on success, -1 if the response is too large or memory ran out
+ */
+static int reserve_input(HttpRequest *request) {
+    if (request->in_capacity - request->in_size > 1) {
+        return SUCCESS;
+    }
+    if (request->in_capacity >= RESPONSE_MAX_SIZE) {
+        snprintf(request->error, sizeof(request->error), "response exceeds %d bytes",
+                 MAX_HTTP_RESPONSE_SIZE);
+        return -1;
+    }
+
+    size_t capacity = request->in_capacity ? request->in_capacity * 2 : RESPONSE_INITIAL_SIZE;
+    if (capacity > RESPONSE_MAX_SIZE) {
+        capacity = RESPONSE_MAX_SIZE;
+    }
+    char *grown = realloc(request->in, capacity);
+    if (!grown) {
+        snprintf(request->error, sizeof(request->error), "insufficient memory for response");
+        return -1;
+    }
+    request->in = grown;
+    request->in_capacity = capacity;
+    return SUCCESS;
+}
+
+// ============================================================================
+// STATE MACHINE
+// ============================================================================
+
+/**
+ * @brief Run the request until the socket would block
+ * @return 1 if the request is still in flight, 0 if it finished
+ */
+static int advance(HttpRequest *request) {
+    uint32_t want = 0;
+
+    for (;;) {
+        if (request->state == HTTP_HANDSHAKE) {
+            ERR_clear_error();
+            int result = SSL_do_handshake(request->ssl);
+            if (result == 1) {
+                request->state = HTTP_SENDING;
+                continue;
+            }
+            int status = tls_status(request, result, "TLS handshake", &want);
+            if (status == -1) {
+                break;
+            }
+            if (status == 0) {
+                snprintf(request->error, sizeof(request->error),
+                         "connection to %s closed during the TLS handshake", request->host);
+            }
+            return fail(request);
+        }
+
+        if (request->state == HTTP_SENDING) {
+            ssize_t sent = connection_io(request, 1, request->out + request->out_sent,
+                                         request->out_size - request->out_sent, &want);
+            if (sent == -1) {
+                break;
+            }
+            if (sent <= 0) {
+                if (sent == 0) {
+                    snprintf(request->error, sizeof(request->error),
+                             "connection to %s closed while sending", request->host);
+                }
+                return fail(request);
+            }
+            request->out_sent += (size_t)sent;
+            if (request->out_sent == request->out_size) {
+                request->state = HTTP_RECEIVING;
+            }
+            continue;
+        }
+
+        // HTTP_RECEIVING
+        if (reserve_input(request) != SUCCESS) {
+            return fail(request);
+        }
+        ssize_t received = connection_io(request, 0, request->in + request->in_size,
+                                         request->in_capacity - request->in_size - 1, &want);
+        if (received == -1) {
+            break;
+        }
+        if (received == -2) {
+            return fail(request);
+        }
+        if (received == 0) {
+            return complete_at_eof(request);
+        }
+
+        request->in_size += (size_t)received;
+        request->in[request->in_size] = '\0';
+        int complete = check_response(request);
+        if (complete < 0) {
+            return fail(request);
+        }
+        if (complete > 0) {
+            return finish(request, NULL);
+        }
+    }
+
+    if (want != request->events) {
+        reactor_modify_fd(request->client->reactor, request->fd, want);
+        request->events = want;
+    }
+    return 1;
+}
+
+/**
+ * @brief Reactor handler for the connection
+ */
+static void connection_event(int fd, uint32_t events, void *userdata) {
+    ALLOC_SCOPE(ALLOC_SUBSYSTEM_NOTIFIER);
+    HttpRequest *request = (HttpRequest*)userdata;
+    (void)events;
+
+    if (request->state == HTTP_CONNECTING) {
+        int error = 0;
+        socklen_t length = sizeof(error);
+        if (getsockopt(fd, SOL_SOCKET, SO_ERROR, &error, &length) < 0) {
+            error = errno;
+        }
+        if (error == EINPROGRESS) {
+            return;
+        }
+        if (error != 0) {
+            snprintf(request->error, sizeof(request->error), "connect to %s failed: %s",
+                     request->host, strerror(error));
+            close_connection(request);
+            if (connect_next(request)) {
+                timesource_expect_io();
+            }
+            return;
+        }
+
+        if (request->tls && start_tls(request) != SUCCESS) {
+            snprintf(request->error, sizeof(request->error), "unable to set up TLS for %s",
+                     request->host);
+            fail(request);
+            return;
+        }
+        request->state = request->tls ? HTTP_HANDSHAKE : HTTP_SENDING;
+    }
+
+    if (advance(request)) {
+        timesource_expect_io();
+    }
+}
+
+/**
+ * @brief Reactor handler for the lookup's eventfd
+ */
+static void lookup_ready(int fd, uint32_t events, void *userdata) {
+    ALLOC_SCOPE(ALLOC_SUBSYSTEM_NOTIFIER);
+    HttpRequest *request = (HttpRequest*)userdata;
+    HttpLookup *lookup = request->lookup;
+    (void)events;
+
+    // The resolver signals just before it publishes its answer; the fd
+    // stays readable, so the next iteration picks it up
+    if (__atomic_load_n(&lookup->state, __ATOMIC_ACQUIRE) != LOOKUP_DONE) {
+        return;
+    }
+
+    reactor_remove_fd(request->client->reactor, fd);
+    request->lookup = NULL;
+    int error = lookup->error;
+    request->addresses = lookup->addresses;
+    lookup->addresses = NULL;
+    lookup_free(lookup);
+
+    if (error != 0) {
+        snprintf(request->error, sizeof(request->error), "unable to resolve %s: %s",
+                 request->host, gai_strerror(error));
+        fail(request);
+        return;
+    }
+
+    request->address = request->addresses;
+    if (connect_next(request)) {
+        timesource_expect_io();
+    }
+}
+
+// ============================================================================
+// PUBLIC API
+// ============================================================================
+
+/**
+ * @brief Create the TLS context shared by all https requests
+ * @return Context, NULL on error
+ */
+static SSL_CTX* create_tls_context(void) {
+    SSL_CTX *tls = SSL_CTX_new(TLS_client_method());
+    if (!tls) {
+        LOG_ERROR("HTTP: unable to create TLS context");
+        return NULL;
+    }
+
+    SSL_CTX_set_min_proto_version(tls, TLS1_2_VERSION);
+    SSL_CTX_set_verify(tls, SSL_VERIFY_PEER, NULL);
+    SSL_CTX_set_mode(tls, SSL_MODE_ENABLE_PARTIAL_WRITE | SSL_MODE_RELEASE_BUFFERS);
+#ifdef SSL_OP_IGNORE_UNEXPECTED_EOF
+    // Responses are framed, so a missing close_notify is not a truncation
+    SSL_CTX_set_options(tls, SSL_OP_IGNORE_UNEXPECTED_EOF);
+#endif
+
+    // The hashed directory is read one certificate per lookup, while the
+    // bundle file would be parsed whole into memory; use it only if asked
+    const char *cert_file = getenv(X509_get_default_cert_file_env());
+    if (SSL_CTX_set_default_verify_dir(tls) != 1 ||
+        (cert_file && SSL_CTX_set_default_verify_file(tls) != 1)) {
+        LOG_ERROR("HTTP: unable to use the trusted certificates");
+        SSL_CTX_free(tls);
+        return NULL;
+    }
+    return tls;
+}
+
+int http_client_init(HttpClient *client, Reactor *reactor) {
+    if (!client || !reactor) {
+        return ERROR_INVALID_PARAM;
+    }
+
+    memset(client, 0, sizeof(HttpClient));
+    client->reactor = reactor;
+    return SUCCESS;
+}
+
+void http_client_cleanup(HttpClient *client) {
+    if (!client || !client->reactor) {
+        return;
+    }
+
+    while (client->requests) {
+        HttpRequest *request = client->requests;
+        client->requests = request->next;
+        release_request(request);
+        free_request(request);
+    }
+
+    if (client->tls) {
+        SSL_CTX_free(client->tls);
+        client->tls = NULL;
+    }
+    client->reactor = NULL;
+}
+
+HttpRequest* http_client_post(HttpClient *client, const char *url, const char *content_type,
+                              const char *bearer_token, const char *body, int timeout_s,
+                              HttpCallback callback, void *userdata) {
+    if (!client || !client->reactor || !url || !content_type || !body || !callback ||
+        strpbrk(content_type, "\r\n") || (bearer_token && strpbrk(bearer_token, "\r\n"))) {
+        return NULL;
+    }
+
+    HttpRequest *request = calloc(1, sizeof(HttpRequest));
+    if (!request) {
+        return NULL;
+    }
+    request->client = client;
+    request->callback = callback;
+    request->userdata = userdata;
+    request->fd = -1;
+    request->content_length = -1;
+    request->start_us = timesource_real_us();
+
+    char port[8];
+    const char *authority;
+    const char *path;
+    size_t authority_length;
+    if (parse_url(url, &request->tls, request->host, sizeof(request->host), port, sizeof(port),
+                  &authority, &authority_length, &path) != SUCCESS) {
+        LOG_ERROR("HTTP: unsupported URL %s", url);
+        free(request);
+        return NULL;
+    }
+
+    // OpenSSL's TLS state costs a few hundred kilobytes; plain HTTP never loads it
+    if (request->tls && !client->tls && !(client->tls = create_tls_context())) {
+        free(request);
+        return NULL;
+    }
+
+    if (build_request(request, path, authority, authority_length, content_type,
+                      bearer_token, body) != SUCCESS) {
+        free_request(request);
+        return NULL;
+    }
+
+    HttpLookup *lookup = calloc(1, sizeof(HttpLookup));
+    if (!lookup) {
+        free_request(request);
+        return NULL;
+    }
+    snprintf(lookup->host, sizeof(lookup->host), "%s", request->host);
+    snprintf(lookup->port, sizeof(lookup->port), "%s", port);
+    lookup->event_fd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    if (lookup->event_fd < 0) {
+        free(lookup);
+        free_request(request);
+        return NULL;
+    }
+
+    if (reactor_add_fd(client->reactor, lookup->event_fd, REACTOR_READ, lookup_ready,
+                       request) != SUCCESS) {
+        lookup_free(lookup);
+        free_request(request);
+        return NULL;
+    }
+
+    request->timer_id = reactor_add_timer(client->reactor, (uint64_t)timeout_s * 1000ULL, 0,
+                                          request_timeout, request);
+    if (request->timer_id < 0) {
+        request->timer_id = 0;
+        reactor_remove_fd(client->reactor, lookup->event_fd);
+        lookup_free(lookup);
+        free_request(request);
+        return NULL;
+    }
+
+    // Starting the lookup is the last step that can fail, so no resolver
+    // thread is ever left behind by an error here
+    if (lookup_start(lookup) != SUCCESS) {
+        reactor_cancel_timer(client->reactor, request->timer_id);
+        reactor_remove_fd(client->reactor, lookup->event_fd);
+        lookup_free(lookup);
+        free_request(request);
+        return NULL;
+    }
+
+    request->lookup = lookup;
+    request->state = HTTP_RESOLVING;
+    request->next = client->requests;
+    client->requests = request;
+
+    timesource_expect_io();
+    return request;
+}
+
+void http_request_cancel(HttpRequest *request) {
+    if (!request || request->state == HTTP_FINISHED) {
+        return;
+    }
+
+    release_request(request);
+    unlink_request(request);
+    free_request(request);
+}
@@ -0,0 +1,126 @@
+/**
+ * @file http_client.h
+ * @brief Minimal HTTP/1.1 client on the reactor, over OpenSSL
+ *
+ * Built with -DDOOR_MONITOR_MINIMAL_HTTP (make small, or MINIMAL_HTTP=1),
+ * the notifier sends its requests with this client instead of libcurl. It
+ * does what the OAuth and FCM exchanges need and nothing more: one POST per
+ * connection, over TLS 1.2 or later with the system trust store and host
+ * name verification, or over plain HTTP for the local stand-in. The
+ * response is read up to MAX_HTTP_RESPONSE_SIZE bytes of body, framed by
+ * Content-Length, chunked encoding or the end of the connection.
+ *
+ * libssl and libcrypto are linked anyway for JWT signing, so dropping
+ * libcurl removes its code and its own dependencies (a second TLS library,
+ * Kerberos, LDAP, SSH, HTTP/2) from the process. Connections are not kept
+ * alive: reminders are rare, and an idle TLS session is the memory this
+ * build is meant to save.
+ *
+ * Host names are resolved by a short-lived thread per request, so
+ * getaddrinfo() never blocks the loop; the answer arrives through an
+ * eventfd. Numeric addresses such as the stand-in's skip the thread.
+ *
+ * Threading:
+ * All functions must be called from the reactor thread, and callbacks run
+ * on it.
+ */
+
+#ifndef HTTP_CLIENT_H
+#define HTTP_CLIENT_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <openssl/ssl.h>
+
+#include "config.h"
+#include "reactor.h"
+
+// ============================================================================
+// DATA STRUCTURES
+// ============================================================================
+
+/// Request in flight (opaque)
+typedef struct HttpRequest HttpRequest;
+
+/**
+ * @brief Outcome of a request, valid during its callback only
+ */
+typedef struct {
+    HttpRequest *request;               /// Request that finished
+    const char *error;                  /// NULL on success, otherwise what failed
+    long status;                        /// HTTP status code, 0 if no response arrived
+    const char *body;                   /// Response body, NUL terminated ("" if none)
+    size_t body_size;                   /// Bytes in body
+    uint64_t duration_us;               /// Time from http_client_post() to completion
+} HttpResult;
+
+/**
+ * @brief Completion callback
+ * @param result Outcome of the request
+ * @param userdata Pointer given to http_client_post()
+ */
+typedef void (*HttpCallback)(const HttpResult *result, void *userdata);
+
+/**
+ * @brief Client state
+ */
+typedef struct {
+    Reactor *reactor;                   /// Loop driving the connections, NULL until initialized
+    SSL_CTX *tls;                       /// TLS settings and trust store, NULL until the first https request
+    HttpRequest *requests;              /// Requests in flight
+} HttpClient;
+
+// ============================================================================
+// PUBLIC API
+// ============================================================================
+
+/**
+ * @brief Initialize a client
+ * @param client Client to initialize
+ * @param reactor Loop driving the connections
+ * @return 0 on success, ERROR_INVALID_PARAM on invalid arguments
+ *
+ * TLS is set up by the first https request. Certificates are then looked
+ * up in the system's hashed certificate directory as connections need
+ * them, rather than loading the whole bundle. SSL_CERT_DIR and
+ * SSL_CERT_FILE override the locations.
+ */
+int http_client_init(HttpClient *client, Reactor *reactor);
+
+/**
+ * @brief Abort all requests and release TLS
+ * @param client Client to clean up
+ *
+ * Callbacks of aborted requests are not called.
+ */
+void http_client_cleanup(HttpClient *client);
+
+/**
+ * @brief Start a POST request
+ * @param client Initialized client
+ * @param url "https://host[:port]/path" or "http://host[:port]/path"
+ * @param content_type Content-Type of body
+ * @param bearer_token Token sent as "Authorization: Bearer", NULL for none
+ * @param body Request body (copied)
+ * @param timeout_s Seconds the whole request may take
+ * @param callback Completion callback
+ * @param userdata Callback argument
+ * @return Request handle, NULL if the URL is invalid, TLS could not be set
+ *         up or memory ran out
+ *
+ * The callback runs from the reactor loop, never from inside this call.
+ */
+HttpRequest* http_client_post(HttpClient *client, const char *url, const char *content_type,
+                              const char *bearer_token, const char *body, int timeout_s,
+                              HttpCallback callback, void *userdata);
+
+/**
+ * @brief Abort a request without calling its callback
+ * @param request Request to abort
+ *
+ * Does nothing when called from the request's own callback; the request is
+ * released once the callback returns.
+ */
+void http_request_cancel(HttpRequest *request);
+
+#endif // HTTP_CLIENT_H
@@ -0,0 +1,1050 @@
+/**
+ * @file notifier.c
+ * @brief Implementation of the reactor-driven FCM sender
+ *
+ * Curl reports the sockets and the timeout it needs through the multi
+ * socket callbacks; they are mirrored into reactor fd registrations and a
+ * one-shot reactor timer. Completed transfers are collected after every
+ * curl_multi_socket_action() call. Requests wait in a fixed slot table
+ * until an OAuth token is available, then each gets its own transfer.
+ *
+ * With -DDOOR_MONITOR_MINIMAL_HTTP the transfers go through the built-in
+ * client of http_client.c instead, which reports each finished request
+ * through a callback. Only the functions in the two backend sections
+ * differ; queueing, tokens and retries are shared.
+ *
+ * The HTTP stack (curl, its TLS backend and the multi handle, or the
+ * built-in client's TLS context) is loaded on first use, not by
+ * notifier_init(). An idle timer releases it again, including curl's
+ * connection cache and its TLS sessions, once nothing has been sent for
+ * notifier_idle_release seconds; the cached OAuth token survives.
+ */
+
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stddef.h>
+
+#include "notifier.h"
+#include "fcm_notification.h"
+#include "fcm_token.h"
+#include "runtime_config.h"
+#include "logger.h"
+#include "metrics.h"
+#include "trace.h"
+#include "timesource.h"
+#include "alloc_stats.h"
+
+// ============================================================================
+// STATIC VARIABLES
+// ============================================================================
+
+static Metric requests_queued = METRIC_COUNTER_INIT("notifier_requests_total",
+    "Notification requests accepted by the notifier");
+static Metric requests_rejected = METRIC_COUNTER_INIT("notifier_queue_full_total",
+    "Notification requests rejected because the queue was full");
+static Metric notifications_sent = METRIC_COUNTER_INIT("notifier_sent_total",
+    "Notifications accepted by FCM");
+static Metric notifications_failed = METRIC_COUNTER_INIT("notifier_failed_total",
+    "Notifications that could not be delivered to FCM");
+static Metric token_refreshes = METRIC_COUNTER_INIT("notifier_oauth_refreshes_total",
+    "OAuth access token requests");
+static Metric token_failures = METRIC_COUNTER_INIT("notifier_oauth_failures_total",
+    "OAuth access token requests that failed");
+static Metric http_duration = METRIC_HISTOGRAM_INIT("notifier_http_duration_us",
+    "OAuth and FCM request duration in microseconds");
+static Metric delivery_duration = METRIC_HISTOGRAM_INIT("notifier_delivery_duration_ms",
+    "Time from queueing a notification to its outcome in milliseconds");
+static Metric stack_loads = METRIC_COUNTER_INIT("notifier_stack_loads_total",
+    "Times the HTTP/TLS stack was initialized");
+static Metric stack_loaded = METRIC_GAUGE_INIT("notifier_stack_loaded",
+    "1 while the HTTP/TLS stack is initialized, 0 while released");
+
+static Metric *const notifier_metrics[] = {
+    &requests_queued, &requests_rejected, &notifications_sent, &notifications_failed,
+    &token_refreshes, &token_failures, &http_duration, &delivery_duration,
+    &stack_loads, &stack_loaded
+};
+
+// ============================================================================
+// INTERNAL HELPER FUNCTIONS
+// ============================================================================
+
+static void pump_requests(Notifier *notifier);
+static void schedule_idle_release(Notifier *notifier, uint64_t delay_ms);
+static void destroy_transfer(Notifier *notifier, NotifierTransfer **transfer,
+                             NotifierRequest *request);
+
+/**
+ * @brief Append received data to a response buffer
+ */
+static size_t write_callback(void *contents, size_t size, size_t nmemb, void *userp) {
+    NotifierBuffer *buffer = (NotifierBuffer*)userp;
+    size_t realsize = size * nmemb;
+
+    if (buffer->size + realsize > MAX_HTTP_RESPONSE_SIZE) {
+        LOG_WARN("Notifier: HTTP response exceeds %d bytes", MAX_HTTP_RESPONSE_SIZE);
+        return 0;
+    }
+
+    // Grow geometrically; the storage is kept for the next response
+    size_t needed = buffer->size + realsize + 1;
+    if (needed > buffer->capacity) {
+        size_t capacity = buffer->capacity ? buffer->capacity : NOTIFIER_RESPONSE_INITIAL_SIZE;
+        while (capacity < needed) {
+            capacity *= 2;
+        }
+        if (capacity > MAX_HTTP_RESPONSE_SIZE + 1) {
+            capacity = MAX_HTTP_RESPONSE_SIZE + 1;
+        }
+
+        char *ptr = realloc(buffer->data, capacity);
+        if (!ptr) {
+            LOG_ERROR("Notifier: insufficient memory for HTTP response");
+            return 0;
+        }
+        buffer->data = ptr;
+        buffer->capacity = capacity;
+    }
+
+    memcpy(&buffer->data[buffer->size], contents, realsize);
+    buffer->size += realsize;
+    buffer->data[buffer->size] = '\0';
+
+    return realsize;
+}
+
+/**
+ * @brief Empty a response buffer, keeping its storage
+ */
+static void buffer_reset(NotifierBuffer *buffer) {
+    buffer->size = 0;
+    if (buffer->data) {
+        buffer->data[0] = '\0';
+    }
+}
+
+/**
+ * @brief Release a response buffer's storage
+ */
+static void buffer_free(NotifierBuffer *buffer) {
+    free(buffer->data);
+    buffer->data = NULL;
+    buffer->size = 0;
+    buffer->capacity = 0;
+}
+
+/**
+ * @brief Free a request slot and report its result
+ */
+static void finish_request(Notifier *notifier, NotifierRequest *request, int result) {
+    NotifierCallback callback = request->callback;
+    void *userdata = request->userdata;
+    uint64_t queued_ms = request->queued_ms;
+
+    destroy_transfer(notifier, &request->transfer, request);
+
+    // The body and response storage stay with the slot
+    memset(request, 0, offsetof(NotifierRequest, body));
+    request->body[0] = '\0';
+    buffer_reset(&request->response);
+
+    METRICS_INC(result == SUCCESS ? &notifications_sent : &notifications_failed);
+    metrics_histogram_observe(&delivery_duration, reactor_now_ms() - queued_ms);
+
+    // The slot is free again, so the callback may queue a new request
+    if (callback) {
+        callback(result, userdata);
+    }
+}
+
+/**
+ * @brief Check whether the cached OAuth token can be used
+ */
+static int token_valid(const Notifier *notifier) {
+    return notifier->oauth_token && reactor_now_ms() < notifier->oauth_refresh_ms;
+}
+
+/**
+ * @brief Drop the cached OAuth token
+ */
+static void invalidate_token(Notifier *notifier) {
+    free(notifier->oauth_token);
+    notifier->oauth_token = NULL;
+    notifier->oauth_refresh_ms = 0;
+}
+
+#ifndef DOOR_MONITOR_MINIMAL_HTTP
+
+// ============================================================================
+// CURL MULTI INTEGRATION
+// ============================================================================
+
+static void check_completed(Notifier *notifier);
+
+/**
+ * @brief Create a transfer handle with the options shared by all requests
+ * @return Configured handle, NULL on error
+ */
+static CURL* create_transfer(const char *url, const char *body, NotifierBuffer *response,
+                             void *owner) {
+    CURL *easy = curl_easy_init();
+    if (!easy) {
+        return NULL;
+    }
+
+    curl_easy_setopt(easy, CURLOPT_URL, url);
+    curl_easy_setopt(easy, CURLOPT_POSTFIELDS, body);
+    curl_easy_setopt(easy, CURLOPT_WRITEFUNCTION, write_callback);
+    curl_easy_setopt(easy, CURLOPT_WRITEDATA, response);
+    curl_easy_setopt(easy, CURLOPT_PRIVATE, owner);
+    curl_easy_setopt(easy, CURLOPT_TIMEOUT, (long)runtime_config_get()->notifier_request_timeout);
+    curl_easy_setopt(easy, CURLOPT_NOSIGNAL, 1L);
+
+    return easy;
+}
+
+/**
+ * @brief Start a transfer on the multi handle
+ * @param request FCM request being sent, NULL for the OAuth token request
+ * @return 0 on success, ERROR_NETWORK on error
+ */
+static int start_transfer(Notifier *notifier, NotifierTransfer **transfer, const char *url,
+                          const char *body, NotifierBuffer *response, NotifierRequest *request) {
+    if (request) {
+        char auth_header[MAX_OAUTH_TOKEN_SIZE + 32];
+        snprintf(auth_header, sizeof(auth_header), "Authorization: Bearer %s", notifier->oauth_token);
+        request->headers = curl_slist_append(request->headers, auth_header);
+        request->headers = curl_slist_append(request->headers, "Content-Type: application/json; UTF-8");
+    }
+
+    *transfer = create_transfer(url, body, response, request);
+    if (!*transfer) {
+        return ERROR_NETWORK;
+    }
+    if (request) {
+        curl_easy_setopt(*transfer, CURLOPT_HTTPHEADER, request->headers);
+    }
+
+    if (curl_multi_add_handle(notifier->multi, *transfer) != CURLM_OK) {
+        curl_easy_cleanup(*transfer);
+        *transfer = NULL;
+        return ERROR_NETWORK;
+    }
+    return SUCCESS;
+}
+
+/**
+ * @brief Remove a transfer from the multi handle and free it, along with
+ *        the headers of the request it sent
+ */
+static void destroy_transfer(Notifier *notifier, NotifierTransfer **transfer,
+                             NotifierRequest *request) {
+    if (*transfer) {
+        curl_multi_remove_handle(notifier->multi, *transfer);
+        curl_easy_cleanup(*transfer);
+        *transfer = NULL;
+    }
+    if (request) {
+        curl_slist_free_all(request->headers);
+        request->headers = NULL;
+    }
+}
+
+/**
+ * @brief Record the duration of a finished transfer
+ */
+static void observe_duration(CURL *easy) {
+    double total_time = 0;
+    if (curl_easy_getinfo(easy, CURLINFO_TOTAL_TIME, &total_time) == CURLE_OK) {
+        metrics_histogram_observe(&http_duration, (uint64_t)(total_time * 1000000.0));
+    }
+}
+
+/**
+ * @brief Reactor handler for a curl socket
+ */
+static void socket_event(int fd, uint32_t events, void *userdata) {
+    ALLOC_SCOPE(ALLOC_SUBSYSTEM_NOTIFIER);
+    Notifier *notifier = (Notifier*)userdata;
+    int flags = 0;
+    int running = 0;
+
+    if (events & REACTOR_READ) flags |= CURL_CSELECT_IN;
+    if (events & REACTOR_WRITE) flags |= CURL_CSELECT_OUT;
+    if (events & REACTOR_ERROR) flags |= CURL_CSELECT_ERR;
+
+    curl_multi_socket_action(notifier->multi, fd, flags, &running);
+    if (running > 0) {
+        timesource_expect_io();
+    }
+    check_completed(notifier);
+}
+
+/**
+ * @brief Reactor handler for the curl timeout
+ */
+static void timeout_expired(void *userdata) {
+    ALLOC_SCOPE(ALLOC_SUBSYSTEM_NOTIFIER);
+    Notifier *notifier = (Notifier*)userdata;
+    int running = 0;
+
+    notifier->timer_id = 0;
+    curl_multi_socket_action(notifier->multi, CURL_SOCKET_TIMEOUT, 0, &running);
+    if (running > 0) {
+        timesource_expect_io();
+    }
+    check_completed(notifier);
+}
+
+/**
+ * @brief Curl socket callback: mirror socket interest into the reactor
+ *
+ * The socket's assigned pointer marks whether it is registered.
+ */
+static int socket_callback(CURL *easy, curl_socket_t s, int what, void *userp, void *socketp) {
+    (void)easy;
+    Notifier *notifier = (Notifier*)userp;
+
+    if (what == CURL_POLL_REMOVE) {
+        if (socketp) {
+            reactor_remove_fd(notifier->reactor, s);
+            curl_multi_assign(notifier->multi, s, NULL);
+        }
+        return 0;
+    }
+
+    uint32_t events = 0;
+    if (what & CURL_POLL_IN) events |= REACTOR_READ;
+    if (what & CURL_POLL_OUT) events |= REACTOR_WRITE;
+
+    if (socketp) {
+        reactor_modify_fd(notifier->reactor, s, events);
+    } else if (reactor_add_fd(notifier->reactor, s, events, socket_event, notifier) == SUCCESS) {
+        curl_multi_assign(notifier->multi, s, notifier);
+    } else {
+        LOG_ERROR("Notifier: unable to watch HTTP socket %d", (int)s);
+        return -1;
+    }
+
+    return 0;
+}
+
+/**
+ * @brief Curl timer callback: (re)arm the reactor timer
+ */
+static int timer_callback(CURLM *multi, long timeout_ms, void *userp) {
+    (void)multi;
+    Notifier *notifier = (Notifier*)userp;
+
+    if (notifier->timer_id > 0) {
+        reactor_cancel_timer(notifier->reactor, notifier->timer_id);
+        notifier->timer_id = 0;
+    }
+
+    if (timeout_ms >= 0) {
+        int id = reactor_add_timer(notifier->reactor, (uint64_t)timeout_ms, 0,
+                                   timeout_expired, notifier);
+        if (id < 0) {
+            LOG_ERROR("Notifier: unable to schedule HTTP timeout");
+            return -1;
+        }
+        notifier->timer_id = id;
+    }
+
+    return 0;
+}
+
+/**
+ * @brief Load curl, its TLS backend and the multi handle
+ * @return 0 on success, ERROR_NETWORK on error
+ */
+static int load_transport(Notifier *notifier) {
+    if (curl_global_init(CURL_GLOBAL_DEFAULT) != CURLE_OK) {
+        LOG_ERROR("Notifier: curl_global_init failed");
+        return ERROR_NETWORK;
+    }
+
+    notifier->multi = curl_multi_init();
+    if (!notifier->multi) {
+        LOG_ERROR("Notifier: curl_multi_init failed");
+        curl_global_cleanup();
+        return ERROR_NETWORK;
+    }
+
+    curl_multi_setopt(notifier->multi, CURLMOPT_SOCKETFUNCTION, socket_callback);
+    curl_multi_setopt(notifier->multi, CURLMOPT_SOCKETDATA, notifier);
+    curl_multi_setopt(notifier->multi, CURLMOPT_TIMERFUNCTION, timer_callback);
+    curl_multi_setopt(notifier->multi, CURLMOPT_TIMERDATA, notifier);
+    return SUCCESS;
+}
+
+/**
+ * @brief Release the multi handle, its connection cache and curl itself
+ */
+static void release_transport(Notifier *notifier) {
+    // Closing cached connections unregisters their sockets from the reactor
+    curl_multi_cleanup(notifier->multi);
+    notifier->multi = NULL;
+    curl_global_cleanup();
+
+    if (notifier->timer_id > 0) {
+        reactor_cancel_timer(notifier->reactor, notifier->timer_id);
+        notifier->timer_id = 0;
+    }
+}
+
+/**
+ * @brief Check whether curl is loaded
+ */
+static int transport_loaded(const Notifier *notifier) {
+    return notifier->multi != NULL;
+}
+
+#else // DOOR_MONITOR_MINIMAL_HTTP
+
+// ============================================================================
+// BUILT-IN HTTP CLIENT
+// ============================================================================
+
+static void transfer_done(const HttpResult *result, void *userdata);
+
+/**
+ * @brief Start a transfer on the built-in client
+ * @param request FCM request being sent, NULL for the OAuth token request
+ * @return 0 on success, ERROR_NETWORK on error
+ *
+ * The response is copied into its buffer by transfer_done().
+ */
+static int start_transfer(Notifier *notifier, NotifierTransfer **transfer, const char *url,
+                          const char *body, NotifierBuffer *response, NotifierRequest *request) {
+    (void)response;
+    *transfer = http_client_post(&notifier->http, url,
+                                 request ? "application/json; UTF-8"
+                                         : "application/x-www-form-urlencoded",
+                                 request ? notifier->oauth_token : NULL, body,
+                                 runtime_config_get()->notifier_request_timeout,
+                                 transfer_done, notifier);
+    return *transfer ? SUCCESS : ERROR_NETWORK;
+}
+
+/**
+ * @brief Abort a transfer
+ */
+static void destroy_transfer(Notifier *notifier, NotifierTransfer **transfer,
+                             NotifierRequest *request) {
+    (void)notifier;
+    (void)request;
+    if (*transfer) {
+        http_request_cancel(*transfer);
+        *transfer = NULL;
+    }
+}
+
+/**
+ * @brief Set up the built-in client (TLS follows with the first https request)
+ * @return 0 on success, ERROR_NETWORK on error
+ */
+static int load_transport(Notifier *notifier) {
+    return http_client_init(&notifier->http, notifier->reactor) == SUCCESS ? SUCCESS : ERROR_NETWORK;
+}
+
+/**
+ * @brief Release the built-in client and its TLS context
+ */
+static void release_transport(Notifier *notifier) {
+    http_client_cleanup(&notifier->http);
+}
+
+/**
+ * @brief Check whether the built-in client is set up
+ */
+static int transport_loaded(const Notifier *notifier) {
+    return notifier->http.reactor != NULL;
+}
+
+#endif // DOOR_MONITOR_MINIMAL_HTTP
+
+// ============================================================================
+// HTTP STACK
+// ============================================================================
+
+static void idle_expired(void *userdata);
+
+/**
+ * @brief Arm the idle release timer if it is enabled and not pending
+ */
+static void schedule_idle_release(Notifier *notifier, uint64_t delay_ms) {
+    if (notifier->idle_timer_id > 0 || !transport_loaded(notifier) ||
+        runtime_config_get()->notifier_idle_release <= 0) {
+        return;
+    }
+
+    int id = reactor_add_timer(notifier->reactor, delay_ms, 0, idle_expired, notifier);
+    if (id > 0) {
+        notifier->idle_timer_id = id;
+    }
+}
+
+/**
+ * @brief Load the HTTP stack if needed
+ * @return 0 on success, ERROR_NETWORK on error
+ */
+static int stack_load(Notifier *notifier) {
+    notifier->last_active_ms = reactor_now_ms();
+    if (transport_loaded(notifier)) {
+        return SUCCESS;
+    }
+
+    uint64_t span = trace_begin();
+    int result = load_transport(notifier);
+    if (result != SUCCESS) {
+        return result;
+    }
+    trace_end("notification", "stack_load", span);
+
+    METRICS_INC(&stack_loads);
+    metrics_gauge_set(&stack_loaded, 1);
+    LOG_DEBUG("Notifier: HTTP stack loaded");
+
+    schedule_idle_release(notifier, (uint64_t)runtime_config_get()->notifier_idle_release * 1000ULL);
+    return SUCCESS;
+}
+
+/**
+ * @brief Release the HTTP stack
+ *
+ * Only called with no transfer in flight.
+ */
+static void stack_release(Notifier *notifier) {
+    if (!transport_loaded(notifier)) {
+        return;
+    }
+
+    release_transport(notifier);
+    metrics_gauge_set(&stack_loaded, 0);
+}
+
+/**
+ * @brief Idle timer: release the stack once it has been unused long enough
+ */
+static void idle_expired(void *userdata) {
+    ALLOC_SCOPE(ALLOC_SUBSYSTEM_NOTIFIER);
+    Notifier *notifier = (Notifier*)userdata;
+    notifier->idle_timer_id = 0;
+
+    uint64_t idle_ms = (uint64_t)runtime_config_get()->notifier_idle_release * 1000ULL;
+    if (idle_ms == 0 || !transport_loaded(notifier)) {
+        return;
+    }
+
+    uint64_t quiet_ms = reactor_now_ms() - notifier->last_active_ms;
+    if (notifier->oauth_transfer || notifier_pending_count(notifier) > 0 || quiet_ms < idle_ms) {
+        // Used since the timer was armed: check again when it could be idle
+        schedule_idle_release(notifier, quiet_ms < idle_ms ? idle_ms - quiet_ms : idle_ms);
+        return;
+    }
+
+    LOG_INFO("Notifier: releasing HTTP stack after %llus idle",
+             (unsigned long long)(quiet_ms / 1000));
+    stack_release(notifier);
+}
+
+// ============================================================================
+// OAUTH TOKEN
+// ============================================================================
+
+/**
+ * @brief Start the OAuth token request
+ * @return 0 on success, negative on error
+ */
+static int start_token_request(Notifier *notifier) {
+    // A stand-in takes an unsigned request; otherwise use the pre-signed
+    // request while its JWT is comfortably valid
+    if (notifier->token_url[0] != '\0') {
+        notifier->oauth_body = strdup("grant_type=urn%3Aietf%3Aparams%3Aoauth%3Agrant-type%3Ajwt-bearer"
+                                      "&assertion=stand-in");
+    } else if (notifier->oauth_prepared &&
+        reactor_now_ms() - notifier->oauth_prepared_ms < NOTIFIER_PREPARED_MAX_AGE * 1000ULL) {
+        notifier->oauth_body = notifier->oauth_prepared;
+    } else {
+        free(notifier->oauth_prepared);
+        notifier->oauth_body = build_oauth_request_body(notifier->service_account_file);
+    }
+    notifier->oauth_prepared = NULL;
+    if (!notifier->oauth_body) {
+        return ERROR_CONFIG_FILE;
+    }
+
+    if (stack_load(notifier) != SUCCESS) {
+        free(notifier->oauth_body);
+        notifier->oauth_body = NULL;
+        return ERROR_NETWORK;
+    }
+
+    const char *url = notifier->token_url[0] != '\0' ? notifier->token_url : OAUTH_TOKEN_URL;
+    if (start_transfer(notifier, &notifier->oauth_transfer, url, notifier->oauth_body,
+                       &notifier->oauth_response, NULL) != SUCCESS) {
+        LOG_ERROR("Notifier: unable to start OAuth request");
+        free(notifier->oauth_body);
+        notifier->oauth_body = NULL;
+        return ERROR_NETWORK;
+    }
+
+    METRICS_INC(&token_refreshes);
+    notifier->oauth_span = trace_begin();
+    LOG_DEBUG("Notifier: requesting OAuth token");
+    return SUCCESS;
+}
+
+/**
+ * @brief Fail every request still waiting for a token
+ */
+static void fail_waiting_requests(Notifier *notifier) {
+    for (int i = 0; i < NOTIFIER_QUEUE_SIZE; i++) {
+        NotifierRequest *request = &notifier->requests[i];
+        if (request->in_use && !request->sending) {
+            finish_request(notifier, request, ERROR_NETWORK);
+        }
+    }
+}
+
+/**
+ * @brief Handle the end of the OAuth token request
+ * @param error NULL if a response arrived, otherwise what failed
+ * @param response_code HTTP status of the response
+ */
+static void token_request_done(Notifier *notifier, const char *error, long response_code) {
+    trace_end("notification", "oauth_http", notifier->oauth_span);
+
+    destroy_transfer(notifier, &notifier->oauth_transfer, NULL);
+    free(notifier->oauth_body);
+    notifier->oauth_body = NULL;
+
+    char *token = NULL;
+    long expires_in = 0;
+    if (error) {
+        LOG_ERROR("OAuth: HTTP request failed: %s", error);
+    } else if (notifier->oauth_response.size > 0) {
+        token = parse_oauth_response(notifier->oauth_response.data, &expires_in);
+    }
+
+    if (!token) {
+        if (!error) {
+            // Error responses carry no secret, so a short preview is safe to log
+            char preview[LOG_PREVIEW_LENGTH + 4];
+            log_preview(preview, sizeof(preview), notifier->oauth_response.data,
+                        notifier->oauth_response.size);
+            LOG_ERROR("OAuth: no access token in response (HTTP %ld): %s",
+                      response_code, preview);
+        }
+        buffer_reset(&notifier->oauth_response);
+        METRICS_INC(&token_failures);
+        fail_waiting_requests(notifier);
+        return;
+    }
+    buffer_reset(&notifier->oauth_response);
+
+    long lifetime = expires_in - NOTIFIER_TOKEN_REFRESH_MARGIN;
+    if (lifetime < 0) {
+        lifetime = 0;
+    }
+
+    invalidate_token(notifier);
+    notifier->oauth_token = token;
+    notifier->oauth_refresh_ms = reactor_now_ms() + (uint64_t)lifetime * 1000ULL;
+    LOG_DEBUG("OAuth token obtained, valid for %lds", expires_in);
+
+    pump_requests(notifier);
+}
+
+// ============================================================================
+// FCM REQUESTS
+// ============================================================================
+
+/**
+ * @brief Start the FCM transfer of a queued request
+ * @return 0 on success, negative on error
+ */
+static int start_send(Notifier *notifier, NotifierRequest *request) {
+    const RuntimeConfig *config = runtime_config_get();
+    char url[512];
+
+    if (notifier->send_url[0] != '\0') {
+        snprintf(url, sizeof(url), "%s", notifier->send_url);
+    } else if (build_fcm_url(url, sizeof(url), config->project_id) < 0) {
+        return ERROR_INVALID_PARAM;
+    }
+
+    if (stack_load(notifier) != SUCCESS) {
+        return ERROR_NETWORK;
+    }
+
+    int body_length = format_fcm_message_json(request->body, sizeof(request->body),
+                                              request->app_token, config->notification_title,
+                                              config->notification_body, FCM_NOTIFICATION_DATA_TYPE);
+    if (body_length < 0 || (size_t)body_length >= sizeof(request->body)) {
+        LOG_ERROR("FCM send: message exceeds %d bytes", NOTIFIER_BODY_SIZE);
+        return ERROR_INVALID_PARAM;
+    }
+
+    if (start_transfer(notifier, &request->transfer, url, request->body, &request->response,
+                       request) != SUCCESS) {
+        return ERROR_NETWORK;
+    }
+
+    request->sending = 1;
+    request->span = trace_begin();
+    LOG_DEBUG("Sending FCM notification to project %s", config->project_id);
+    return SUCCESS;
+}
+
+/**
+ * @brief Handle the end of an FCM transfer
+ * @param error NULL if a response arrived, otherwise what failed
+ * @param response_code HTTP status of the response
+ */
+static void send_request_done(Notifier *notifier, NotifierRequest *request, const char *error,
+                              long response_code) {
+    trace_end("notification", "fcm_http", request->span);
+
+    if (error) {
+        LOG_ERROR("FCM send: HTTP request failed: %s", error);
+        finish_request(notifier, request, ERROR_NETWORK);
+        return;
+    }
+
+    if (response_code == 200) {
+        LOG_DEBUG("FCM response: HTTP 200, %zu bytes", request->response.size);
+        finish_request(notifier, request, SUCCESS);
+        return;
+    }
+
+    char preview[LOG_PREVIEW_LENGTH + 4];
+    log_preview(preview, sizeof(preview), request->response.data, request->response.size);
+
+    // A revoked or expired token is refreshed once before giving up
+    if (response_code == 401 && !request->token_retried) {
+        LOG_WARN("FCM rejected the OAuth token, refreshing it: %s", preview);
+        invalidate_token(notifier);
+
+        destroy_transfer(notifier, &request->transfer, request);
+        request->body[0] = '\0';
+        buffer_reset(&request->response);
+        request->sending = 0;
+        request->token_retried = 1;
+
+        pump_requests(notifier);
+        return;
+    }
+
+    LOG_WARN("FCM send failed: HTTP %ld, %zu bytes: %s",
+             response_code, request->response.size, preview);
+    finish_request(notifier, request, ERROR_NETWORK);
+}
+
+/**
+ * @brief Start waiting requests, fetching a token first if needed
+ */
+static void pump_requests(Notifier *notifier) {
+    if (notifier_pending_count(notifier) == 0) {
+        return;
+    }
+
+    if (!token_valid(notifier)) {
+        if (!notifier->oauth_transfer && start_token_request(notifier) != SUCCESS) {
+            fail_waiting_requests(notifier);
+        }
+        return;
+    }
+
+    for (int i = 0; i < NOTIFIER_QUEUE_SIZE; i++) {
+        NotifierRequest *request = &notifier->requests[i];
+        if (request->in_use && !request->sending) {
+            int result = start_send(notifier, request);
+            if (result != SUCCESS) {
+                LOG_ERROR("FCM send: unable to start request (%d)", result);
+                finish_request(notifier, request, result);
+            }
+        }
+    }
+}
+
+#ifndef DOOR_MONITOR_MINIMAL_HTTP
+
+/**
+ * @brief Collect finished transfers
+ */
+static void check_completed(Notifier *notifier) {
+    CURLMsg *message;
+    int remaining;
+
+    while ((message = curl_multi_info_read(notifier->multi, &remaining)) != NULL) {
+        if (message->msg != CURLMSG_DONE) {
+            continue;
+        }
+
+        CURL *easy = message->easy_handle;
+        CURLcode code = message->data.result;
+        const char *error = (code == CURLE_OK) ? NULL : curl_easy_strerror(code);
+        long response_code = 0;
+        curl_easy_getinfo(easy, CURLINFO_RESPONSE_CODE, &response_code);
+        observe_duration(easy);
+        notifier->last_active_ms = reactor_now_ms();
+
+        if (easy == notifier->oauth_transfer) {
+            token_request_done(notifier, error, response_code);
+            continue;
+        }
+
+        NotifierRequest *request = NULL;
+        curl_easy_getinfo(easy, CURLINFO_PRIVATE, (char**)&request);
+        if (request) {
+            send_request_done(notifier, request, error, response_code);
+        }
+    }
+
+    // Picks up notifier_idle_release being enabled by a reload
+    schedule_idle_release(notifier, (uint64_t)runtime_config_get()->notifier_idle_release * 1000ULL);
+}
+
+#else // DOOR_MONITOR_MINIMAL_HTTP
+
+/**
+ * @brief Built-in client callback: hand a finished transfer to its handler
+ *
+ * The handle is forgotten before the handler runs; the client frees it
+ * once this returns.
+ */
+static void transfer_done(const HttpResult *result, void *userdata) {
+    ALLOC_SCOPE(ALLOC_SUBSYSTEM_NOTIFIER);
+    Notifier *notifier = (Notifier*)userdata;
+    NotifierBuffer *response = NULL;
+    NotifierRequest *request = NULL;
+
+    if (result->request == notifier->oauth_transfer) {
+        notifier->oauth_transfer = NULL;
+        response = &notifier->oauth_response;
+    } else {
+        for (int i = 0; i < NOTIFIER_QUEUE_SIZE && !request; i++) {
+            if (notifier->requests[i].transfer == result->request) {
+                request = &notifier->requests[i];
+                request->transfer = NULL;
+                response = &request->response;
+            }
+        }
+    }
+    if (!response) {
+        return;
+    }
+
+    const char *error = result->error;
+    if (!error && write_callback((void*)result->body, 1, result->body_size, response) !=
+                  result->body_size) {
+        error = "response not stored";
+    }
+    metrics_histogram_observe(&http_duration, result->duration_us);
+    notifier->last_active_ms = reactor_now_ms();
+
+    if (request) {
+        send_request_done(notifier, request, error, result->status);
+    } else {
+        token_request_done(notifier, error, result->status);
+    }
+
+    // Picks up notifier_idle_release being enabled by a reload
+    schedule_idle_release(notifier, (uint64_t)runtime_config_get()->notifier_idle_release * 1000ULL);
+}
+
+#endif // DOOR_MONITOR_MINIMAL_HTTP
+
+// ============================================================================
+// PUBLIC FUNCTIONS
+// ============================================================================
+
+int notifier_init(Notifier *notifier, Reactor *reactor, const char *service_account_file) {
+    if (!notifier || !reactor || !service_account_file) {
+        return ERROR_INVALID_PARAM;
+    }
+
+    memset(notifier, 0, sizeof(Notifier));
+    notifier->reactor = reactor;
+    snprintf(notifier->service_account_file, sizeof(notifier->service_account_file),
+             "%s", service_account_file);
+
+    // The HTTP stack is loaded by the first request or notifier_warm_up()
+    metrics_register_all(notifier_metrics, sizeof(notifier_metrics) / sizeof(notifier_metrics[0]));
+
+    return SUCCESS;
+}
+
+void notifier_cleanup(Notifier *notifier) {
+    if (!notifier || !notifier->reactor) {
+        return;
+    }
+
+    for (int i = 0; i < NOTIFIER_QUEUE_SIZE; i++) {
+        NotifierRequest *request = &notifier->requests[i];
+        if (request->in_use) {
+            request->callback = NULL;
+            finish_request(notifier, request, ERROR_GENERIC);
+        }
+    }
+
+    destroy_transfer(notifier, &notifier->oauth_transfer, NULL);
+    free(notifier->oauth_body);
+    notifier->oauth_body = NULL;
+    free(notifier->oauth_prepared);
+    notifier->oauth_prepared = NULL;
+    buffer_free(&notifier->oauth_response);
+    for (int i = 0; i < NOTIFIER_QUEUE_SIZE; i++) {
+        buffer_free(&notifier->requests[i].response);
+    }
+    invalidate_token(notifier);
+
+    if (notifier->idle_timer_id > 0) {
+        reactor_cancel_timer(notifier->reactor, notifier->idle_timer_id);
+        notifier->idle_timer_id = 0;
+    }
+
+    stack_release(notifier);
+    notifier->reactor = NULL;
+}
+
+int notifier_prepare_credentials(Notifier *notifier) {
+    if (!notifier || !notifier->reactor) {
+        return ERROR_INVALID_PARAM;
+    }
+
+    // A stand-in accepts unsigned requests
+    if (notifier->token_url[0] != '\0') {
+        return SUCCESS;
+    }
+
+    uint64_t span = trace_begin();
+    char *body = build_oauth_request_body(notifier->service_account_file);
+    trace_end("notification", "oauth_sign", span);
+    if (!body) {
+        return ERROR_CONFIG_FILE;
+    }
+
+    free(notifier->oauth_prepared);
+    notifier->oauth_prepared = body;
+    notifier->oauth_prepared_ms = reactor_now_ms();
+    return SUCCESS;
+}
+
+int notifier_warm_up(Notifier *notifier) {
+    if (!notifier || !notifier->reactor) {
+        return ERROR_INVALID_PARAM;
+    }
+
+    if (token_valid(notifier) || notifier->oauth_transfer) {
+        return SUCCESS;
+    }
+
+    LOG_DEBUG("Notifier: fetching OAuth token ahead of the first reminder");
+    return start_token_request(notifier);
+}
+
+int notifier_set_endpoints(Notifier *notifier, const char *token_url, const char *send_url) {
+    if (!notifier || !notifier->reactor || !token_url || !send_url ||
+        strlen(token_url) >= sizeof(notifier->token_url) ||
+        strlen(send_url) >= sizeof(notifier->send_url)) {
+        return ERROR_INVALID_PARAM;
+    }
+
+    snprintf(notifier->token_url, sizeof(notifier->token_url), "%s", token_url);
+    snprintf(notifier->send_url, sizeof(notifier->send_url), "%s", send_url);
+    LOG_INFO("Notifier: sending to stand-in %s", send_url);
+    return SUCCESS;
+}
+
+int notifier_send_door_reminder(Notifier *notifier, const char *app_token,
+                                NotifierCallback callback, void *userdata) {
+    if (!notifier || !notifier->reactor || !app_token || app_token[0] == '\0') {
+        return ERROR_INVALID_PARAM;
+    }
+
+    ALLOC_SCOPE(ALLOC_SUBSYSTEM_NOTIFIER);
+    NotifierRequest *request = NULL;
+    for (int i = 0; i < NOTIFIER_QUEUE_SIZE; i++) {
+        if (!notifier->requests[i].in_use) {
+            request = &notifier->requests[i];
+            break;
+        }
+    }
+
+    if (!request) {
+        LOG_WARN("Notifier: queue full, dropping reminder");
+        METRICS_INC(&requests_rejected);
+        return ERROR_CAPACITY_EXCEEDED;
+    }
+
+    memset(request, 0, offsetof(NotifierRequest, body));
+    request->in_use = 1;
+    snprintf(request->app_token, sizeof(request->app_token), "%s", app_token);
+    request->callback = callback;
+    request->userdata = userdata;
+    request->queued_ms = reactor_now_ms();
+
+    // Start right away when possible; transfers only progress from the loop,
+    // so the callback never runs before this call returns
+    int result = SUCCESS;
+    if (token_valid(notifier)) {
+        result = start_send(notifier, request);
+    } else if (!notifier->oauth_transfer) {
+        result = start_token_request(notifier);
+    }
+
+    if (result != SUCCESS) {
+        LOG_ERROR("Notifier: unable to start reminder (%d)", result);
+        destroy_transfer(notifier, &request->transfer, request);
+        memset(request, 0, offsetof(NotifierRequest, body));
+        request->body[0] = '\0';
+        buffer_reset(&request->response);
+        METRICS_INC(&notifications_failed);
+        return result;
+    }
+
+    METRICS_INC(&requests_queued);
+    return SUCCESS;
+}
+
+int notifier_pending_count(const Notifier *notifier) {
+    int count = 0;
+
+    if (!notifier) {
+        return 0;
+    }
+
+    for (int i = 0; i < NOTIFIER_QUEUE_SIZE; i++) {
+        if (notifier->requests[i].in_use) {
+            count++;
+        }
+    }
+
+    return count;
+}
+
+uint64_t notifier_oldest_pending_ms(const Notifier *notifier) {
+    uint64_t oldest = 0;
+
+    if (!notifier) {
+        return 0;
+    }
+
+    for (int i = 0; i < NOTIFIER_QUEUE_SIZE; i++) {
+        const NotifierRequest *request = &notifier->requests[i];
+        if (request->in_use && (oldest == 0 || request->queued_ms < oldest)) {
+            oldest = request->queued_ms;
+        }
+    }
+
+    return oldest ? reactor_now_ms() - oldest : 0;
+}
+
+int notifier_stack_loaded(const Notifier *notifier) {
+    return notifier && transport_loaded(notifier);
+}
@@ -0,0 +1,217 @@
+/**
+ * @file notifier.h
+ * @brief Non-blocking FCM notification sender driven by the reactor
+ *
+ * The notifier performs the OAuth token exchange and the FCM send requests
+ * with the curl multi interface, or with the built-in client of
+ * http_client.h in builds with -DDOOR_MONITOR_MINIMAL_HTTP. Either way the
+ * sockets and timeouts are registered with the reactor, so HTTP traffic
+ * never blocks the event loop that also serves the Bluetooth clients and
+ * the door sensor.
+ *
+ * Features:
+ * - OAuth access token cached until shortly before it expires
+ * - Requests queued while a token is being obtained
+ * - One retry with a fresh token when FCM rejects the cached one
+ * - Optional warm-up: credentials signed off the loop and the first token
+ *   fetched at startup instead of on the first reminder
+ * - HTTP/TLS stack loaded on first use and released after a long idle
+ *   period (notifier_idle_release), so rarely-sending nodes stay small
+ * - Completion reported through a callback on the reactor thread
+ * - Endpoints replaceable by a local stand-in for simulation
+ *
+ * Threading:
+ * All functions must be called from the reactor thread.
+ */
+
+#ifndef NOTIFIER_H
+#define NOTIFIER_H
+
+#include <stdint.h>
+
+#include "config.h"
+#include "reactor.h"
+
+#ifdef DOOR_MONITOR_MINIMAL_HTTP
+#include "http_client.h"
+
+/// Transfer handle of the HTTP backend
+typedef HttpRequest NotifierTransfer;
+#else
+#include <curl/curl.h>
+
+/// Transfer handle of the HTTP backend
+typedef CURL NotifierTransfer;
+#endif
+
+// ============================================================================
+// DATA STRUCTURES
+// ============================================================================
+
+/**
+ * @brief Completion callback
+ * @param result 0 if FCM accepted the notification, negative on failure
+ * @param userdata Pointer given with the request
+ */
+typedef void (*NotifierCallback)(int result, void *userdata);
+
+/**
+ * @brief HTTP response body being received
+ *
+ * The storage is kept between requests, so once a slot has seen its largest
+ * response, receiving another one does not allocate.
+ */
+typedef struct {
+    char *data;                         /// Response bytes, NUL terminated
+    size_t size;                        /// Bytes received
+    size_t capacity;                    /// Bytes allocated for data
+} NotifierBuffer;
+
+/**
+ * @brief Queued notification request
+ */
+typedef struct {
+    int in_use;                         /// Slot holds a request
+    int sending;                        /// FCM request is in flight
+    int token_retried;                  /// Already retried with a fresh token
+    char app_token[TOKEN_SIZE];         /// Recipient FCM token
+    NotifierCallback callback;          /// Completion callback
+    void *userdata;                     /// Callback argument
+    NotifierTransfer *transfer;         /// Transfer handle while sending
+#ifndef DOOR_MONITOR_MINIMAL_HTTP
+    struct curl_slist *headers;         /// Request headers while sending
+#endif
+    uint64_t span;                      /// Trace span start
+    uint64_t queued_ms;                 /// Reactor time the request was queued
+    // Slot storage from here on is reused, not cleared, by the next request
+    char body[NOTIFIER_BODY_SIZE];      /// Request body while sending
+    NotifierBuffer response;            /// Response body while sending
+} NotifierRequest;
+
+/**
+ * @brief Notifier state
+ */
+typedef struct {
+    Reactor *reactor;                   /// Loop driving the transfers
+#ifdef DOOR_MONITOR_MINIMAL_HTTP
+    HttpClient http;                    /// Built-in client, http.reactor NULL while released
+#else
+    CURLM *multi;                       /// Curl multi handle, NULL while the stack is released
+    int timer_id;                       /// Pending curl timeout, 0 if none
+#endif
+    int idle_timer_id;                  /// Pending idle release check, 0 if none
+    uint64_t last_active_ms;            /// Reactor time the stack was last used
+    char service_account_file[256];     /// Service account used for OAuth
+    char *oauth_token;                  /// Cached access token, NULL if none
+    uint64_t oauth_refresh_ms;          /// Reactor time after which the token is refreshed
+    NotifierTransfer *oauth_transfer;   /// Token request in flight, NULL if none
+    char *oauth_body;                   /// Token request body while in flight
+    char *oauth_prepared;               /// Pre-signed token request body, NULL if none
+    uint64_t oauth_prepared_ms;         /// Reactor time oauth_prepared was signed
+    NotifierBuffer oauth_response;      /// Token response while in flight
+    uint64_t oauth_span;                /// Trace span start of the token request
+    char token_url[128];                /// Token endpoint override, empty for Google
+    char send_url[256];                 /// Send endpoint override, empty for FCM
+    NotifierRequest requests[NOTIFIER_QUEUE_SIZE]; /// Request slots
+} Notifier;
+
+// ============================================================================
+// LIFECYCLE
+// ============================================================================
+
+/**
+ * @brief Initialize the notifier
+ * @param notifier Pointer to notifier to initialize
+ * @param reactor Reactor that drives the HTTP transfers
+ * @param service_account_file Path to the service account JSON file
+ * @return 0 on success, negative on error
+ *
+ * Cheap: the HTTP/TLS stack is only loaded by the first request or warm-up.
+ */
+int notifier_init(Notifier *notifier, Reactor *reactor, const char *service_account_file);
+
+/**
+ * @brief Abort pending requests and release resources
+ * @param notifier Pointer to notifier
+ *
+ * Callbacks of aborted requests are not called.
+ */
+void notifier_cleanup(Notifier *notifier);
+
+/**
+ * @brief Load the service account and sign a token request ahead of time
+ * @param notifier Pointer to initialized notifier
+ * @return 0 on success, ERROR_CONFIG_FILE if the credentials are unusable
+ *
+ * Reading the service account, parsing the private key and signing the
+ * JWT are the slow part of the first token request. This function does
+ * them without touching the reactor, so it may run on a startup worker
+ * thread as long as no other notifier function runs at the same time.
+ */
+int notifier_prepare_credentials(Notifier *notifier);
+
+/**
+ * @brief Fetch an OAuth token now instead of on the first reminder
+ * @param notifier Pointer to notifier
+ * @return 0 if a token is cached or being fetched, negative on error
+ *
+ * Loads the HTTP stack and uses the request prepared by
+ * notifier_prepare_credentials() if there is a fresh one. A failed fetch
+ * is logged; the next reminder retries.
+ */
+int notifier_warm_up(Notifier *notifier);
+
+/**
+ * @brief Send to a stand-in instead of Google
+ * @param notifier Pointer to initialized notifier
+ * @param token_url OAuth token endpoint
+ * @param send_url FCM send endpoint
+ * @return 0 on success, ERROR_INVALID_PARAM if a URL is missing or too long
+ *
+ * Meant for simulation: the stand-in has no key to check, so token
+ * requests carry a placeholder assertion and no service account is read.
+ * Call before the first request.
+ */
+int notifier_set_endpoints(Notifier *notifier, const char *token_url, const char *send_url);
+
+// ============================================================================
+// REQUESTS
+// ============================================================================
+
+/**
+ * @brief Queue a door-close reminder
+ * @param notifier Pointer to notifier
+ * @param app_token Recipient FCM token
+ * @param callback Completion callback (can be NULL)
+ * @param userdata Callback argument
+ * @return 0 if queued, ERROR_CAPACITY_EXCEEDED if the queue is full,
+ *         other negative values on error
+ *
+ * The callback runs from the reactor loop, never from inside this call.
+ */
+int notifier_send_door_reminder(Notifier *notifier, const char *app_token,
+                                NotifierCallback callback, void *userdata);
+
+/**
+ * @brief Count queued and in-flight requests
+ * @param notifier Pointer to notifier
+ * @return Number of pending requests
+ */
+int notifier_pending_count(const Notifier *notifier);
+
+/**
+ * @brief Age of the oldest queued or in-flight request
+ * @param notifier Pointer to notifier
+ * @return Milliseconds since the oldest pending request was queued,
+ *         0 if none is pending
+ */
+uint64_t notifier_oldest_pending_ms(const Notifier *notifier);
+
+/**
+ * @brief Check whether the HTTP/TLS stack is currently loaded
+ * @param notifier Pointer to notifier
+ * @return 1 if loaded, 0 if not yet loaded or released while idle
+ */
+int notifier_stack_loaded(const Notifier *notifier);
+
+#endif // NOTIFIER_H
@@ -0,0 +1,579 @@
+/**
+ * @file door_monitor_bench.c
+ * @brief Microbenchmarks of the daemon's hot functions
+ *
+ * Runs each benchmark for a fixed minimum time after a warm-up and prints
+ * one JSON object per benchmark on stdout (JSON Lines), so results can be
+ * diffed, plotted or checked by a script:
+ *
+ *   {"benchmark":"device_manager_process_data/token","iterations":1048576,
+ *    "ns_per_op":812.4,"ns_per_op_min":799.1,"allocs_per_op":9.00,
+ *    "bytes_allocated_per_op":1452.0,"ops_per_sec":1230920,
+ *    "input_bytes_per_op":172,"mb_per_sec":211.7}
+ *
+ * ns_per_op is the median of the repetitions (-r), ns_per_op_min the
+ * fastest. Allocations are counted by the daemon's heap accounting
+ * (alloc_stats.c), or in builds without it by wrapping malloc, calloc and
+ * realloc here; either way those made inside json-c, OpenSSL and curl
+ * count too. input_bytes_per_op and mb_per_sec are only present where
+ * the operation consumes a buffer.
+ *
+ * Usage:
+ *   door_monitor_bench [-f filter] [-t ms] [-r repetitions] [-l]
+ *
+ * The static helpers of fcm_token.c (base64_url_encode, sign_jwt,
+ * create_jwt, WriteCallback) and notifier.c (write_callback) are reached
+ * by including those translation units below; their objects are not linked.
+ * WriteCallback is absent from DOOR_MONITOR_MINIMAL_HTTP builds.
+ *
+ * Exit status: 0 if every selected benchmark ran, 1 if one failed to set
+ * up, 2 on invalid usage.
+ */
+
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <unistd.h>
+#include <errno.h>
+#include <getopt.h>
+#include <time.h>
+
+#include "config.h"
+#include "logger.h"
+#include "runtime_config.h"
+#include "device_manager.h"
+#include "fcm_notification.h"
+#include "alloc_stats.h"
+
+// Static helpers under test
+#include "../Send_notification/fcm_token.c"
+#include "../Send_notification/notifier.c"
+
+/// Default measured time per repetition
+#define BENCH_DEFAULT_TIME_MS 200
+
+/// Default repetitions per benchmark
+#define BENCH_DEFAULT_REPETITIONS 5
+
+/// Repetitions accepted with -r
+#define BENCH_MAX_REPETITIONS 51
+
+/// Simulated HTTP response: total size and chunk size handed to the callbacks
+#define BENCH_RESPONSE_SIZE 16384
+#define BENCH_RESPONSE_CHUNK 1024
+
+/// Input of base64_url_encode
+#define BENCH_BASE64_INPUT 256
+
+// ============================================================================
+// DATA STRUCTURES
+// ============================================================================
+
+/**
+ * @brief One benchmark
+ */
+typedef struct {
+    const char *name;                   /// Name in the output
+    int (*setup)(void);                 /// Prepare state, 0 on success (can be NULL)
+    void (*run)(void);                  /// One operation
+    void (*teardown)(void);             /// Release state (can be NULL)
+    size_t input_bytes;                 /// Bytes consumed per operation, 0 if not meaningful
+} Benchmark;
+
+/**
+ * @brief Command-line options
+ */
+typedef struct {
+    const char *filter;                 /// Run benchmarks whose name contains this
+    int time_ms;                        /// Measured time per repetition
+    int repetitions;                    /// Measured repetitions
+    int list;                           /// Only print the names
+} Options;
+
+// ============================================================================
+// ALLOCATION COUNTING
+// ============================================================================
+
+#ifdef DOOR_MONITOR_HEAP_STATS
+
+/**
+ * @brief Read the allocations and requested bytes since start
+ */
+static void read_allocations(uint64_t *count, uint64_t *bytes) {
+    *count = 0;
+    *bytes = 0;
+    for (int i = 0; i < ALLOC_SUBSYSTEM_COUNT; i++) {
+        AllocSubsystemStats stats;
+        alloc_stats_read((AllocSubsystem)i, &stats);
+        *count += stats.allocations;
+        *bytes += stats.bytes_allocated;
+    }
+}
+
+#else
+
+extern void *__libc_malloc(size_t size);
+extern void *__libc_calloc(size_t count, size_t size);
+extern void *__libc_realloc(void *ptr, size_t size);
+extern void __libc_free(void *ptr);
+
+/// Allocations and requested bytes since start (atomic, libraries may use threads)
+static uint64_t alloc_count = 0;
+static uint64_t alloc_bytes = 0;
+
+/**
+ * @brief Count one allocation
+ */
+static void count_allocation(size_t size) {
+    __atomic_add_fetch(&alloc_count, 1, __ATOMIC_RELAXED);
+    __atomic_add_fetch(&alloc_bytes, size, __ATOMIC_RELAXED);
+}
+
+void *malloc(size_t size) {
+    count_allocation(size);
+    return __libc_malloc(size);
+}
+
+void *calloc(size_t count, size_t size) {
+    count_allocation(count * size);
+    return __libc_calloc(count, size);
+}
+
+void *realloc(void *ptr, size_t size) {
+    count_allocation(size);
+    return __libc_realloc(ptr, size);
+}
+
+void free(void *ptr) {
+    __libc_free(ptr);
+}
+
+/**
+ * @brief Read the allocations and requested bytes since start
+ */
+static void read_allocations(uint64_t *count, uint64_t *bytes) {
+    *count = __atomic_load_n(&alloc_count, __ATOMIC_RELAXED);
+    *bytes = __atomic_load_n(&alloc_bytes, __ATOMIC_RELAXED);
+}
+
+#endif // DOOR_MONITOR_HEAP_STATS
+
+// ============================================================================
+// STATIC VARIABLES
+// ============================================================================
+
+static Options options;
+
+static DeviceManager bench_manager;
+static int last_fd;
+static char last_mac[18];
+static char token_message[TOKEN_SIZE + 32];
+static size_t token_message_len;
+static char fcm_token[TOKEN_SIZE];
+
+static unsigned char base64_input[BENCH_BASE64_INPUT];
+static EVP_PKEY *jwt_key;
+static char *jwt_key_pem;
+static char jwt_message[512];
+static char response_chunk[BENCH_RESPONSE_CHUNK];
+
+/// Keeps results alive so the compiler cannot drop the work
+static volatile uintptr_t sink;
+
+// ============================================================================
+// HELPERS
+// ============================================================================
+
+/**
+ * @brief Print usage to stderr
+ */
+static void usage(const char *program) {
+    fprintf(stderr, "Usage: %s [options]\n", program);
+    fprintf(stderr, "  -f TEXT  Only run benchmarks whose name contains TEXT\n");
+    fprintf(stderr, "  -t MS    Measured time per repetition (default %d)\n", BENCH_DEFAULT_TIME_MS);
+    fprintf(stderr, "  -r N     Repetitions, the median is reported (default %d)\n",
+            BENCH_DEFAULT_REPETITIONS);
+    fprintf(stderr, "  -l       List the benchmarks and exit\n");
+}
+
+/**
+ * @brief Read the monotonic clock in nanoseconds
+ */
+static uint64_t now_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ULL + (uint64_t)ts.tv_nsec;
+}
+
+/**
+ * @brief Parse a positive integer option
+ * @return 0 on success, -1 if the text is not a number in [1, max]
+ */
+static int parse_count(const char *text, int max, int *value) {
+    char *end = NULL;
+    errno = 0;
+    long parsed = strtol(text, &end, 10);
+    if (errno != 0 || end == text || *end != '\0' || parsed < 1 || parsed > max) {
+        return -1;
+    }
+    *value = (int)parsed;
+    return 0;
+}
+
+/**
+ * @brief qsort comparator for timings
+ */
+static int compare_doubles(const void *a, const void *b) {
+    double x = *(const double*)a;
+    double y = *(const double*)b;
+    return (x > y) - (x < y);
+}
+
+// ============================================================================
+// DEVICE MANAGER
+// ============================================================================
+
+/**
+ * @brief A full device manager, every device with a token
+ */
+static int setup_manager(void) {
+    if (device_manager_init(&bench_manager) != SUCCESS) {
+        return -1;
+    }
+
+    int length = snprintf(token_message, sizeof(token_message), "{\"fcm_token\": \"bench-");
+    for (int i = 0; i < MIN_FCM_TOKEN_LENGTH + 10 && length < (int)sizeof(token_message) - 3; i++) {
+        token_message[length++] = 'x';
+    }
+    length += snprintf(token_message + length, sizeof(token_message) - (size_t)length, "\"}");
+    token_message_len = (size_t)length;
+
+    // Socket numbers far above any real fd; cleanup closes them harmlessly
+    for (int i = 0; i < runtime_config_get()->max_devices; i++) {
+        last_fd = (1 << 24) + i;
+        snprintf(last_mac, sizeof(last_mac), "02:42:4E:00:00:%02X", (unsigned)i & 0xFF);
+        if (!device_manager_add_device(&bench_manager, last_mac, last_fd) ||
+            device_manager_process_data(&bench_manager, last_fd, token_message,
+                                        token_message_len) != SUCCESS) {
+            return -1;
+        }
+    }
+    return 0;
+}
+
+static void teardown_manager(void) {
+    device_manager_cleanup(&bench_manager);
+}
+
+static void run_process_token(void) {
+    device_manager_process_data(&bench_manager, last_fd, token_message, token_message_len);
+}
+
+static void run_process_heartbeat(void) {
+    device_manager_process_data(&bench_manager, last_fd, "{}", 2);
+}
+
+static void run_find_by_socket(void) {
+    sink = (uintptr_t)device_manager_find_by_socket(&bench_manager, last_fd);
+}
+
+static void run_find_by_mac(void) {
+    sink = (uintptr_t)device_manager_find_by_mac(&bench_manager, last_mac);
+}
+
+static void run_check_timeouts(void) {
+    sink = (uintptr_t)device_manager_check_timeouts(&bench_manager);
+}
+
+// ============================================================================
+// LOGGER
+// ============================================================================
+
+static void run_log_filtered(void) {
+    log_message_level(LOG_LEVEL_DEBUG, "DEBUG", "Device %s sent %d bytes", last_mac, 42);
+}
+
+static void run_log_written(void) {
+    log_message_level(LOG_LEVEL_INFO, "INFO", "Device %s sent %d bytes", last_mac, 42);
+}
+
+// ============================================================================
+// FCM
+// ============================================================================
+
+static int setup_fcm_token(void) {
+    memset(fcm_token, 'x', MIN_FCM_TOKEN_LENGTH + 16);
+    fcm_token[MIN_FCM_TOKEN_LENGTH + 16] = '\0';
+    for (size_t i = 0; i < sizeof(base64_input); i++) {
+        base64_input[i] = (unsigned char)(i * 37 + 11);
+    }
+    return 0;
+}
+
+/// The request body the notifier builds in its queue slot
+static void run_fcm_message_json(void) {
+    static char body[NOTIFIER_BODY_SIZE];
+    sink = (uintptr_t)format_fcm_message_json(body, sizeof(body), fcm_token, FCM_NOTIFICATION_TITLE,
+                                              FCM_NOTIFICATION_BODY, FCM_NOTIFICATION_DATA_TYPE);
+}
+
+static void run_base64_url_encode(void) {
+    static char encoded[BASE64_ENCODED_SIZE(BENCH_BASE64_INPUT)];
+    sink = (uintptr_t)base64_url_encode(base64_input, (int)sizeof(base64_input),
+                                        encoded, sizeof(encoded));
+}
+
+/**
+ * @brief A service-account sized RSA key, in memory and as PEM
+ */
+static int setup_jwt(void) {
+    EVP_PKEY_CTX *ctx = EVP_PKEY_CTX_new_id(EVP_PKEY_RSA, NULL);
+    if (!ctx || EVP_PKEY_keygen_init(ctx) <= 0 ||
+        EVP_PKEY_CTX_set_rsa_keygen_bits(ctx, 2048) <= 0 ||
+        EVP_PKEY_keygen(ctx, &jwt_key) <= 0) {
+        EVP_PKEY_CTX_free(ctx);
+        return -1;
+    }
+    EVP_PKEY_CTX_free(ctx);
+
+    BIO *bio = BIO_new(BIO_s_mem());
+    BUF_MEM *pem = NULL;
+    if (!bio || PEM_write_bio_PrivateKey(bio, jwt_key, NULL, NULL, 0, NULL, NULL) != 1) {
+        BIO_free(bio);
+        return -1;
+    }
+    BIO_get_mem_ptr(bio, &pem);
+    jwt_key_pem = strndup(pem->data, pem->length);
+    BIO_free(bio);
+
+    snprintf(jwt_message, sizeof(jwt_message),
+             "eyJhbGciOiJSUzI1NiIsInR5cCI6IkpXVCJ9.%s", "eyJpc3MiOiJiZW5jaEBleGFtcGxlLmlhbS5nc2Vy"
+             "dmljZWFjY291bnQuY29tIiwic2NvcGUiOiJodHRwczovL3d3dy5nb29nbGVhcGlzLmNvbS9hdXRoL2Zp"
+             "cmViYXNlLm1lc3NhZ2luZyJ9");
+    return jwt_key_pem ? 0 : -1;
+}
+
+static void teardown_jwt(void) {
+    EVP_PKEY_free(jwt_key);
+    jwt_key = NULL;
+    free(jwt_key_pem);
+    jwt_key_pem = NULL;
+}
+
+static void run_sign_jwt(void) {
+    char signature[BASE64_ENCODED_SIZE(JWT_MAX_SIGNATURE_BYTES)];
+    sink = (uintptr_t)sign_jwt(jwt_message, jwt_key, signature, sizeof(signature));
+}
+
+static void run_create_jwt(void) {
+    char *jwt = create_jwt("bench@example.iam.gserviceaccount.com", jwt_key_pem);
+    sink = (uintptr_t)jwt;
+    free(jwt);
+}
+
+// ============================================================================
+// HTTP RESPONSE BUFFERS
+// ============================================================================
+
+static int setup_response(void) {
+    memset(response_chunk, 'r', sizeof(response_chunk));
+    return 0;
+}
+
+#ifndef DOOR_MONITOR_MINIMAL_HTTP
+
+/// One BENCH_RESPONSE_SIZE response through fcm_token.c's WriteCallback
+static void run_write_callback(void) {
+    struct APIResponse response = { NULL, 0, 0 };
+    for (int i = 0; i < BENCH_RESPONSE_SIZE / BENCH_RESPONSE_CHUNK; i++) {
+        WriteCallback(response_chunk, 1, sizeof(response_chunk), &response);
+    }
+    sink = (uintptr_t)response.data;
+    free(response.data);
+}
+
+#endif // DOOR_MONITOR_MINIMAL_HTTP
+
+/// Response buffer of a notifier queue slot, kept across requests like the slot's
+static NotifierBuffer notifier_buffer;
+
+/// One MAX_HTTP_RESPONSE_SIZE response through the notifier's write_callback
+static void run_notifier_write_callback(void) {
+    buffer_reset(&notifier_buffer);
+    for (int i = 0; i < MAX_HTTP_RESPONSE_SIZE / BENCH_RESPONSE_CHUNK; i++) {
+        write_callback(response_chunk, 1, sizeof(response_chunk), &notifier_buffer);
+    }
+    sink = (uintptr_t)notifier_buffer.data;
+}
+
+static void teardown_notifier_buffer(void) {
+    buffer_free(&notifier_buffer);
+}
+
+// ============================================================================
+// RUNNER
+// ============================================================================
+
+static const Benchmark benchmarks[] = {
+    { "device_manager_process_data/token", setup_manager, run_process_token, teardown_manager, 0 },
+    { "device_manager_process_data/heartbeat", setup_manager, run_process_heartbeat,
+      teardown_manager, 2 },
+    { "device_manager_find_by_socket", setup_manager, run_find_by_socket, teardown_manager, 0 },
+    { "device_manager_find_by_mac", setup_manager, run_find_by_mac, teardown_manager, 0 },
+    { "device_manager_check_timeouts", setup_manager, run_check_timeouts, teardown_manager, 0 },
+    { "log_message_level/filtered", NULL, run_log_filtered, NULL, 0 },
+    { "log_message_level/written", NULL, run_log_written, NULL, 0 },
+    { "format_fcm_message_json", setup_fcm_token, run_fcm_message_json, NULL, 0 },
+    { "base64_url_encode/256", setup_fcm_token, run_base64_url_encode, NULL, BENCH_BASE64_INPUT },
+    { "sign_jwt/rsa2048", setup_jwt, run_sign_jwt, teardown_jwt, 0 },
+    { "create_jwt/rsa2048", setup_jwt, run_create_jwt, teardown_jwt, 0 },
+#ifndef DOOR_MONITOR_MINIMAL_HTTP
+    { "WriteCallback/16k_in_1k_chunks", setup_response, run_write_callback, NULL,
+      BENCH_RESPONSE_SIZE },
+#endif
+    { "notifier_write_callback/8k_in_1k_chunks", setup_response, run_notifier_write_callback,
+      teardown_notifier_buffer, MAX_HTTP_RESPONSE_SIZE },
+};
+
+#define BENCHMARK_COUNT ((int)(sizeof(benchmarks) / sizeof(benchmarks[0])))
+
+/**
+ * @brief Time a number of iterations
+ * @return Elapsed nanoseconds
+ */
+static uint64_t time_iterations(const Benchmark *benchmark, uint64_t iterations) {
+    uint64_t start = now_ns();
+    for (uint64_t i = 0; i < iterations; i++) {
+        benchmark->run();
+    }
+    return now_ns() - start;
+}
+
+/**
+ * @brief Run one benchmark and print its result line
+ * @param out Stream for the result
+ * @return 0 on success, -1 if setup failed
+ */
+static int run_benchmark(const Benchmark *benchmark, FILE *out) {
+    if (benchmark->setup && benchmark->setup() != 0) {
+        fprintf(stderr, "%s: setup failed\n", benchmark->name);
+        if (benchmark->teardown) {
+            benchmark->teardown();
+        }
+        return -1;
+    }
+
+    // Warm up and find an iteration count filling the measured time
+    uint64_t target_ns = (uint64_t)options.time_ms * 1000000ULL;
+    uint64_t iterations = 1;
+    uint64_t elapsed = time_iterations(benchmark, iterations);
+    while (elapsed < target_ns / 10 && iterations < (1ULL << 40)) {
+        iterations *= 2;
+        elapsed = time_iterations(benchmark, iterations);
+    }
+    iterations = elapsed > 0 ? iterations * target_ns / elapsed : iterations;
+    if (iterations == 0) {
+        iterations = 1;
+    }
+
+    double ns_per_op[BENCH_MAX_REPETITIONS];
+    uint64_t allocs = 0;
+    uint64_t bytes = 0;
+    for (int r = 0; r < options.repetitions; r++) {
+        uint64_t allocs_before, bytes_before, allocs_after, bytes_after;
+        read_allocations(&allocs_before, &bytes_before);
+        ns_per_op[r] = (double)time_iterations(benchmark, iterations) / (double)iterations;
+        read_allocations(&allocs_after, &bytes_after);
+        allocs += allocs_after - allocs_before;
+        bytes += bytes_after - bytes_before;
+    }
+
+    if (benchmark->teardown) {
+        benchmark->teardown();
+    }
+
+    qsort(ns_per_op, (size_t)options.repetitions, sizeof(double), compare_doubles);
+    double median = ns_per_op[options.repetitions / 2];
+    double total_ops = (double)iterations * options.repetitions;
+
+    fprintf(out, "{\"benchmark\":\"%s\",\"iterations\":%llu,\"ns_per_op\":%.1f,"
+            "\"ns_per_op_min\":%.1f,\"allocs_per_op\":%.2f,\"bytes_allocated_per_op\":%.1f,"
+            "\"ops_per_sec\":%.0f", benchmark->name, (unsigned long long)iterations, median,
+            ns_per_op[0], allocs / total_ops, bytes / total_ops,
+            median > 0 ? 1e9 / median : 0.0);
+    if (benchmark->input_bytes > 0) {
+        fprintf(out, ",\"input_bytes_per_op\":%zu,\"mb_per_sec\":%.1f", benchmark->input_bytes,
+                median > 0 ? benchmark->input_bytes * 1e3 / median : 0.0);
+    }
+    fprintf(out, "}\n");
+    fflush(out);
+
+    return 0;
+}
+
+// ============================================================================
+// MAIN
+// ============================================================================
+
+int main(int argc, char *argv[]) {
+    int opt;
+
+    options.time_ms = BENCH_DEFAULT_TIME_MS;
+    options.repetitions = BENCH_DEFAULT_REPETITIONS;
+
+    while ((opt = getopt(argc, argv, "f:t:r:lh")) != -1) {
+        int bad = 0;
+        switch (opt) {
+            case 'f': options.filter = optarg; break;
+            case 't': bad = parse_count(optarg, 60000, &options.time_ms); break;
+            case 'r': bad = parse_count(optarg, BENCH_MAX_REPETITIONS, &options.repetitions); break;
+            case 'l': options.list = 1; break;
+            case 'h':
+                usage(argv[0]);
+                return 0;
+            default:
+                usage(argv[0]);
+                return 2;
+        }
+        if (bad) {
+            fprintf(stderr, "Invalid value for -%c: %s\n", opt, optarg);
+            return 2;
+        }
+    }
+
+    if (optind < argc) {
+        usage(argv[0]);
+        return 2;
+    }
+
+    if (options.list) {
+        for (int i = 0; i < BENCHMARK_COUNT; i++) {
+            printf("%s\n", benchmarks[i].name);
+        }
+        return 0;
+    }
+
+    // Log lines go to stdout: send them to /dev/null and results to the real stdout
+    int result_fd = dup(STDOUT_FILENO);
+    FILE *out = result_fd >= 0 ? fdopen(result_fd, "w") : NULL;
+    if (!out || !freopen("/dev/null", "w", stdout)) {
+        fprintf(stderr, "Cannot redirect the log: %s\n", strerror(errno));
+        return 2;
+    }
+    logger_set_level(LOG_LEVEL_INFO);
+
+    int failures = 0;
+    for (int i = 0; i < BENCHMARK_COUNT; i++) {
+        if (options.filter && !strstr(benchmarks[i].name, options.filter)) {
+            continue;
+        }
+        if (run_benchmark(&benchmarks[i], out) != 0) {
+            failures++;
+        }
+    }
+
+    fclose(out);
+    return failures > 0 ? 1 : 0;
+}
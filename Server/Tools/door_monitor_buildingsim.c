@@ -0,0 +1,1448 @@
+/**
+ * @file door_monitor_buildingsim.c
+ * @brief Discrete-event building simulator for capacity planning
+ *
+ * Models a building whose rooms are each watched by a door_monitor, and the
+ * people who work in them: when they arrive and leave, their breaks, how
+ * their phones connect, drop out and reconnect, and whether they lock the
+ * door behind them. Weeks of simulated time run in seconds, and the report
+ * answers the planning questions: how many reminders the building sends,
+ * how many of them were wrong, how bursty connections get and what the
+ * daemon's work costs per event.
+ *
+ * The daemon's own device manager, reminder policy and reactor are linked
+ * in unchanged, one instance of each per room, as on one Raspberry Pi per
+ * room. The simulator stands in for the rest:
+ * - Bluetooth server: a phone connecting is the find/reconnect/capacity/add
+ *   sequence bluetooth_server.c runs on accept, a message is a call to
+ *   device_manager_process_data(), a disconnect a call to
+ *   device_manager_handle_disconnect(). Socket numbers are fictitious.
+ * - Notifier: notifier_send_door_reminder() is defined here and completes
+ *   after a drawn FCM latency, failing at the model's rate.
+ * - Clock: the virtual clock (timesource.h) jumps from event to event, so
+ *   heartbeat expiry, the timeout sweep and reminder retries see simulated
+ *   time.
+ *
+ * Usage:
+ *   door_monitor_buildingsim [-m model] [-c config] [-d days] [-s seed] [-v]
+ *
+ * The model is a "key = value" file, see building.model.example. The
+ * daemon configuration given with -c supplies max_devices,
+ * heartbeat_timeout, heartbeat_check_interval and the reminder retry
+ * settings, so a planned configuration change can be tried first.
+ *
+ * A delivered reminder is false when someone was in the room or the door
+ * was already locked at delivery. A room left empty with the door
+ * unlocked for missed_after seconds without a reminder is a missed one.
+ *
+ * Exit status: 0 after a run, 2 on invalid usage or model.
+ */
+
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <stddef.h>
+#include <string.h>
+#include <strings.h>
+#include <ctype.h>
+#include <errno.h>
+#include <math.h>
+#include <getopt.h>
+#include <unistd.h>
+#include <time.h>
+#include <sys/resource.h>
+
+#include "config.h"
+#include "logger.h"
+#include "runtime_config.h"
+#include "timesource.h"
+#include "reactor.h"
+#include "device_manager.h"
+#include "reminder.h"
+#include "notifier.h"
+
+/// Simulated day in milliseconds
+#define SIM_DAY_MS (24ULL * 3600ULL * 1000ULL)
+
+/// Socket numbers handed to the device manager, far above any real fd
+#define SIM_FD_BASE (1 << 24)
+
+/// Breaks considered per occupant and day
+#define SIM_MAX_BREAKS 16
+
+/// Heartbeat message sent by the app
+#define SIM_HEARTBEAT_MESSAGE "{}"
+
+// ============================================================================
+// DATA STRUCTURES
+// ============================================================================
+
+/**
+ * @brief Building model, read from the model file
+ *
+ * Durations are in the unit their key names; times of day are minutes
+ * after midnight, written HH:MM in the file.
+ */
+typedef struct {
+    double rooms;                       /// Rooms, one daemon each
+    double occupants;                   /// People (phones) per room
+    double days;                        /// Simulated days, day 0 is a Monday
+    double workdays;                    /// Workdays at the start of each week
+    double attendance;                  /// Chance of coming in on a workday
+    double weekend_attendance;          /// Chance of coming in on another day
+    double arrival_time;                /// Mean arrival
+    double arrival_sd_minutes;          /// Spread of arrivals
+    double departure_time;              /// Mean departure
+    double departure_sd_minutes;        /// Spread of departures
+    double breaks_per_day;              /// Mean breaks (room left and re-entered)
+    double break_minutes;               /// Mean break length
+    double heartbeat_seconds;           /// App heartbeat interval
+    double connect_seconds;             /// Mean from entering to connected
+    double link_drops_per_hour;         /// Connection losses while in the room
+    double silent_drop_share;           /// Losses the daemon only notices by heartbeat timeout
+    double reconnect_seconds;           /// Mean from a loss or rejection to the next attempt
+    double range_exit_seconds;          /// Mean from leaving the room to out of range
+    double clean_exit_share;            /// Exits that close the connection (others time out)
+    double lock_on_leave;               /// Chance the last one out at the end of the day locks
+    double lock_on_break;               /// Chance the last one out for a break locks
+    double reminder_response;           /// Chance a delivered reminder gets the door locked
+    double response_minutes;            /// Mean from reminder to locked door
+    double fcm_latency_ms;              /// Mean FCM response time
+    double fcm_failure_rate;            /// Share of sends that fail
+    double missed_after;                /// Seconds unattended without a reminder that count as missed
+} Model;
+
+/**
+ * @brief Model value types
+ */
+typedef enum {
+    MODEL_NUMBER,                       /// Decimal number
+    MODEL_TIME_OF_DAY                   /// HH:MM, stored as minutes after midnight
+} ModelType;
+
+/**
+ * @brief One model key
+ */
+typedef struct {
+    const char *key;                    /// Name in the model file
+    ModelType type;                     /// Value syntax
+    size_t offset;                      /// Field in Model
+    double min;                         /// Smallest accepted value
+    double max;                         /// Largest accepted value
+} ModelSetting;
+
+#define MODEL_SETTING(name, lo, hi) { #name, MODEL_NUMBER, offsetof(Model, name), lo, hi }
+#define MODEL_TIME(name) { #name, MODEL_TIME_OF_DAY, offsetof(Model, name), 0, 24 * 60 - 1 }
+
+static const ModelSetting model_settings[] = {
+    MODEL_SETTING(rooms, 1, 4096),
+    MODEL_SETTING(occupants, 1, 64),
+    MODEL_SETTING(days, 1, 3660),
+    MODEL_SETTING(workdays, 0, 7),
+    MODEL_SETTING(attendance, 0, 1),
+    MODEL_SETTING(weekend_attendance, 0, 1),
+    MODEL_TIME(arrival_time),
+    MODEL_SETTING(arrival_sd_minutes, 0, 600),
+    MODEL_TIME(departure_time),
+    MODEL_SETTING(departure_sd_minutes, 0, 600),
+    MODEL_SETTING(breaks_per_day, 0, SIM_MAX_BREAKS),
+    MODEL_SETTING(break_minutes, 1, 600),
+    MODEL_SETTING(heartbeat_seconds, 1, 3600),
+    MODEL_SETTING(connect_seconds, 0, 3600),
+    MODEL_SETTING(link_drops_per_hour, 0, 60),
+    MODEL_SETTING(silent_drop_share, 0, 1),
+    MODEL_SETTING(reconnect_seconds, 0, 3600),
+    MODEL_SETTING(range_exit_seconds, 0, 3600),
+    MODEL_SETTING(clean_exit_share, 0, 1),
+    MODEL_SETTING(lock_on_leave, 0, 1),
+    MODEL_SETTING(lock_on_break, 0, 1),
+    MODEL_SETTING(reminder_response, 0, 1),
+    MODEL_SETTING(response_minutes, 0, 1440),
+    MODEL_SETTING(fcm_latency_ms, 0, 60000),
+    MODEL_SETTING(fcm_failure_rate, 0, 1),
+    MODEL_SETTING(missed_after, 1, 86400),
+};
+
+#define MODEL_SETTING_COUNT ((int)(sizeof(model_settings) / sizeof(model_settings[0])))
+
+/**
+ * @brief Simulation event types
+ */
+typedef enum {
+    EVENT_DAY = 0,                      /// Draw everyone's schedule for the day
+    EVENT_ARRIVE,                       /// Occupant enters the room
+    EVENT_LEAVE,                        /// Occupant leaves (flag: for a break)
+    EVENT_OUT_OF_RANGE,                 /// A phone that left loses its connection
+    EVENT_CONNECT,                      /// Phone opens a connection
+    EVENT_HEARTBEAT,                    /// Phone sends a heartbeat
+    EVENT_LINK_DROP,                    /// Phone loses its connection in the room
+    EVENT_SWEEP,                        /// Heartbeat timeout sweep of every room
+    EVENT_TIMER,                        /// A room's reactor timer is due
+    EVENT_SEND_DONE,                    /// FCM answers a reminder
+    EVENT_RESPONSE,                     /// Someone locks the door after a reminder
+    EVENT_TYPE_COUNT
+} EventType;
+
+/**
+ * @brief One scheduled event
+ */
+typedef struct {
+    uint64_t at_ms;                     /// Time on the timesource_now_ms() scale
+    uint64_t sequence;                  /// Scheduling order, breaks ties
+    EventType type;                     /// What happens
+    int room;                           /// Room index
+    int occupant;                       /// Occupant index within the room, -1 if none
+    unsigned int generation;            /// Phone generation or timer deadline check
+    int flag;                           /// Type specific (break, send result)
+    NotifierCallback callback;          /// EVENT_SEND_DONE: reminder policy callback
+    void *userdata;                     /// EVENT_SEND_DONE: callback argument
+} Event;
+
+/**
+ * @brief One person and their phone
+ */
+typedef struct {
+    char mac[18];                       /// Phone address
+    char token_message[TOKEN_SIZE + 32]; /// {"fcm_token": ...} sent on connect
+    int present;                        /// In the room
+    int linked;                         /// Phone holds a working connection
+    int fd;                             /// Socket the daemon holds for the phone, -1 if none
+    unsigned int generation;            /// Changed on every link change, drops stale phone events
+    unsigned int visits;                /// Incremented on every arrival, drops stale exits
+} Occupant;
+
+/**
+ * @brief Tumbling-window rate peak
+ */
+typedef struct {
+    uint64_t window;                    /// Current window number
+    int count;                          /// Events in the current window
+    int peak;                           /// Most events in any window
+} RatePeak;
+
+/**
+ * @brief One room and its daemon
+ */
+typedef struct {
+    int index;                          /// Room number
+    DeviceManager manager;              /// Daemon device manager
+    ReminderPolicy policy;              /// Daemon reminder policy
+    Reactor reactor;                    /// Daemon loop, runs the retry timers
+    Notifier notifier;                  /// Never initialized, identifies the room
+    Occupant *occupants;                /// People working here
+    int present;                        /// Occupants actually in the room
+    DoorState door;                     /// Actual door state
+    int unattended;                     /// Empty with the door unlocked
+    uint64_t unattended_since_ms;       /// Start of the unattended stretch
+    int reminded;                       /// A correct reminder arrived in this stretch
+    uint64_t timer_deadline_ms;         /// Reactor deadline an EVENT_TIMER is queued for
+    int peak_devices;                   /// Most devices registered at once
+    RatePeak connects_per_minute;       /// Connection attempts on this daemon
+} Room;
+
+/**
+ * @brief Daemon entry points timed for the CPU report
+ */
+typedef enum {
+    COST_CONNECT = 0,                   /// Accept path
+    COST_MESSAGE,                       /// device_manager_process_data()
+    COST_DISCONNECT,                    /// device_manager_handle_disconnect()
+    COST_SWEEP,                         /// device_manager_check_timeouts()
+    COST_DOOR,                          /// reminder_policy_door_changed()
+    COST_SEND_RESULT,                   /// Notifier completion callback
+    COST_TIMER,                         /// reactor_run_once() for a due timer
+    COST_COUNT
+} CostKind;
+
+/**
+ * @brief Calls and time spent in one daemon entry point
+ */
+typedef struct {
+    const char *name;                   /// Label in the report
+    uint64_t calls;                     /// Calls made
+    uint64_t ns;                        /// Real time spent inside
+} Cost;
+
+/**
+ * @brief Counters for the report
+ */
+typedef struct {
+    uint64_t events;                    /// Events processed
+    uint64_t visits;                    /// Arrivals (including returns from breaks)
+    uint64_t link_drops;                /// Connections lost in the room
+    uint64_t silent_drops;              /// ... of which not noticed by the daemon
+    uint64_t connect_attempts;          /// Accept paths run
+    uint64_t new_devices;               /// Devices added
+    uint64_t reconnects;                /// Devices still registered on reconnect
+    uint64_t rejected;                  /// Refused at max_devices
+    uint64_t messages;                  /// Tokens and heartbeats processed
+    uint64_t disconnects;               /// Connections closed by phones
+    uint64_t daemon_closes;             /// Sockets closed by the daemon (timeout, reconnect)
+    uint64_t live_closes;               /// ... of which the phone still used
+    uint64_t sends;                     /// Reminders handed to the notifier
+    uint64_t delivered;                 /// Accepted by FCM
+    uint64_t failed;                    /// Refused by FCM
+    uint64_t false_occupied;            /// Delivered while someone was in the room
+    uint64_t false_locked;              /// Delivered while the door was locked
+    uint64_t episodes;                  /// Unattended stretches longer than missed_after
+    uint64_t missed;                    /// ... without a correct reminder
+    uint64_t responses;                 /// Doors locked after a reminder
+} Counters;
+
+/**
+ * @brief Command-line options
+ */
+typedef struct {
+    const char *model_path;             /// Model file, NULL for the built-in model
+    const char *config_path;            /// Daemon configuration, NULL for defaults
+    int days;                           /// Overrides the model's days, 0 = keep
+    unsigned long long seed;            /// Random seed
+    int verbose;                        /// Show the daemon's log
+} Options;
+
+// ============================================================================
+// STATIC VARIABLES
+// ============================================================================
+
+/// Built-in model: a small office floor
+static Model model = {
+    .rooms = 20,
+    .occupants = 4,
+    .days = 28,
+    .workdays = 5,
+    .attendance = 0.85,
+    .weekend_attendance = 0.05,
+    .arrival_time = 8 * 60 + 30,
+    .arrival_sd_minutes = 30,
+    .departure_time = 17 * 60 + 30,
+    .departure_sd_minutes = 45,
+    .breaks_per_day = 3,
+    .break_minutes = 15,
+    .heartbeat_seconds = 20,
+    .connect_seconds = 10,
+    .link_drops_per_hour = 0.2,
+    .silent_drop_share = 0.3,
+    .reconnect_seconds = 20,
+    .range_exit_seconds = 15,
+    .clean_exit_share = 0.7,
+    .lock_on_leave = 0.9,
+    .lock_on_break = 0.2,
+    .reminder_response = 0.8,
+    .response_minutes = 5,
+    .fcm_latency_ms = 300,
+    .fcm_failure_rate = 0.01,
+    .missed_after = 600,
+};
+
+static Options options;
+static Counters counters;
+static Room *rooms;
+static int room_count;
+static int occupants_per_room;
+static uint64_t origin_ms;
+static uint64_t end_ms;
+static int next_fd = SIM_FD_BASE;
+static uint64_t rng_state = 1;
+
+static Event *heap;
+static size_t heap_size;
+static size_t heap_capacity;
+static uint64_t event_sequence;
+
+static RatePeak connects_per_second;
+static RatePeak connects_per_minute;
+static RatePeak sends_per_minute;
+
+static uint32_t *reminder_delays_s;
+static size_t reminder_delay_count;
+static size_t reminder_delay_capacity;
+
+static Cost costs[COST_COUNT] = {
+    [COST_CONNECT] = { "connect", 0, 0 },
+    [COST_MESSAGE] = { "message", 0, 0 },
+    [COST_DISCONNECT] = { "disconnect", 0, 0 },
+    [COST_SWEEP] = { "sweep", 0, 0 },
+    [COST_DOOR] = { "door", 0, 0 },
+    [COST_SEND_RESULT] = { "send-result", 0, 0 },
+    [COST_TIMER] = { "timer", 0, 0 },
+};
+
+// ============================================================================
+// HELPERS
+// ============================================================================
+
+/**
+ * @brief Print usage to stderr
+ */
+static void usage(const char *program) {
+    fprintf(stderr, "Usage: %s [options]\n", program);
+    fprintf(stderr, "  -m FILE  Building model (default: built-in, see building.model.example)\n");
+    fprintf(stderr, "  -c FILE  Daemon configuration (default: compiled-in defaults)\n");
+    fprintf(stderr, "  -d DAYS  Simulated days, overrides the model\n");
+    fprintf(stderr, "  -s SEED  Random seed (default 1)\n");
+    fprintf(stderr, "  -v       Show the daemon's log\n");
+}
+
+/**
+ * @brief Read a system clock in nanoseconds
+ */
+static uint64_t read_clock_ns(clockid_t clock) {
+    struct timespec ts;
+    clock_gettime(clock, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ULL + (uint64_t)ts.tv_nsec;
+}
+
+/**
+ * @brief Start timing a daemon call
+ */
+static uint64_t cost_begin(void) {
+    return read_clock_ns(CLOCK_MONOTONIC);
+}
+
+/**
+ * @brief Finish timing a daemon call
+ */
+static void cost_end(CostKind kind, uint64_t start_ns) {
+    costs[kind].calls++;
+    costs[kind].ns += read_clock_ns(CLOCK_MONOTONIC) - start_ns;
+}
+
+/**
+ * @brief Uniform random number in [0, 1) (xorshift64*)
+ */
+static double random_uniform(void) {
+    rng_state ^= rng_state >> 12;
+    rng_state ^= rng_state << 25;
+    rng_state ^= rng_state >> 27;
+    return (double)((rng_state * 0x2545F4914F6CDD1DULL) >> 11) * 0x1.0p-53;
+}
+
+/**
+ * @brief Bernoulli trial
+ */
+static int random_chance(double probability) {
+    return random_uniform() < probability;
+}
+
+/**
+ * @brief Exponentially distributed value with the given mean
+ */
+static double random_exponential(double mean) {
+    return mean > 0 ? -mean * log(1.0 - random_uniform()) : 0.0;
+}
+
+/**
+ * @brief Normally distributed value (Box-Muller)
+ */
+static double random_normal(double mean, double sd) {
+    double u = 1.0 - random_uniform();
+    double v = random_uniform();
+    return mean + sd * sqrt(-2.0 * log(u)) * cos(2.0 * M_PI * v);
+}
+
+/**
+ * @brief Poisson distributed count (Knuth)
+ */
+static int random_poisson(double mean) {
+    double limit = exp(-mean);
+    double product = random_uniform();
+    int count = 0;
+    while (product > limit) {
+        count++;
+        product *= random_uniform();
+    }
+    return count;
+}
+
+/**
+ * @brief Convert a duration in seconds to milliseconds, at least 1
+ */
+static uint64_t seconds_to_ms(double seconds) {
+    double ms = seconds * 1000.0;
+    return ms < 1.0 ? 1 : (uint64_t)ms;
+}
+
+/**
+ * @brief Count one event in a tumbling window
+ */
+static void rate_count(RatePeak *rate, uint64_t now_ms, uint64_t window_ms) {
+    uint64_t window = now_ms / window_ms;
+    if (window != rate->window) {
+        rate->window = window;
+        rate->count = 0;
+    }
+    if (++rate->count > rate->peak) {
+        rate->peak = rate->count;
+    }
+}
+
+/**
+ * @brief Raise the open file limit to fit one epoll instance per room
+ */
+static void raise_fd_limit(int needed) {
+    struct rlimit limit;
+    if (getrlimit(RLIMIT_NOFILE, &limit) != 0 || limit.rlim_cur >= (rlim_t)needed) {
+        return;
+    }
+
+    limit.rlim_cur = (limit.rlim_max == RLIM_INFINITY || limit.rlim_max >= (rlim_t)needed)
+                     ? (rlim_t)needed : limit.rlim_max;
+    setrlimit(RLIMIT_NOFILE, &limit);
+}
+
+// ============================================================================
+// MODEL FILE
+// ============================================================================
+
+/**
+ * @brief Strip leading and trailing whitespace in place
+ */
+static char* trim(char *text) {
+    while (isspace((unsigned char)*text)) {
+        text++;
+    }
+
+    char *end = text + strlen(text);
+    while (end > text && isspace((unsigned char)end[-1])) {
+        end--;
+    }
+    *end = '\0';
+
+    return text;
+}
+
+/**
+ * @brief Parse one model value into its field
+ * @return NULL on success, or a description of the problem
+ */
+static const char* parse_model_value(const ModelSetting *setting, const char *value) {
+    double *field = (double*)((char*)&model + setting->offset);
+    char *end = NULL;
+    double number;
+
+    errno = 0;
+    if (setting->type == MODEL_TIME_OF_DAY) {
+        long hours = strtol(value, &end, 10);
+        if (errno != 0 || end == value || *end != ':') {
+            return "not a time of day (HH:MM)";
+        }
+        const char *minutes_text = end + 1;
+        long minutes = strtol(minutes_text, &end, 10);
+        if (errno != 0 || end == minutes_text || *end != '\0' || minutes < 0 || minutes > 59) {
+            return "not a time of day (HH:MM)";
+        }
+        number = (double)(hours * 60 + minutes);
+    } else {
+        number = strtod(value, &end);
+        if (errno != 0 || end == value || *end != '\0') {
+            return "not a number";
+        }
+    }
+
+    if (number < setting->min || number > setting->max) {
+        return "out of range";
+    }
+    *field = number;
+    return NULL;
+}
+
+/**
+ * @brief Read a model file on top of the built-in model
+ * @return 0 on success, -1 on any error (reported on stderr)
+ */
+static int load_model(const char *path) {
+    FILE *file = fopen(path, "r");
+    if (!file) {
+        fprintf(stderr, "Cannot open model %s: %s\n", path, strerror(errno));
+        return -1;
+    }
+
+    char line[512];
+    int line_number = 0;
+    int result = 0;
+
+    while (result == 0 && fgets(line, sizeof(line), file)) {
+        line_number++;
+
+        char *comment = strchr(line, '#');
+        if (comment) {
+            *comment = '\0';
+        }
+        char *text = trim(line);
+        if (text[0] == '\0') {
+            continue;
+        }
+
+        char *equals = strchr(text, '=');
+        if (!equals) {
+            fprintf(stderr, "Model %s:%d: expected key = value\n", path, line_number);
+            result = -1;
+            break;
+        }
+
+        *equals = '\0';
+        char *key = trim(text);
+        char *value = trim(equals + 1);
+
+        const ModelSetting *setting = NULL;
+        for (int i = 0; i < MODEL_SETTING_COUNT; i++) {
+            if (strcmp(model_settings[i].key, key) == 0) {
+                setting = &model_settings[i];
+                break;
+            }
+        }
+        if (!setting) {
+            fprintf(stderr, "Model %s:%d: unknown key '%s'\n", path, line_number, key);
+            result = -1;
+            break;
+        }
+
+        const char *problem = parse_model_value(setting, value);
+        if (problem) {
+            fprintf(stderr, "Model %s:%d: %s: %s\n", path, line_number, key, problem);
+            result = -1;
+        }
+    }
+
+    fclose(file);
+    return result;
+}
+
+// ============================================================================
+// EVENT QUEUE
+// ============================================================================
+
+/**
+ * @brief Order events by time, then by scheduling order
+ */
+static int event_before(const Event *a, const Event *b) {
+    return a->at_ms < b->at_ms || (a->at_ms == b->at_ms && a->sequence < b->sequence);
+}
+
+/**
+ * @brief Queue an event
+ * @return Pointer to the queued event for setting type specific fields
+ */
+static Event* schedule(uint64_t at_ms, EventType type, int room, int occupant,
+                       unsigned int generation) {
+    if (heap_size == heap_capacity) {
+        size_t capacity = heap_capacity ? heap_capacity * 2 : 4096;
+        Event *grown = realloc(heap, capacity * sizeof(Event));
+        if (!grown) {
+            fprintf(stderr, "Out of memory for %zu events\n", capacity);
+            exit(2);
+        }
+        heap = grown;
+        heap_capacity = capacity;
+    }
+
+    Event event = {
+        .at_ms = at_ms, .sequence = event_sequence++, .type = type,
+        .room = room, .occupant = occupant, .generation = generation
+    };
+
+    size_t index = heap_size++;
+    while (index > 0) {
+        size_t parent = (index - 1) / 2;
+        if (!event_before(&event, &heap[parent])) {
+            break;
+        }
+        heap[index] = heap[parent];
+        index = parent;
+    }
+    heap[index] = event;
+
+    return &heap[index];
+}
+
+/**
+ * @brief Remove the earliest event
+ */
+static Event pop_event(void) {
+    Event first = heap[0];
+    Event last = heap[--heap_size];
+
+    size_t index = 0;
+    for (;;) {
+        size_t child = index * 2 + 1;
+        if (child >= heap_size) {
+            break;
+        }
+        if (child + 1 < heap_size && event_before(&heap[child + 1], &heap[child])) {
+            child++;
+        }
+        if (!event_before(&heap[child], &last)) {
+            break;
+        }
+        heap[index] = heap[child];
+        index = child;
+    }
+    if (heap_size > 0) {
+        heap[index] = last;
+    }
+
+    return first;
+}
+
+// ============================================================================
+// GROUND TRUTH
+// ============================================================================
+
+/**
+ * @brief Record the delay from leaving to a correct reminder
+ */
+static void record_reminder_delay(uint64_t delay_ms) {
+    if (reminder_delay_count == reminder_delay_capacity) {
+        size_t capacity = reminder_delay_capacity ? reminder_delay_capacity * 2 : 1024;
+        uint32_t *grown = realloc(reminder_delays_s, capacity * sizeof(uint32_t));
+        if (!grown) {
+            return;
+        }
+        reminder_delays_s = grown;
+        reminder_delay_capacity = capacity;
+    }
+    reminder_delays_s[reminder_delay_count++] = (uint32_t)(delay_ms / 1000);
+}
+
+/**
+ * @brief Close an unattended stretch and score it
+ */
+static void finish_unattended(Room *room, uint64_t now) {
+    if (now - room->unattended_since_ms >= seconds_to_ms(model.missed_after)) {
+        counters.episodes++;
+        if (!room->reminded) {
+            counters.missed++;
+        }
+    }
+    room->unattended = 0;
+}
+
+/**
+ * @brief Track whether the room is really empty with the door unlocked
+ */
+static void update_truth(Room *room, uint64_t now) {
+    int unattended = (room->present == 0 && room->door == UNLOCKED);
+
+    if (unattended && !room->unattended) {
+        room->unattended = 1;
+        room->unattended_since_ms = now;
+        room->reminded = 0;
+    } else if (!unattended && room->unattended) {
+        finish_unattended(room, now);
+    }
+}
+
+// ============================================================================
+// DAEMON SIDE
+// ============================================================================
+
+/**
+ * @brief Queue the room's next reactor timer, if it changed
+ *
+ * The reminder policy's retries are reactor timers; the room's loop is
+ * run when the earliest one is due.
+ */
+static void schedule_room_timer(Room *room) {
+    if (room->reactor.heap_size == 0) {
+        room->timer_deadline_ms = 0;
+        return;
+    }
+
+    uint64_t deadline = room->reactor.timers[room->reactor.heap[0]].deadline_ms;
+    if (deadline != room->timer_deadline_ms) {
+        room->timer_deadline_ms = deadline;
+        schedule(deadline, EVENT_TIMER, room->index, -1, 0);
+    }
+}
+
+/**
+ * @brief Tell the room's daemon about a door edge
+ */
+static void set_door(Room *room, DoorState state, uint64_t now) {
+    if (room->door == state) {
+        return;
+    }
+
+    room->door = state;
+    update_truth(room, now);
+
+    uint64_t start = cost_begin();
+    reminder_policy_door_changed(&room->policy, state);
+    cost_end(COST_DOOR, start);
+}
+
+/**
+ * @brief Device manager callback: the last device left
+ */
+static void on_room_empty(const char *token, void *userdata) {
+    reminder_policy_room_empty(&((Room*)userdata)->policy, token);
+}
+
+/**
+ * @brief Device manager callback: someone entered the empty room
+ */
+static void on_room_occupied(void *userdata) {
+    reminder_policy_room_occupied(&((Room*)userdata)->policy);
+}
+
+/**
+ * @brief Device manager callback: the daemon closes a phone's socket
+ *
+ * Runs when a device timed out or reconnected; phones that disconnect
+ * themselves are no longer looked up here. A phone that still thought its
+ * connection worked notices and tries again.
+ */
+static void on_socket_closing(int socket_fd, void *userdata) {
+    Room *room = (Room*)userdata;
+
+    for (int i = 0; i < occupants_per_room; i++) {
+        Occupant *occupant = &room->occupants[i];
+        if (occupant->fd != socket_fd) {
+            continue;
+        }
+
+        occupant->fd = -1;
+        counters.daemon_closes++;
+        if (occupant->linked) {
+            counters.live_closes++;
+            occupant->linked = 0;
+            occupant->generation++;
+            if (occupant->present) {
+                schedule(timesource_now_ms() + seconds_to_ms(random_exponential(model.reconnect_seconds)),
+                         EVENT_CONNECT, room->index, i, occupant->generation);
+            }
+        }
+        return;
+    }
+}
+
+/**
+ * @brief Notifier stand-in: answer after a drawn FCM latency
+ *
+ * Replaces notifier.c at link time; the reminder policy cannot tell the
+ * difference. The callback runs from a later event, never from within.
+ */
+int notifier_send_door_reminder(Notifier *notifier, const char *app_token,
+                                NotifierCallback callback, void *userdata) {
+    if (!notifier || !app_token || app_token[0] == '\0' || !callback) {
+        return ERROR_INVALID_PARAM;
+    }
+
+    Room *room = (Room*)((char*)notifier - offsetof(Room, notifier));
+    uint64_t now = timesource_now_ms();
+
+    counters.sends++;
+    rate_count(&sends_per_minute, now - origin_ms, 60000);
+
+    Event *event = schedule(now + (uint64_t)random_exponential(model.fcm_latency_ms),
+                            EVENT_SEND_DONE, room->index, -1, 0);
+    event->flag = random_chance(model.fcm_failure_rate) ? ERROR_NETWORK : SUCCESS;
+    event->callback = callback;
+    event->userdata = userdata;
+
+    return SUCCESS;
+}
+
+// ============================================================================
+// PHONES
+// ============================================================================
+
+/**
+ * @brief Phone opens a connection: the Bluetooth server's accept path
+ */
+static void phone_connect(Room *room, int index, uint64_t now) {
+    Occupant *occupant = &room->occupants[index];
+    int fd = next_fd++;
+    Device *device;
+
+    counters.connect_attempts++;
+    rate_count(&connects_per_second, now - origin_ms, 1000);
+    rate_count(&connects_per_minute, now - origin_ms, 60000);
+    rate_count(&room->connects_per_minute, now - origin_ms, 60000);
+
+    uint64_t start = cost_begin();
+    Device *existing = device_manager_find_by_mac(&room->manager, occupant->mac);
+    if (existing) {
+        device = device_manager_reconnect_device(&room->manager, existing, fd) == SUCCESS
+                 ? existing : NULL;
+    } else if (device_manager_has_capacity(&room->manager)) {
+        device = device_manager_add_device(&room->manager, occupant->mac, fd);
+    } else {
+        device = NULL;
+    }
+    cost_end(COST_CONNECT, start);
+
+    if (!device) {
+        // The app scans again later
+        counters.rejected++;
+        schedule(now + seconds_to_ms(random_exponential(model.reconnect_seconds)),
+                 EVENT_CONNECT, room->index, index, occupant->generation);
+        return;
+    }
+
+    if (existing) {
+        counters.reconnects++;
+    } else {
+        counters.new_devices++;
+    }
+    if (room->manager.device_count > room->peak_devices) {
+        room->peak_devices = room->manager.device_count;
+    }
+
+    occupant->fd = fd;
+    occupant->linked = 1;
+    occupant->generation++;
+
+    start = cost_begin();
+    device_manager_process_data(&room->manager, fd, occupant->token_message,
+                                strlen(occupant->token_message));
+    cost_end(COST_MESSAGE, start);
+    counters.messages++;
+
+    schedule(now + seconds_to_ms(model.heartbeat_seconds), EVENT_HEARTBEAT,
+             room->index, index, occupant->generation);
+    if (model.link_drops_per_hour > 0) {
+        schedule(now + seconds_to_ms(random_exponential(3600.0 / model.link_drops_per_hour)),
+                 EVENT_LINK_DROP, room->index, index, occupant->generation);
+    }
+}
+
+/**
+ * @brief Phone loses its connection
+ * @param clean The daemon sees the socket close (otherwise it waits for the heartbeat timeout)
+ */
+static void phone_link_lost(Room *room, Occupant *occupant, int clean) {
+    occupant->linked = 0;
+    occupant->generation++;
+
+    if (clean && occupant->fd > 0) {
+        int fd = occupant->fd;
+        occupant->fd = -1;
+        counters.disconnects++;
+        uint64_t start = cost_begin();
+        device_manager_handle_disconnect(&room->manager, fd);
+        cost_end(COST_DISCONNECT, start);
+    }
+}
+
+// ============================================================================
+// PEOPLE
+// ============================================================================
+
+/**
+ * @brief Someone enters the room
+ */
+static void occupant_arrive(Room *room, int index, uint64_t now) {
+    Occupant *occupant = &room->occupants[index];
+
+    counters.visits++;
+    occupant->present = 1;
+    occupant->visits++;
+    room->present++;
+    set_door(room, UNLOCKED, now);
+    update_truth(room, now);
+
+    // Back before the phone went out of range: the connection survives
+    if (!occupant->linked) {
+        occupant->generation++;
+        schedule(now + seconds_to_ms(random_exponential(model.connect_seconds)),
+                 EVENT_CONNECT, room->index, index, occupant->generation);
+    }
+}
+
+/**
+ * @brief Someone leaves the room
+ * @param for_break Coming back later the same day
+ */
+static void occupant_leave(Room *room, int index, int for_break, uint64_t now) {
+    Occupant *occupant = &room->occupants[index];
+
+    occupant->present = 0;
+    room->present--;
+    if (room->present == 0 && random_chance(for_break ? model.lock_on_break : model.lock_on_leave)) {
+        set_door(room, LOCKED, now);
+    }
+    update_truth(room, now);
+
+    schedule(now + seconds_to_ms(random_exponential(model.range_exit_seconds)),
+             EVENT_OUT_OF_RANGE, room->index, index, occupant->visits);
+}
+
+/**
+ * @brief Draw one occupant's day: arrival, breaks, departure
+ */
+static void plan_occupant_day(int room_index, int index, int day) {
+    int weekday = day % 7;
+    double attendance = weekday < (int)model.workdays ? model.attendance : model.weekend_attendance;
+    if (!random_chance(attendance)) {
+        return;
+    }
+
+    uint64_t midnight = origin_ms + (uint64_t)day * SIM_DAY_MS;
+    double arrival = random_normal(model.arrival_time, model.arrival_sd_minutes);
+    double departure = random_normal(model.departure_time, model.departure_sd_minutes);
+    if (arrival < 5) {
+        arrival = 5;
+    }
+    if (arrival > 23 * 60) {
+        arrival = 23 * 60;
+    }
+    if (departure < arrival + 30) {
+        departure = arrival + 30;
+    }
+    if (departure > 24 * 60 - 5) {
+        departure = 24 * 60 - 5;
+    }
+
+    schedule(midnight + (uint64_t)(arrival * 60000.0), EVENT_ARRIVE, room_index, index, 0);
+
+    // Breaks in time order, dropped where they would overlap or run past departure
+    double starts[SIM_MAX_BREAKS];
+    int breaks = random_poisson(model.breaks_per_day);
+    if (breaks > SIM_MAX_BREAKS) {
+        breaks = SIM_MAX_BREAKS;
+    }
+    for (int i = 0; i < breaks; i++) {
+        starts[i] = arrival + random_uniform() * (departure - arrival);
+    }
+    for (int i = 1; i < breaks; i++) {
+        for (int j = i; j > 0 && starts[j] < starts[j - 1]; j--) {
+            double swap = starts[j];
+            starts[j] = starts[j - 1];
+            starts[j - 1] = swap;
+        }
+    }
+
+    double free_from = arrival + 1;
+    for (int i = 0; i < breaks; i++) {
+        double length = 1 + random_exponential(model.break_minutes);
+        if (starts[i] < free_from || starts[i] + length > departure - 1) {
+            continue;
+        }
+        Event *leave = schedule(midnight + (uint64_t)(starts[i] * 60000.0), EVENT_LEAVE,
+                                room_index, index, 0);
+        leave->flag = 1;
+        schedule(midnight + (uint64_t)((starts[i] + length) * 60000.0), EVENT_ARRIVE,
+                 room_index, index, 0);
+        free_from = starts[i] + length + 1;
+    }
+
+    schedule(midnight + (uint64_t)(departure * 60000.0), EVENT_LEAVE, room_index, index, 0);
+}
+
+// ============================================================================
+// EVENT HANDLING
+// ============================================================================
+
+/**
+ * @brief Deliver a reminder result to the room's policy and score it
+ */
+static void send_done(Room *room, const Event *event, uint64_t now) {
+    if (event->flag == SUCCESS) {
+        counters.delivered++;
+        if (room->present > 0) {
+            counters.false_occupied++;
+        } else if (room->door == LOCKED) {
+            counters.false_locked++;
+        } else {
+            if (room->unattended && !room->reminded) {
+                record_reminder_delay(now - room->unattended_since_ms);
+            }
+            room->reminded = 1;
+            if (random_chance(model.reminder_response)) {
+                schedule(now + seconds_to_ms(random_exponential(model.response_minutes * 60.0)),
+                         EVENT_RESPONSE, room->index, -1, 0);
+            }
+        }
+    } else {
+        counters.failed++;
+    }
+
+    uint64_t start = cost_begin();
+    event->callback(event->flag, event->userdata);
+    cost_end(COST_SEND_RESULT, start);
+}
+
+/**
+ * @brief Handle one event
+ */
+static void handle_event(const Event *event) {
+    uint64_t now = event->at_ms;
+    Room *room = event->room >= 0 ? &rooms[event->room] : NULL;
+    Occupant *occupant = (room && event->occupant >= 0) ? &room->occupants[event->occupant] : NULL;
+    const RuntimeConfig *config = runtime_config_get();
+
+    switch (event->type) {
+        case EVENT_DAY: {
+            int day = (int)((now - origin_ms) / SIM_DAY_MS);
+            for (int r = 0; r < room_count; r++) {
+                for (int i = 0; i < occupants_per_room; i++) {
+                    plan_occupant_day(r, i, day);
+                }
+            }
+            if (now + SIM_DAY_MS < end_ms) {
+                schedule(now + SIM_DAY_MS, EVENT_DAY, -1, -1, 0);
+            }
+            break;
+        }
+
+        case EVENT_ARRIVE:
+            occupant_arrive(room, event->occupant, now);
+            break;
+
+        case EVENT_LEAVE:
+            occupant_leave(room, event->occupant, event->flag, now);
+            break;
+
+        case EVENT_OUT_OF_RANGE:
+            if (!occupant->present && occupant->visits == event->generation && occupant->linked) {
+                phone_link_lost(room, occupant, random_chance(model.clean_exit_share));
+            } else if (!occupant->present && occupant->visits == event->generation) {
+                // Never connected this visit: stop trying
+                occupant->generation++;
+            }
+            break;
+
+        case EVENT_CONNECT:
+            if (occupant->generation == event->generation && occupant->present && !occupant->linked) {
+                phone_connect(room, event->occupant, now);
+            }
+            break;
+
+        case EVENT_HEARTBEAT:
+            if (occupant->generation == event->generation && occupant->linked) {
+                uint64_t start = cost_begin();
+                device_manager_process_data(&room->manager, occupant->fd, SIM_HEARTBEAT_MESSAGE,
+                                            strlen(SIM_HEARTBEAT_MESSAGE));
+                cost_end(COST_MESSAGE, start);
+                counters.messages++;
+                schedule(now + seconds_to_ms(model.heartbeat_seconds), EVENT_HEARTBEAT,
+                         room->index, event->occupant, occupant->generation);
+            }
+            break;
+
+        case EVENT_LINK_DROP:
+            if (occupant->generation == event->generation && occupant->linked && occupant->present) {
+                int silent = random_chance(model.silent_drop_share);
+                counters.link_drops++;
+                counters.silent_drops += (uint64_t)silent;
+                phone_link_lost(room, occupant, !silent);
+                schedule(now + seconds_to_ms(random_exponential(model.reconnect_seconds)),
+                         EVENT_CONNECT, room->index, event->occupant, occupant->generation);
+            }
+            break;
+
+        case EVENT_SWEEP:
+            // An empty manager has nothing to expire; skipping it changes nothing
+            for (int r = 0; r < room_count; r++) {
+                if (rooms[r].manager.device_count > 0) {
+                    uint64_t start = cost_begin();
+                    device_manager_check_timeouts(&rooms[r].manager);
+                    cost_end(COST_SWEEP, start);
+                    schedule_room_timer(&rooms[r]);
+                }
+            }
+            schedule(now + (uint64_t)config->heartbeat_check_interval * 1000ULL, EVENT_SWEEP,
+                     -1, -1, 0);
+            break;
+
+        case EVENT_TIMER:
+            if (room->timer_deadline_ms == now) {
+                room->timer_deadline_ms = 0;
+                uint64_t start = cost_begin();
+                reactor_run_once(&room->reactor, 0);
+                cost_end(COST_TIMER, start);
+            }
+            break;
+
+        case EVENT_SEND_DONE:
+            send_done(room, event, now);
+            break;
+
+        case EVENT_RESPONSE:
+            if (room->present == 0) {
+                counters.responses++;
+                set_door(room, LOCKED, now);
+            }
+            break;
+
+        case EVENT_TYPE_COUNT:
+            break;
+    }
+
+    if (room) {
+        schedule_room_timer(room);
+    }
+}
+
+// ============================================================================
+// SETUP AND REPORT
+// ============================================================================
+
+/**
+ * @brief Set up every room's daemon objects and occupants
+ * @return 0 on success, -1 on failure
+ */
+static int setup_rooms(void) {
+    int token_length = runtime_config_get()->min_token_length + 16;
+    if (token_length > TOKEN_SIZE - 1) {
+        token_length = TOKEN_SIZE - 1;
+    }
+
+    rooms = calloc((size_t)room_count, sizeof(Room));
+    if (!rooms) {
+        return -1;
+    }
+
+    for (int r = 0; r < room_count; r++) {
+        Room *room = &rooms[r];
+        room->index = r;
+        room->door = LOCKED;
+        room->occupants = calloc((size_t)occupants_per_room, sizeof(Occupant));
+        if (!room->occupants || reactor_init(&room->reactor) != 0 ||
+            device_manager_init(&room->manager) != 0 ||
+            reminder_policy_init(&room->policy, &room->reactor, &room->notifier, LOCKED) != 0) {
+            return -1;
+        }
+
+        DeviceManagerCallbacks callbacks = {
+            .room_empty = on_room_empty,
+            .room_occupied = on_room_occupied,
+            .socket_closing = on_socket_closing,
+            .userdata = room
+        };
+        device_manager_set_callbacks(&room->manager, &callbacks);
+
+        for (int i = 0; i < occupants_per_room; i++) {
+            Occupant *occupant = &room->occupants[i];
+            int id = r * occupants_per_room + i;
+            occupant->fd = -1;
+            // Locally administered addresses, distinct per phone
+            snprintf(occupant->mac, sizeof(occupant->mac), "02:42:53:%02X:%02X:%02X",
+                     (id >> 16) & 0xFF, (id >> 8) & 0xFF, id & 0xFF);
+            int length = snprintf(occupant->token_message, sizeof(occupant->token_message),
+                                  "{\"fcm_token\": \"bsim-%06d-", id);
+            for (int j = 12; j < token_length && length < (int)sizeof(occupant->token_message) - 3; j++) {
+                occupant->token_message[length++] = 'x';
+            }
+            snprintf(occupant->token_message + length, sizeof(occupant->token_message) - (size_t)length,
+                     "\"}");
+        }
+    }
+
+    return 0;
+}
+
+/**
+ * @brief qsort comparator for delays
+ */
+static int compare_delays(const void *a, const void *b) {
+    uint32_t x = *(const uint32_t*)a;
+    uint32_t y = *(const uint32_t*)b;
+    return (x > y) - (x < y);
+}
+
+/**
+ * @brief Share of a total in percent
+ */
+static double percent(uint64_t part, uint64_t total) {
+    return total > 0 ? 100.0 * (double)part / (double)total : 0.0;
+}
+
+/**
+ * @brief Print the final report
+ */
+static void report(FILE *out, int days, uint64_t real_ns, uint64_t cpu_ns) {
+    const RuntimeConfig *config = runtime_config_get();
+    int busiest_devices = 0;
+    int busiest_rate = 0;
+    for (int r = 0; r < room_count; r++) {
+        if (rooms[r].peak_devices > busiest_devices) {
+            busiest_devices = rooms[r].peak_devices;
+        }
+        if (rooms[r].connects_per_minute.peak > busiest_rate) {
+            busiest_rate = rooms[r].connects_per_minute.peak;
+        }
+    }
+
+    double real_s = real_ns / 1e9;
+    double room_days = (double)room_count * days;
+    uint64_t false_reminders = counters.false_occupied + counters.false_locked;
+
+    fprintf(out, "door_monitor_buildingsim: %d rooms x %d occupants, %d days in %.2f s (%.0fx real time)\n",
+           room_count, occupants_per_room, days, real_s,
+           real_s > 0 ? days * 86400.0 / real_s : 0.0);
+    fprintf(out, "Daemon settings: max_devices %d, heartbeat_timeout %d s, sweep every %d s, "
+           "retry %d s x %d\n", config->max_devices, config->heartbeat_timeout,
+           config->heartbeat_check_interval, config->reminder_retry_delay,
+           config->reminder_max_attempts);
+    fprintf(out, "People:\n");
+    fprintf(out, "  room entries      %llu\n", (unsigned long long)counters.visits);
+    fprintf(out, "  link drops        %llu (%llu silent)\n", (unsigned long long)counters.link_drops,
+           (unsigned long long)counters.silent_drops);
+    fprintf(out, "Connections:\n");
+    fprintf(out, "  attempts          %llu (%llu new devices, %llu reconnects, %llu rejected at capacity)\n",
+           (unsigned long long)counters.connect_attempts, (unsigned long long)counters.new_devices,
+           (unsigned long long)counters.reconnects, (unsigned long long)counters.rejected);
+    fprintf(out, "  peak rate         %d/s and %d/min building-wide, %d/min on the busiest daemon\n",
+           connects_per_second.peak, connects_per_minute.peak, busiest_rate);
+    fprintf(out, "  peak devices      %d on the busiest daemon (limit %d)\n", busiest_devices,
+           config->max_devices);
+    fprintf(out, "  messages          %llu (%.1f/s building-wide on average)\n",
+           (unsigned long long)counters.messages, counters.messages / (days * 86400.0));
+    fprintf(out, "  closed by phones  %llu\n", (unsigned long long)counters.disconnects);
+    fprintf(out, "  closed by daemon  %llu (%llu while the phone still used it)\n",
+           (unsigned long long)counters.daemon_closes, (unsigned long long)counters.live_closes);
+    fprintf(out, "Notifications:\n");
+    fprintf(out, "  sends             %llu (%llu delivered, %llu failed), peak %d/min\n",
+           (unsigned long long)counters.sends, (unsigned long long)counters.delivered,
+           (unsigned long long)counters.failed, sends_per_minute.peak);
+    fprintf(out, "  volume            %.2f delivered per room and day\n",
+           room_days > 0 ? counters.delivered / room_days : 0.0);
+    fprintf(out, "  false reminders   %llu (%.1f%% of delivered: %llu room occupied, %llu door locked)\n",
+           (unsigned long long)false_reminders, percent(false_reminders, counters.delivered),
+           (unsigned long long)counters.false_occupied, (unsigned long long)counters.false_locked);
+    fprintf(out, "  missed reminders  %llu of %llu rooms left unlocked for %.0f s or longer (%.1f%%)\n",
+           (unsigned long long)counters.missed, (unsigned long long)counters.episodes,
+           model.missed_after, percent(counters.missed, counters.episodes));
+    if (reminder_delay_count > 0) {
+        qsort(reminder_delays_s, reminder_delay_count, sizeof(uint32_t), compare_delays);
+        fprintf(out, "  delay after exit  p50 %u s  p90 %u s  p99 %u s  max %u s\n",
+               reminder_delays_s[(reminder_delay_count - 1) / 2],
+               reminder_delays_s[(size_t)((reminder_delay_count - 1) * 0.90)],
+               reminder_delays_s[(size_t)((reminder_delay_count - 1) * 0.99)],
+               reminder_delays_s[reminder_delay_count - 1]);
+    }
+    fprintf(out, "  doors locked      %llu after a reminder\n", (unsigned long long)counters.responses);
+    fprintf(out, "CPU:\n");
+    fprintf(out, "  events            %llu, %.0f ns CPU per event (simulator included)\n",
+           (unsigned long long)counters.events,
+           counters.events > 0 ? (double)cpu_ns / counters.events : 0.0);
+    for (int kind = 0; kind < COST_COUNT; kind++) {
+        fprintf(out, "  %-17s %llu calls, %.0f ns per call\n", costs[kind].name,
+               (unsigned long long)costs[kind].calls,
+               costs[kind].calls > 0 ? (double)costs[kind].ns / costs[kind].calls : 0.0);
+    }
+}
+
+// ============================================================================
+// MAIN
+// ============================================================================
+
+int main(int argc, char *argv[]) {
+    int opt;
+
+    options.seed = 1;
+
+    while ((opt = getopt(argc, argv, "m:c:d:s:vh")) != -1) {
+        char *end = NULL;
+        switch (opt) {
+            case 'm': options.model_path = optarg; break;
+            case 'c': options.config_path = optarg; break;
+            case 'd':
+                errno = 0;
+                options.days = (int)strtol(optarg, &end, 10);
+                if (errno != 0 || end == optarg || *end != '\0' || options.days < 1 || options.days > 3660) {
+                    fprintf(stderr, "Invalid value for -d: %s\n", optarg);
+                    return 2;
+                }
+                break;
+            case 's':
+                errno = 0;
+                options.seed = strtoull(optarg, &end, 0);
+                if (errno != 0 || end == optarg || *end != '\0') {
+                    fprintf(stderr, "Invalid value for -s: %s\n", optarg);
+                    return 2;
+                }
+                break;
+            case 'v': options.verbose = 1; break;
+            case 'h':
+                usage(argv[0]);
+                return 0;
+            default:
+                usage(argv[0]);
+                return 2;
+        }
+    }
+
+    if (optind < argc) {
+        usage(argv[0]);
+        return 2;
+    }
+    if (options.model_path && load_model(options.model_path) != 0) {
+        return 2;
+    }
+    if (options.config_path && runtime_config_init(options.config_path, 1) != SUCCESS) {
+        fprintf(stderr, "Invalid daemon configuration: %s\n", options.config_path);
+        return 2;
+    }
+
+    // The daemon logs to stdout; the report gets its own stream
+    FILE *out = stdout;
+    if (options.verbose) {
+        logger_set_level((LogLevel)runtime_config_get()->log_level);
+    } else {
+        logger_set_level(LOG_LEVEL_ERROR);
+        int report_fd = dup(STDOUT_FILENO);
+        out = report_fd >= 0 ? fdopen(report_fd, "w") : NULL;
+        if (!out || !freopen("/dev/null", "w", stdout)) {
+            fprintf(stderr, "Cannot silence the daemon log: %s\n", strerror(errno));
+            return 2;
+        }
+    }
+    timesource_use_virtual();
+
+    room_count = (int)model.rooms;
+    occupants_per_room = (int)model.occupants;
+    int days = options.days > 0 ? options.days : (int)model.days;
+    rng_state = options.seed * 0x9E3779B97F4A7C15ULL + 1;
+
+    raise_fd_limit(room_count + 64);
+    if (setup_rooms() != 0) {
+        fprintf(stderr, "Setup failed for %d rooms: %s\n", room_count, strerror(errno));
+        return 2;
+    }
+
+    origin_ms = timesource_now_ms();
+    end_ms = origin_ms + (uint64_t)days * SIM_DAY_MS;
+    schedule(origin_ms, EVENT_DAY, -1, -1, 0);
+    schedule(origin_ms + (uint64_t)runtime_config_get()->heartbeat_check_interval * 1000ULL,
+             EVENT_SWEEP, -1, -1, 0);
+
+    uint64_t real_start = read_clock_ns(CLOCK_MONOTONIC);
+    uint64_t cpu_start = read_clock_ns(CLOCK_PROCESS_CPUTIME_ID);
+
+    while (heap_size > 0 && heap[0].at_ms < end_ms) {
+        Event event = pop_event();
+        timesource_advance_to_ms(event.at_ms);
+        counters.events++;
+        handle_event(&event);
+    }
+
+    // Score rooms still left unlocked at the end
+    for (int r = 0; r < room_count; r++) {
+        if (rooms[r].unattended) {
+            finish_unattended(&rooms[r], end_ms);
+        }
+    }
+
+    uint64_t cpu_ns = read_clock_ns(CLOCK_PROCESS_CPUTIME_ID) - cpu_start;
+    uint64_t real_ns = read_clock_ns(CLOCK_MONOTONIC) - real_start;
+    report(out, days, real_ns, cpu_ns);
+    fflush(out);
+
+    for (int r = 0; r < room_count; r++) {
+        reminder_policy_cleanup(&rooms[r].policy);
+        device_manager_set_callbacks(&rooms[r].manager, NULL);
+        device_manager_cleanup(&rooms[r].manager);
+        reactor_cleanup(&rooms[r].reactor);
+        free(rooms[r].occupants);
+    }
+    free(rooms);
+    free(heap);
+    free(reminder_delays_s);
+    runtime_config_cleanup();
+
+    return 0;
+}
@@ -0,0 +1,230 @@
+/**
+ * @file door_monitor_ctl.c
+ * @brief Command-line client for the door monitor control socket
+ *
+ * Sends one command to the running daemon and prints its JSON reply.
+ * The "shm" command is answered locally from the shared-memory status
+ * segment instead, without talking to the daemon.
+ *
+ * Usage:
+ *   door_monitor_ctl [-s socket] <command> [args...]
+ *   door_monitor_ctl [-m segment] shm
+ *   door_monitor_ctl help
+ *
+ * Exit status: 0 if the daemon accepted the command, 1 if it reported an
+ * error, 2 if it could not be reached.
+ */
+
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <getopt.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <sys/time.h>
+#include <sys/un.h>
+
+#include "config.h"
+#include "status_shm.h"
+
+/**
+ * @brief Print usage to stderr
+ */
+static void usage(const char *program) {
+    fprintf(stderr, "Usage: %s [-s socket] <command> [args...]\n", program);
+    fprintf(stderr, "       %s [-m segment] shm\n", program);
+    fprintf(stderr, "Run '%s help' for the list of commands.\n", program);
+    fprintf(stderr, "Default socket: %s\n", CONTROL_SOCKET_PATH);
+    fprintf(stderr, "Default segment: %s\n", STATUS_SHM_PATH);
+}
+
+/**
+ * @brief Print a snapshot of the status segment as JSON
+ * @return Exit status: 0 on success, 1 if the daemon stopped, 2 if unreadable
+ */
+static int print_status_segment(const char *path) {
+    int fd = open(path, O_RDONLY | O_CLOEXEC);
+    if (fd < 0) {
+        fprintf(stderr, "Cannot open %s: %s\n", path, strerror(errno));
+        return 2;
+    }
+    const StatusShmSegment *segment = mmap(NULL, sizeof(StatusShmSegment), PROT_READ,
+                                           MAP_SHARED, fd, 0);
+    close(fd);
+    if (segment == MAP_FAILED) {
+        fprintf(stderr, "Cannot map %s: %s\n", path, strerror(errno));
+        return 2;
+    }
+
+    StatusShmSegment snapshot;
+    int result = status_shm_read(segment, &snapshot);
+    munmap((void*)segment, sizeof(StatusShmSegment));
+    if (result != 0) {
+        fprintf(stderr, "No valid status segment at %s\n", path);
+        return 2;
+    }
+
+    static const char *const health_names[] = { "ok", "degraded", "failed" };
+    const char *health = snapshot.health >= 0 && snapshot.health <= 2
+                         ? health_names[snapshot.health] : "unknown";
+
+    printf("{\"pid\":%d,\"sequence\":%llu,\"started\":%lld,\"updated\":%lld,"
+           "\"health\":\"%s\",\"rooms\":[",
+           (int)snapshot.pid, (unsigned long long)snapshot.sequence,
+           (long long)snapshot.started, (long long)snapshot.updated, health);
+    for (uint32_t i = 0; i < snapshot.room_count && i < STATUS_SHM_MAX_ROOMS; i++) {
+        const StatusShmRoom *room = &snapshot.rooms[i];
+        const char *door = room->door_state == 0 ? "locked" :
+                           room->door_state == 1 ? "unlocked" : "error";
+        printf("%s{\"room\":\"%.*s\",\"devices\":%u,\"occupied\":%s,\"door\":\"%s\","
+               "\"occupancy_changed\":%lld,\"door_changed\":%lld}",
+               i > 0 ? "," : "", (int)sizeof(room->room_id), room->room_id,
+               (unsigned)room->devices, room->occupied ? "true" : "false", door,
+               (long long)room->occupancy_changed, (long long)room->door_changed);
+    }
+
+    const StatusShmCounters *counters = &snapshot.counters;
+    printf("],\"counters\":{\"messages_processed\":%llu,\"devices_added\":%llu,"
+           "\"device_timeouts\":%llu,\"connections_accepted\":%llu,"
+           "\"notifications_sent\":%llu,\"notifications_failed\":%llu,"
+           "\"reminders_delivered\":%llu,\"reminders_abandoned\":%llu},\"ok\":%s}\n",
+           (unsigned long long)counters->messages_processed,
+           (unsigned long long)counters->devices_added,
+           (unsigned long long)counters->device_timeouts,
+           (unsigned long long)counters->connections_accepted,
+           (unsigned long long)counters->notifications_sent,
+           (unsigned long long)counters->notifications_failed,
+           (unsigned long long)counters->reminders_delivered,
+           (unsigned long long)counters->reminders_abandoned,
+           snapshot.pid != 0 ? "true" : "false");
+
+    return snapshot.pid != 0 ? 0 : 1;
+}
+
+/**
+ * @brief Connect to the control socket
+ * @return Connected socket, or -1 on error
+ */
+static int connect_daemon(const char *path) {
+    struct sockaddr_un addr;
+    memset(&addr, 0, sizeof(addr));
+    if (strlen(path) >= sizeof(addr.sun_path)) {
+        fprintf(stderr, "Socket path too long: %s\n", path);
+        return -1;
+    }
+    addr.sun_family = AF_UNIX;
+    snprintf(addr.sun_path, sizeof(addr.sun_path), "%s", path);
+
+    int fd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if (fd < 0) {
+        fprintf(stderr, "socket: %s\n", strerror(errno));
+        return -1;
+    }
+
+    // Never hang on a daemon that stopped answering
+    struct timeval timeout = { .tv_sec = CONTROL_CLIENT_TIMEOUT, .tv_usec = 0 };
+    setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+    setsockopt(fd, SOL_SOCKET, SO_SNDTIMEO, &timeout, sizeof(timeout));
+
+    if (connect(fd, (struct sockaddr*)&addr, sizeof(addr)) < 0) {
+        fprintf(stderr, "Cannot connect to %s: %s\n", path, strerror(errno));
+        close(fd);
+        return -1;
+    }
+
+    return fd;
+}
+
+int main(int argc, char *argv[]) {
+    const char *socket_path = CONTROL_SOCKET_PATH;
+    const char *segment_path = STATUS_SHM_PATH;
+    int opt;
+
+    while ((opt = getopt(argc, argv, "+s:m:h")) != -1) {
+        switch (opt) {
+            case 's':
+                socket_path = optarg;
+                break;
+            case 'm':
+                segment_path = optarg;
+                break;
+            case 'h':
+                usage(argv[0]);
+                return 0;
+            default:
+                usage(argv[0]);
+                return 2;
+        }
+    }
+
+    if (optind >= argc) {
+        usage(argv[0]);
+        return 2;
+    }
+
+    if (strcmp(argv[optind], "shm") == 0 && optind + 1 == argc) {
+        return print_status_segment(segment_path);
+    }
+
+    // Join the command words into one line
+    char command[256];
+    size_t length = 0;
+    for (int i = optind; i < argc; i++) {
+        int written = snprintf(command + length, sizeof(command) - length, "%s%s",
+                               i > optind ? " " : "", argv[i]);
+        if (written < 0 || (size_t)written >= sizeof(command) - length - 1) {
+            fprintf(stderr, "Command too long\n");
+            return 2;
+        }
+        length += (size_t)written;
+    }
+    command[length++] = '\n';
+
+    int fd = connect_daemon(socket_path);
+    if (fd < 0) {
+        return 2;
+    }
+
+    if (send(fd, command, length, MSG_NOSIGNAL) != (ssize_t)length) {
+        fprintf(stderr, "Failed to send command: %s\n", strerror(errno));
+        close(fd);
+        return 2;
+    }
+
+    // Read the reply until the daemon closes the connection
+    char *reply = NULL;
+    size_t reply_len = 0;
+    char buffer[4096];
+    ssize_t n;
+    while ((n = recv(fd, buffer, sizeof(buffer), 0)) > 0) {
+        char *grown = realloc(reply, reply_len + (size_t)n + 1);
+        if (!grown) {
+            fprintf(stderr, "Out of memory\n");
+            free(reply);
+            close(fd);
+            return 2;
+        }
+        reply = grown;
+        memcpy(reply + reply_len, buffer, (size_t)n);
+        reply_len += (size_t)n;
+        reply[reply_len] = '\0';
+    }
+    close(fd);
+
+    if (n < 0 || !reply) {
+        fprintf(stderr, "No reply from daemon%s%s\n",
+                n < 0 ? ": " : "", n < 0 ? strerror(errno) : "");
+        free(reply);
+        return 2;
+    }
+
+    fputs(reply, stdout);
+    int ok = (strstr(reply, "\"ok\":true") != NULL);
+    free(reply);
+
+    return ok ? 0 : 1;
+}
@@ -0,0 +1,752 @@
+/**
+ * @file door_monitor_loadgen.c
+ * @brief Load generator for the device protocol of the Bluetooth server
+ *
+ * Opens many concurrent client connections, sends FCM token and heartbeat
+ * messages at a configurable rate, closes and reopens connections to model
+ * phones coming and going, and reports the latencies it measured.
+ *
+ * Usage:
+ *   door_monitor_loadgen [-s socket | -b address] [-n connections] [-d seconds]
+ *                        [-r opens/s] [-H ms] [-T ms] [-c churn/s] [-l length]
+ *
+ * Transports:
+ * - Loopback (default): the daemon started with --simulate listens on a
+ *   Unix socket and acknowledges every processed message with one byte.
+ *   Each connection binds its own BT_LOOPBACK_CLIENT_PREFIX name, so the
+ *   daemon sees a distinct device per connection.
+ * - L2CAP (-b): connects to a real daemon over Bluetooth. There are no
+ *   acknowledgements and every connection comes from this adapter's
+ *   address, so only connect latency and disconnects are measured.
+ *
+ * Measurements:
+ * - connect: connect() until the socket is connected (kernel side)
+ * - accept:  connect() until the token is acknowledged, i.e. the daemon
+ *            accepted the connection, registered the device and parsed
+ *            its first message (loopback only)
+ * - ack:     send until acknowledgement for every message (loopback only)
+ *
+ * A connection the daemon closes before acknowledging anything was
+ * rejected (usually MAX_DEVICES reached); it is retried after
+ * LOADGEN_RETRY_DELAY_MS, like a phone would.
+ *
+ * Exit status: 0 after a run in which at least one connection was
+ * accepted, 1 if none was, 2 on invalid usage or setup failure.
+ */
+
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <stddef.h>
+#include <string.h>
+#include <unistd.h>
+#include <errno.h>
+#include <signal.h>
+#include <getopt.h>
+#include <time.h>
+#include <sys/epoll.h>
+#include <sys/resource.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <bluetooth/bluetooth.h>
+#include <bluetooth/l2cap.h>
+
+#include "config.h"
+
+/// Scheduling granularity of heartbeats, churn and ramp-up
+#define LOADGEN_TICK_MS 5
+
+/// Delay before a rejected or dropped connection is reopened
+#define LOADGEN_RETRY_DELAY_MS 1000
+
+/// Messages a connection may have waiting for acknowledgement
+#define LOADGEN_MAX_INFLIGHT 8
+
+/// Latency samples kept per measurement (reservoir sampled beyond)
+#define LOADGEN_MAX_SAMPLES (1 << 20)
+
+// ============================================================================
+// DATA STRUCTURES
+// ============================================================================
+
+/**
+ * @brief Connection states
+ */
+typedef enum {
+    CLIENT_IDLE = 0,                    /// Closed, reopened at retry_at_us
+    CLIENT_CONNECTING,                  /// connect() in progress
+    CLIENT_OPEN                         /// Connected, token sent
+} ClientState;
+
+/**
+ * @brief One simulated phone
+ */
+typedef struct {
+    int fd;                             /// Socket, -1 while idle
+    ClientState state;                  /// Connection state
+    char mac[18];                       /// Address announced on loopback
+    uint64_t connect_start_us;          /// When connect() was called
+    uint64_t retry_at_us;               /// When an idle client reconnects
+    uint64_t next_heartbeat_us;         /// Next heartbeat, 0 if disabled
+    uint64_t next_token_us;             /// Next token resend, 0 if disabled
+    int acknowledged;                   /// The daemon acknowledged a message
+    uint64_t inflight_us[LOADGEN_MAX_INFLIGHT]; /// Send times waiting for acks
+    int inflight_head;                  /// Oldest send waiting for an ack
+    int inflight_count;                 /// Sends waiting for an ack
+} Client;
+
+/**
+ * @brief Latency samples of one measurement
+ */
+typedef struct {
+    const char *name;                   /// Label in the report
+    uint32_t *samples;                  /// Microseconds, unsorted
+    size_t count;                       /// Samples stored
+    uint64_t seen;                      /// Samples offered
+    uint64_t max_us;                    /// Largest sample seen
+} Latency;
+
+/**
+ * @brief Command-line options
+ */
+typedef struct {
+    const char *socket_path;            /// Loopback socket
+    const char *bt_address;             /// L2CAP server address, NULL for loopback
+    int connections;                    /// Concurrent connections
+    int duration_s;                     /// Run time
+    int open_rate;                      /// Connections opened per second, 0 = all at once
+    int heartbeat_ms;                   /// Heartbeat interval per connection, 0 = none
+    int token_ms;                       /// Token resend interval per connection, 0 = none
+    int churn_rate;                     /// Connections closed and reopened per second
+    int token_length;                   /// Generated token length
+} Options;
+
+/**
+ * @brief Counters for the report
+ */
+typedef struct {
+    uint64_t connects;                  /// connect() calls
+    uint64_t connect_failures;          /// connect() refused or backlog full
+    uint64_t accepted;                  /// Connections acknowledged (loopback) or connected (L2CAP)
+    uint64_t rejected;                  /// Closed by the daemon before any ack
+    uint64_t dropped;                   /// Closed by the daemon after an ack
+    uint64_t churned;                   /// Closed by us for churn
+    uint64_t tokens;                    /// Token messages sent
+    uint64_t heartbeats;                /// Heartbeat messages sent
+    uint64_t send_failures;             /// Sends that found the connection closed
+    uint64_t stalled;                   /// Sends skipped, too many unacknowledged
+    uint64_t acks;                      /// BT_LOOPBACK_ACK received
+    uint64_t nacks;                     /// BT_LOOPBACK_NACK received
+} Counters;
+
+// ============================================================================
+// STATIC VARIABLES
+// ============================================================================
+
+static volatile sig_atomic_t stop_requested = 0;
+
+static Options options;
+static Counters counters;
+static Client *clients;
+static int epoll_fd = -1;
+static char *token_message;
+static size_t token_message_len;
+
+static Latency connect_latency = { .name = "connect" };
+static Latency accept_latency = { .name = "accept" };
+static Latency ack_latency = { .name = "ack" };
+
+// ============================================================================
+// HELPERS
+// ============================================================================
+
+/**
+ * @brief Print usage to stderr
+ */
+static void usage(const char *program) {
+    fprintf(stderr, "Usage: %s [options]\n", program);
+    fprintf(stderr, "  -s PATH  Loopback socket of a --simulate daemon (default %s)\n",
+            SIMULATION_BT_SOCKET_PATH);
+    fprintf(stderr, "  -b ADDR  Connect over L2CAP to this Bluetooth address instead\n");
+    fprintf(stderr, "  -n N     Concurrent connections (default 100)\n");
+    fprintf(stderr, "  -d SEC   Duration in seconds (default 30)\n");
+    fprintf(stderr, "  -r N     Connections opened per second (default 0: all at once)\n");
+    fprintf(stderr, "  -H MS    Heartbeat interval per connection (default 1000, 0: none)\n");
+    fprintf(stderr, "  -T MS    Token resend interval per connection (default 0: on connect only)\n");
+    fprintf(stderr, "  -c N     Connections closed and reopened per second (default 0)\n");
+    fprintf(stderr, "  -l LEN   Token length (default %d)\n", MIN_FCM_TOKEN_LENGTH + 16);
+}
+
+/**
+ * @brief Read the monotonic clock in microseconds
+ */
+static uint64_t now_us(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000ULL + (uint64_t)ts.tv_nsec / 1000;
+}
+
+/**
+ * @brief Parse a non-negative integer option
+ * @return 0 on success, -1 if the text is not a number in [0, max]
+ */
+static int parse_count(const char *text, int max, int *value) {
+    char *end = NULL;
+    errno = 0;
+    long parsed = strtol(text, &end, 10);
+    if (errno != 0 || end == text || *end != '\0' || parsed < 0 || parsed > max) {
+        return -1;
+    }
+    *value = (int)parsed;
+    return 0;
+}
+
+/**
+ * @brief Signal handler: finish the run and print the report
+ */
+static void handle_stop(int signum) {
+    (void)signum;
+    stop_requested = 1;
+}
+
+/**
+ * @brief Record one latency sample
+ */
+static void latency_record(Latency *latency, uint64_t us) {
+    uint32_t sample = us > UINT32_MAX ? UINT32_MAX : (uint32_t)us;
+
+    latency->seen++;
+    if (us > latency->max_us) {
+        latency->max_us = us;
+    }
+
+    if (!latency->samples) {
+        latency->samples = malloc(LOADGEN_MAX_SAMPLES * sizeof(uint32_t));
+        if (!latency->samples) {
+            return;
+        }
+    }
+
+    // Past the cap, keep a uniform sample of everything seen
+    if (latency->count < LOADGEN_MAX_SAMPLES) {
+        latency->samples[latency->count++] = sample;
+    } else {
+        uint64_t slot = ((uint64_t)random() << 31 | (uint64_t)random()) % latency->seen;
+        if (slot < LOADGEN_MAX_SAMPLES) {
+            latency->samples[slot] = sample;
+        }
+    }
+}
+
+/**
+ * @brief qsort comparator for samples
+ */
+static int compare_samples(const void *a, const void *b) {
+    uint32_t x = *(const uint32_t*)a;
+    uint32_t y = *(const uint32_t*)b;
+    return (x > y) - (x < y);
+}
+
+/**
+ * @brief Print percentiles of one measurement
+ */
+static void latency_report(Latency *latency) {
+    if (latency->count == 0) {
+        printf("  %-8s no samples\n", latency->name);
+        return;
+    }
+
+    qsort(latency->samples, latency->count, sizeof(uint32_t), compare_samples);
+
+    const double percentiles[] = { 0.50, 0.90, 0.99, 0.999 };
+    printf("  %-8s n=%-9llu", latency->name, (unsigned long long)latency->seen);
+    for (size_t i = 0; i < sizeof(percentiles) / sizeof(percentiles[0]); i++) {
+        size_t index = (size_t)(percentiles[i] * (double)(latency->count - 1));
+        printf("  p%g %.3f ms", percentiles[i] * 100.0, latency->samples[index] / 1000.0);
+    }
+    printf("  max %.3f ms\n", latency->max_us / 1000.0);
+}
+
+/**
+ * @brief Raise the open file limit to fit every connection
+ */
+static void raise_fd_limit(int needed) {
+    struct rlimit limit;
+    if (getrlimit(RLIMIT_NOFILE, &limit) != 0 || limit.rlim_cur >= (rlim_t)needed) {
+        return;
+    }
+
+    limit.rlim_cur = (limit.rlim_max == RLIM_INFINITY || limit.rlim_max >= (rlim_t)needed)
+                     ? (rlim_t)needed : limit.rlim_max;
+    setrlimit(RLIMIT_NOFILE, &limit);
+    if (limit.rlim_cur < (rlim_t)needed) {
+        fprintf(stderr, "Warning: open file limit %llu is below the %d needed\n",
+                (unsigned long long)limit.rlim_cur, needed);
+    }
+}
+
+// ============================================================================
+// CONNECTIONS
+// ============================================================================
+
+/**
+ * @brief Close a connection and schedule its reopening
+ */
+static void client_close(Client *client, uint64_t retry_at_us) {
+    if (client->fd >= 0) {
+        epoll_ctl(epoll_fd, EPOLL_CTL_DEL, client->fd, NULL);
+        close(client->fd);
+        client->fd = -1;
+    }
+    client->state = CLIENT_IDLE;
+    client->retry_at_us = retry_at_us;
+    client->inflight_count = 0;
+    client->inflight_head = 0;
+}
+
+/**
+ * @brief The daemon closed the connection
+ */
+static void client_lost(Client *client, uint64_t now) {
+    if (client->acknowledged || (options.bt_address && client->state == CLIENT_OPEN)) {
+        counters.dropped++;
+    } else {
+        counters.rejected++;
+    }
+    client_close(client, now + LOADGEN_RETRY_DELAY_MS * 1000ULL);
+}
+
+/**
+ * @brief Send one message and remember when, for its acknowledgement
+ * @return 0 on success, -1 if the connection was closed
+ */
+static int client_send(Client *client, const char *message, size_t length, uint64_t now) {
+    int loopback = (options.bt_address == NULL);
+
+    if (loopback && client->inflight_count >= LOADGEN_MAX_INFLIGHT) {
+        counters.stalled++;
+        return 0;
+    }
+
+    if (send(client->fd, message, length, MSG_NOSIGNAL | MSG_DONTWAIT) != (ssize_t)length) {
+        if (errno == EAGAIN || errno == EWOULDBLOCK) {
+            counters.stalled++;
+            return 0;
+        }
+        counters.send_failures++;
+        client_lost(client, now);
+        return -1;
+    }
+
+    if (loopback) {
+        int slot = (client->inflight_head + client->inflight_count) % LOADGEN_MAX_INFLIGHT;
+        client->inflight_us[slot] = now;
+        client->inflight_count++;
+    }
+    return 0;
+}
+
+/**
+ * @brief Connection established: send the token, start heartbeats
+ */
+static void client_connected(Client *client, uint64_t now) {
+    client->state = CLIENT_OPEN;
+    client->acknowledged = 0;
+    latency_record(&connect_latency, now - client->connect_start_us);
+
+    // Without acknowledgements, being connected is all we can observe
+    if (options.bt_address) {
+        counters.accepted++;
+        latency_record(&accept_latency, now - client->connect_start_us);
+    }
+
+    struct epoll_event event = { .events = EPOLLIN, .data.ptr = client };
+    epoll_ctl(epoll_fd, EPOLL_CTL_MOD, client->fd, &event);
+
+    // Spread periodic traffic so connections opened together do not send together
+    client->next_heartbeat_us = options.heartbeat_ms > 0
+        ? now + (uint64_t)(random() % options.heartbeat_ms + 1) * 1000ULL : 0;
+    client->next_token_us = options.token_ms > 0 ? now + (uint64_t)options.token_ms * 1000ULL : 0;
+
+    counters.tokens++;
+    client_send(client, token_message, token_message_len, now);
+}
+
+/**
+ * @brief Open a connection
+ */
+static void client_open(Client *client, uint64_t now) {
+    int loopback = (options.bt_address == NULL);
+    int fd;
+
+    if (loopback) {
+        fd = socket(AF_UNIX, SOCK_SEQPACKET | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+    } else {
+        fd = socket(AF_BLUETOOTH, SOCK_SEQPACKET | SOCK_NONBLOCK | SOCK_CLOEXEC, BTPROTO_L2CAP);
+    }
+    if (fd < 0) {
+        counters.connect_failures++;
+        client_close(client, now + LOADGEN_RETRY_DELAY_MS * 1000ULL);
+        return;
+    }
+
+    int result;
+    if (loopback) {
+        // The abstract name tells the server which MAC address this is
+        struct sockaddr_un local = {0};
+        struct sockaddr_un server = {0};
+        local.sun_family = AF_UNIX;
+        int name_len = snprintf(local.sun_path + 1, sizeof(local.sun_path) - 1, "%sloadgen-%d/%s",
+                                BT_LOOPBACK_CLIENT_PREFIX, (int)getpid(), client->mac);
+        socklen_t local_len = (socklen_t)(offsetof(struct sockaddr_un, sun_path) + 1 + (size_t)name_len);
+        server.sun_family = AF_UNIX;
+        snprintf(server.sun_path, sizeof(server.sun_path), "%s", options.socket_path);
+
+        result = bind(fd, (struct sockaddr*)&local, local_len);
+        if (result == 0) {
+            result = connect(fd, (struct sockaddr*)&server, sizeof(server));
+        }
+    } else {
+        struct sockaddr_l2 server = {0};
+        server.l2_family = AF_BLUETOOTH;
+        server.l2_psm = htobs(BLE_PSM);
+        str2ba(options.bt_address, &server.l2_bdaddr);
+        result = connect(fd, (struct sockaddr*)&server, sizeof(server));
+    }
+
+    counters.connects++;
+    client->fd = fd;
+    client->connect_start_us = now;
+
+    if (result != 0 && errno != EINPROGRESS) {
+        // EAGAIN: the listen backlog is full, which is load too
+        counters.connect_failures++;
+        client_close(client, now + LOADGEN_RETRY_DELAY_MS * 1000ULL);
+        return;
+    }
+
+    struct epoll_event event = { .events = result == 0 ? EPOLLIN : EPOLLOUT, .data.ptr = client };
+    if (epoll_ctl(epoll_fd, EPOLL_CTL_ADD, fd, &event) != 0) {
+        counters.connect_failures++;
+        client_close(client, now + LOADGEN_RETRY_DELAY_MS * 1000ULL);
+        return;
+    }
+
+    client->state = CLIENT_CONNECTING;
+    if (result == 0) {
+        client_connected(client, now);
+    }
+}
+
+/**
+ * @brief Socket event for a connection
+ */
+static void client_event(Client *client, uint32_t events, uint64_t now) {
+    if (client->state == CLIENT_CONNECTING) {
+        int error = 0;
+        socklen_t length = sizeof(error);
+        getsockopt(client->fd, SOL_SOCKET, SO_ERROR, &error, &length);
+        if (error != 0) {
+            counters.connect_failures++;
+            client_close(client, now + LOADGEN_RETRY_DELAY_MS * 1000ULL);
+            return;
+        }
+        client_connected(client, now);
+        return;
+    }
+
+    if (!(events & (EPOLLIN | EPOLLHUP | EPOLLERR))) {
+        return;
+    }
+
+    char buffer[64];
+    ssize_t n;
+    while ((n = recv(client->fd, buffer, sizeof(buffer), MSG_DONTWAIT)) > 0) {
+        for (ssize_t i = 0; i < n; i++) {
+            if (buffer[i] != BT_LOOPBACK_ACK && buffer[i] != BT_LOOPBACK_NACK) {
+                continue;
+            }
+            if (buffer[i] == BT_LOOPBACK_ACK) {
+                counters.acks++;
+            } else {
+                counters.nacks++;
+            }
+            if (client->inflight_count == 0) {
+                continue;
+            }
+
+            uint64_t sent = client->inflight_us[client->inflight_head];
+            client->inflight_head = (client->inflight_head + 1) % LOADGEN_MAX_INFLIGHT;
+            client->inflight_count--;
+            latency_record(&ack_latency, now - sent);
+
+            if (!client->acknowledged) {
+                client->acknowledged = 1;
+                counters.accepted++;
+                latency_record(&accept_latency, now - client->connect_start_us);
+            }
+        }
+    }
+
+    if (n == 0 || (n < 0 && errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR)) {
+        client_lost(client, now);
+    }
+}
+
+// ============================================================================
+// LOAD SCHEDULE
+// ============================================================================
+
+/**
+ * @brief Send the heartbeats and token resends that are due
+ */
+static void send_due_messages(uint64_t now) {
+    for (int i = 0; i < options.connections; i++) {
+        Client *client = &clients[i];
+        if (client->state != CLIENT_OPEN) {
+            continue;
+        }
+
+        if (client->next_token_us && now >= client->next_token_us) {
+            client->next_token_us += (uint64_t)options.token_ms * 1000ULL;
+            counters.tokens++;
+            if (client_send(client, token_message, token_message_len, now) != 0) {
+                continue;
+            }
+        }
+        if (client->next_heartbeat_us && now >= client->next_heartbeat_us) {
+            client->next_heartbeat_us += (uint64_t)options.heartbeat_ms * 1000ULL;
+            counters.heartbeats++;
+            client_send(client, "{}", 2, now);
+        }
+    }
+}
+
+/**
+ * @brief Close random open connections; they reopen on the next tick
+ */
+static void churn(int count, uint64_t now) {
+    for (int attempt = 0; count > 0 && attempt < options.connections; attempt++) {
+        Client *client = &clients[random() % options.connections];
+        if (client->state == CLIENT_OPEN) {
+            client_close(client, now);
+            counters.churned++;
+            count--;
+        }
+    }
+}
+
+/**
+ * @brief Print one progress line to stderr
+ */
+static void report_progress(uint64_t elapsed_us) {
+    int open = 0;
+    for (int i = 0; i < options.connections; i++) {
+        open += (clients[i].state == CLIENT_OPEN);
+    }
+    fprintf(stderr, "[%4llus] open %d  accepted %llu  rejected %llu  acks %llu\n",
+            (unsigned long long)(elapsed_us / 1000000ULL), open,
+            (unsigned long long)counters.accepted, (unsigned long long)counters.rejected,
+            (unsigned long long)counters.acks);
+}
+
+/**
+ * @brief Print the final report to stdout
+ */
+static void report(uint64_t elapsed_us) {
+    double seconds = elapsed_us / 1e6;
+    uint64_t messages = counters.tokens + counters.heartbeats;
+
+    printf("door_monitor_loadgen: %d connections over %s for %.1f s\n", options.connections,
+           options.bt_address ? "L2CAP" : "loopback", seconds);
+    printf("Connections:\n");
+    printf("  connect() calls   %llu (%llu failed or backlog full)\n",
+           (unsigned long long)counters.connects, (unsigned long long)counters.connect_failures);
+    printf("  accepted          %llu\n", (unsigned long long)counters.accepted);
+    printf("  rejected          %llu (closed by the daemon before any ack)\n",
+           (unsigned long long)counters.rejected);
+    printf("  dropped           %llu (closed by the daemon later)\n",
+           (unsigned long long)counters.dropped);
+    printf("  churned           %llu\n", (unsigned long long)counters.churned);
+    printf("Messages:\n");
+    printf("  sent              %llu (%llu tokens, %llu heartbeats), %.1f/s\n",
+           (unsigned long long)messages, (unsigned long long)counters.tokens,
+           (unsigned long long)counters.heartbeats, seconds > 0 ? messages / seconds : 0.0);
+    printf("  send failures     %llu\n", (unsigned long long)counters.send_failures);
+    printf("  stalled           %llu (skipped, %d unacknowledged or socket full)\n",
+           (unsigned long long)counters.stalled, LOADGEN_MAX_INFLIGHT);
+    if (!options.bt_address) {
+        printf("  acknowledged      %llu (%llu failed to process)\n",
+               (unsigned long long)(counters.acks + counters.nacks),
+               (unsigned long long)counters.nacks);
+    }
+    printf("Latency:\n");
+    latency_report(&connect_latency);
+    if (options.bt_address) {
+        printf("  accept   same as connect (no acknowledgements over L2CAP)\n");
+        printf("  ack      n/a (no acknowledgements over L2CAP)\n");
+    } else {
+        latency_report(&accept_latency);
+        latency_report(&ack_latency);
+    }
+}
+
+// ============================================================================
+// MAIN
+// ============================================================================
+
+/**
+ * @brief Build the token message every connection sends
+ * @return 0 on success, -1 if out of memory
+ */
+static int build_token_message(void) {
+    size_t size = (size_t)options.token_length + 32;
+    token_message = malloc(size);
+    if (!token_message) {
+        return -1;
+    }
+
+    int prefix = snprintf(token_message, size, "{\"fcm_token\": \"loadgen-");
+    for (int i = 0; i < options.token_length - 8; i++) {
+        token_message[prefix + i] = 'x';
+    }
+    int length = prefix + (options.token_length > 8 ? options.token_length - 8 : 0);
+    length += snprintf(token_message + length, size - (size_t)length, "\"}");
+    token_message_len = (size_t)length;
+    return 0;
+}
+
+int main(int argc, char *argv[]) {
+    int opt;
+
+    options.socket_path = SIMULATION_BT_SOCKET_PATH;
+    options.connections = 100;
+    options.duration_s = 30;
+    options.heartbeat_ms = 1000;
+    options.token_length = MIN_FCM_TOKEN_LENGTH + 16;
+
+    while ((opt = getopt(argc, argv, "s:b:n:d:r:H:T:c:l:h")) != -1) {
+        int bad = 0;
+        switch (opt) {
+            case 's': options.socket_path = optarg; break;
+            case 'b': options.bt_address = optarg; break;
+            case 'n': bad = parse_count(optarg, 1000000, &options.connections); break;
+            case 'd': bad = parse_count(optarg, 86400, &options.duration_s); break;
+            case 'r': bad = parse_count(optarg, 1000000, &options.open_rate); break;
+            case 'H': bad = parse_count(optarg, 3600000, &options.heartbeat_ms); break;
+            case 'T': bad = parse_count(optarg, 3600000, &options.token_ms); break;
+            case 'c': bad = parse_count(optarg, 1000000, &options.churn_rate); break;
+            case 'l': bad = parse_count(optarg, BUFFER_SIZE - 32, &options.token_length); break;
+            case 'h':
+                usage(argv[0]);
+                return 0;
+            default:
+                usage(argv[0]);
+                return 2;
+        }
+        if (bad) {
+            fprintf(stderr, "Invalid value for -%c: %s\n", opt, optarg);
+            return 2;
+        }
+    }
+
+    if (optind < argc || options.connections == 0) {
+        usage(argv[0]);
+        return 2;
+    }
+    if (options.bt_address && bachk(options.bt_address) < 0) {
+        fprintf(stderr, "Invalid Bluetooth address: %s\n", options.bt_address);
+        return 2;
+    }
+    if (!options.bt_address && strlen(options.socket_path) >= sizeof(((struct sockaddr_un*)0)->sun_path)) {
+        fprintf(stderr, "Socket path too long: %s\n", options.socket_path);
+        return 2;
+    }
+
+    raise_fd_limit(options.connections + 16);
+
+    clients = calloc((size_t)options.connections, sizeof(Client));
+    epoll_fd = epoll_create1(EPOLL_CLOEXEC);
+    if (!clients || epoll_fd < 0 || build_token_message() != 0) {
+        fprintf(stderr, "Setup failed: %s\n", strerror(errno));
+        return 2;
+    }
+
+    srandom((unsigned int)getpid());
+    for (int i = 0; i < options.connections; i++) {
+        // Locally administered addresses, distinct per connection
+        clients[i].fd = -1;
+        snprintf(clients[i].mac, sizeof(clients[i].mac), "02:4C:47:%02X:%02X:%02X",
+                 (i >> 16) & 0xFF, (i >> 8) & 0xFF, i & 0xFF);
+    }
+
+    struct sigaction action = {0};
+    action.sa_handler = handle_stop;
+    sigaction(SIGINT, &action, NULL);
+    sigaction(SIGTERM, &action, NULL);
+
+    uint64_t start = now_us();
+    uint64_t end = start + (uint64_t)options.duration_s * 1000000ULL;
+    uint64_t last_tick = start;
+    uint64_t next_progress = start + 1000000ULL;
+    double open_credit = options.open_rate > 0 ? 0.0 : options.connections;
+    double churn_credit = 0.0;
+    int opened = 0;
+    struct epoll_event events[256];
+
+    uint64_t now = start;
+    while (!stop_requested && now < end) {
+        int count = epoll_wait(epoll_fd, events, 256, LOADGEN_TICK_MS);
+        now = now_us();
+        for (int i = 0; i < count; i++) {
+            client_event((Client*)events[i].data.ptr, events[i].events, now);
+        }
+
+        if (now - last_tick < LOADGEN_TICK_MS * 1000ULL) {
+            continue;
+        }
+        double tick_s = (now - last_tick) / 1e6;
+        last_tick = now;
+
+        // Ramp up, then reopen whatever is idle and due
+        if (options.open_rate > 0) {
+            open_credit += options.open_rate * tick_s;
+        }
+        for (; opened < options.connections && open_credit >= 1.0; opened++, open_credit -= 1.0) {
+            client_open(&clients[opened], now);
+        }
+        for (int i = 0; i < opened; i++) {
+            if (clients[i].state == CLIENT_IDLE && now >= clients[i].retry_at_us) {
+                client_open(&clients[i], now);
+            }
+        }
+
+        if (options.churn_rate > 0) {
+            churn_credit += options.churn_rate * tick_s;
+            churn((int)churn_credit, now);
+            churn_credit -= (int)churn_credit;
+        }
+
+        send_due_messages(now);
+
+        if (now >= next_progress) {
+            report_progress(now - start);
+            next_progress += 1000000ULL;
+        }
+    }
+
+    report(now - start);
+
+    for (int i = 0; i < options.connections; i++) {
+        client_close(&clients[i], 0);
+    }
+    close(epoll_fd);
+    free(clients);
+    free(token_message);
+    free(connect_latency.samples);
+    free(accept_latency.samples);
+    free(ack_latency.samples);
+
+    return counters.accepted > 0 ? 0 : 1;
+}
@@ -11,6 +11,45 @@
 #ifndef CONFIG_H
 #define CONFIG_H
 
+// ============================================================================
+// SITE CONFIGURATION
+// ============================================================================
+
+/// Identifier of the monitored room (notification text and metric labels)
+#define ROOM_ID "809"
+
+/// Runtime configuration file overriding the defaults below (optional)
+#define CONFIG_FILE_PATH "/etc/door_monitor.conf"
+
+/// Root-only directory for the state file and diagnostic output (systemd StateDirectory)
+#define DATA_DIRECTORY "/var/lib/door_monitor"
+
+/// State kept across restarts (last disconnected token)
+#define STATE_FILE_PATH DATA_DIRECTORY "/state"
+
+/// Threads running independent startup steps
+#define STARTUP_WORKERS 2
+
+// ============================================================================
+// SMALL-FOOTPRINT BUILD
+// ============================================================================
+
+// "make small" (-DDOOR_MONITOR_SMALL) sizes the static pools below for a
+// Pi Zero-class node serving one room. Other builds can set any of them on
+// the compiler command line. TOKEN_SIZE is kept: FCM does not bound its
+// token length, and a truncated token fails every reminder to that phone.
+#ifdef DOOR_MONITOR_SMALL
+#define MAX_DEVICES 6
+#define BUFFER_SIZE 512
+#define REACTOR_MAX_EVENTS 8
+#define NOTIFIER_QUEUE_SIZE 4
+#define TRACE_BUFFER_EVENTS 256
+#define METRICS_MAX_SLOTS 512
+#define METRICS_MAX_CLIENTS 2
+#define METRICS_RESPONSE_SIZE 8192
+#define LOG_COMPILED_LEVEL 1
+#endif
+
 // ============================================================================
 // FIREBASE CLOUD MESSAGING CONFIGURATION
 // ============================================================================
@@ -25,7 +64,7 @@
 #define FCM_NOTIFICATION_TITLE "Door-close reminder"
 
 /// FCM notification body text
-#define FCM_NOTIFICATION_BODY "Room 809 : Don't forget to close the door !"
+#define FCM_NOTIFICATION_BODY "Room " ROOM_ID " : Don't forget to close the door !"
 
 /// FCM notification data type identifier
 #define FCM_NOTIFICATION_DATA_TYPE "door-close-reminder"
@@ -37,14 +76,25 @@
 /// L2CAP Protocol Service Multiplexer for BLE communication
 #define BLE_PSM 0x1001
 
+/// Range of dynamically assigned PSMs accepted for ble_psm (below it are SIG-reserved)
+#define BLE_PSM_MIN 0x1001
+#define BLE_PSM_MAX 0xFFFF
+
 /// Maximum number of concurrent BLE devices
+#ifndef MAX_DEVICES
 #define MAX_DEVICES 10
+#endif
 
 /// FCM token buffer size
 #define TOKEN_SIZE 256
 
 /// Communication buffer size for BLE data
+#ifndef BUFFER_SIZE
 #define BUFFER_SIZE 1024
+#endif
+
+/// Nesting depth accepted in messages from devices (json-c's default)
+#define DEVICE_MESSAGE_MAX_DEPTH 32
 
 /// Device heartbeat timeout in seconds
 #define HEARTBEAT_TIMEOUT 60
@@ -66,21 +116,68 @@
 // SYSTEM CONFIGURATION
 // ============================================================================
 
-/// Heartbeat monitoring thread sleep interval in seconds
+/// Interval between heartbeat timeout sweeps in seconds
 #define HEARTBEAT_CHECK_INTERVAL 10
 
-/// Select timeout for network operations in seconds
-#define NETWORK_SELECT_TIMEOUT 5
-
 /// Maximum HTTP response size for FCM operations
 #define MAX_HTTP_RESPONSE_SIZE 8192
 
+/// Response head (status line and headers) accepted by the built-in HTTP client
+#define HTTP_CLIENT_MAX_HEAD_SIZE 4096
+
+/// First allocation of a notifier response buffer (doubled up to MAX_HTTP_RESPONSE_SIZE)
+#define NOTIFIER_RESPONSE_INITIAL_SIZE 512
+
 /// JWT token maximum size for OAuth operations
 #define MAX_JWT_SIZE 4096
 
 /// OAuth token maximum size
 #define MAX_OAUTH_TOKEN_SIZE 2048
 
+// ============================================================================
+// EVENT LOOP CONFIGURATION
+// ============================================================================
+
+/// File descriptors the reactor can watch (devices plus server, GPIO, signals, HTTP)
+#define REACTOR_MAX_FDS (MAX_DEVICES + 16)
+
+/// Timers the reactor can hold at once
+#define REACTOR_MAX_TIMERS 32
+
+/// Events fetched per epoll_wait() call
+#ifndef REACTOR_MAX_EVENTS
+#define REACTOR_MAX_EVENTS 16
+#endif
+
+/// Notification requests queued while waiting for an OAuth token
+#ifndef NOTIFIER_QUEUE_SIZE
+#define NOTIFIER_QUEUE_SIZE 8
+#endif
+
+/// FCM request body held by each queue slot (token, title and body, JSON-escaped)
+#define NOTIFIER_BODY_SIZE 2048
+
+/// Refresh the cached OAuth token this many seconds before it expires
+#define NOTIFIER_TOKEN_REFRESH_MARGIN 300
+
+/// Timeout for a single OAuth or FCM HTTP request in seconds
+#define NOTIFIER_REQUEST_TIMEOUT 30
+
+/// Seconds a pre-signed OAuth request stays usable (JWTs are valid for an hour)
+#define NOTIFIER_PREPARED_MAX_AGE 600
+
+/// Release the HTTP/TLS stack after this many seconds without a request (0 = keep loaded)
+#define NOTIFIER_IDLE_RELEASE 900
+
+/// Sign credentials and fetch an OAuth token at startup (0 = on the first reminder)
+#define NOTIFIER_WARM_UP_DEFAULT 1
+
+/// Delay before retrying a failed door-close reminder in seconds
+#define REMINDER_RETRY_DELAY 30
+
+/// Reminder attempts per empty-room episode
+#define REMINDER_MAX_ATTEMPTS 3
+
 // ============================================================================
 // PROJECT DIRECTORY STRUCTURE
 // ============================================================================
@@ -104,9 +201,206 @@
 /// Timestamp format for log messages
 #define LOG_TIMESTAMP_FORMAT "%H:%M:%S"
 
+/// Most verbose level compiled in: 3 debug, 2 info, 1 warnings, 0 errors only
+#ifndef LOG_COMPILED_LEVEL
+#define LOG_COMPILED_LEVEL 3
+#endif
+
 /// Log buffer size
 #define LOG_BUFFER_SIZE 256
 
+/// Maximum number of payload characters shown in log previews
+#define LOG_PREVIEW_LENGTH 48
+
+/// Rate-limit window for repeated log messages in seconds
+#define LOG_RATELIMIT_INTERVAL 60
+
+/// Messages emitted per call site within one rate-limit window
+#define LOG_RATELIMIT_BURST 3
+
+// ============================================================================
+// DIAGNOSTICS CONFIGURATION
+// ============================================================================
+
+/// Lock hold time (microseconds) above which the holding call site is recorded
+#define LOCK_STATS_SLOW_HOLD_US 1000
+
+/// Spans kept per thread in the trace ring buffer
+#ifndef TRACE_BUFFER_EVENTS
+#define TRACE_BUFFER_EVENTS 2048
+#endif
+
+/// Record spans from startup (1) or only after trace_set_enabled() (0)
+#define TRACE_ENABLED_DEFAULT 1
+
+/// Output file for trace exports requested with SIGUSR2
+#define TRACE_EXPORT_PATH DATA_DIRECTORY "/trace.json"
+
+/// Per-thread metric slots (a counter uses 1 slot, a histogram 34)
+#ifndef METRICS_MAX_SLOTS
+#define METRICS_MAX_SLOTS 1024
+#endif
+
+/// Prometheus endpoint: "host:port" for TCP or an absolute path for a UNIX socket
+#define METRICS_LISTEN_ADDRESS "127.0.0.1:9464"
+
+/// Scrape connections served at the same time
+#ifndef METRICS_MAX_CLIENTS
+#define METRICS_MAX_CLIENTS 4
+#endif
+
+/// Seconds a scrape connection may stay open
+#define METRICS_CLIENT_TIMEOUT 5
+
+/// Initial size of the exposition buffer (grown on demand)
+#ifndef METRICS_RESPONSE_SIZE
+#define METRICS_RESPONSE_SIZE 32768
+#endif
+
+/// Device messages handled before an alloc-check build requires zero allocations per message
+#define ALLOC_CHECK_WARMUP_MESSAGES 32
+
+/// Interval at which per-subsystem heap totals are published and sampled
+#define HEAP_STATS_INTERVAL_MS 10000
+
+/// Length of a heap trend window; its lowest live value is its floor
+#define HEAP_TREND_WINDOW_S 3600
+
+/// Window floors a heap trend is fitted over
+#define HEAP_TREND_WINDOWS 24
+
+/// Fitted rise over HEAP_TREND_WINDOWS floors that flags a subsystem as growing
+#define HEAP_TREND_MIN_GROWTH_BYTES 32768
+
+/// Profiler samples per second of CPU time
+#define PROFILER_FREQUENCY_HZ 99
+
+/// Seconds a profile records unless a duration is given
+#define PROFILER_DURATION_S 30
+
+/// Folded-stack output of the profiler
+#define PROFILER_OUTPUT_PATH DATA_DIRECTORY "/profile.folded"
+
+/// Highest sampling rate accepted
+#define PROFILER_MAX_FREQUENCY_HZ 1000
+
+/// Longest profile accepted in seconds
+#define PROFILER_MAX_DURATION_S 600
+
+/// Samples kept per profile (about 400 bytes each on 64-bit, allocated while profiling)
+#define PROFILER_MAX_SAMPLES 16384
+
+/// Stack frames kept per sample, counted from the sampled function outwards
+#define PROFILER_MAX_DEPTH 48
+
+// ============================================================================
+// CONTROL SOCKET CONFIGURATION
+// ============================================================================
+
+/// UNIX socket serving door_monitor_ctl (owner-only permissions)
+#define CONTROL_SOCKET_PATH "/run/door_monitor.sock"
+
+/// Control connections served at the same time
+#define CONTROL_MAX_CLIENTS 2
+
+/// Seconds a control connection may stay open
+#define CONTROL_CLIENT_TIMEOUT 5
+
+// ============================================================================
+// STATUS SEGMENT CONFIGURATION
+// ============================================================================
+
+/// Shared-memory status segment read by local monitors (empty disables it)
+#define STATUS_SHM_PATH "/dev/shm/door_monitor_status"
+
+/// Milliseconds between refreshes of the counters in the status segment
+#define STATUS_SHM_INTERVAL_MS 100
+
+/// Room entries in the status segment (part of the layout, see status_shm.h)
+#define STATUS_SHM_MAX_ROOMS 8
+
+// ============================================================================
+// HEALTH MONITORING CONFIGURATION
+// ============================================================================
+
+/// Milliseconds between health evaluations (shortened to half the systemd
+/// watchdog period when that is smaller)
+#define HEALTH_CHECK_INTERVAL_MS 1000
+
+/// Event loop lag (ms) that marks the daemon degraded
+#define HEALTH_LOOP_LAG_DEGRADED_MS 250
+
+/// Event loop lag (ms) that marks the daemon failed
+#define HEALTH_LOOP_LAG_FAILED_MS 5000
+
+/// A pending notification older than this many request timeouts is stuck
+#define HEALTH_NOTIFIER_STUCK_FACTOR 4
+
+/// Milliseconds without a loop tick before the stall detector logs an error
+#define HEALTH_STALL_TIMEOUT_MS 10000
+
+// ============================================================================
+// REAL-TIME CONFIGURATION
+// ============================================================================
+
+/// SCHED_FIFO priority of the reactor thread (0 = normal scheduling)
+#define RT_PRIORITY_DEFAULT 0
+
+/// SCHED_FIFO priority of the GPIO interrupt thread (0 = leave wiringPi's choice)
+#define RT_ISR_PRIORITY_DEFAULT 0
+
+/// Lock the daemon's memory with mlockall() and pre-fault reserves
+#define RT_LOCK_MEMORY_DEFAULT 0
+
+/// Reactor stack pre-faulted when memory is locked (KiB)
+#define RT_PREFAULT_STACK_KB 256
+
+/// Heap reserve pre-faulted when memory is locked (KiB)
+#define RT_PREFAULT_HEAP_KB 1024
+
+/// Period of the scheduling latency probe in milliseconds (0 = off)
+#define RT_LATENCY_PROBE_MS 100
+
+// ============================================================================
+// SIMULATION CONFIGURATION
+// ============================================================================
+
+/// Unix socket replacing the L2CAP listener with --simulate
+#define SIMULATION_BT_SOCKET_PATH "/tmp/door_monitor_sim.sock"
+
+/// Abstract socket name prefix of loopback clients (see bluetooth_server.h)
+#define BT_LOOPBACK_CLIENT_PREFIX "door_monitor_sim/"
+
+/// Byte sent to a loopback client once its message is processed
+#define BT_LOOPBACK_ACK '+'
+
+/// Byte sent to a loopback client when its message could not be processed
+#define BT_LOOPBACK_NACK '-'
+
+/// Concurrent connections to the FCM stand-in
+#define FCM_STANDIN_MAX_CLIENTS 8
+
+/// Seconds before an idle stand-in connection is closed
+#define FCM_STANDIN_CLIENT_TIMEOUT 30
+
+/// Scenario file lines (events) accepted by the simulation
+#define SIMULATION_MAX_EVENTS 4096
+
+/// Simulated devices a scenario may name
+#define SIMULATION_MAX_DEVICES 64
+
+/// Iterations a scenario "bench" event may ask for
+#define SIMULATION_BENCH_MAX_ITERATIONS 100000
+
+/// Milliseconds a bench waits after each door edge and arrival for the daemon to catch up
+#define SIMULATION_BENCH_SETTLE_MS 20
+
+/// Milliseconds a bench iteration waits for the reminder to reach the stand-in
+#define SIMULATION_BENCH_TIMEOUT_MS 5000
+
+/// Real milliseconds the loop waits for announced I/O before the virtual clock jumps
+#define VIRTUAL_CLOCK_IDLE_MS 2
+
 // ============================================================================
 // NETWORK CONFIGURATION
 // ============================================================================
@@ -173,4 +467,7 @@
 /// Invalid parameter error
 #define ERROR_INVALID_PARAM -7
 
+/// Fixed capacity (devices, metric slots, ...) exhausted
+#define ERROR_CAPACITY_EXCEEDED -8
+
 #endif // CONFIG_H
\ No newline at end of file